@@ -2,9 +2,10 @@
 #include <Eigen/Dense>
 #include <Eigen/Cholesky>
 #include <iostream>
-#include <chrono>
 #include <cstdlib>
 
+#include "cpp_benchmark/benchmark.hpp"
+
 /*
 This code is entirely based on the examples from Eigen. 
 This file simply creates dynamic sized symmetric positive definite matrices and calls Eigen/Cholesky and times the calls. 
@@ -15,18 +16,6 @@ See instruction on Eigen's website: https://eigen.tuxfamily.org/dox/TopicUsingIn
 
 
 using namespace Eigen;
-namespace cn = std::chrono;
-cn::time_point<cn::high_resolution_clock> startTimer()
-{
-	return cn::high_resolution_clock::now();
-}
-
-double endTimer(cn::time_point<cn::high_resolution_clock> t1)
-{
-	auto t2 = cn::high_resolution_clock::now();
-	cn::duration<double> diff = t2 - t1;
-	return diff.count() * 1000;
-}
 
 MatrixXf genRandomPosDefMatrix(int size)
 {
@@ -45,22 +34,19 @@ MatrixXf genRandomPosDefMatrix(int size)
 
 int main(int argc, const char * argv[])
 {
-	int numRuns = 10;
-	for(int mSize = 4; mSize <= 4096; mSize *= 2)
+	bench::Config defaults;
+	defaults.repetitions = 10;
+	bench::Harness h(argc, argv, defaults);
+	for (int mSize : h.sweep(4, 4096))
 	{
 		MatrixXf A = genRandomPosDefMatrix(mSize);
 		MatrixXf L(mSize,mSize);
 
-		//Warm up run
-		L = A.ldlt().matrixL(); 
-
-		auto t1 = startTimer();	
-		for(int i = 0; i < numRuns; i++)
-			L = A.llt().matrixL(); 
-		auto time1 = endTimer(t1)/numRuns;
+		// n^3 / 3 flops, the matrix read and the factor written
+		bench::Work work((double)mSize * mSize * mSize / 3, (double)mSize * mSize * 2 * sizeof(float));
+		double time1 = h.time("Eigen", "LLt", mSize, [&] { L = A.llt().matrixL(); }, work);
 		//std::cout << "The Cholesky factor L is" << std::endl << L << std::endl;
 		std::cout << mSize << "\t\t" << time1 << " ms"<< std::endl;
 	}
 	return 0;
 }
-
@@ -0,0 +1,509 @@
+#ifndef _BENCH_BENCHMARK_HPP_
+#define _BENCH_BENCHMARK_HPP_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+#include "perf_counters.hpp"
+
+// Timing harness shared by the C++ examples, include as "cpp_benchmark/benchmark.hpp" with -I..
+// Every measurement is a number of warmup calls followed by timed samples; calls much shorter than the
+// clock's useful resolution are repeated within a sample, calibrated on the warmups. Samples are summarized
+// by their median, the median absolute deviation (MAD) and a 95% confidence interval of the median, which
+// unlike a mean are not thrown off by the odd sample hit by an interrupt or a frequency change, plus GFLOP/s
+// and GB/s from the work a call does, and with --counters the hardware counters per call (perf_counters.hpp).
+// Binaries print their own tables of medians; the full statistics go to stderr with --verbose and to CSV and
+// JSON files for comparisons across runs and machines
+// Command line options, common to all binaries, see usage()
+
+namespace bench {
+
+	/// Settings from the command line, on top of defaults chosen by each binary
+	struct Config
+	{
+		int warmups = 1;
+		int repetitions = 5; // timed samples per measurement
+		double minSampleMs = 1; // calls shorter than this are repeated within a sample
+		std::vector<int> sizes; // replaces the default size sweeps, within the range of each
+		int minSize = 0;
+		int maxSize = 1 << 30;
+		std::vector<std::string> only; // tables to run, all if empty
+		int pinCore = -1; // core the timing thread is pinned to, -1 leaves it to the scheduler
+		std::string csvPath;
+		std::string jsonPath;
+		bool verbose = false;
+		bool counters = false; // print the counter tables, and count the library regions
+	};
+
+	/// Work done by one call, for the rates
+	struct Work
+	{
+		Work(double flops = 0, double bytes = 0) : flops(flops), bytes(bytes) {}
+
+		double flops;
+		double bytes; // read plus written
+	};
+
+	/// Summary of the samples of one measurement, in milliseconds per call
+	struct Stats
+	{
+		int samples = 0;
+		double median = 0;
+		double mad = 0; // median absolute deviation from the median, unscaled
+		double mean = 0;
+		double stddev = 0;
+		double min = 0;
+		double max = 0;
+		double ciLow = 0; // 95% confidence interval of the median
+		double ciHigh = 0;
+	};
+
+	static inline double medianOfSorted(const std::vector<double> & v)
+	{
+		size_t n = v.size();
+		return n == 0 ? 0 : n % 2 ? v[n / 2] : (v[n / 2 - 1] + v[n / 2]) / 2;
+	}
+
+	/// The confidence interval is distribution-free: the order statistics of ranks n / 2 -+ 1.96 sqrt(n) / 2,
+	/// from the normal approximation of the binomial distribution; with fewer than 6 samples it is [min, max]
+	inline Stats summarize(std::vector<double> samples)
+	{
+		Stats s;
+		int n = (int)samples.size();
+		s.samples = n;
+		if (n == 0)
+			return s;
+		std::sort(samples.begin(), samples.end());
+		s.median = medianOfSorted(samples);
+		s.min = samples.front();
+		s.max = samples.back();
+		double sum = 0, sum2 = 0;
+		std::vector<double> dev(n);
+		for (int i = 0; i < n; i++)
+		{
+			sum += samples[i];
+			sum2 += samples[i] * samples[i];
+			dev[i] = std::abs(samples[i] - s.median);
+		}
+		s.mean = sum / n;
+		s.stddev = n > 1 ? std::sqrt(std::max(0.0, (sum2 - sum * s.mean) / (n - 1))) : 0;
+		std::sort(dev.begin(), dev.end());
+		s.mad = medianOfSorted(dev);
+		// 1-based ranks
+		int lo = (int)std::floor((n - 1.96 * std::sqrt((double)n)) / 2);
+		int hi = (int)std::ceil(1 + (n + 1.96 * std::sqrt((double)n)) / 2);
+		s.ciLow = samples[std::max(1, lo) - 1];
+		s.ciHigh = samples[std::min(n, hi) - 1];
+		return s;
+	}
+
+	/// One measurement
+	struct Result
+	{
+		std::string table;
+		std::string label;
+		long size = 0;
+		Stats stats;
+		Work work;
+		long callsPerSample = 1;
+		long calls = 0; // warmups included
+		CounterValues counters; // per call of the timed samples, of the timing thread only; measure() with --counters only
+
+		double gflops() const { return stats.median > 0 ? work.flops / stats.median * 1e-6 : 0; }
+		double gbs() const { return stats.median > 0 ? work.bytes / stats.median * 1e-6 : 0; }
+	};
+
+	/// Pins the calling thread to a core, returns false where that is not supported or not allowed
+	inline bool pinCurrentThread(int core)
+	{
+#ifdef __linux__
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(core, &set);
+		return sched_setaffinity(0, sizeof(set), &set) == 0;
+#else
+		(void)core;
+		return false;
+#endif
+	}
+
+	inline void usage(std::ostream & os, const char * binary)
+	{
+		os << "Usage: " << binary << " [options]\n"
+			<< "  --warmups N        untimed calls before each measurement\n"
+			<< "  --reps N           timed samples per measurement\n"
+			<< "  --min-sample-ms X  repeat shorter calls within one sample\n"
+			<< "  --sizes LIST       sizes to run instead of the default sweeps, a,b,c or from:to[:factor]\n"
+			<< "  --min-size N       skip smaller sizes\n"
+			<< "  --max-size N       skip larger sizes\n"
+			<< "  --only T1,T2       run these tables only\n"
+			<< "  --pin CORE         pin the timing thread to a core\n"
+			<< "  --csv FILE         write every measurement as CSV\n"
+			<< "  --json FILE        write every measurement as JSON\n"
+			<< "  --verbose          print the statistics of every measurement to stderr\n"
+			<< "  --counters         print hardware counters per measurement and per library region,\n"
+			<< "                     region counting adds a few microseconds per region to the timings\n"
+			<< "  --help\n";
+	}
+
+	static inline std::vector<std::string> splitList(const std::string & s)
+	{
+		std::vector<std::string> parts;
+		size_t start = 0;
+		for (;;)
+		{
+			size_t comma = s.find(',', start);
+			parts.push_back(s.substr(start, comma - start));
+			if (comma == std::string::npos)
+				return parts;
+			start = comma + 1;
+		}
+	}
+
+	static inline int parseInt(const std::string & option, const std::string & value)
+	{
+		char * end;
+		long v = std::strtol(value.c_str(), &end, 10);
+		if (value.empty() || *end)
+			throw std::invalid_argument(option + ": not an integer: " + value);
+		return (int)v;
+	}
+
+	// a,b,c or from:to[:factor]
+	static inline std::vector<int> parseSizes(const std::string & value)
+	{
+		std::vector<int> sizes;
+		for (const std::string & part : splitList(value))
+		{
+			size_t colon = part.find(':');
+			if (colon == std::string::npos)
+			{
+				sizes.push_back(parseInt("--sizes", part));
+				continue;
+			}
+			size_t colon2 = part.find(':', colon + 1);
+			int from = parseInt("--sizes", part.substr(0, colon));
+			int to = parseInt("--sizes", part.substr(colon + 1, colon2 - colon - 1));
+			int factor = colon2 == std::string::npos ? 2 : parseInt("--sizes", part.substr(colon2 + 1));
+			if (from < 1 || factor < 2)
+				throw std::invalid_argument("--sizes: bad range " + part);
+			for (long s = from; s <= to; s *= factor)
+				sizes.push_back((int)s);
+		}
+		return sizes;
+	}
+
+	/// Runs and records the measurements of one binary
+	class Harness
+	{
+	public:
+		/// Parses the command line over defaults, prints the usage and exits on --help
+		/// Throws std::invalid_argument on unknown options or bad values
+		Harness(int argc, const char * argv[], Config defaults = Config()) : m_config(defaults), m_binary(argc > 0 ? argv[0] : "")
+		{
+			for (int i = 1; i < argc; i++)
+			{
+				std::string option = argv[i];
+				if (option == "--help")
+				{
+					usage(std::cout, argv[0]);
+					std::exit(0);
+				}
+				if (option == "--verbose")
+				{
+					m_config.verbose = true;
+					continue;
+				}
+				if (option == "--counters")
+				{
+					m_config.counters = true;
+					continue;
+				}
+				if (i + 1 >= argc)
+					throw std::invalid_argument(option + ": missing value");
+				std::string value = argv[++i];
+				if (option == "--warmups")
+					m_config.warmups = std::max(0, parseInt(option, value));
+				else if (option == "--reps")
+					m_config.repetitions = std::max(1, parseInt(option, value));
+				else if (option == "--min-sample-ms")
+					m_config.minSampleMs = std::atof(value.c_str());
+				else if (option == "--sizes")
+					m_config.sizes = parseSizes(value);
+				else if (option == "--min-size")
+					m_config.minSize = parseInt(option, value);
+				else if (option == "--max-size")
+					m_config.maxSize = parseInt(option, value);
+				else if (option == "--only")
+					m_config.only = splitList(value);
+				else if (option == "--pin")
+					m_config.pinCore = parseInt(option, value);
+				else if (option == "--csv")
+					m_config.csvPath = value;
+				else if (option == "--json")
+					m_config.jsonPath = value;
+				else
+					throw std::invalid_argument("unknown option " + option);
+			}
+			if (m_config.pinCore >= 0 && !pinCurrentThread(m_config.pinCore))
+				std::cerr << "warning: cannot pin to core " << m_config.pinCore << std::endl;
+			if (m_config.counters)
+				enableRegionCounting(true);
+		}
+
+		~Harness() { write(); }
+
+		Harness(const Harness &) = delete;
+		Harness & operator=(const Harness &) = delete;
+
+		const Config & config() const { return m_config; }
+
+		/// Whether a table was selected with --only
+		bool enabled(const std::string & table) const
+		{
+			return m_config.only.empty() || std::find(m_config.only.begin(), m_config.only.end(), table) != m_config.only.end();
+		}
+
+		/// Sizes for a table: from, from * factor, ... up to to, or the --sizes within that range, and within --min/max-size
+		std::vector<int> sweep(int from, int to, int factor = 2) const
+		{
+			std::vector<int> sizes;
+			for (long s = from; s <= to; s *= factor)
+				sizes.push_back((int)s);
+			return sweep(sizes);
+		}
+
+		std::vector<int> sweep(const std::vector<int> & defaults) const
+		{
+			std::vector<int> sizes;
+			if (defaults.empty())
+				return sizes;
+			int lo = *std::min_element(defaults.begin(), defaults.end());
+			int hi = *std::max_element(defaults.begin(), defaults.end());
+			for (int s : m_config.sizes.empty() ? defaults : m_config.sizes)
+				if (s >= std::max(lo, m_config.minSize) && s <= std::min(hi, m_config.maxSize))
+					sizes.push_back(s);
+			return sizes;
+		}
+
+		/// Times f, see the top of the file, and records the result
+		const Result & measure(const std::string & table, const std::string & label, long size, const std::function<void()> & f, Work work = Work())
+		{
+			typedef std::chrono::steady_clock Clock;
+			auto run = [&](long n)
+			{
+				auto t = Clock::now();
+				for (long i = 0; i < n; i++)
+					f();
+				return std::chrono::duration<double, std::milli>(Clock::now() - t).count();
+			};
+			double fastest = 0;
+			for (int w = 0; w < m_config.warmups; w++)
+			{
+				double ms = run(1);
+				fastest = w == 0 ? ms : std::min(fastest, ms);
+			}
+			long perSample = 1;
+			if (m_config.warmups > 0 && fastest < m_config.minSampleMs)
+				perSample = (long)std::ceil(m_config.minSampleMs / std::max(fastest, 1e-6));
+			// With --counters only, read outside of the timed samples
+			CounterValues before, after;
+			if (m_config.counters)
+				before = threadCounters().read();
+			std::vector<double> samples(m_config.repetitions);
+			for (double & sample : samples)
+				sample = run(perSample) / perSample;
+			if (m_config.counters)
+				after = threadCounters().read();
+			Result & r = add(table, label, size, samples, work);
+			if (m_config.counters)
+				r.counters = (after - before) / ((double)perSample * m_config.repetitions);
+			r.callsPerSample = perSample;
+			r.calls = m_config.warmups + perSample * m_config.repetitions;
+			report(r);
+			return r;
+		}
+
+		/// Median milliseconds per call of measure()
+		double time(const std::string & table, const std::string & label, long size, const std::function<void()> & f, Work work = Work())
+		{
+			return measure(table, label, size, f, work).stats.median;
+		}
+
+		/// Records samples timed by the caller, in milliseconds per call, e.g. a part of a call
+		const Result & record(const std::string & table, const std::string & label, long size, const std::vector<double> & samplesMs, Work work = Work())
+		{
+			Result & r = add(table, label, size, samplesMs, work);
+			r.calls = (long)samplesMs.size();
+			report(r);
+			return r;
+		}
+
+		const std::vector<Result> & results() const { return m_results; }
+
+		/// With --counters: the counters per call of every measurement, then the totals of the library regions
+		void printCounters(std::ostream & os) const
+		{
+			if (!m_config.counters)
+				return;
+			const PerfCounters & counters = threadCounters();
+			if (!counters.available())
+			{
+				os << "Hardware counters not available: " << counters.error() << std::endl;
+				return;
+			}
+			char sep = ',';
+			os << "Table" << sep << "Label" << sep << "Size" << sep << "Cycles" << sep << "Instructions" << sep << "IPC" << sep
+				<< "L1D-MPKI" << sep << "LLC-MPKI" << sep << "Branch-MPKI" << sep << "GHz" << std::endl;
+			for (const Result & r : m_results)
+				if (r.counters.has(CYCLES))
+				{
+					os << r.table << sep << r.label << sep << r.size << sep;
+					printCounters(os, r.counters, sep);
+				}
+			if (counterRegions().empty())
+				return;
+			os << "Region" << sep << "Calls" << sep << "Cycles" << sep << "Instructions" << sep << "IPC" << sep
+				<< "L1D-MPKI" << sep << "LLC-MPKI" << sep << "Branch-MPKI" << sep << "GHz" << std::endl;
+			for (const CounterRegion & region : counterRegions())
+			{
+				os << region.name << sep << region.calls << sep;
+				printCounters(os, region.calls > 0 ? region.total / region.calls : region.total, sep);
+			}
+		}
+
+		/// Writes the --csv and --json files, again on destruction
+		void write() const
+		{
+			if (!m_config.csvPath.empty())
+			{
+				std::ofstream os(m_config.csvPath);
+				os << "binary,table,label,size,samples,calls_per_sample,median_ms,mad_ms,mean_ms,stddev_ms,min_ms,max_ms,"
+					<< "ci_low_ms,ci_high_ms,flops,bytes,gflops,gbs,cycles,instructions,ipc,l1d_mpki,llc_mpki,branch_mpki,ghz\n";
+				for (const Result & r : m_results)
+				{
+					const Stats & s = r.stats;
+					os << m_binary << ',' << r.table << ',' << r.label << ',' << r.size << ',' << s.samples << ',' << r.callsPerSample << ','
+						<< s.median << ',' << s.mad << ',' << s.mean << ',' << s.stddev << ',' << s.min << ',' << s.max << ','
+						<< s.ciLow << ',' << s.ciHigh << ',' << r.work.flops << ',' << r.work.bytes << ',' << r.gflops() << ',' << r.gbs();
+					// Empty where a counter could not be read
+					const CounterValues & c = r.counters;
+					os << ',' << optional(c.has(CYCLES), c.value[CYCLES], "") << ',' << optional(c.has(INSTRUCTIONS), c.value[INSTRUCTIONS], "")
+						<< ',' << optional(c.ipc() > 0, c.ipc(), "") << ',' << optional(c.has(L1D_MISSES), c.perKiloInstructions(L1D_MISSES), "")
+						<< ',' << optional(c.has(LLC_MISSES), c.perKiloInstructions(LLC_MISSES), "")
+						<< ',' << optional(c.has(BRANCH_MISSES), c.perKiloInstructions(BRANCH_MISSES), "") << ',' << optional(c.ghz() > 0, c.ghz(), "") << '\n';
+				}
+			}
+			if (!m_config.jsonPath.empty())
+			{
+				std::ofstream os(m_config.jsonPath);
+				os << "{\n  \"binary\": " << quote(m_binary) << ",\n  \"warmups\": " << m_config.warmups
+					<< ",\n  \"repetitions\": " << m_config.repetitions << ",\n  \"minSampleMs\": " << m_config.minSampleMs
+					<< ",\n  \"pinCore\": " << m_config.pinCore << ",\n  \"hardwareThreads\": " << std::thread::hardware_concurrency()
+					<< ",\n  \"results\": [";
+				for (size_t i = 0; i < m_results.size(); i++)
+				{
+					const Result & r = m_results[i];
+					const Stats & s = r.stats;
+					os << (i ? "," : "") << "\n    {\"table\": " << quote(r.table) << ", \"label\": " << quote(r.label) << ", \"size\": " << r.size
+						<< ", \"samples\": " << s.samples << ", \"callsPerSample\": " << r.callsPerSample
+						<< ", \"medianMs\": " << s.median << ", \"madMs\": " << s.mad << ", \"meanMs\": " << s.mean << ", \"stddevMs\": " << s.stddev
+						<< ", \"minMs\": " << s.min << ", \"maxMs\": " << s.max << ", \"ciLowMs\": " << s.ciLow << ", \"ciHighMs\": " << s.ciHigh
+						<< ", \"flops\": " << r.work.flops << ", \"bytes\": " << r.work.bytes << ", \"gflops\": " << r.gflops() << ", \"gbs\": " << r.gbs();
+					const CounterValues & c = r.counters;
+					os << ", \"cycles\": " << optional(c.has(CYCLES), c.value[CYCLES], "null")
+						<< ", \"instructions\": " << optional(c.has(INSTRUCTIONS), c.value[INSTRUCTIONS], "null")
+						<< ", \"ipc\": " << optional(c.ipc() > 0, c.ipc(), "null")
+						<< ", \"l1dMpki\": " << optional(c.has(L1D_MISSES), c.perKiloInstructions(L1D_MISSES), "null")
+						<< ", \"llcMpki\": " << optional(c.has(LLC_MISSES), c.perKiloInstructions(LLC_MISSES), "null")
+						<< ", \"branchMpki\": " << optional(c.has(BRANCH_MISSES), c.perKiloInstructions(BRANCH_MISSES), "null")
+						<< ", \"ghz\": " << optional(c.ghz() > 0, c.ghz(), "null") << "}";
+				}
+				os << "\n  ]\n}\n";
+			}
+		}
+
+	private:
+		Result & add(const std::string & table, const std::string & label, long size, const std::vector<double> & samples, Work work)
+		{
+			Result r;
+			r.table = table;
+			r.label = label;
+			r.size = size;
+			r.stats = summarize(samples);
+			r.work = work;
+			m_results.push_back(r);
+			return m_results.back();
+		}
+
+		void report(const Result & r) const
+		{
+			if (!m_config.verbose)
+				return;
+			const Stats & s = r.stats;
+			std::cerr << r.table << '/' << r.label << ' ' << r.size << ": median " << s.median << " ms, MAD " << s.mad
+				<< " ms, 95% CI [" << s.ciLow << ", " << s.ciHigh << "], " << s.samples << " x " << r.callsPerSample << " calls";
+			if (r.work.flops > 0)
+				std::cerr << ", " << r.gflops() << " GFLOP/s";
+			if (r.work.bytes > 0)
+				std::cerr << ", " << r.gbs() << " GB/s";
+			if (r.counters.ipc() > 0)
+				std::cerr << ", IPC " << r.counters.ipc();
+			if (r.counters.has(L1D_MISSES) && r.counters.has(INSTRUCTIONS))
+				std::cerr << ", L1D MPKI " << r.counters.perKiloInstructions(L1D_MISSES);
+			if (r.counters.has(LLC_MISSES) && r.counters.has(INSTRUCTIONS))
+				std::cerr << ", LLC MPKI " << r.counters.perKiloInstructions(LLC_MISSES);
+			std::cerr << std::endl;
+		}
+
+		static void printCounters(std::ostream & os, const CounterValues & c, char sep)
+		{
+			os << optional(c.has(CYCLES), c.value[CYCLES], "n/a") << sep << optional(c.has(INSTRUCTIONS), c.value[INSTRUCTIONS], "n/a") << sep
+				<< optional(c.ipc() > 0, c.ipc(), "n/a") << sep << optional(c.has(L1D_MISSES), c.perKiloInstructions(L1D_MISSES), "n/a") << sep
+				<< optional(c.has(LLC_MISSES), c.perKiloInstructions(LLC_MISSES), "n/a") << sep
+				<< optional(c.has(BRANCH_MISSES), c.perKiloInstructions(BRANCH_MISSES), "n/a") << sep
+				<< optional(c.ghz() > 0, c.ghz(), "n/a") << std::endl;
+		}
+
+		// The value, or the placeholder where there is none
+		static std::string optional(bool has, double value, const char * none)
+		{
+			if (!has)
+				return none;
+			std::ostringstream os;
+			os << value;
+			return os.str();
+		}
+
+		static std::string quote(const std::string & s)
+		{
+			std::string q = "\"";
+			for (char c : s)
+			{
+				if (c == '"' || c == '\\')
+					q += '\\';
+				q += c;
+			}
+			return q + "\"";
+		}
+
+		Config m_config;
+		std::string m_binary;
+		std::vector<Result> m_results;
+	};
+
+}
+#endif
@@ -0,0 +1,261 @@
+#ifndef _BENCH_PERF_COUNTERS_HPP_
+#define _BENCH_PERF_COUNTERS_HPP_
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#endif
+
+// Hardware performance counters of the calling thread through Linux perf_event_open, in user mode only so that
+// the default perf_event_paranoid setting of 2 allows them
+// Cycles and instructions do not depend on the clock frequency, unlike wall-clock times with Turbo Boost on, and
+// the miss counts tell a kernel limited by memory from one limited by arithmetic
+// Each event is opened on its own: whatever the CPU, the kernel or the container does not provide is left out
+// (virtual machines often have no hardware events at all), and with more events than hardware counters the
+// kernel time-shares them, the counts are then scaled by enabled / running time
+//
+// Regions: a ScopedCounters object adds the counts between its construction and destruction to a named
+// CounterRegion. Regions are off unless enableRegionCounting(true), then every scope costs two reads of all the
+// counters, a few microseconds, so scopes go around whole loops and not around single kernel calls
+// Counts are per thread, a region entered from several threads sums them
+
+namespace bench {
+
+	enum Counter
+	{
+		CYCLES,
+		INSTRUCTIONS,
+		L1D_MISSES, // L1 data cache read misses
+		LLC_MISSES, // last level cache misses
+		BRANCH_MISSES,
+		TASK_CLOCK, // nanoseconds on a CPU, a software event, so it usually works where the others do not
+		NUM_COUNTERS
+	};
+
+	inline const char * counterName(int c)
+	{
+		static const char * names[NUM_COUNTERS] = { "cycles", "instructions", "l1d_misses", "llc_misses", "branch_misses", "task_clock_ns" };
+		return names[c];
+	}
+
+	/// Counts, or differences of counts, with the counters that could be read
+	struct CounterValues
+	{
+		double value[NUM_COUNTERS] = {};
+		bool valid[NUM_COUNTERS] = {};
+
+		bool has(Counter c) const { return valid[c]; }
+
+		/// Instructions per cycle, 0 without both counters
+		double ipc() const { return has(CYCLES) && has(INSTRUCTIONS) && value[CYCLES] > 0 ? value[INSTRUCTIONS] / value[CYCLES] : 0; }
+
+		/// Events per thousand instructions (MPKI for misses), 0 without both counters
+		double perKiloInstructions(Counter c) const
+		{
+			return has(c) && has(INSTRUCTIONS) && value[INSTRUCTIONS] > 0 ? 1000 * value[c] / value[INSTRUCTIONS] : 0;
+		}
+
+		/// Average clock frequency while running, 0 without cycles and task clock
+		double ghz() const { return has(CYCLES) && has(TASK_CLOCK) && value[TASK_CLOCK] > 0 ? value[CYCLES] / value[TASK_CLOCK] : 0; }
+
+		CounterValues & operator+=(const CounterValues & other)
+		{
+			for (int c = 0; c < NUM_COUNTERS; c++)
+			{
+				value[c] += other.value[c];
+				valid[c] = valid[c] || other.valid[c];
+			}
+			return *this;
+		}
+
+		CounterValues operator-(const CounterValues & other) const
+		{
+			CounterValues d;
+			for (int c = 0; c < NUM_COUNTERS; c++)
+			{
+				d.valid[c] = valid[c] && other.valid[c];
+				d.value[c] = d.valid[c] ? value[c] - other.value[c] : 0;
+			}
+			return d;
+		}
+
+		CounterValues operator/(double divisor) const
+		{
+			CounterValues q = *this;
+			for (int c = 0; c < NUM_COUNTERS; c++)
+				q.value[c] /= divisor;
+			return q;
+		}
+	};
+
+	/// The counters of the thread that creates it, counting from construction on
+	class PerfCounters
+	{
+	public:
+		PerfCounters()
+		{
+			for (int c = 0; c < NUM_COUNTERS; c++)
+				m_fd[c] = -1;
+#ifdef __linux__
+			const unsigned long long cache = PERF_COUNT_HW_CACHE_OP_READ << 8 | PERF_COUNT_HW_CACHE_RESULT_MISS << 16;
+			open(CYCLES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+			open(INSTRUCTIONS, PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+			open(L1D_MISSES, PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cache);
+			open(LLC_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+			open(BRANCH_MISSES, PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+			open(TASK_CLOCK, PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK);
+#else
+			m_error = "perf_event_open is Linux only";
+#endif
+		}
+
+		~PerfCounters()
+		{
+			for (int c = 0; c < NUM_COUNTERS; c++)
+				if (m_fd[c] >= 0)
+					close(m_fd[c]);
+		}
+
+		PerfCounters(const PerfCounters &) = delete;
+		PerfCounters & operator=(const PerfCounters &) = delete;
+
+		/// Whether cycles and instructions can be read, the least for the numbers to mean anything
+		bool available() const { return m_fd[CYCLES] >= 0 && m_fd[INSTRUCTIONS] >= 0; }
+
+		bool available(Counter c) const { return m_fd[c] >= 0; }
+
+		/// Why the first counter that failed could not be opened, empty if all are open
+		const std::string & error() const { return m_error; }
+
+		/// Counts since construction
+		CounterValues read() const
+		{
+			CounterValues v;
+			for (int c = 0; c < NUM_COUNTERS; c++)
+			{
+				unsigned long long data[3]; // value, time enabled, time running
+				if (m_fd[c] < 0 || ::read(m_fd[c], data, sizeof(data)) != (ssize_t)sizeof(data))
+					continue;
+				v.valid[c] = true;
+				v.value[c] = data[2] == 0 ? 0 : data[2] < data[1] ? (double)data[0] * data[1] / data[2] : (double)data[0];
+			}
+			return v;
+		}
+
+	private:
+#ifdef __linux__
+		void open(Counter c, unsigned type, unsigned long long config)
+		{
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = type;
+			attr.config = config;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			m_fd[c] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+			if (m_fd[c] < 0 && m_error.empty())
+				m_error = std::string(counterName(c)) + ": " + strerror(errno);
+		}
+#endif
+
+		int m_fd[NUM_COUNTERS];
+		std::string m_error;
+	};
+
+	/// The counters of the calling thread, opened on first use
+	inline PerfCounters & threadCounters()
+	{
+		static thread_local PerfCounters counters;
+		return counters;
+	}
+
+	/// Counts accumulated over all the scopes of one name
+	struct CounterRegion
+	{
+		explicit CounterRegion(const std::string & name) : name(name) {}
+
+		void add(const CounterValues & delta)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			total += delta;
+			calls++;
+		}
+
+		std::string name;
+		CounterValues total;
+		long calls = 0;
+		std::mutex mutex;
+	};
+
+	inline std::atomic<bool> & regionCountingFlag()
+	{
+		static std::atomic<bool> enabled(false);
+		return enabled;
+	}
+
+	/// Turns the ScopedCounters on or off
+	inline void enableRegionCounting(bool enable) { regionCountingFlag() = enable; }
+
+	inline bool regionCountingEnabled() { return regionCountingFlag().load(std::memory_order_relaxed); }
+
+	/// All regions, in order of first use; elements are never moved
+	inline std::deque<CounterRegion> & counterRegions()
+	{
+		static std::deque<CounterRegion> regions;
+		return regions;
+	}
+
+	/// The region of a name, created on first use
+	inline CounterRegion & counterRegion(const std::string & name)
+	{
+		static std::mutex mutex;
+		std::lock_guard<std::mutex> lock(mutex);
+		std::deque<CounterRegion> & regions = counterRegions();
+		for (CounterRegion & r : regions)
+			if (r.name == name)
+				return r;
+		regions.emplace_back(name);
+		return regions.back();
+	}
+
+	/// Adds the counts of the enclosing scope to a region, does nothing while region counting is off
+	class ScopedCounters
+	{
+	public:
+		explicit ScopedCounters(CounterRegion & region) : m_region(regionCountingEnabled() ? &region : NULL)
+		{
+			if (m_region)
+				m_start = threadCounters().read();
+		}
+
+		~ScopedCounters()
+		{
+			if (m_region)
+				m_region->add(threadCounters().read() - m_start);
+		}
+
+		ScopedCounters(const ScopedCounters &) = delete;
+		ScopedCounters & operator=(const ScopedCounters &) = delete;
+
+	private:
+		CounterRegion * m_region;
+		CounterValues m_start;
+	};
+
+}
+
+/// Counts the rest of the enclosing scope into the region of a name, looked up once per call site
+#define BENCH_COUNTERS_SCOPE(name) \
+	static bench::CounterRegion & benchCounterRegion_ = bench::counterRegion(name); \
+	bench::ScopedCounters benchCounterScope_(benchCounterRegion_)
+
+#endif
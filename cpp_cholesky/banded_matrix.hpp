@@ -0,0 +1,207 @@
+#ifndef _LINALG_BANDED_MATRIX_HPP_
+#define _LINALG_BANDED_MATRIX_HPP_
+
+#include "matrix.hpp"
+#include <algorithm>
+
+namespace linalg{
+
+// Lower band of a symmetric matrix with A(r, c) == 0 for r - c > bandwidth, O(n * bandwidth) memory
+// Row r keeps columns r - bandwidth .. r contiguously, right-aligned in a row of stride elements,
+// so the part of two rows left of a diagonal is a pair of plain vectors for the dot product kernels
+// The first bandwidth rows start with padding that is kept at zero
+template<typename T>
+class BandedLowerMatrix
+{
+public:
+	BandedLowerMatrix(int n, int bandwidth) : rows(n), cols(n), bandwidth(bandwidth), stride(util::getColStride(bandwidth + 1))
+	{
+		assert(bandwidth >= 0);
+		data = linalg::util::alignedCalloc<T>(size(), sizeof(T), MEM_ALIGNMENT);
+		memset(data, 0, size() * sizeof(T));
+	}
+
+	/// Band of the lower triangle of M, entries outside the band are not read
+	BandedLowerMatrix(const Matrix<T> & M, int bandwidth) : BandedLowerMatrix(M.rows, bandwidth)
+	{
+		pack(M);
+	}
+
+	BandedLowerMatrix(const BandedLowerMatrix & B) : rows(B.rows), cols(B.cols), bandwidth(B.bandwidth), stride(B.stride)
+	{
+		data = linalg::util::alignedCalloc<T>(size(), sizeof(T), MEM_ALIGNMENT);
+		memcpy(data, B.data, size() * sizeof(T));
+	}
+
+	~BandedLowerMatrix()
+	{
+		free(data);
+	}
+
+	BandedLowerMatrix & operator=(const BandedLowerMatrix & B)
+	{
+		assert(rows == B.rows && bandwidth == B.bandwidth);
+		memcpy(data, B.data, size() * sizeof(T));
+		return *this;
+	}
+
+	//data can only be owned by one copy
+	BandedLowerMatrix & operator=(BandedLowerMatrix && B)
+	{
+		assert(rows == B.rows && bandwidth == B.bandwidth);
+		free(data);
+		data = B.data;
+		B.data = 0;
+		return *this;
+	}
+
+	void pack(const Matrix<T> & M)
+	{
+		assert(M.rows == rows && M.cols == cols);
+		for (int r = 0; r < rows; r++)
+			for (int c = firstCol(r); c <= r; c++)
+				(*this)(r, c) = M(r, c);
+	}
+
+	/// Full matrix, zero outside the band, the upper triangle mirrors the lower one
+	Matrix<T> toMatrix() const
+	{
+		Matrix<T> M(rows, cols);
+		for (int r = 0; r < rows; r++)
+			for (int c = 0; c < cols; c++)
+				M(r, c) = 0;
+		for (int r = 0; r < rows; r++)
+			for (int c = firstCol(r); c <= r; c++)
+				M(r, c) = M(c, r) = (*this)(r, c);
+		return M;
+	}
+
+	/// First column of the band in row r
+	int firstCol(int r) const { return std::max(0, r - bandwidth); }
+	bool inBand(int r, int c) const { return c <= r && r - c <= bandwidth; }
+
+	/// Element (r, c) of the band, r - bandwidth <= c <= r
+	T & operator()(int r, int c) { return data[(size_t)r * stride + c - r + bandwidth]; }
+	const T & operator()(int r, int c) const { return data[(size_t)r * stride + c - r + bandwidth]; }
+
+	/// Number of stored elements, padding included
+	size_t size() const { return (size_t)rows * stride; }
+
+	int rows;
+	int cols;
+	int bandwidth;
+	int stride;
+
+	T * data;
+};
+
+// Symmetric block-tridiagonal matrix of numBlocks x numBlocks blocks of blockSize x blockSize:
+// the diagonal blocks and the blocks right below them, everything else is zero
+// Each block is a contiguous row-major blockSize x stride array, the diagonal blocks first
+template<typename T>
+class BlockTridiagonalMatrix
+{
+public:
+	BlockTridiagonalMatrix(int numBlocks, int blockSize)
+		: rows(numBlocks * blockSize), cols(numBlocks * blockSize), numBlocks(numBlocks), blockSize(blockSize), stride(util::getColStride(blockSize))
+	{
+		assert(numBlocks > 0 && blockSize > 0);
+		data = linalg::util::alignedCalloc<T>(size(), sizeof(T), MEM_ALIGNMENT);
+		memset(data, 0, size() * sizeof(T));
+	}
+
+	/// Blocks of the lower triangle of M, the rest of M is not read
+	BlockTridiagonalMatrix(const Matrix<T> & M, int blockSize) : BlockTridiagonalMatrix(M.rows / blockSize, blockSize)
+	{
+		assert(M.rows % blockSize == 0);
+		pack(M);
+	}
+
+	BlockTridiagonalMatrix(const BlockTridiagonalMatrix & B)
+		: rows(B.rows), cols(B.cols), numBlocks(B.numBlocks), blockSize(B.blockSize), stride(B.stride)
+	{
+		data = linalg::util::alignedCalloc<T>(size(), sizeof(T), MEM_ALIGNMENT);
+		memcpy(data, B.data, size() * sizeof(T));
+	}
+
+	~BlockTridiagonalMatrix()
+	{
+		free(data);
+	}
+
+	BlockTridiagonalMatrix & operator=(const BlockTridiagonalMatrix & B)
+	{
+		assert(numBlocks == B.numBlocks && blockSize == B.blockSize);
+		memcpy(data, B.data, size() * sizeof(T));
+		return *this;
+	}
+
+	//data can only be owned by one copy
+	BlockTridiagonalMatrix & operator=(BlockTridiagonalMatrix && B)
+	{
+		assert(numBlocks == B.numBlocks && blockSize == B.blockSize);
+		free(data);
+		data = B.data;
+		B.data = 0;
+		return *this;
+	}
+
+	void pack(const Matrix<T> & M)
+	{
+		assert(M.rows == rows && M.cols == cols);
+		for (int k = 0; k < numBlocks; k++)
+			for (int r = 0; r < blockSize; r++)
+				for (int c = 0; c < blockSize; c++)
+				{
+					diagonalBlock(k)(r, c) = M(k * blockSize + r, k * blockSize + c);
+					if (k + 1 < numBlocks)
+						subBlock(k)(r, c) = M((k + 1) * blockSize + r, k * blockSize + c);
+				}
+	}
+
+	/// Full matrix, the upper triangle mirrors the lower one
+	/// Only the lower triangle of the diagonal blocks is read, as for a factor
+	Matrix<T> toMatrix() const
+	{
+		Matrix<T> M(rows, cols);
+		for (int r = 0; r < rows; r++)
+			for (int c = 0; c < cols; c++)
+				M(r, c) = 0;
+		for (int k = 0; k < numBlocks; k++)
+			for (int r = 0; r < blockSize; r++)
+				for (int c = 0; c < blockSize; c++)
+				{
+					int i = k * blockSize + r;
+					int j = k * blockSize + c;
+					if (c <= r)
+						M(i, j) = M(j, i) = diagonalBlock(k)(r, c);
+					if (k + 1 < numBlocks)
+						M(i + blockSize, j) = M(j, i + blockSize) = subBlock(k)(r, c);
+				}
+		return M;
+	}
+
+	/// Block (k, k)
+	MatrixView<T> diagonalBlock(int k) { return MatrixView<T>(data + blockOffset(k), blockSize, blockSize, stride); }
+	MatrixView<const T> diagonalBlock(int k) const { return MatrixView<const T>(data + blockOffset(k), blockSize, blockSize, stride); }
+	/// Block (k + 1, k), k < numBlocks - 1
+	MatrixView<T> subBlock(int k) { return MatrixView<T>(data + blockOffset(numBlocks + k), blockSize, blockSize, stride); }
+	MatrixView<const T> subBlock(int k) const { return MatrixView<const T>(data + blockOffset(numBlocks + k), blockSize, blockSize, stride); }
+
+	/// Number of stored elements, padding included
+	size_t size() const { return (size_t)(2 * numBlocks - 1) * blockSize * stride; }
+
+	int rows;
+	int cols;
+	int numBlocks;
+	int blockSize;
+	int stride;
+
+	T * data;
+
+private:
+	size_t blockOffset(int b) const { return (size_t)b * blockSize * stride; }
+};
+
+}
+#endif
@@ -2,55 +2,292 @@
 #define _LINALG_CHOLESKY_HPP_
 
 #include "matrix.hpp"
+#include "thread_pool.hpp"
+#include "cholesky_kernels.hpp"
+#include "cpu_features.hpp"
+#include "cpp_benchmark/perf_counters.hpp"
 #include <iostream>
 #include <functional>
 #include <cmath>
 #include <vector>
+#include <memory>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <limits>
 
 namespace linalg{
 
+	// SSE, AVX, FMA and AVX512 select the column-by-column algorithm with that instruction set
+	// BLOCKED, PARALLEL and AUTO use the widest kernels the CPU supports, AUTO also picks the algorithm
 #ifdef HAVE_MKL
-	enum class CholeskyImpl { CPP, AVX, BLAS };
+	enum class CholeskyImpl { CPP, SSE, AVX, FMA, AVX512, BLOCKED, PARALLEL, AUTO, BLAS };
 #else
-	enum class CholeskyImpl { CPP, AVX };
+	enum class CholeskyImpl { CPP, SSE, AVX, FMA, AVX512, BLOCKED, PARALLEL, AUTO };
 #endif
 
+	// Default panel/tile width of the blocked factorizations, a multiple of 8 keeps panel rows AVX friendly
+	const int CHOLESKY_BLOCK_SIZE = 96;
+	const int CHOLESKY_MAX_BLOCK_SIZE = 512;
+	// Below this size AUTO keeps the column-by-column algorithm: with the multi-row dot products
+	// it stays ahead of the blocked one as long as the matrix is not much larger than L2
+	const int CHOLESKY_AUTO_BLOCKED_SIZE = 1024;
+
 	//Define a function pointer to choose between two implementations
-	typedef std::function<float(const float * u, const float * v, const float * d, int size)> func_type_LDLt;
-	typedef std::function<float(const float * u, const float * v, int size)> func_type_LLt;
- 
-	float sum3VecProductAVX(const float * u, const float * v, const float * d, int size);
-	float sum2VecProductAVX(const float * u, const float * v, int size);
+	template<typename T> using func_type_LDLt = std::function<T(const T * u, const T * v, const T * d, int size)>;
+	template<typename T> using func_type_LLt = std::function<T(const T * u, const T * v, int size)>;
+
+	/// One instruction set's worth of the kernels used by the blocked, tiled, solve and update drivers,
+	/// chosen once at runtime, see select()
+	template<typename T>
+	struct CholeskyKernels
+	{
+		T (*sum3VecProduct)(const T * u, const T * v, const T * d, int size);
+		T (*sum2VecProduct)(const T * u, const T * v, int size);
+		void (*axpySub)(T a, const T * x, T * y, int size);
+		void (*gemmSub)(const T * A, int lda, const T * B, int ldb, T * C, int ldc, int m, int n, int k);
+		void (*sum3VecProductRows)(const T * rows, int stride, const T * v, const T * d, int size, int numRows, T * out);
+		void (*sum2VecProductRows)(const T * rows, int stride, const T * v, int size, int numRows, T * out);
+		// NULL when there is no vector version, updates then run the scalar loops
+		void (*updateRows)(T * L, int stride, int cols, T * x, int numVecs, const T * params, int paramStride, bool ldlt);
+
+		/// Kernels of one instruction set, impl must be CPP, SSE, AVX, FMA or AVX512 and supported
+		/// Specialized for float and double below
+		static CholeskyKernels select(CholeskyImpl impl);
+	};
+
+	// The drivers below are instantiated for float and double in their .cpp files
+
+	// Right-looking blocked factorizations, in place on the lower triangle of A (see cholesky_blocked.cpp)
+	// work holds the packed panel, it is resized as needed and can be kept across calls
+	template<typename T>
+	void blockedCholeskyLLt(MatrixView<T> A, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+	template<typename T>
+	void blockedCholeskyLDLt(MatrixView<T> A, T * diag, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels);
 
-    static float sum3VecProduct(const float * u, const float * v, const float * d, int size)
+	// Block kernels on raw row-major blocks (see cholesky_blocked.cpp), diag == NULL selects LL^T
+	// diag points to the diagonal entries of the columns the block covers
+	// Factor the nb x nb block A in place, all updates from earlier columns applied
+	template<typename T>
+	void factorBlock(T * A, int lda, T * diag, int nb, const CholeskyKernels<T> & kernels);
+	// Solve the rows x nb block B against the factored nb x nb block L, B <- B L^-T (D^-1)
+	template<typename T>
+	void solveBlock(T * B, int ldb, const T * L, int ldl, const T * diag, int rows, int nb, const CholeskyKernels<T> & kernels);
+	// packed (kb x cols) = ((D) W^T), W is cols x kb
+	template<typename T>
+	void packTransposed(const T * W, int ldw, const T * diag, int cols, int kb, T * packed, int ldp);
+	// C (rows x cols) -= A (rows x kb) * packed (kb x cols), lower triangle only if lower
+	template<typename T>
+	void updatePacked(T * C, int ldc, const T * A, int lda, const T * packed, int ldp, int rows, int cols, int kb, bool lower, const CholeskyKernels<T> & kernels);
+
+	// The same on blocks of a MatrixView, shared by the blocked and the tiled factorizations, diag == NULL selects LL^T
+	// Factor rows/cols k0..k1-1, whose updates from earlier columns have all been applied
+	template<typename T>
+	void factorDiagonalBlock(MatrixView<T> A, T * diag, int k0, int k1, const CholeskyKernels<T> & kernels);
+	// Solve rows r0..r1-1 of columns k0..k1-1 against the factored diagonal block k0..k1-1
+	template<typename T>
+	void solvePanel(MatrixView<T> A, const T * diag, int r0, int r1, int k0, int k1, const CholeskyKernels<T> & kernels);
+	// A(r0:r1, c0:c1) -= L(r0:r1, k0:k1) * (D) * L(c0:c1, k0:k1)^T, lower triangle only if r0 == c0
+	// packed must hold at least (k1 - k0) x (c1 - c0) elements
+	template<typename T>
+	void updateBlock(MatrixView<T> A, const T * diag, MatrixView<T> packed, int r0, int r1, int c0, int c1, int k0, int k1, const CholeskyKernels<T> & kernels);
+
+	// Solves A x = b in place with a factor stored as by Cholesky, diag == NULL selects LL^T (see cholesky_solve.cpp)
+	template<typename T>
+	void choleskySolve(MatrixView<T> L, const T * diag, T * b, const CholeskyKernels<T> & kernels);
+	// Solves A X = B in place for the columns of B, in blocks of blockSize rows, work is resized as needed
+	template<typename T>
+	void choleskySolve(MatrixView<T> L, const T * diag, MatrixView<T> B, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+	// Replaces the factor of A by the factor of A + sign * V V^T, sign is 1 or -1, diag == NULL selects LL^T
+	// Returns false if a downdate leaves a non-positive pivot, the factor is then no longer valid (see cholesky_update.cpp)
+	template<typename T>
+	bool choleskyUpdate(MatrixView<T> L, T * diag, MatrixView<const T> V, T sign, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+	// Task-parallel tiled factorization on a work-stealing pool, diag == NULL selects LL^T (see cholesky_tiled.cpp)
+	// work holds one packed tile per worker, it is resized as needed and can be kept across calls
+	template<typename T>
+	void tiledCholesky(MatrixView<T> A, T * diag, int tileSize, WorkStealingPool & pool, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+	template<typename T>
+    static T sum3VecProduct(const T * u, const T * v, const T * d, int size)
     {
-        float dp = 0;
+        T dp = 0;
 		for (int i = 0; i < size; i++)        
 			dp += u[i] * v[i] * d[i];
 		return dp;
     }
 
-	static float sum2VecProduct(const float * u, const float * v, int size)
+	template<typename T>
+	static T sum2VecProduct(const T * u, const T * v, int size)
 	{
-		float dp = 0;
+		T dp = 0;
 		for (int i = 0; i < size; i++)
 			dp += u[i] * v[i];
 		return dp;
 	}
 
+	template<typename T>
+	static void sum3VecProductRows(const T * rows, int stride, const T * v, const T * d, int size, int numRows, T * out)
+	{
+		for (int r = 0; r < numRows; r++)
+			out[r] = sum3VecProduct(rows + r * stride, v, d, size);
+	}
+
+	template<typename T>
+	static void sum2VecProductRows(const T * rows, int stride, const T * v, int size, int numRows, T * out)
+	{
+		for (int r = 0; r < numRows; r++)
+			out[r] = sum2VecProduct(rows + r * stride, v, size);
+	}
+
+	template<typename T>
+	static void axpySub(T a, const T * x, T * y, int size)
+	{
+		for (int i = 0; i < size; i++)
+			y[i] -= a * x[i];
+	}
+
+	template<typename T>
+	static void gemmSub(const T * A, int lda, const T * B, int ldb, T * C, int ldc, int m, int n, int k)
+	{
+		for (int i = 0; i < m; i++)
+			for (int p = 0; p < k; p++)
+				axpySub(A[i * lda + p], &B[p * ldb], &C[i * ldc], n);
+	}
+
+	/// True if the CPU running the program has the instructions impl needs
+	static bool isSupported(CholeskyImpl impl)
+	{
+		const CpuFeatures & cpu = cpuFeatures();
+		switch (impl)
+		{
+		case CholeskyImpl::SSE:
+			return cpu.sse3;
+		case CholeskyImpl::AVX:
+			return cpu.avx;
+		case CholeskyImpl::FMA:
+			return cpu.avx2 && cpu.fma;
+		case CholeskyImpl::AVX512:
+			return cpu.avx512f;
+		default:
+			return true;
+		}
+	}
+
+	/// Widest of AVX512, FMA, AVX, SSE supported by the CPU, CPP if none is
+	static CholeskyImpl widestSupportedImpl()
+	{
+		const CholeskyImpl order[] = { CholeskyImpl::AVX512, CholeskyImpl::FMA, CholeskyImpl::AVX, CholeskyImpl::SSE };
+		for (CholeskyImpl impl : order)
+			if (isSupported(impl))
+				return impl;
+		return CholeskyImpl::CPP;
+	}
+
+	/// Instruction set of the kernels impl runs on: the widest supported one for BLOCKED, PARALLEL, AUTO and BLAS
+	static CholeskyImpl kernelImpl(CholeskyImpl impl)
+	{
+		switch (impl)
+		{
+		case CholeskyImpl::CPP:
+		case CholeskyImpl::SSE:
+		case CholeskyImpl::AVX:
+		case CholeskyImpl::FMA:
+		case CholeskyImpl::AVX512:
+			return impl;
+		default:
+			return widestSupportedImpl();
+		}
+	}
+
+	// The SSE, FMA and AVX-512 families reuse the AVX rank-k update kernel when AVX is there as well
+	template<>
+	inline CholeskyKernels<float> CholeskyKernels<float>::select(CholeskyImpl impl)
+	{
+		bool avx = cpuFeatures().avx;
+		switch (impl)
+		{
+		case CholeskyImpl::SSE:
+		{
+			CholeskyKernels<float> k = { &sumPairwiseProductSSE, &sum2VecProductSSE, &axpySubSSE, &gemmSubSSE, &sum3VecProductRowsSSE, &sum2VecProductRowsSSE, avx ? &updateRowsAVX : NULL };
+			return k;
+		}
+		case CholeskyImpl::AVX:
+		{
+			CholeskyKernels<float> k = { &sum3VecProductAVX, &sum2VecProductAVX, &axpySubAVX, &gemmSubAVX, &sum3VecProductRowsAVX, &sum2VecProductRowsAVX, &updateRowsAVX };
+			return k;
+		}
+		case CholeskyImpl::FMA:
+		{
+			CholeskyKernels<float> k = { &sum3VecProductFMA, &sum2VecProductFMA, &axpySubFMA, &gemmSubFMA, &sum3VecProductRowsFMA, &sum2VecProductRowsFMA, &updateRowsAVX };
+			return k;
+		}
+		case CholeskyImpl::AVX512:
+		{
+			CholeskyKernels<float> k = { &sum3VecProductAVX512, &sum2VecProductAVX512, &axpySubAVX512, &gemmSubAVX512, &sum3VecProductRowsAVX512, &sum2VecProductRowsAVX512, avx ? &updateRowsAVX : NULL };
+			return k;
+		}
+		case CholeskyImpl::CPP:
+		default:
+		{
+			CholeskyKernels<float> k = { &linalg::sum3VecProduct<float>, &linalg::sum2VecProduct<float>, &linalg::axpySub<float>, &linalg::gemmSub<float>,
+				&linalg::sum3VecProductRows<float>, &linalg::sum2VecProductRows<float>, NULL };
+			return k;
+		}
+		}
+	}
+
+	// Double precision kernels exist for AVX and AVX2 + FMA: SSE falls back to the C++ loops
+	// and AVX-512 to the FMA kernels, the rank-k update always runs the scalar loops
+	template<>
+	inline CholeskyKernels<double> CholeskyKernels<double>::select(CholeskyImpl impl)
+	{
+		if (impl == CholeskyImpl::AVX512)
+			impl = cpuFeatures().fma ? CholeskyImpl::FMA : CholeskyImpl::AVX;
+		switch (impl)
+		{
+		case CholeskyImpl::AVX:
+		{
+			CholeskyKernels<double> k = { &sum3VecProductAVX, &sum2VecProductAVX, &axpySubAVX, &gemmSubAVX, &sum3VecProductRowsAVX, &sum2VecProductRowsAVX, NULL };
+			return k;
+		}
+		case CholeskyImpl::FMA:
+		{
+			CholeskyKernels<double> k = { &sum3VecProductFMA, &sum2VecProductFMA, &axpySubFMA, &gemmSubFMA, &sum3VecProductRowsFMA, &sum2VecProductRowsFMA, NULL };
+			return k;
+		}
+		case CholeskyImpl::SSE:
+		case CholeskyImpl::CPP:
+		default:
+		{
+			CholeskyKernels<double> k = { &linalg::sum3VecProduct<double>, &linalg::sum2VecProduct<double>, &linalg::axpySub<double>, &linalg::gemmSub<double>,
+				&linalg::sum3VecProductRows<double>, &linalg::sum2VecProductRows<double>, NULL };
+			return k;
+		}
+		}
+	}
+
 #ifdef HAVE_MKL
 	static float sum2VecProductBLAS(const float * u, const float * v, int size)
 	{
 		return cblas_sdot(size, u, 1, v, 1);
 	}
+
+	static double sum2VecProductBLAS(const double * u, const double * v, int size)
+	{
+		return cblas_ddot(size, u, 1, v, 1);
+	}
 #endif
 
-    static float sum3VecProductWrapper(const float * row1, const float * row2, const float * diag, int size, func_type_LDLt computeFunc)
+	template<typename T>
+    static T sum3VecProductWrapper(const T * row1, const T * row2, const T * diag, int size, const func_type_LDLt<T> & computeFunc)
     {              
         return computeFunc(row1, row2, diag, size); //either sumPairwiseProduct or sumPairwiseProductSSE
     }
 
-	static float sum2VecProductWrapper(const float * row1, const float * row2, int size, func_type_LLt computeFunc)
+	template<typename T>
+	static T sum2VecProductWrapper(const T * row1, const T * row2, int size, const func_type_LLt<T> & computeFunc)
 	{
 		return computeFunc(row1, row2, size); //either sumPairwiseProduct or sumPairwiseProductSSE
 	}
@@ -61,112 +298,438 @@ namespace linalg{
 /// L is lower diagonal m_chol with each (i,j)th element multiplied by sqrt(m_chol(j,j))
 /// and the diagonal consists of sqrt(m_chol(j,j))
 /// This implementation delays the computation of sqrt(D) until after the main loop
+/// T is float or double, see the Cholesky and CholeskyDouble typedefs below
 
-class Cholesky
+template<typename T>
+class BasicCholesky
 {
 public:	
-	explicit Cholesky(int size, CholeskyImpl impl) : m_chol(size, size)
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	/// Storage for size x size is allocated up front and reused by every factorization of that size or smaller,
+	/// so that once one of each solve and update has run, a loop of factorizations does not allocate, except with
+	/// PARALLEL whose task graph (dependency counters, queued tasks) is built anew by every factorization
+	explicit BasicCholesky(int size, CholeskyImpl impl) : m_chol(size, size), m_factor(m_chol.view()), m_impl(impl)
 	{
-		diag.resize(size);
+		diag.reserve(size);
+
+		if (!isSupported(impl))
+			throw std::runtime_error("Cholesky: instruction set not supported by this CPU");
+		// AUTO: blocked for sizes where the trailing update dominates, plain loops otherwise
+		if (impl == CholeskyImpl::AUTO)
+			m_impl = size >= CHOLESKY_AUTO_BLOCKED_SIZE ? CholeskyImpl::BLOCKED : widestSupportedImpl();
 
-		//Define function pointers pointing to SSE optimized and naive CPP implementation
+		//Define function pointers pointing to SIMD optimized and naive CPP implementation
 		//and decide which one to use based on argument in constructor
-		switch (impl)
-		{
+		//BLOCKED and PARALLEL use the widest kernels inside the diagonal block and the panel
+		m_kernels = CholeskyKernels<T>::select(kernelImpl(impl));
+		m_LDLt_Impl = m_kernels.sum3VecProduct;
+		m_LLt_Impl = m_kernels.sum2VecProduct;
+		m_multiRowDot = (impl != CholeskyImpl::CPP);
 #ifdef HAVE_MKL
-		case CholeskyImpl::BLAS:
-			m_LDLt_Impl = &sum3VecProduct; //BLAS does not have 3 vector product, fallback to CPP
-			m_LLt_Impl = &sum2VecProductBLAS;
-			break;
-#endif
-		case CholeskyImpl::AVX:
-			m_LDLt_Impl = &sum3VecProductAVX;
-			m_LLt_Impl = &sum2VecProductAVX;
-			break;
-		case CholeskyImpl::CPP:
-		default:
-			m_LDLt_Impl = &sum3VecProduct;
-			m_LLt_Impl = &sum2VecProduct;
-			break;
+		if (impl == CholeskyImpl::BLAS)
+		{
+			m_LDLt_Impl = &sum3VecProduct<T>; //BLAS does not have 3 vector product, fallback to CPP
+			m_LLt_Impl = static_cast<T (*)(const T *, const T *, int)>(&sum2VecProductBLAS);
+			m_multiRowDot = false;
 		}
+#endif
+	}
+
+	/// Panel width used by CholeskyImpl::BLOCKED and tile size used by CholeskyImpl::PARALLEL,
+	/// tune to the cache size of the machine, capped at CHOLESKY_MAX_BLOCK_SIZE
+	void setBlockSize(int blockSize) { m_blockSize = std::max(1, std::min(blockSize, CHOLESKY_MAX_BLOCK_SIZE)); }
+
+	/// Column-by-column algorithms only: compute CHOLESKY_DOT_ROWS entries of a column per kernel call,
+	/// loading row j once for all of them and reducing all the sums together
+	/// On by default for the SIMD implementations, off for CPP and BLAS
+	void setMultiRowDot(bool enable) { m_multiRowDot = enable; }
+
+	/// Algorithm in use, AUTO is reported as what it resolved to
+	CholeskyImpl getImpl() const { return m_impl; }
+
+	/// Number of threads used by CholeskyImpl::PARALLEL, including the calling thread
+	/// Defaults to std::thread::hardware_concurrency()
+	void setNumThreads(int numThreads)
+	{
+		if (numThreads != m_numThreads)
+			m_pool.reset();
+		m_numThreads = numThreads;
 	}
 	
     /// Compute the LDL^T decomposition of mat, given mat 
-	void calculateCholeskyLDLt(const Matrix<float>& M)
+	void calculateCholeskyLDLt(const Matrix<T>& M)
+	{
+		factorLDLt(load(M));
+	}
+
+	/// Same, factoring M's storage in place: no copy of M is made
+	void calculateCholeskyLDLt(Matrix<T>&& M)
+	{
+		m_chol = std::move(M);
+		factorLDLt(m_chol.view());
+	}
+
+	/// Factors the square view A in place, overwriting the caller's storage with L and D
+	/// Only the lower triangle of A is read, the upper one may be used as scratch
+	/// Solves and updates then work on A, which must outlive them
+	void calculateCholeskyLDLtInPlace(MatrixView<T> A) { factorLDLt(A); }
+
+	/// Compute the LL^T decomposition of mat, given mat 
+	void calculateCholeskyLLt(const Matrix<T>& M)
+	{
+		factorLLt(load(M));
+	}
+
+	/// Same, factoring M's storage in place: no copy of M is made
+	void calculateCholeskyLLt(Matrix<T>&& M)
+	{
+		m_chol = std::move(M);
+		factorLLt(m_chol.view());
+	}
+
+	/// Factors the square view A in place, overwriting the caller's storage with L
+	/// Only the lower triangle of A is read, the upper one may be used as scratch
+	/// Solves and updates then work on A, which must outlive them
+	void calculateCholeskyLLtInPlace(MatrixView<T> A) { factorLLt(A); }
+
+
+	/// Solves A x = b in place, using the factor of the last calculateCholeskyLLt/LDLt call
+	void solve(std::vector<T> & b) const
+	{
+		assert((int)b.size() == m_factor.rows);
+		choleskySolve(m_factor, m_isLDLt ? &diag[0] : NULL, &b[0], m_kernels);
+	}
+
+	/// Solves A X = B in place for all columns of B at once, much faster than one column at a time
+	void solve(Matrix<T> & B) { solve(B.view()); }
+	/// Same for a block of columns of a larger matrix
+	void solve(MatrixView<T> B)
+	{
+		assert(B.rows == m_factor.rows);
+		choleskySolve(m_factor, m_isLDLt ? &diag[0] : NULL, B, m_blockSize, m_solveWork, m_kernels);
+	}
+
+	/// Turns the stored factor of A into the factor of A + v v^T in O(n^2)
+	bool update(const std::vector<T> & v) { return modify(v, (T)1); }
+	/// Turns the stored factor of A into the factor of A - v v^T in O(n^2)
+	/// Returns false if A - v v^T is not positive definite, the factor must then be recomputed
+	bool downdate(const std::vector<T> & v) { return modify(v, (T)-1); }
+
+	/// Rank-k versions for the k columns of V, O(k n^2)
+	bool update(const Matrix<T> & V) { return choleskyUpdate(m_factor, m_isLDLt ? &diag[0] : NULL, V.view(), (T)1, m_updateWork, m_kernels); }
+	bool downdate(const Matrix<T> & V) { return choleskyUpdate(m_factor, m_isLDLt ? &diag[0] : NULL, V.view(), (T)-1, m_updateWork, m_kernels); }
+
+	Matrix<T> getCholeskyMatrix() const
+	{
+		//This populates the upper-triangular L^T part of the LDL^T matrix
+		int n = m_factor.rows;
+		Matrix<T> chol(n, n);
+		for (int i = 0; i < n; i++)
+			memcpy(&chol.data[i * chol.stride], &m_factor.data[i * m_factor.stride], (i + 1) * sizeof(T));
+		mirrorLower(chol);
+		return chol;
+	}
+
+	/// Same matrix as getCholeskyMatrix, moved out of the object instead of copied: the upper triangle
+	/// is overwritten in place. The object has no factor afterwards, until the next calculateCholeskyLLt/LDLt
+	/// Falls back to getCholeskyMatrix when the factor does not fill the object's storage:
+	/// after the InPlace calls, and for matrices smaller than the workspace
+	Matrix<T> releaseCholeskyMatrix()
 	{
-		//Setup
-		m_chol = M;
+		if (m_factor.data != m_chol.data || m_factor.rows != m_chol.rows)
+			return getCholeskyMatrix();
+		mirrorLower(m_chol);
+		m_factor = MatrixView<T>(NULL, 0, 0, 0);
+		return std::move(m_chol);
+	}
 
-        int stride = m_chol.stride;
+private:
+	// Copies the lower triangle of M, all the factorizations read, into the top left corner of m_chol
+	// The storage is reused for any size up to the largest one seen, so repeated calls do not allocate
+	MatrixView<T> load(const Matrix<T> & M)
+	{
+		assert(M.rows == M.cols);
+		int n = M.rows;
+		if (!m_chol.data || n > m_chol.rows)
+			m_chol = Matrix<T>(n, n);
+		MatrixView<T> A = m_chol.block(0, 0, n, n);
+		for (int i = 0; i < n; i++)
+			memcpy(&A.data[i * A.stride], &M.data[i * M.stride], (i + 1) * sizeof(T));
+		return A;
+	}
+
+	// Column by column unless BLOCKED or PARALLEL, the factor overwrites A and becomes m_factor
+	void factorLDLt(MatrixView<T> A)
+	{
+		assert(A.rows == A.cols);
+		m_factor = A;
+		m_isLDLt = true;
+		diag.resize(A.rows);
+
+		if (m_impl == CholeskyImpl::BLOCKED)
+		{
+			blockedCholeskyLDLt(A, &diag[0], m_blockSize, m_factorWork, m_kernels);
+			return;
+		}
+		if (m_impl == CholeskyImpl::PARALLEL)
+		{
+			tiledCholesky(A, &diag[0], m_blockSize, getPool(), m_factorWork, m_kernels);
+			return;
+		}
+
+        int stride = A.stride;
+		// Hardware counters of the whole loop, with --counters in the benchmarks
+		BENCH_COUNTERS_SCOPE("column-LDLt");
 		
-		for (int j = 0; j < m_chol.cols; j++)
+		for (int j = 0; j < A.cols; j++)
 		{
-			float sum = 0;
+			T sum = 0;
 			//for (int k = 0; k < j; k++)
-				//sum += m_chol(j, k) * m_chol(j, k) * diag[k];
-			//m_chol(j, j) = m_chol(j, j) - sum;
-			m_chol(j, j) = m_chol(j, j) - sum3VecProductWrapper(&m_chol.data[j * stride], &m_chol.data[j * stride], &diag[0], j, m_LDLt_Impl);
-			diag[j] = m_chol(j, j);
+				//sum += A(j, k) * A(j, k) * diag[k];
+			//A(j, j) = A(j, j) - sum;
+			A(j, j) = A(j, j) - sum3VecProductWrapper(&A.data[j * stride], &A.data[j * stride], &diag[0], j, m_LDLt_Impl);
+			diag[j] = A(j, j);
 
-			float invDiag = 1 / m_chol(j, j);
-			for (int i = j + 1; i < m_chol.rows; i++)
+			T invDiag = 1 / A(j, j);
+			if (m_multiRowDot)
+			{
+				T sums[CHOLESKY_DOT_ROWS];
+				for (int i = j + 1; i < A.rows; i += CHOLESKY_DOT_ROWS)
+				{
+					int numRows = std::min(CHOLESKY_DOT_ROWS, A.rows - i);
+					m_kernels.sum3VecProductRows(&A.data[i * stride], stride, &A.data[j * stride], &diag[0], j, numRows, sums);
+					for (int r = 0; r < numRows; r++)
+						A(i + r, j) = invDiag * (A(i + r, j) - sums[r]);
+				}
+				continue;
+			}
+			for (int i = j + 1; i < A.rows; i++)
 			{	// i > j, i.e. lower diagonal
 				//float sum = 0;
 				//for (int k = 0; k < j; k++)
-				//	sum += m_chol(i, k) * m_chol(j, k) * diag[k];
-				m_chol(i, j) = invDiag * (m_chol(i, j) - sum3VecProductWrapper(&m_chol.data[i * stride], &m_chol.data[j * stride], &diag[0], j, m_LDLt_Impl));
+				//	sum += A(i, k) * A(j, k) * diag[k];
+				A(i, j) = invDiag * (A(i, j) - sum3VecProductWrapper(&A.data[i * stride], &A.data[j * stride], &diag[0], j, m_LDLt_Impl));
 			}
 		}
     }
 
-	/// Compute the LL^T decomposition of mat, given mat 
-	void calculateCholeskyLLt(const Matrix<float>& M)
+	void factorLLt(MatrixView<T> A)
 	{
-		//Setup
-		m_chol = M;
+		assert(A.rows == A.cols);
+		m_factor = A;
+		m_isLDLt = false;
 
-		int stride = m_chol.stride;
+		if (m_impl == CholeskyImpl::BLOCKED)
+		{
+			blockedCholeskyLLt(A, m_blockSize, m_factorWork, m_kernels);
+			return;
+		}
+		if (m_impl == CholeskyImpl::PARALLEL)
+		{
+			tiledCholesky(A, (T *)NULL, m_blockSize, getPool(), m_factorWork, m_kernels);
+			return;
+		}
+
+		int stride = A.stride;
+		BENCH_COUNTERS_SCOPE("column-LLt");
 
-		for (int j = 0; j < m_chol.cols; j++)
+		for (int j = 0; j < A.cols; j++)
 		{
 			//float sum = 0;
 			//for (int k = 0; k < j; k++)
-			//	sum += m_chol(j, k) * m_chol(j, k);
+			//	sum += A(j, k) * A(j, k);
 			
-			m_chol(j, j) = std::sqrt(m_chol(j, j) - sum2VecProductWrapper(&m_chol.data[j*stride], &m_chol.data[j*stride], j, m_LLt_Impl));
+			A(j, j) = std::sqrt(A(j, j) - sum2VecProductWrapper(&A.data[j*stride], &A.data[j*stride], j, m_LLt_Impl));
 
-			float invDiag = 1 / m_chol(j, j);
-			for (int i = j + 1; i < m_chol.rows; i++)
+			T invDiag = 1 / A(j, j);
+			if (m_multiRowDot)
+			{
+				T sums[CHOLESKY_DOT_ROWS];
+				for (int i = j + 1; i < A.rows; i += CHOLESKY_DOT_ROWS)
+				{
+					int numRows = std::min(CHOLESKY_DOT_ROWS, A.rows - i);
+					m_kernels.sum2VecProductRows(&A.data[i * stride], stride, &A.data[j * stride], j, numRows, sums);
+					for (int r = 0; r < numRows; r++)
+						A(i + r, j) = invDiag * (A(i + r, j) - sums[r]);
+				}
+				continue;
+			}
+			for (int i = j + 1; i < A.rows; i++)
 			{	// i > j
 				//float sum = 0;
 				//for (int k = 0; k < j; k++)
-				//	sum += m_chol(i, k) * m_chol(j, k);
-				//m_chol(i, j) = invDiag * (m_chol(i, j) - sum);
+				//	sum += A(i, k) * A(j, k);
+				//A(i, j) = invDiag * (A(i, j) - sum);
 
-				m_chol(i, j) = invDiag * (m_chol(i, j) - sum2VecProductWrapper(&m_chol.data[i*stride], &m_chol.data[j*stride], j, m_LLt_Impl));
+				A(i, j) = invDiag * (A(i, j) - sum2VecProductWrapper(&A.data[i*stride], &A.data[j*stride], j, m_LLt_Impl));
 			}
 		}
 	}
 
-	Matrix<float> getCholeskyMatrix()
+
+	bool modify(const std::vector<T> & v, T sign)
 	{
-		//This populates the upper-triangular L^T part of the LDL^T matrix
-		Matrix<float> chol(m_chol);
-		for (int i = 0; i < m_chol.rows; i++)
-			for (int j = i + 1; j < m_chol.cols; j++)
-				chol(i, j) = m_chol(j, i);
+		assert((int)v.size() == m_factor.rows);
+		MatrixView<const T> V(&v[0], m_factor.rows, 1, 1);
+		return choleskyUpdate(m_factor, m_isLDLt ? &diag[0] : NULL, V, sign, m_updateWork, m_kernels);
+	}
 
-		return chol;
+	WorkStealingPool & getPool()
+	{
+		if (!m_pool)
+			m_pool.reset(new WorkStealingPool(m_numThreads > 0 ? m_numThreads : (int)std::thread::hardware_concurrency()));
+		return *m_pool;
 	}
 
-private:
 	// We store Cholesky in-place
-	Matrix<float> m_chol;
-	std::vector<float> diag;
+	Matrix<T> m_chol;
+	MatrixView<T> m_factor; // m_chol, or the caller's storage after an InPlace call
+	std::vector<T> diag;
+	CholeskyImpl m_impl; // AUTO is resolved in the constructor
+	CholeskyKernels<T> m_kernels;
+	int m_blockSize = CHOLESKY_BLOCK_SIZE;
+	int m_numThreads = 0;
+	std::unique_ptr<WorkStealingPool> m_pool; // created on first use, threads are reused across factorizations
+	bool m_isLDLt = false;
+	bool m_multiRowDot = false;
+	std::vector<T> m_factorWork; // packed panel of BLOCKED, per worker tiles of PARALLEL
+	std::vector<T> m_solveWork; // packed blocks of L for multi right-hand side solves
+	std::vector<T> m_updateWork; // rotation parameters of rank-k updates
 	// Function pointer that chooses the implementation dynamically
-	func_type_LDLt m_LDLt_Impl = NULL;
-	func_type_LLt m_LLt_Impl = NULL;
+	func_type_LDLt<T> m_LDLt_Impl = NULL;
+	func_type_LLt<T> m_LLt_Impl = NULL;
+
+};
+
+typedef BasicCholesky<float> Cholesky;
+typedef BasicCholesky<double> CholeskyDouble;
+
+/// Solves double precision systems A x = b at close to float speed: A is factored in float, with twice
+/// the SIMD width and half the memory traffic of double, and the float solution is refined with residuals
+/// computed in double until it is as accurate as a double precision solve
+/// See Langou et al., "Exploiting the performance of 32 bit floating point arithmetic in obtaining
+/// 64 bit accuracy", 2006, and LAPACK's dsposv
+/// Refinement converges when the condition number of A is well below 1 / float epsilon (about 1e7),
+/// otherwise solve() falls back to a double precision factorization
+class MixedPrecisionCholesky
+{
+public:
+	explicit MixedPrecisionCholesky(int size, CholeskyImpl impl)
+		: m_Af(size, size), m_chol(size, impl), m_impl(impl),
+		m_kernels(CholeskyKernels<double>::select(widestSupportedImpl())), m_x(size), m_r(size), m_d(size)
+	{
+	}
+
+	/// Refinement steps before giving up and factoring in double, 30 as in dsposv
+	/// Refinement also gives up as soon as a step does not halve the residual
+	void setMaxIterations(int maxIterations) { m_maxIterations = maxIterations; }
+
+	/// Factors a float copy of the lower triangle of A, made in the same pass that computes the norm of A
+	/// A is not copied but kept by reference to compute the residuals: it must hold both triangles and outlive the solves
+	void calculateCholeskyLLt(const Matrix<double> & A)
+	{
+		assert(A.rows == m_Af.rows && A.cols == m_Af.cols);
+		int n = A.rows;
+		m_A = &A;
+		m_fallback.reset();
+		// Row sums of |A| from the lower triangle, A(i, j) counts for rows i and j
+		std::fill(m_r.begin(), m_r.end(), 0.0);
+		for (int i = 0; i < n; i++)
+		{
+			const double * row = &A.data[i * A.stride];
+			float * rowF = &m_Af.data[i * m_Af.stride];
+			double rowSum = 0;
+			for (int j = 0; j < i; j++)
+			{
+				rowF[j] = (float)row[j];
+				rowSum += std::abs(row[j]);
+				m_r[j] += std::abs(row[j]);
+			}
+			rowF[i] = (float)row[i];
+			m_r[i] += rowSum + std::abs(row[i]);
+		}
+		m_normA = normInf(m_r);
+		m_chol.calculateCholeskyLLtInPlace(m_Af.view());
+	}
+
+	/// Solves A x = b in place, returns the number of refinement steps,
+	/// or -1 if refinement did not converge and x comes from a double precision factorization
+	int solve(std::vector<double> & b)
+	{
+		int n = m_Af.rows;
+		assert(m_A && (int)b.size() == n);
+		// Stop once the normwise backward error ||b - A x|| / (||A|| ||x||) is at double rounding level
+		double threshold = std::sqrt((double)n) * std::numeric_limits<double>::epsilon() * m_normA;
+
+		std::fill(m_x.begin(), m_x.end(), 0.0);
+		m_r = b;
+		double lastNormR = std::numeric_limits<double>::infinity();
+		for (int it = 0; it <= m_maxIterations; it++)
+		{
+			// Correction from the float factor, the first one is the plain float solution
+			for (int i = 0; i < n; i++)
+				m_d[i] = (float)m_r[i];
+			m_chol.solve(m_d);
+			for (int i = 0; i < n; i++)
+				m_x[i] += m_d[i];
+
+			double normR = residual(b);
+			if (normR <= threshold * normInf(m_x))
+			{
+				b = m_x;
+				return it;
+			}
+			// NaN when the float factorization broke down; too slow a convergence costs more than factoring in double
+			if (!(normR <= lastNormR / 2))
+				break;
+			lastNormR = normR;
+		}
+
+		if (!m_fallback)
+		{
+			m_fallback.reset(new CholeskyDouble(n, m_impl));
+			m_fallback->calculateCholeskyLLt(*m_A);
+		}
+		m_fallback->solve(b);
+		return -1;
+	}
+
+private:
+	static double normInf(const std::vector<double> & v)
+	{
+		double norm = 0;
+		for (double x : v)
+			norm = std::max(norm, std::abs(x));
+		return norm;
+	}
+
+	// m_r = b - A m_x in double, CHOLESKY_DOT_ROWS rows of A per kernel call, returns ||m_r||
+	double residual(const std::vector<double> & b)
+	{
+		const Matrix<double> & A = *m_A;
+		int n = A.rows;
+		double sums[CHOLESKY_DOT_ROWS];
+		for (int i = 0; i < n; i += CHOLESKY_DOT_ROWS)
+		{
+			int numRows = std::min(CHOLESKY_DOT_ROWS, n - i);
+			m_kernels.sum2VecProductRows(&A.data[i * A.stride], A.stride, &m_x[0], n, numRows, sums);
+			for (int r = 0; r < numRows; r++)
+				m_r[i + r] = b[i + r] - sums[r];
+		}
+		return normInf(m_r);
+	}
 
+	const Matrix<double> * m_A = NULL; // the caller's matrix, for the residuals
+	Matrix<float> m_Af; // float copy of the lower triangle of A, overwritten by its factor
+	double m_normA = 0;
+	Cholesky m_chol;
+	CholeskyImpl m_impl;
+	CholeskyKernels<double> m_kernels;
+	int m_maxIterations = 30;
+	std::vector<double> m_x;
+	std::vector<double> m_r;
+	std::vector<float> m_d;
+	std::unique_ptr<CholeskyDouble> m_fallback; // only built if refinement fails
 };
 	
 }
@@ -1,13 +1,29 @@
 #include <immintrin.h> //AVX
 
-#include "cholesky.hpp"
+#include "cholesky_kernels.hpp"
 
 // Assumes the machine has AVX instructions
-// If you are not sure of this (i.e. you run on very old machines), 
-// you may wish to add runtime checks around this code
+// Cholesky only selects these kernels when cpuFeatures() reports AVX, see cpu_features.hpp
 
 namespace linalg{
 
+	// _mm256_hadd_ps adds within each 128-bit half only, so fold the upper half onto the lower one first
+	static inline float horizontalSumAVX(__m256 v)
+	{
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		sum = _mm_hadd_ps(sum, sum);
+		sum = _mm_hadd_ps(sum, sum);
+		return _mm_cvtss_f32(sum);
+	}
+
+	static inline float sum2VecProductStrided(const float * u, const float * v, int vStride, int size)
+	{
+		float dp = 0;
+		for (int i = 0; i < size; i++)
+			dp += u[i] * v[i * vStride];
+		return dp;
+	}
+
     float sum3VecProductAVX(const float * u, const float * v, const float * d, int size)
     {
 		float acc[8] = {0, 0, 0, 0, 0, 0, 0, 0};
@@ -19,17 +35,14 @@ namespace linalg{
 		_mm256_zeroall();
 		for (int it = 0; it < groups_8; it++)
 		{
-			__m256 a1 = _mm256_load_ps(u + 8 * it);
-			__m256 b1 = _mm256_load_ps(v +  8 * it);
-			__m256 c1 = _mm256_load_ps(d +  8 * it);
+			__m256 a1 = _mm256_loadu_ps(u + 8 * it);
+			__m256 b1 = _mm256_loadu_ps(v +  8 * it);
+			__m256 c1 = _mm256_loadu_ps(d +  8 * it);
 			b1 = _mm256_mul_ps(a1, b1);
 			c1 = _mm256_mul_ps(b1, c1);
 			singleLane = _mm256_add_ps(singleLane, c1);
 		}
-		singleLane = _mm256_hadd_ps(singleLane, singleLane);
-		singleLane = _mm256_hadd_ps(singleLane, singleLane);
-		singleLane = _mm256_hadd_ps(singleLane, singleLane);
-		_mm256_storeu_ps(&acc[0], singleLane); // we have the answer in acc[0] as we have already done the horizontal add
+		acc[0] = horizontalSumAVX(singleLane);
 
 		// Add last few after multiples of 8
 		if (groups_1)
@@ -50,14 +63,11 @@ namespace linalg{
 		_mm256_zeroall();
 		for (int it = 0; it < groups_8; it++)
 		{
-			__m256 a1 = _mm256_load_ps(u + 8 * it);
-			__m256 b1 = _mm256_load_ps(v + 8 * it);
+			__m256 a1 = _mm256_loadu_ps(u + 8 * it);
+			__m256 b1 = _mm256_loadu_ps(v + 8 * it);
 			singleLane = _mm256_add_ps(singleLane, _mm256_mul_ps(a1, b1));
 		}
-		singleLane = _mm256_hadd_ps(singleLane, singleLane);
-		singleLane = _mm256_hadd_ps(singleLane, singleLane);
-		singleLane = _mm256_hadd_ps(singleLane, singleLane);
-		_mm256_storeu_ps(&acc[0], singleLane); // we have the answer in acc[0] as we have already done the horizontal add
+		acc[0] = horizontalSumAVX(singleLane);
 
 											   // Add last few after multiples of 8
 		if (groups_1)
@@ -67,5 +77,452 @@ namespace linalg{
 		return acc[0];
 	}
 
+	// Computes C -= A * B for MR rows of A against a packed panel B (k x n, row-major)
+	// Every row of A is broadcast against two 8-wide slices of B, so MR x 16 results stay in registers
+	template<int MR>
+	static inline void gemmSubRowsAVX(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int n, int k)
+	{
+		int j = 0;
+		for (; j + 16 <= n; j += 16)
+		{
+			__m256 acc0[MR], acc1[MR];
+			for (int r = 0; r < MR; r++)
+			{
+				acc0[r] = _mm256_setzero_ps();
+				acc1[r] = _mm256_setzero_ps();
+			}
+			for (int p = 0; p < k; p++)
+			{
+				__m256 b0 = _mm256_loadu_ps(B + p * ldb + j);
+				__m256 b1 = _mm256_loadu_ps(B + p * ldb + j + 8);
+				for (int r = 0; r < MR; r++)
+				{
+					__m256 a = _mm256_broadcast_ss(A + r * lda + p);
+					acc0[r] = _mm256_add_ps(acc0[r], _mm256_mul_ps(a, b0));
+					acc1[r] = _mm256_add_ps(acc1[r], _mm256_mul_ps(a, b1));
+				}
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				float * c = C + r * ldc + j;
+				_mm256_storeu_ps(c, _mm256_sub_ps(_mm256_loadu_ps(c), acc0[r]));
+				_mm256_storeu_ps(c + 8, _mm256_sub_ps(_mm256_loadu_ps(c + 8), acc1[r]));
+			}
+		}
+		for (; j + 8 <= n; j += 8)
+		{
+			__m256 acc[MR];
+			for (int r = 0; r < MR; r++)
+				acc[r] = _mm256_setzero_ps();
+			for (int p = 0; p < k; p++)
+			{
+				__m256 b = _mm256_loadu_ps(B + p * ldb + j);
+				for (int r = 0; r < MR; r++)
+					acc[r] = _mm256_add_ps(acc[r], _mm256_mul_ps(_mm256_broadcast_ss(A + r * lda + p), b));
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				float * c = C + r * ldc + j;
+				_mm256_storeu_ps(c, _mm256_sub_ps(_mm256_loadu_ps(c), acc[r]));
+			}
+		}
+		// Remaining columns, fewer than 8, must not touch memory beyond the row
+		for (; j < n; j++)
+			for (int r = 0; r < MR; r++)
+				C[r * ldc + j] -= sum2VecProductStrided(A + r * lda, B + j, ldb, k);
+	}
+
+	void gemmSubAVX(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k)
+	{
+		int i = 0;
+		for (; i + 4 <= m; i += 4)
+			gemmSubRowsAVX<4>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+		for (; i < m; i++)
+			gemmSubRowsAVX<1>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+	}
+
+	void axpySubAVX(float a, const float * x, float * y, int size)
+	{
+		__m256 a8 = _mm256_set1_ps(a);
+		int i = 0;
+		for (; i + 8 <= size; i += 8)
+			_mm256_storeu_ps(y + i, _mm256_sub_ps(_mm256_loadu_ps(y + i), _mm256_mul_ps(a8, _mm256_loadu_ps(x + i))));
+		for (; i < size; i++)
+			y[i] -= a * x[i];
+	}
+
+	// Transposes the 8x8 block held in r[0..7], rows become columns
+	static inline void transpose8x8AVX(__m256 * r)
+	{
+		__m256 t0 = _mm256_unpacklo_ps(r[0], r[1]);
+		__m256 t1 = _mm256_unpackhi_ps(r[0], r[1]);
+		__m256 t2 = _mm256_unpacklo_ps(r[2], r[3]);
+		__m256 t3 = _mm256_unpackhi_ps(r[2], r[3]);
+		__m256 t4 = _mm256_unpacklo_ps(r[4], r[5]);
+		__m256 t5 = _mm256_unpackhi_ps(r[4], r[5]);
+		__m256 t6 = _mm256_unpacklo_ps(r[6], r[7]);
+		__m256 t7 = _mm256_unpackhi_ps(r[6], r[7]);
+		__m256 s0 = _mm256_shuffle_ps(t0, t2, 0x44);
+		__m256 s1 = _mm256_shuffle_ps(t0, t2, 0xEE);
+		__m256 s2 = _mm256_shuffle_ps(t1, t3, 0x44);
+		__m256 s3 = _mm256_shuffle_ps(t1, t3, 0xEE);
+		__m256 s4 = _mm256_shuffle_ps(t4, t6, 0x44);
+		__m256 s5 = _mm256_shuffle_ps(t4, t6, 0xEE);
+		__m256 s6 = _mm256_shuffle_ps(t5, t7, 0x44);
+		__m256 s7 = _mm256_shuffle_ps(t5, t7, 0xEE);
+		r[0] = _mm256_permute2f128_ps(s0, s4, 0x20);
+		r[1] = _mm256_permute2f128_ps(s1, s5, 0x20);
+		r[2] = _mm256_permute2f128_ps(s2, s6, 0x20);
+		r[3] = _mm256_permute2f128_ps(s3, s7, 0x20);
+		r[4] = _mm256_permute2f128_ps(s0, s4, 0x31);
+		r[5] = _mm256_permute2f128_ps(s1, s5, 0x31);
+		r[6] = _mm256_permute2f128_ps(s2, s6, 0x31);
+		r[7] = _mm256_permute2f128_ps(s3, s7, 0x31);
+	}
+
+	void updateRowsAVX(float * L, int stride, int cols, float * x, int numVecs, const float * params, int paramStride, bool ldlt)
+	{
+		int numParams = ldlt ? 2 : 4;
+		__m256 xv[CHOLESKY_UPDATE_VECS];
+		for (int j = 0; j < numVecs; j++)
+			xv[j] = _mm256_loadu_ps(x + 8 * j);
+
+		for (int k0 = 0; k0 < cols; k0 += 8)
+		{
+			// Load the 8x8 tile and transpose it, so that every register holds one column across the 8 rows
+			__m256 t[8];
+			for (int r = 0; r < 8; r++)
+				t[r] = _mm256_loadu_ps(L + r * stride + k0);
+			transpose8x8AVX(t);
+
+			// All vectors are applied while the tile is in registers, in order, one column after the other
+			for (int j = 0; j < numVecs; j++)
+			{
+				const float * pj = params + j * numParams * paramStride + k0;
+				__m256 xj = xv[j];
+				if (ldlt)
+					for (int q = 0; q < 8; q++)
+					{
+						// x -= p L; L += b x
+						xj = _mm256_sub_ps(xj, _mm256_mul_ps(_mm256_broadcast_ss(pj + q), t[q]));
+						t[q] = _mm256_add_ps(t[q], _mm256_mul_ps(_mm256_broadcast_ss(pj + paramStride + q), xj));
+					}
+				else
+					for (int q = 0; q < 8; q++)
+					{
+						// L = L / c + s sn / c x; x = c x - sn L
+						t[q] = _mm256_add_ps(_mm256_mul_ps(t[q], _mm256_broadcast_ss(pj + q)),
+							_mm256_mul_ps(_mm256_broadcast_ss(pj + paramStride + q), xj));
+						xj = _mm256_sub_ps(_mm256_mul_ps(_mm256_broadcast_ss(pj + 2 * paramStride + q), xj),
+							_mm256_mul_ps(_mm256_broadcast_ss(pj + 3 * paramStride + q), t[q]));
+					}
+				xv[j] = xj;
+			}
+
+			transpose8x8AVX(t);
+			for (int r = 0; r < 8; r++)
+				_mm256_storeu_ps(L + r * stride + k0, t[r]);
+		}
+
+		for (int j = 0; j < numVecs; j++)
+			_mm256_storeu_ps(x + 8 * j, xv[j]);
+	}
+
+	// 8 sums in one register, lane r holding the sum of a[r]: one reduction for 8 dot products
+	static inline __m256 horizontalSum8AVX(const __m256 * a)
+	{
+		__m256 s0123 = _mm256_hadd_ps(_mm256_hadd_ps(a[0], a[1]), _mm256_hadd_ps(a[2], a[3]));
+		__m256 s4567 = _mm256_hadd_ps(_mm256_hadd_ps(a[4], a[5]), _mm256_hadd_ps(a[6], a[7]));
+		// Each 128-bit half now holds partial sums of its own half of the inputs
+		return _mm256_add_ps(_mm256_permute2f128_ps(s0123, s4567, 0x20), _mm256_permute2f128_ps(s0123, s4567, 0x31));
+	}
+
+	// out[r] = rows[r * stride + k] * v[k] (* d[k]) summed over k, for R rows
+	// v (times d) is loaded once per step for all rows and every row has its own accumulator
+	template<int R, bool D>
+	static inline void dotRowsAVX(const float * rows, int stride, const float * v, const float * d, int size, float * out)
+	{
+		__m256 acc[R];
+		for (int r = 0; r < R; r++)
+			acc[r] = _mm256_setzero_ps();
+		int k = 0;
+		for (; k + 8 <= size; k += 8)
+		{
+			__m256 b = _mm256_loadu_ps(v + k);
+			if (D)
+				b = _mm256_mul_ps(b, _mm256_loadu_ps(d + k));
+			for (int r = 0; r < R; r++)
+				acc[r] = _mm256_add_ps(acc[r], _mm256_mul_ps(_mm256_loadu_ps(rows + r * stride + k), b));
+		}
+		if (R == 8)
+			_mm256_storeu_ps(out, horizontalSum8AVX(acc));
+		else
+			for (int r = 0; r < R; r++)
+				out[r] = horizontalSumAVX(acc[r]);
+		for (; k < size; k++)
+		{
+			float b = D ? v[k] * d[k] : v[k];
+			for (int r = 0; r < R; r++)
+				out[r] += rows[r * stride + k] * b;
+		}
+	}
+
+	template<bool D>
+	static inline void dotRowsAVX(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		int r = 0;
+		for (; r + 8 <= numRows; r += 8)
+			dotRowsAVX<8, D>(rows + r * stride, stride, v, d, size, out + r);
+		if (r + 4 <= numRows)
+		{
+			dotRowsAVX<4, D>(rows + r * stride, stride, v, d, size, out + r);
+			r += 4;
+		}
+		for (; r < numRows; r++)
+			dotRowsAVX<1, D>(rows + r * stride, stride, v, d, size, out + r);
+	}
+
+	void sum2VecProductRowsAVX(const float * rows, int stride, const float * v, int size, int numRows, float * out)
+	{
+		dotRowsAVX<false>(rows, stride, v, NULL, size, numRows, out);
+	}
+
+	void sum3VecProductRowsAVX(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		dotRowsAVX<true>(rows, stride, v, d, size, numRows, out);
+	}
+
+	// Double precision versions, 4 lanes per register
+
+	static inline double horizontalSumAVX(__m256d v)
+	{
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+		return _mm_cvtsd_f64(_mm_hadd_pd(sum, sum));
+	}
+
+	// 4 sums in one register, lane r holding the sum of a[r]
+	static inline __m256d horizontalSum4AVX(const __m256d * a)
+	{
+		__m256d s01 = _mm256_hadd_pd(a[0], a[1]);
+		__m256d s23 = _mm256_hadd_pd(a[2], a[3]);
+		return _mm256_add_pd(_mm256_permute2f128_pd(s01, s23, 0x20), _mm256_permute2f128_pd(s01, s23, 0x31));
+	}
+
+	// out[r] = rows[r * stride + k] * v[k] (* d[k]) summed over k, for R rows, see the float version
+	template<int R, bool D>
+	static inline void dotRowsAVX(const double * rows, int stride, const double * v, const double * d, int size, double * out)
+	{
+		__m256d acc[R];
+		for (int r = 0; r < R; r++)
+			acc[r] = _mm256_setzero_pd();
+		int k = 0;
+		for (; k + 4 <= size; k += 4)
+		{
+			__m256d b = _mm256_loadu_pd(v + k);
+			if (D)
+				b = _mm256_mul_pd(b, _mm256_loadu_pd(d + k));
+			for (int r = 0; r < R; r++)
+				acc[r] = _mm256_add_pd(acc[r], _mm256_mul_pd(_mm256_loadu_pd(rows + r * stride + k), b));
+		}
+		for (int r = 0; r + 4 <= R; r += 4)
+			_mm256_storeu_pd(out + r, horizontalSum4AVX(acc + r));
+		if (R < 4)
+			for (int r = 0; r < R; r++)
+				out[r] = horizontalSumAVX(acc[r]);
+		for (; k < size; k++)
+		{
+			double b = D ? v[k] * d[k] : v[k];
+			for (int r = 0; r < R; r++)
+				out[r] += rows[r * stride + k] * b;
+		}
+	}
+
+	template<bool D>
+	static inline void dotRowsAVX(const double * rows, int stride, const double * v, const double * d, int size, int numRows, double * out)
+	{
+		int r = 0;
+		for (; r + 8 <= numRows; r += 8)
+			dotRowsAVX<8, D>(rows + r * stride, stride, v, d, size, out + r);
+		if (r + 4 <= numRows)
+		{
+			dotRowsAVX<4, D>(rows + r * stride, stride, v, d, size, out + r);
+			r += 4;
+		}
+		for (; r < numRows; r++)
+			dotRowsAVX<1, D>(rows + r * stride, stride, v, d, size, out + r);
+	}
+
+	double sum3VecProductAVX(const double * u, const double * v, const double * d, int size)
+	{
+		double sum;
+		dotRowsAVX<1, true>(u, 0, v, d, size, &sum);
+		return sum;
+	}
+
+	double sum2VecProductAVX(const double * u, const double * v, int size)
+	{
+		double sum;
+		dotRowsAVX<1, false>(u, 0, v, NULL, size, &sum);
+		return sum;
+	}
+
+	void sum2VecProductRowsAVX(const double * rows, int stride, const double * v, int size, int numRows, double * out)
+	{
+		dotRowsAVX<false>(rows, stride, v, NULL, size, numRows, out);
+	}
+
+	void sum3VecProductRowsAVX(const double * rows, int stride, const double * v, const double * d, int size, int numRows, double * out)
+	{
+		dotRowsAVX<true>(rows, stride, v, d, size, numRows, out);
+	}
+
+	void axpySubAVX(double a, const double * x, double * y, int size)
+	{
+		__m256d a4 = _mm256_set1_pd(a);
+		int i = 0;
+		for (; i + 4 <= size; i += 4)
+			_mm256_storeu_pd(y + i, _mm256_sub_pd(_mm256_loadu_pd(y + i), _mm256_mul_pd(a4, _mm256_loadu_pd(x + i))));
+		for (; i < size; i++)
+			y[i] -= a * x[i];
+	}
+
+	// Computes C -= A * B for MR rows of A against a packed panel B (k x n, row-major), MR x 8 results in registers
+	template<int MR>
+	static inline void gemmSubRowsAVX(const double * A, int lda, const double * B, int ldb, double * C, int ldc, int n, int k)
+	{
+		int j = 0;
+		for (; j + 8 <= n; j += 8)
+		{
+			__m256d acc0[MR], acc1[MR];
+			for (int r = 0; r < MR; r++)
+			{
+				acc0[r] = _mm256_setzero_pd();
+				acc1[r] = _mm256_setzero_pd();
+			}
+			for (int p = 0; p < k; p++)
+			{
+				__m256d b0 = _mm256_loadu_pd(B + p * ldb + j);
+				__m256d b1 = _mm256_loadu_pd(B + p * ldb + j + 4);
+				for (int r = 0; r < MR; r++)
+				{
+					__m256d a = _mm256_broadcast_sd(A + r * lda + p);
+					acc0[r] = _mm256_add_pd(acc0[r], _mm256_mul_pd(a, b0));
+					acc1[r] = _mm256_add_pd(acc1[r], _mm256_mul_pd(a, b1));
+				}
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				double * c = C + r * ldc + j;
+				_mm256_storeu_pd(c, _mm256_sub_pd(_mm256_loadu_pd(c), acc0[r]));
+				_mm256_storeu_pd(c + 4, _mm256_sub_pd(_mm256_loadu_pd(c + 4), acc1[r]));
+			}
+		}
+		for (; j < n; j++)
+			for (int r = 0; r < MR; r++)
+			{
+				double sum = 0;
+				for (int p = 0; p < k; p++)
+					sum += A[r * lda + p] * B[p * ldb + j];
+				C[r * ldc + j] -= sum;
+			}
+	}
+
+	void gemmSubAVX(const double * A, int lda, const double * B, int ldb, double * C, int ldc, int m, int n, int k)
+	{
+		int i = 0;
+		for (; i + 4 <= m; i += 4)
+			gemmSubRowsAVX<4>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+		for (; i < m; i++)
+			gemmSubRowsAVX<1>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+	}
+
+
+	// Transposes, tile by tile in registers, see transpose.cpp
+	void transposeAVX(const float * src, int lds, float * dst, int ldd, int rows, int cols)
+	{
+		__m256 r[8];
+		for (int i = 0; i < rows; i += 8)
+			for (int j = 0; j < cols; j += 8)
+			{
+				for (int k = 0; k < 8; k++)
+					r[k] = _mm256_loadu_ps(src + (size_t)(i + k) * lds + j);
+				transpose8x8AVX(r);
+				for (int k = 0; k < 8; k++)
+					_mm256_storeu_ps(dst + (size_t)(j + k) * ldd + i, r[k]);
+			}
+	}
+
+	void transposeSwapAVX(float * a, float * b, int ld, int rows, int cols)
+	{
+		__m256 ra[8], rb[8];
+		for (int i = 0; i < rows; i += 8)
+			for (int j = 0; j < (a == b ? i + 8 : cols); j += 8)
+			{
+				float * ta = a + (size_t)i * ld + j;
+				float * tb = b + (size_t)j * ld + i;
+				for (int k = 0; k < 8; k++)
+				{
+					ra[k] = _mm256_loadu_ps(ta + (size_t)k * ld);
+					rb[k] = _mm256_loadu_ps(tb + (size_t)k * ld);
+				}
+				transpose8x8AVX(ra);
+				transpose8x8AVX(rb);
+				for (int k = 0; k < 8; k++)
+				{
+					_mm256_storeu_ps(tb + (size_t)k * ld, ra[k]);
+					_mm256_storeu_ps(ta + (size_t)k * ld, rb[k]);
+				}
+			}
+	}
+
+	static inline void transpose4x4AVX(__m256d * r)
+	{
+		__m256d t0 = _mm256_unpacklo_pd(r[0], r[1]); // r00 r10 r02 r12
+		__m256d t1 = _mm256_unpackhi_pd(r[0], r[1]); // r01 r11 r03 r13
+		__m256d t2 = _mm256_unpacklo_pd(r[2], r[3]); // r20 r30 r22 r32
+		__m256d t3 = _mm256_unpackhi_pd(r[2], r[3]); // r21 r31 r23 r33
+		r[0] = _mm256_permute2f128_pd(t0, t2, 0x20);
+		r[1] = _mm256_permute2f128_pd(t1, t3, 0x20);
+		r[2] = _mm256_permute2f128_pd(t0, t2, 0x31);
+		r[3] = _mm256_permute2f128_pd(t1, t3, 0x31);
+	}
+
+	void transposeAVX(const double * src, int lds, double * dst, int ldd, int rows, int cols)
+	{
+		__m256d r[4];
+		for (int i = 0; i < rows; i += 4)
+			for (int j = 0; j < cols; j += 4)
+			{
+				for (int k = 0; k < 4; k++)
+					r[k] = _mm256_loadu_pd(src + (size_t)(i + k) * lds + j);
+				transpose4x4AVX(r);
+				for (int k = 0; k < 4; k++)
+					_mm256_storeu_pd(dst + (size_t)(j + k) * ldd + i, r[k]);
+			}
+	}
+
+	void transposeSwapAVX(double * a, double * b, int ld, int rows, int cols)
+	{
+		__m256d ra[4], rb[4];
+		for (int i = 0; i < rows; i += 4)
+			for (int j = 0; j < (a == b ? i + 4 : cols); j += 4)
+			{
+				double * ta = a + (size_t)i * ld + j;
+				double * tb = b + (size_t)j * ld + i;
+				for (int k = 0; k < 4; k++)
+				{
+					ra[k] = _mm256_loadu_pd(ta + (size_t)k * ld);
+					rb[k] = _mm256_loadu_pd(tb + (size_t)k * ld);
+				}
+				transpose4x4AVX(ra);
+				transpose4x4AVX(rb);
+				for (int k = 0; k < 4; k++)
+				{
+					_mm256_storeu_pd(tb + (size_t)k * ld, ra[k]);
+					_mm256_storeu_pd(ta + (size_t)k * ld, rb[k]);
+				}
+			}
+	}
+
 }
       
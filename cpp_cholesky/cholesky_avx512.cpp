@@ -0,0 +1,182 @@
+#include <immintrin.h> //AVX-512F
+
+#include "cholesky_kernels.hpp"
+
+// Assumes the machine has AVX-512F instructions
+// Cholesky only selects these kernels when cpuFeatures() reports AVX-512F, see cpu_features.hpp
+// Masked loads and stores handle the tails, so no scalar remainder loops are needed
+
+namespace linalg{
+
+	static inline __mmask16 tailMask(int count)
+	{
+		return (__mmask16)((1u << count) - 1);
+	}
+
+	float sum3VecProductAVX512(const float * u, const float * v, const float * d, int size)
+	{
+		__m512 acc0 = _mm512_setzero_ps();
+		__m512 acc1 = _mm512_setzero_ps();
+		int i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			acc0 = _mm512_fmadd_ps(_mm512_mul_ps(_mm512_loadu_ps(u + i), _mm512_loadu_ps(v + i)), _mm512_loadu_ps(d + i), acc0);
+			acc1 = _mm512_fmadd_ps(_mm512_mul_ps(_mm512_loadu_ps(u + i + 16), _mm512_loadu_ps(v + i + 16)), _mm512_loadu_ps(d + i + 16), acc1);
+		}
+		for (; i < size; i += 16)
+		{
+			__mmask16 m = size - i >= 16 ? (__mmask16)0xFFFF : tailMask(size - i);
+			acc0 = _mm512_fmadd_ps(_mm512_mul_ps(_mm512_maskz_loadu_ps(m, u + i), _mm512_maskz_loadu_ps(m, v + i)), _mm512_maskz_loadu_ps(m, d + i), acc0);
+		}
+		return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+	}
+
+	float sum2VecProductAVX512(const float * u, const float * v, int size)
+	{
+		__m512 acc0 = _mm512_setzero_ps();
+		__m512 acc1 = _mm512_setzero_ps();
+		int i = 0;
+		for (; i + 32 <= size; i += 32)
+		{
+			acc0 = _mm512_fmadd_ps(_mm512_loadu_ps(u + i), _mm512_loadu_ps(v + i), acc0);
+			acc1 = _mm512_fmadd_ps(_mm512_loadu_ps(u + i + 16), _mm512_loadu_ps(v + i + 16), acc1);
+		}
+		for (; i < size; i += 16)
+		{
+			__mmask16 m = size - i >= 16 ? (__mmask16)0xFFFF : tailMask(size - i);
+			acc0 = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, u + i), _mm512_maskz_loadu_ps(m, v + i), acc0);
+		}
+		return _mm512_reduce_add_ps(_mm512_add_ps(acc0, acc1));
+	}
+
+	void axpySubAVX512(float a, const float * x, float * y, int size)
+	{
+		__m512 a16 = _mm512_set1_ps(a);
+		for (int i = 0; i < size; i += 16)
+		{
+			__mmask16 m = size - i >= 16 ? (__mmask16)0xFFFF : tailMask(size - i);
+			_mm512_mask_storeu_ps(y + i, m, _mm512_fnmadd_ps(a16, _mm512_maskz_loadu_ps(m, x + i), _mm512_maskz_loadu_ps(m, y + i)));
+		}
+	}
+
+	// Computes C -= A * B for MR rows of A against a packed panel B (k x n, row-major), MR x 32 results in registers
+	template<int MR>
+	static inline void gemmSubRowsAVX512(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int n, int k)
+	{
+		int j = 0;
+		for (; j + 32 <= n; j += 32)
+		{
+			__m512 acc0[MR], acc1[MR];
+			for (int r = 0; r < MR; r++)
+			{
+				acc0[r] = _mm512_setzero_ps();
+				acc1[r] = _mm512_setzero_ps();
+			}
+			for (int p = 0; p < k; p++)
+			{
+				__m512 b0 = _mm512_loadu_ps(B + p * ldb + j);
+				__m512 b1 = _mm512_loadu_ps(B + p * ldb + j + 16);
+				for (int r = 0; r < MR; r++)
+				{
+					__m512 a = _mm512_set1_ps(A[r * lda + p]);
+					acc0[r] = _mm512_fmadd_ps(a, b0, acc0[r]);
+					acc1[r] = _mm512_fmadd_ps(a, b1, acc1[r]);
+				}
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				float * c = C + r * ldc + j;
+				_mm512_storeu_ps(c, _mm512_sub_ps(_mm512_loadu_ps(c), acc0[r]));
+				_mm512_storeu_ps(c + 16, _mm512_sub_ps(_mm512_loadu_ps(c + 16), acc1[r]));
+			}
+		}
+		for (; j < n; j += 16)
+		{
+			__mmask16 m = n - j >= 16 ? (__mmask16)0xFFFF : tailMask(n - j);
+			__m512 acc[MR];
+			for (int r = 0; r < MR; r++)
+				acc[r] = _mm512_setzero_ps();
+			for (int p = 0; p < k; p++)
+			{
+				__m512 b = _mm512_maskz_loadu_ps(m, B + p * ldb + j);
+				for (int r = 0; r < MR; r++)
+					acc[r] = _mm512_fmadd_ps(_mm512_set1_ps(A[r * lda + p]), b, acc[r]);
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				float * c = C + r * ldc + j;
+				_mm512_mask_storeu_ps(c, m, _mm512_sub_ps(_mm512_maskz_loadu_ps(m, c), acc[r]));
+			}
+		}
+	}
+
+	void gemmSubAVX512(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k)
+	{
+		int i = 0;
+		for (; i + 4 <= m; i += 4)
+			gemmSubRowsAVX512<4>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+		for (; i < m; i++)
+			gemmSubRowsAVX512<1>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+	}
+
+	// 8 sums in one register, lane r holding the sum of a[r]: one reduction for 8 dot products
+	static inline __m256 horizontalSum8AVX512(const __m512 * a)
+	{
+		__m256 h[8];
+		for (int r = 0; r < 8; r++)
+			h[r] = _mm256_add_ps(_mm512_castps512_ps256(a[r]), _mm256_castpd_ps(_mm512_extractf64x4_pd(_mm512_castps_pd(a[r]), 1)));
+		__m256 s0123 = _mm256_hadd_ps(_mm256_hadd_ps(h[0], h[1]), _mm256_hadd_ps(h[2], h[3]));
+		__m256 s4567 = _mm256_hadd_ps(_mm256_hadd_ps(h[4], h[5]), _mm256_hadd_ps(h[6], h[7]));
+		return _mm256_add_ps(_mm256_permute2f128_ps(s0123, s4567, 0x20), _mm256_permute2f128_ps(s0123, s4567, 0x31));
+	}
+
+	// out[r] = rows[r * stride + k] * v[k] (* d[k]) summed over k, for R rows
+	// v (times d) is loaded once per step for all rows and every row has its own accumulator
+	template<int R, bool D>
+	static inline void dotRowsAVX512(const float * rows, int stride, const float * v, const float * d, int size, float * out)
+	{
+		__m512 acc[R];
+		for (int r = 0; r < R; r++)
+			acc[r] = _mm512_setzero_ps();
+		for (int k = 0; k < size; k += 16)
+		{
+			__mmask16 m = size - k >= 16 ? (__mmask16)0xFFFF : tailMask(size - k);
+			__m512 b = _mm512_maskz_loadu_ps(m, v + k);
+			if (D)
+				b = _mm512_mul_ps(b, _mm512_maskz_loadu_ps(m, d + k));
+			for (int r = 0; r < R; r++)
+				acc[r] = _mm512_fmadd_ps(_mm512_maskz_loadu_ps(m, rows + r * stride + k), b, acc[r]);
+		}
+		if (R == 8)
+			_mm256_storeu_ps(out, horizontalSum8AVX512(acc));
+		else
+			for (int r = 0; r < R; r++)
+				out[r] = _mm512_reduce_add_ps(acc[r]);
+	}
+
+	template<bool D>
+	static inline void dotRowsAVX512(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		int r = 0;
+		for (; r + 8 <= numRows; r += 8)
+			dotRowsAVX512<8, D>(rows + r * stride, stride, v, d, size, out + r);
+		if (r + 4 <= numRows)
+		{
+			dotRowsAVX512<4, D>(rows + r * stride, stride, v, d, size, out + r);
+			r += 4;
+		}
+		for (; r < numRows; r++)
+			dotRowsAVX512<1, D>(rows + r * stride, stride, v, d, size, out + r);
+	}
+
+	void sum2VecProductRowsAVX512(const float * rows, int stride, const float * v, int size, int numRows, float * out)
+	{
+		dotRowsAVX512<false>(rows, stride, v, NULL, size, numRows, out);
+	}
+
+	void sum3VecProductRowsAVX512(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		dotRowsAVX512<true>(rows, stride, v, d, size, numRows, out);
+	}
+
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <cmath>
+
+#include "cholesky_banded.hpp"
+
+// Banded: the row-oriented algorithm of Cholesky::calculateCholeskyLLt restricted to the band. Entry (i, j)
+// needs the dot product of rows i and j over columns max(0, i - b) .. j - 1, and both rows hold those
+// columns contiguously in BandedLowerMatrix, so every step is one call of the dot product kernels
+// Block-tridiagonal: for k = 0 .. N - 1
+//   1. factor the diagonal block, L(k, k) L(k, k)^T = A(k, k)
+//   2. solve the block below it, L(k + 1, k) = A(k + 1, k) L(k, k)^-T
+//   3. update the next diagonal block, A(k + 1, k + 1) -= L(k + 1, k) L(k + 1, k)^T
+// with the blocked kernels of cholesky_blocked.cpp, in panels of blockSize columns
+
+namespace linalg{
+
+	template<typename T>
+	bool bandedCholesky(BandedLowerMatrix<T> & A, T * diag, const CholeskyKernels<T> & kernels)
+	{
+		int n = A.rows;
+		for (int i = 0; i < n; i++)
+		{
+			int lo = A.firstCol(i);
+			T * rowI = &A(i, lo);
+			// Columns of row j left of j start at lo too, as rows above i start at or before it
+			for (int j = lo; j < i; j++)
+			{
+				const T * rowJ = &A(j, lo);
+				if (diag)
+					rowI[j - lo] = (rowI[j - lo] - kernels.sum3VecProduct(rowI, rowJ, diag + lo, j - lo)) / diag[j];
+				else
+					rowI[j - lo] = (rowI[j - lo] - kernels.sum2VecProduct(rowI, rowJ, j - lo)) / rowJ[j - lo];
+			}
+			T d = rowI[i - lo] - (diag ? kernels.sum3VecProduct(rowI, rowI, diag + lo, i - lo) : kernels.sum2VecProduct(rowI, rowI, i - lo));
+			if (!(d > 0))
+				return false;
+			if (diag)
+				diag[i] = rowI[i - lo] = d;
+			else
+				rowI[i - lo] = std::sqrt(d);
+		}
+		return true;
+	}
+
+	template<typename T>
+	void bandedCholeskySolve(const BandedLowerMatrix<T> & L, const T * diag, T * b, const CholeskyKernels<T> & kernels)
+	{
+		int n = L.rows;
+		// L y = b
+		for (int i = 0; i < n; i++)
+		{
+			int lo = L.firstCol(i);
+			b[i] -= kernels.sum2VecProduct(&L(i, lo), b + lo, i - lo);
+			if (!diag)
+				b[i] /= L(i, i);
+		}
+		// LDL^T: L has a unit diagonal, D^-1 y
+		if (diag)
+			for (int i = 0; i < n; i++)
+				b[i] /= diag[i];
+		// L^T x = y, once x(i) is known remove its contribution from the rows above
+		for (int i = n - 1; i >= 0; i--)
+		{
+			int lo = L.firstCol(i);
+			if (!diag)
+				b[i] /= L(i, i);
+			kernels.axpySub(b[i], &L(i, lo), b + lo, i - lo);
+		}
+	}
+
+	// B <- B L^-T (D^-1) for the factored square block L, in panels of blockSize columns
+	template<typename T>
+	static void solveBlockColumns(MatrixView<T> B, MatrixView<const T> L, const T * diag, int blockSize, MatrixView<T> packed, const CholeskyKernels<T> & kernels)
+	{
+		int m = L.rows;
+		for (int k0 = 0; k0 < m; k0 += blockSize)
+		{
+			int k1 = std::min(k0 + blockSize, m);
+			const T * dk = diag ? diag + k0 : diag;
+			solveBlock(&B(0, k0), B.stride, &L(k0, k0), L.stride, dk, B.rows, k1 - k0, kernels);
+			if (k1 == m)
+				break;
+			// Remaining columns: B(:, k1:m) -= B(:, k0:k1) (D) L(k1:m, k0:k1)^T
+			packTransposed(&L(k1, k0), L.stride, dk, m - k1, k1 - k0, packed.data, packed.stride);
+			updatePacked(&B(0, k1), B.stride, &B(0, k0), B.stride, packed.data, packed.stride, B.rows, m - k1, k1 - k0, false, kernels);
+		}
+	}
+
+	// Lower triangle of C -= W (D) W^T, W is square, in panels of blockSize columns of W
+	template<typename T>
+	static void updateLowerBlock(MatrixView<T> C, MatrixView<const T> W, const T * diag, int blockSize, MatrixView<T> packed, const CholeskyKernels<T> & kernels)
+	{
+		int m = W.rows;
+		for (int k0 = 0; k0 < m; k0 += blockSize)
+		{
+			int k1 = std::min(k0 + blockSize, m);
+			packTransposed(&W(0, k0), W.stride, diag ? diag + k0 : diag, m, k1 - k0, packed.data, packed.stride);
+			updatePacked(C.data, C.stride, &W(0, k0), W.stride, packed.data, packed.stride, m, m, k1 - k0, true, kernels);
+		}
+	}
+
+	template<typename T>
+	bool blockTridiagonalCholesky(BlockTridiagonalMatrix<T> & A, T * diag, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int m = A.blockSize;
+		blockSize = std::max(1, std::min(blockSize, CHOLESKY_MAX_BLOCK_SIZE));
+		// The blocked factorization of the diagonal blocks resizes work too, to the same size
+		int ldp = util::getColStride(m);
+		work.resize((size_t)std::min(blockSize, m) * ldp);
+
+		for (int k = 0; k < A.numBlocks; k++)
+		{
+			T * dk = diag ? diag + k * m : diag;
+			MatrixView<T> Akk = A.diagonalBlock(k);
+			if (diag)
+				blockedCholeskyLDLt(Akk, dk, blockSize, work, kernels);
+			else
+				blockedCholeskyLLt(Akk, blockSize, work, kernels);
+			for (int i = 0; i < m; i++)
+				if (!(Akk(i, i) > 0))
+					return false;
+			if (k + 1 == A.numBlocks)
+				break;
+
+			MatrixView<T> packed(&work[0], std::min(blockSize, m), m, ldp);
+			MatrixView<T> Lk = A.subBlock(k);
+			solveBlockColumns(Lk, MatrixView<const T>(Akk.data, m, m, Akk.stride), dk, blockSize, packed, kernels);
+			updateLowerBlock(A.diagonalBlock(k + 1), MatrixView<const T>(Lk.data, m, m, Lk.stride), dk, blockSize, packed, kernels);
+		}
+		return true;
+	}
+
+	template<typename T>
+	void blockTridiagonalSolve(const BlockTridiagonalMatrix<T> & L, const T * diag, T * b, const CholeskyKernels<T> & kernels)
+	{
+		int m = L.blockSize;
+		int nb = L.numBlocks;
+		T sums[CHOLESKY_DOT_ROWS];
+
+		// L y = b, by block rows
+		for (int k = 0; k < nb; k++)
+		{
+			T * bk = b + k * m;
+			if (k > 0)
+			{
+				MatrixView<const T> Lk = L.subBlock(k - 1);
+				for (int r = 0; r < m; r += CHOLESKY_DOT_ROWS)
+				{
+					int numRows = std::min(CHOLESKY_DOT_ROWS, m - r);
+					kernels.sum2VecProductRows(&Lk(r, 0), Lk.stride, bk - m, m, numRows, sums);
+					for (int q = 0; q < numRows; q++)
+						bk[r + q] -= sums[q];
+				}
+			}
+			MatrixView<const T> Lkk = L.diagonalBlock(k);
+			for (int r = 0; r < m; r++)
+			{
+				bk[r] -= kernels.sum2VecProduct(&Lkk(r, 0), bk, r);
+				if (!diag)
+					bk[r] /= Lkk(r, r);
+			}
+		}
+		// LDL^T: L has a unit diagonal, D^-1 y
+		if (diag)
+			for (int i = 0; i < L.rows; i++)
+				b[i] /= diag[i];
+		// L^T x = y, once x(i) is known remove its contribution from the rows above
+		for (int k = nb - 1; k >= 0; k--)
+		{
+			T * bk = b + k * m;
+			MatrixView<const T> Lkk = L.diagonalBlock(k);
+			for (int r = m - 1; r >= 0; r--)
+			{
+				if (!diag)
+					bk[r] /= Lkk(r, r);
+				kernels.axpySub(bk[r], &Lkk(r, 0), bk, r);
+				if (k > 0)
+					kernels.axpySub(bk[r], &L.subBlock(k - 1)(r, 0), bk - m, m);
+			}
+		}
+	}
+
+	template bool bandedCholesky<float>(BandedLowerMatrix<float> &, float *, const CholeskyKernels<float> &);
+	template bool bandedCholesky<double>(BandedLowerMatrix<double> &, double *, const CholeskyKernels<double> &);
+	template void bandedCholeskySolve<float>(const BandedLowerMatrix<float> &, const float *, float *, const CholeskyKernels<float> &);
+	template void bandedCholeskySolve<double>(const BandedLowerMatrix<double> &, const double *, double *, const CholeskyKernels<double> &);
+	template bool blockTridiagonalCholesky<float>(BlockTridiagonalMatrix<float> &, float *, int, std::vector<float> &, const CholeskyKernels<float> &);
+	template bool blockTridiagonalCholesky<double>(BlockTridiagonalMatrix<double> &, double *, int, std::vector<double> &, const CholeskyKernels<double> &);
+	template void blockTridiagonalSolve<float>(const BlockTridiagonalMatrix<float> &, const float *, float *, const CholeskyKernels<float> &);
+	template void blockTridiagonalSolve<double>(const BlockTridiagonalMatrix<double> &, const double *, double *, const CholeskyKernels<double> &);
+
+}
@@ -0,0 +1,139 @@
+#ifndef _LINALG_CHOLESKY_BANDED_HPP_
+#define _LINALG_CHOLESKY_BANDED_HPP_
+
+#include "cholesky.hpp"
+#include "banded_matrix.hpp"
+
+// Cholesky of structured SPD matrices whose factor has no fill outside their nonzero structure
+//   - banded (BandedLowerMatrix): L has the bandwidth b of A, O(n b^2) time and O(n b) memory
+//   - block-tridiagonal (BlockTridiagonalMatrix): L is block bidiagonal, every step is a dense
+//     factorization, panel solve and update of one block, run by the blocked kernels
+// See Golub & Van Loan, section 4.3
+
+namespace linalg{
+
+	// Row-oriented factorization in place, diag == NULL selects LL^T (see cholesky_banded.cpp)
+	// Returns false if A is not positive definite, A is then partially overwritten
+	template<typename T>
+	bool bandedCholesky(BandedLowerMatrix<T> & A, T * diag, const CholeskyKernels<T> & kernels);
+
+	// Solves A x = b in place with a factor stored as by bandedCholesky
+	template<typename T>
+	void bandedCholeskySolve(const BandedLowerMatrix<T> & L, const T * diag, T * b, const CholeskyKernels<T> & kernels);
+
+	// Block factorization in place, in panels of blockSize columns inside the blocks, diag == NULL selects LL^T
+	// work holds a packed panel, it is resized as needed and can be kept across calls
+	// Returns false if A is not positive definite
+	template<typename T>
+	bool blockTridiagonalCholesky(BlockTridiagonalMatrix<T> & A, T * diag, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+	// Solves A x = b in place with a factor stored as by blockTridiagonalCholesky
+	template<typename T>
+	void blockTridiagonalSolve(const BlockTridiagonalMatrix<T> & L, const T * diag, T * b, const CholeskyKernels<T> & kernels);
+
+/// Same storage conventions as Cholesky for a banded matrix: L, or the unit L of LDL^T with D on its diagonal
+/// Passing the input as an rvalue factors it in place, without any copy
+template<typename T>
+class BandedCholesky
+{
+public:
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	/// BLOCKED, PARALLEL, AUTO and BLAS all run the widest kernels
+	BandedCholesky(int size, int bandwidth, CholeskyImpl impl) : m_chol(size, bandwidth), diag(size)
+	{
+		if (!isSupported(impl))
+			throw std::runtime_error("BandedCholesky: instruction set not supported by this CPU");
+		m_kernels = CholeskyKernels<T>::select(kernelImpl(impl));
+	}
+
+	/// Compute the LDL^T decomposition of mat, given mat
+	/// Returns false if mat is not positive definite
+	bool calculateCholeskyLDLt(const BandedLowerMatrix<T> & M) { m_chol = M; return factor(true); }
+	bool calculateCholeskyLDLt(BandedLowerMatrix<T> && M) { m_chol = std::move(M); return factor(true); }
+	bool calculateCholeskyLDLt(const Matrix<T> & M) { m_chol.pack(M); return factor(true); }
+
+	/// Compute the LL^T decomposition of mat, given mat
+	/// Returns false if mat is not positive definite
+	bool calculateCholeskyLLt(const BandedLowerMatrix<T> & M) { m_chol = M; return factor(false); }
+	bool calculateCholeskyLLt(BandedLowerMatrix<T> && M) { m_chol = std::move(M); return factor(false); }
+	bool calculateCholeskyLLt(const Matrix<T> & M) { m_chol.pack(M); return factor(false); }
+
+	/// Solves A x = b in place, using the factor of the last calculateCholeskyLLt/LDLt call
+	void solve(std::vector<T> & b) const
+	{
+		assert((int)b.size() == m_chol.rows);
+		bandedCholeskySolve(m_chol, m_isLDLt ? &diag[0] : NULL, &b[0], m_kernels);
+	}
+
+	/// Full factor, with the upper triangle mirrored as in Cholesky::getCholeskyMatrix
+	Matrix<T> getCholeskyMatrix() const { return m_chol.toMatrix(); }
+
+	const BandedLowerMatrix<T> & getBandedMatrix() const { return m_chol; }
+
+private:
+	bool factor(bool ldlt)
+	{
+		m_isLDLt = ldlt;
+		return bandedCholesky(m_chol, ldlt ? &diag[0] : (T *)NULL, m_kernels);
+	}
+
+	BandedLowerMatrix<T> m_chol;
+	std::vector<T> diag;
+	CholeskyKernels<T> m_kernels;
+	bool m_isLDLt = false;
+};
+
+/// Same storage conventions as Cholesky for a block-tridiagonal matrix, the factor is block bidiagonal
+template<typename T>
+class BlockTridiagonalCholesky
+{
+public:
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	/// BLOCKED, PARALLEL, AUTO and BLAS all run the widest kernels
+	BlockTridiagonalCholesky(int numBlocks, int blockSize, CholeskyImpl impl) : m_chol(numBlocks, blockSize), diag(numBlocks * blockSize)
+	{
+		if (!isSupported(impl))
+			throw std::runtime_error("BlockTridiagonalCholesky: instruction set not supported by this CPU");
+		m_kernels = CholeskyKernels<T>::select(kernelImpl(impl));
+	}
+
+	/// Compute the LDL^T decomposition of mat, given mat
+	/// Returns false if mat is not positive definite
+	bool calculateCholeskyLDLt(const BlockTridiagonalMatrix<T> & M) { m_chol = M; return factor(true); }
+	bool calculateCholeskyLDLt(BlockTridiagonalMatrix<T> && M) { m_chol = std::move(M); return factor(true); }
+
+	/// Compute the LL^T decomposition of mat, given mat
+	/// Returns false if mat is not positive definite
+	bool calculateCholeskyLLt(const BlockTridiagonalMatrix<T> & M) { m_chol = M; return factor(false); }
+	bool calculateCholeskyLLt(BlockTridiagonalMatrix<T> && M) { m_chol = std::move(M); return factor(false); }
+
+	/// Solves A x = b in place, using the factor of the last calculateCholeskyLLt/LDLt call
+	void solve(std::vector<T> & b) const
+	{
+		assert((int)b.size() == m_chol.rows);
+		blockTridiagonalSolve(m_chol, m_isLDLt ? &diag[0] : NULL, &b[0], m_kernels);
+	}
+
+	/// Full factor, with the upper triangle mirrored as in Cholesky::getCholeskyMatrix
+	Matrix<T> getCholeskyMatrix() const { return m_chol.toMatrix(); }
+
+	/// Columns per panel inside the blocks, capped at CHOLESKY_MAX_BLOCK_SIZE
+	void setBlockSize(int blockSize) { m_blockSize = std::max(1, std::min(blockSize, CHOLESKY_MAX_BLOCK_SIZE)); }
+
+private:
+	bool factor(bool ldlt)
+	{
+		m_isLDLt = ldlt;
+		return blockTridiagonalCholesky(m_chol, ldlt ? &diag[0] : (T *)NULL, m_blockSize, m_work, m_kernels);
+	}
+
+	BlockTridiagonalMatrix<T> m_chol;
+	std::vector<T> diag;
+	CholeskyKernels<T> m_kernels;
+	bool m_isLDLt = false;
+	int m_blockSize = CHOLESKY_BLOCK_SIZE;
+	std::vector<T> m_work; // packed panel of the block updates
+};
+
+}
+#endif
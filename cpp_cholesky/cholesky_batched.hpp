@@ -0,0 +1,221 @@
+#ifndef _LINALG_CHOLESKY_BATCHED_HPP_
+#define _LINALG_CHOLESKY_BATCHED_HPP_
+
+#include "matrix.hpp"
+#include "cholesky_kernels.hpp"
+#include "cpu_features.hpp"
+#include "cpp_benchmark/perf_counters.hpp"
+#include <cmath>
+#include <stdexcept>
+
+// Batched Cholesky for many small matrices of the same size
+// Matrices are interleaved across SIMD lanes: BATCH_LANES matrices form a group and element (r, c)
+// of all matrices in a group is stored contiguously, so one AVX register holds (r, c) of 8 matrices
+// and one AVX-512 register holds it for all 16. Every step of the factorization then runs on
+// full-width vectors, whatever the matrix size, instead of on dot products of length j < 8
+
+namespace linalg{
+
+	// AUTO picks the widest kernel the CPU supports
+	enum class BatchImpl { CPP, AVX, AVX512, AUTO };
+
+	inline bool isSupported(BatchImpl impl)
+	{
+		switch (impl)
+		{
+		case BatchImpl::AVX512:
+			return cpuFeatures().avx512f;
+		case BatchImpl::AVX:
+			return cpuFeatures().avx;
+		default:
+			return true;
+		}
+	}
+
+	inline void batchedCholeskyLLt(float * data, int size, int groups)
+	{
+		for (int g = 0; g < groups; g++)
+		{
+			float * G = data + g * size * size * BATCH_LANES;
+			for (int j = 0; j < size; j++)
+			{
+				float * Gjj = G + (j * size + j) * BATCH_LANES;
+				for (int l = 0; l < BATCH_LANES; l++)
+				{
+					float sum = 0;
+					for (int k = 0; k < j; k++)
+						sum += G[(j * size + k) * BATCH_LANES + l] * G[(j * size + k) * BATCH_LANES + l];
+					Gjj[l] = std::sqrt(Gjj[l] - sum);
+				}
+				for (int i = j + 1; i < size; i++)
+					for (int l = 0; l < BATCH_LANES; l++)
+					{
+						float sum = 0;
+						for (int k = 0; k < j; k++)
+							sum += G[(i * size + k) * BATCH_LANES + l] * G[(j * size + k) * BATCH_LANES + l];
+						G[(i * size + j) * BATCH_LANES + l] = (G[(i * size + j) * BATCH_LANES + l] - sum) / Gjj[l];
+					}
+			}
+		}
+	}
+
+	inline void batchedCholeskyLDLt(float * data, int size, int groups)
+	{
+		for (int g = 0; g < groups; g++)
+		{
+			float * G = data + g * size * size * BATCH_LANES;
+			for (int j = 0; j < size; j++)
+			{
+				float * Gjj = G + (j * size + j) * BATCH_LANES;
+				for (int l = 0; l < BATCH_LANES; l++)
+				{
+					float sum = 0;
+					for (int k = 0; k < j; k++)
+						sum += G[(j * size + k) * BATCH_LANES + l] * G[(j * size + k) * BATCH_LANES + l] * G[(k * size + k) * BATCH_LANES + l];
+					Gjj[l] = Gjj[l] - sum;
+				}
+				for (int i = j + 1; i < size; i++)
+					for (int l = 0; l < BATCH_LANES; l++)
+					{
+						float sum = 0;
+						for (int k = 0; k < j; k++)
+							sum += G[(i * size + k) * BATCH_LANES + l] * G[(j * size + k) * BATCH_LANES + l] * G[(k * size + k) * BATCH_LANES + l];
+						G[(i * size + j) * BATCH_LANES + l] = (G[(i * size + j) * BATCH_LANES + l] - sum) / Gjj[l];
+					}
+			}
+		}
+	}
+
+/// count matrices of size x size stored lane-major, see above
+/// Matrix m is lane m % BATCH_LANES of group m / BATCH_LANES
+/// Lanes past count in the last group hold identity matrices, so they factor without NaNs
+/// Throws std::invalid_argument if size is larger than BATCH_MAX_SIZE, the largest the SIMD kernels handle
+class MatrixBatch
+{
+public:
+	MatrixBatch(int s, int c) : size(s), count(c), groups((c + BATCH_LANES - 1) / BATCH_LANES)
+	{
+		if (size > BATCH_MAX_SIZE)
+			throw std::invalid_argument("MatrixBatch: size larger than BATCH_MAX_SIZE");
+		data = linalg::util::alignedCalloc<float>(groups * size * size * BATCH_LANES, sizeof(float), MEM_ALIGNMENT);
+		for (int m = count; m < groups * BATCH_LANES; m++)
+			for (int r = 0; r < size; r++)
+				(*this)(m, r, r) = 1;
+	}
+
+	MatrixBatch(const MatrixBatch & b) : size(b.size), count(b.count), groups(b.groups)
+	{
+		data = linalg::util::alignedCalloc<float>(groups * size * size * BATCH_LANES, sizeof(float), MEM_ALIGNMENT);
+		memcpy(data, b.data, groups * size * size * BATCH_LANES * sizeof(float));
+	}
+
+	~MatrixBatch()
+	{
+		free(data);
+	}
+
+	MatrixBatch & operator=(const MatrixBatch & b)
+	{
+		assert(size == b.size);
+		assert(count == b.count);
+		memcpy(data, b.data, groups * size * size * BATCH_LANES * sizeof(float));
+		return *this;
+	}
+
+	float & operator()(int m, int r, int c) { return data[index(m, r, c)]; }
+	const float & operator()(int m, int r, int c) const { return data[index(m, r, c)]; }
+
+	void setMatrix(int m, const Matrix<float> & M)
+	{
+		assert(M.rows == size && M.cols == size);
+		for (int r = 0; r < size; r++)
+			for (int c = 0; c < size; c++)
+				(*this)(m, r, c) = M(r, c);
+	}
+
+	Matrix<float> getMatrix(int m) const
+	{
+		Matrix<float> M(size, size);
+		for (int r = 0; r < size; r++)
+			for (int c = 0; c < size; c++)
+				M(r, c) = (*this)(m, r, c);
+		return M;
+	}
+
+	int size;
+	int count;
+	int groups;
+
+	float * data;
+
+private:
+	int index(int m, int r, int c) const
+	{
+		return ((m / BATCH_LANES) * size * size + r * size + c) * BATCH_LANES + m % BATCH_LANES;
+	}
+};
+
+/// Factors every matrix of a MatrixBatch at once, one matrix per SIMD lane
+/// Same storage conventions as Cholesky: LL^T keeps L in the lower triangle, LDL^T keeps D on the diagonal
+class BatchedCholesky
+{
+public:
+	/// Throws std::invalid_argument if size is larger than BATCH_MAX_SIZE, see MatrixBatch
+	BatchedCholesky(int size, int count, BatchImpl impl) : m_chol(size, count)
+	{
+		if (impl == BatchImpl::AUTO)
+			impl = isSupported(BatchImpl::AVX512) ? BatchImpl::AVX512 : isSupported(BatchImpl::AVX) ? BatchImpl::AVX : BatchImpl::CPP;
+		if (!isSupported(impl))
+			throw std::runtime_error("BatchedCholesky: instruction set not supported by this CPU");
+		switch (impl)
+		{
+		case BatchImpl::AVX512:
+			m_LDLt_Impl = &batchedCholeskyLDLtAVX512;
+			m_LLt_Impl = &batchedCholeskyLLtAVX512;
+			break;
+		case BatchImpl::AVX:
+			m_LDLt_Impl = &batchedCholeskyLDLtAVX;
+			m_LLt_Impl = &batchedCholeskyLLtAVX;
+			break;
+		case BatchImpl::CPP:
+		default:
+			m_LDLt_Impl = &batchedCholeskyLDLt;
+			m_LLt_Impl = &batchedCholeskyLLt;
+			break;
+		}
+	}
+
+	void calculateCholeskyLDLt(const MatrixBatch & B)
+	{
+		m_chol = B;
+		BENCH_COUNTERS_SCOPE("batched-LDLt");
+		m_LDLt_Impl(m_chol.data, m_chol.size, m_chol.groups);
+	}
+
+	void calculateCholeskyLLt(const MatrixBatch & B)
+	{
+		m_chol = B;
+		BENCH_COUNTERS_SCOPE("batched-LLt");
+		m_LLt_Impl(m_chol.data, m_chol.size, m_chol.groups);
+	}
+
+	/// Factor of matrix m, with the upper triangle mirrored as in Cholesky::getCholeskyMatrix
+	Matrix<float> getCholeskyMatrix(int m) const
+	{
+		Matrix<float> chol(m_chol.size, m_chol.size);
+		for (int i = 0; i < m_chol.size; i++)
+			for (int j = 0; j <= i; j++)
+				chol(i, j) = chol(j, i) = m_chol(m, i, j);
+		return chol;
+	}
+
+	const MatrixBatch & getBatch() const { return m_chol; }
+
+private:
+	MatrixBatch m_chol;
+	void (*m_LDLt_Impl)(float * data, int size, int groups) = NULL;
+	void (*m_LLt_Impl)(float * data, int size, int groups) = NULL;
+};
+
+}
+#endif
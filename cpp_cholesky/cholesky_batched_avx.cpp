@@ -0,0 +1,100 @@
+#include <immintrin.h> //AVX
+
+#include "cholesky_kernels.hpp"
+
+// Assumes the machine has AVX instructions
+// A group of BATCH_LANES = 16 matrices is processed as two independent 8-lane halves,
+// interleaved so that their dependency chains overlap
+
+namespace linalg{
+
+	void batchedCholeskyLLtAVX(float * data, int size, int groups)
+	{
+		const int rowStride = size * BATCH_LANES;
+		for (int g = 0; g < groups; g++)
+		{
+			float * G = data + g * size * rowStride;
+			for (int j = 0; j < size; j++)
+			{
+				const float * Lj = G + j * rowStride;
+				__m256 d0 = _mm256_load_ps(Lj + j * BATCH_LANES);
+				__m256 d1 = _mm256_load_ps(Lj + j * BATCH_LANES + 8);
+				for (int k = 0; k < j; k++)
+				{
+					__m256 l0 = _mm256_load_ps(Lj + k * BATCH_LANES);
+					__m256 l1 = _mm256_load_ps(Lj + k * BATCH_LANES + 8);
+					d0 = _mm256_sub_ps(d0, _mm256_mul_ps(l0, l0));
+					d1 = _mm256_sub_ps(d1, _mm256_mul_ps(l1, l1));
+				}
+				d0 = _mm256_sqrt_ps(d0);
+				d1 = _mm256_sqrt_ps(d1);
+				_mm256_store_ps(G + j * rowStride + j * BATCH_LANES, d0);
+				_mm256_store_ps(G + j * rowStride + j * BATCH_LANES + 8, d1);
+
+				__m256 inv0 = _mm256_div_ps(_mm256_set1_ps(1), d0);
+				__m256 inv1 = _mm256_div_ps(_mm256_set1_ps(1), d1);
+				for (int i = j + 1; i < size; i++)
+				{
+					float * Li = G + i * rowStride;
+					__m256 s0 = _mm256_load_ps(Li + j * BATCH_LANES);
+					__m256 s1 = _mm256_load_ps(Li + j * BATCH_LANES + 8);
+					for (int k = 0; k < j; k++)
+					{
+						s0 = _mm256_sub_ps(s0, _mm256_mul_ps(_mm256_load_ps(Li + k * BATCH_LANES), _mm256_load_ps(Lj + k * BATCH_LANES)));
+						s1 = _mm256_sub_ps(s1, _mm256_mul_ps(_mm256_load_ps(Li + k * BATCH_LANES + 8), _mm256_load_ps(Lj + k * BATCH_LANES + 8)));
+					}
+					_mm256_store_ps(Li + j * BATCH_LANES, _mm256_mul_ps(s0, inv0));
+					_mm256_store_ps(Li + j * BATCH_LANES + 8, _mm256_mul_ps(s1, inv1));
+				}
+			}
+		}
+	}
+
+	void batchedCholeskyLDLtAVX(float * data, int size, int groups)
+	{
+		const int rowStride = size * BATCH_LANES;
+		// Row j scaled by D, computed once per column and reused by every row below it
+		__attribute__((aligned(32))) float scaled[BATCH_MAX_SIZE * BATCH_LANES];
+
+		for (int g = 0; g < groups; g++)
+		{
+			float * G = data + g * size * rowStride;
+			for (int j = 0; j < size; j++)
+			{
+				const float * Lj = G + j * rowStride;
+				__m256 d0 = _mm256_load_ps(Lj + j * BATCH_LANES);
+				__m256 d1 = _mm256_load_ps(Lj + j * BATCH_LANES + 8);
+				for (int k = 0; k < j; k++)
+				{
+					__m256 l0 = _mm256_load_ps(Lj + k * BATCH_LANES);
+					__m256 l1 = _mm256_load_ps(Lj + k * BATCH_LANES + 8);
+					__m256 w0 = _mm256_mul_ps(l0, _mm256_load_ps(G + k * rowStride + k * BATCH_LANES));
+					__m256 w1 = _mm256_mul_ps(l1, _mm256_load_ps(G + k * rowStride + k * BATCH_LANES + 8));
+					_mm256_store_ps(scaled + k * BATCH_LANES, w0);
+					_mm256_store_ps(scaled + k * BATCH_LANES + 8, w1);
+					d0 = _mm256_sub_ps(d0, _mm256_mul_ps(l0, w0));
+					d1 = _mm256_sub_ps(d1, _mm256_mul_ps(l1, w1));
+				}
+				_mm256_store_ps(G + j * rowStride + j * BATCH_LANES, d0);
+				_mm256_store_ps(G + j * rowStride + j * BATCH_LANES + 8, d1);
+
+				__m256 inv0 = _mm256_div_ps(_mm256_set1_ps(1), d0);
+				__m256 inv1 = _mm256_div_ps(_mm256_set1_ps(1), d1);
+				for (int i = j + 1; i < size; i++)
+				{
+					float * Li = G + i * rowStride;
+					__m256 s0 = _mm256_load_ps(Li + j * BATCH_LANES);
+					__m256 s1 = _mm256_load_ps(Li + j * BATCH_LANES + 8);
+					for (int k = 0; k < j; k++)
+					{
+						s0 = _mm256_sub_ps(s0, _mm256_mul_ps(_mm256_load_ps(Li + k * BATCH_LANES), _mm256_load_ps(scaled + k * BATCH_LANES)));
+						s1 = _mm256_sub_ps(s1, _mm256_mul_ps(_mm256_load_ps(Li + k * BATCH_LANES + 8), _mm256_load_ps(scaled + k * BATCH_LANES + 8)));
+					}
+					_mm256_store_ps(Li + j * BATCH_LANES, _mm256_mul_ps(s0, inv0));
+					_mm256_store_ps(Li + j * BATCH_LANES + 8, _mm256_mul_ps(s1, inv1));
+				}
+			}
+		}
+	}
+
+}
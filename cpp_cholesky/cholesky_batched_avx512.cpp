@@ -0,0 +1,76 @@
+#include <immintrin.h> //AVX-512F
+
+#include "cholesky_kernels.hpp"
+
+// Assumes the machine has AVX-512F instructions
+// A group of BATCH_LANES = 16 matrices fills exactly one register
+
+namespace linalg{
+
+	void batchedCholeskyLLtAVX512(float * data, int size, int groups)
+	{
+		const int rowStride = size * BATCH_LANES;
+		for (int g = 0; g < groups; g++)
+		{
+			float * G = data + g * size * rowStride;
+			for (int j = 0; j < size; j++)
+			{
+				const float * Lj = G + j * rowStride;
+				__m512 d = _mm512_load_ps(Lj + j * BATCH_LANES);
+				for (int k = 0; k < j; k++)
+				{
+					__m512 l = _mm512_load_ps(Lj + k * BATCH_LANES);
+					d = _mm512_fnmadd_ps(l, l, d);
+				}
+				d = _mm512_sqrt_ps(d);
+				_mm512_store_ps(G + j * rowStride + j * BATCH_LANES, d);
+
+				__m512 inv = _mm512_div_ps(_mm512_set1_ps(1), d);
+				for (int i = j + 1; i < size; i++)
+				{
+					float * Li = G + i * rowStride;
+					__m512 s = _mm512_load_ps(Li + j * BATCH_LANES);
+					for (int k = 0; k < j; k++)
+						s = _mm512_fnmadd_ps(_mm512_load_ps(Li + k * BATCH_LANES), _mm512_load_ps(Lj + k * BATCH_LANES), s);
+					_mm512_store_ps(Li + j * BATCH_LANES, _mm512_mul_ps(s, inv));
+				}
+			}
+		}
+	}
+
+	void batchedCholeskyLDLtAVX512(float * data, int size, int groups)
+	{
+		const int rowStride = size * BATCH_LANES;
+		// Row j scaled by D, computed once per column and reused by every row below it
+		__attribute__((aligned(64))) float scaled[BATCH_MAX_SIZE * BATCH_LANES];
+
+		for (int g = 0; g < groups; g++)
+		{
+			float * G = data + g * size * rowStride;
+			for (int j = 0; j < size; j++)
+			{
+				const float * Lj = G + j * rowStride;
+				__m512 d = _mm512_load_ps(Lj + j * BATCH_LANES);
+				for (int k = 0; k < j; k++)
+				{
+					__m512 l = _mm512_load_ps(Lj + k * BATCH_LANES);
+					__m512 w = _mm512_mul_ps(l, _mm512_load_ps(G + k * rowStride + k * BATCH_LANES));
+					_mm512_store_ps(scaled + k * BATCH_LANES, w);
+					d = _mm512_fnmadd_ps(l, w, d);
+				}
+				_mm512_store_ps(G + j * rowStride + j * BATCH_LANES, d);
+
+				__m512 inv = _mm512_div_ps(_mm512_set1_ps(1), d);
+				for (int i = j + 1; i < size; i++)
+				{
+					float * Li = G + i * rowStride;
+					__m512 s = _mm512_load_ps(Li + j * BATCH_LANES);
+					for (int k = 0; k < j; k++)
+						s = _mm512_fnmadd_ps(_mm512_load_ps(Li + k * BATCH_LANES), _mm512_load_ps(scaled + k * BATCH_LANES), s);
+					_mm512_store_ps(Li + j * BATCH_LANES, _mm512_mul_ps(s, inv));
+				}
+			}
+		}
+	}
+
+}
@@ -0,0 +1,183 @@
+#include <algorithm>
+
+#include "cholesky.hpp"
+
+// Right-looking blocked Cholesky, see Golub & Van Loan, section 4.2.9
+// For every panel of blockSize columns:
+//   1. factor the diagonal block with the row-oriented (Cholesky-Banachiewicz) algorithm
+//   2. solve the rows below the diagonal block against it (triangular solve, TRSM)
+//   3. subtract the panel's contribution from the trailing lower triangle (SYRK/GEMM)
+// Step 3 does nearly all the flops and works on cache-sized blocks, unlike the column-by-column
+// dot products in Cholesky::calculateCholeskyLLt which stream the whole matrix for every column
+// The three steps are also the tile kernels of the task-parallel factorization in cholesky_tiled.cpp
+// Each step is a hardware counter region (see cpp_benchmark/perf_counters.hpp), counted per thread
+
+namespace linalg{
+
+	// Number of trailing columns updated against one packed panel, so that the
+	// packed panel slice (blockSize x UPDATE_COLS elements) stays in L2
+	static const int UPDATE_COLS = 256;
+
+	// Forward substitution of one row (columns 0..end-1 of the block) against the rows of the factored block L
+	// The entries of the row left of column j are already final when column j is solved
+	template<typename T>
+	static void solveRow(T * row, const T * L, int ldl, const T * diag, int end, const T * invDiag, const CholeskyKernels<T> & kernels)
+	{
+		if (diag)
+			for (int j = 0; j < end; j++)
+				row[j] = invDiag[j] * (row[j] - kernels.sum3VecProduct(row, &L[j * ldl], diag, j));
+		else
+			for (int j = 0; j < end; j++)
+				row[j] = invDiag[j] * (row[j] - kernels.sum2VecProduct(row, &L[j * ldl], j));
+	}
+
+	template<typename T>
+	void factorBlock(T * A, int lda, T * diag, int nb, const CholeskyKernels<T> & kernels)
+	{
+		T invDiag[CHOLESKY_MAX_BLOCK_SIZE];
+		for (int i = 0; i < nb; i++)
+		{
+			T * rowI = &A[i * lda];
+			solveRow(rowI, A, lda, diag, i, invDiag, kernels);
+			if (diag)
+			{
+				rowI[i] = rowI[i] - kernels.sum3VecProduct(rowI, rowI, diag, i);
+				diag[i] = rowI[i];
+			}
+			else
+			{
+				rowI[i] = std::sqrt(rowI[i] - kernels.sum2VecProduct(rowI, rowI, i));
+			}
+			invDiag[i] = 1 / rowI[i];
+		}
+	}
+
+	// The rows of B are independent: CHOLESKY_DOT_ROWS of them are solved together, column j of all of them from one
+	// multi-row dot product that loads row j of L once, instead of one short dot product and reduction per entry
+	template<typename T>
+	void solveBlock(T * B, int ldb, const T * L, int ldl, const T * diag, int rows, int nb, const CholeskyKernels<T> & kernels)
+	{
+		T invDiag[CHOLESKY_MAX_BLOCK_SIZE];
+		for (int j = 0; j < nb; j++)
+			invDiag[j] = 1 / L[j * ldl + j];
+		T sums[CHOLESKY_DOT_ROWS];
+		for (int i = 0; i < rows; i += CHOLESKY_DOT_ROWS)
+		{
+			int numRows = std::min(CHOLESKY_DOT_ROWS, rows - i);
+			T * rowsI = &B[i * ldb];
+			for (int j = 0; j < nb; j++)
+			{
+				if (diag)
+					kernels.sum3VecProductRows(rowsI, ldb, &L[j * ldl], diag, j, numRows, sums);
+				else
+					kernels.sum2VecProductRows(rowsI, ldb, &L[j * ldl], j, numRows, sums);
+				for (int r = 0; r < numRows; r++)
+					rowsI[r * ldb + j] = invDiag[j] * (rowsI[r * ldb + j] - sums[r]);
+			}
+		}
+	}
+
+	template<typename T>
+	void packTransposed(const T * W, int ldw, const T * diag, int cols, int kb, T * packed, int ldp)
+	{
+		for (int j = 0; j < cols; j++)
+			for (int p = 0; p < kb; p++)
+				packed[p * ldp + j] = diag ? W[j * ldw + p] * diag[p] : W[j * ldw + p];
+	}
+
+	template<typename T>
+	void updatePacked(T * C, int ldc, const T * A, int lda, const T * packed, int ldp, int rows, int cols, int kb, bool lower, const CholeskyKernels<T> & kernels)
+	{
+		for (int jc = 0; jc < cols; jc += UPDATE_COLS)
+		{
+			int jEnd = std::min(jc + UPDATE_COLS, cols);
+			for (int i = lower ? jc : 0; i < rows; i += 4)
+			{
+				int numRows = std::min(4, rows - i);
+				// Columns up to the diagonal of the last row in the group,
+				// the few entries above the diagonal that are touched are never read
+				int numCols = (lower ? std::min(jEnd, i + numRows) : jEnd) - jc;
+				kernels.gemmSub(&A[i * lda], lda, &packed[jc], ldp, &C[i * ldc + jc], ldc, numRows, numCols, kb);
+			}
+		}
+	}
+
+	template<typename T>
+	void factorDiagonalBlock(MatrixView<T> A, T * diag, int k0, int k1, const CholeskyKernels<T> & kernels)
+	{
+		BENCH_COUNTERS_SCOPE("blocked-factor");
+		factorBlock(&A.data[k0 * A.stride + k0], A.stride, diag ? diag + k0 : diag, k1 - k0, kernels);
+	}
+
+	template<typename T>
+	void solvePanel(MatrixView<T> A, const T * diag, int r0, int r1, int k0, int k1, const CholeskyKernels<T> & kernels)
+	{
+		BENCH_COUNTERS_SCOPE("blocked-solve");
+		if (r1 > r0)
+			solveBlock(&A.data[r0 * A.stride + k0], A.stride, &A.data[k0 * A.stride + k0], A.stride, diag ? diag + k0 : diag, r1 - r0, k1 - k0, kernels);
+	}
+
+	template<typename T>
+	void updateBlock(MatrixView<T> A, const T * diag, MatrixView<T> packed, int r0, int r1, int c0, int c1, int k0, int k1, const CholeskyKernels<T> & kernels)
+	{
+		if (r1 <= r0 || c1 <= c0)
+			return;
+		BENCH_COUNTERS_SCOPE("blocked-update");
+		int stride = A.stride;
+		// Pack W transposed so that the update reads contiguous rows of both operands
+		packTransposed(&A.data[c0 * stride + k0], stride, diag ? diag + k0 : diag, c1 - c0, k1 - k0, packed.data, packed.stride);
+		// Only the lower triangle of blocks on the diagonal is updated
+		updatePacked(&A.data[r0 * stride + c0], stride, &A.data[r0 * stride + k0], stride, packed.data, packed.stride,
+			r1 - r0, c1 - c0, k1 - k0, r0 == c0, kernels);
+	}
+
+	template<typename T>
+	static void blockedCholesky(MatrixView<T> A, T * diag, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int n = A.rows;
+		blockSize = std::min(blockSize, CHOLESKY_MAX_BLOCK_SIZE);
+		int ldp = util::getColStride(n);
+		work.resize((size_t)blockSize * ldp);
+		MatrixView<T> panelT(&work[0], blockSize, n, ldp);
+
+		for (int k0 = 0; k0 < n; k0 += blockSize)
+		{
+			int k1 = std::min(k0 + blockSize, n);
+			factorDiagonalBlock(A, diag, k0, k1, kernels);
+			solvePanel(A, diag, k1, n, k0, k1, kernels);
+			updateBlock(A, diag, panelT, k1, n, k1, n, k0, k1, kernels);
+		}
+	}
+
+	template<typename T>
+	void blockedCholeskyLLt(MatrixView<T> A, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		blockedCholesky(A, (T *)NULL, blockSize, work, kernels);
+	}
+
+	template<typename T>
+	void blockedCholeskyLDLt(MatrixView<T> A, T * diag, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		blockedCholesky(A, diag, blockSize, work, kernels);
+	}
+
+	template void blockedCholeskyLLt<float>(MatrixView<float>, int, std::vector<float> &, const CholeskyKernels<float> &);
+	template void blockedCholeskyLLt<double>(MatrixView<double>, int, std::vector<double> &, const CholeskyKernels<double> &);
+	template void blockedCholeskyLDLt<float>(MatrixView<float>, float *, int, std::vector<float> &, const CholeskyKernels<float> &);
+	template void blockedCholeskyLDLt<double>(MatrixView<double>, double *, int, std::vector<double> &, const CholeskyKernels<double> &);
+	template void factorBlock<float>(float *, int, float *, int, const CholeskyKernels<float> &);
+	template void factorBlock<double>(double *, int, double *, int, const CholeskyKernels<double> &);
+	template void solveBlock<float>(float *, int, const float *, int, const float *, int, int, const CholeskyKernels<float> &);
+	template void solveBlock<double>(double *, int, const double *, int, const double *, int, int, const CholeskyKernels<double> &);
+	template void packTransposed<float>(const float *, int, const float *, int, int, float *, int);
+	template void packTransposed<double>(const double *, int, const double *, int, int, double *, int);
+	template void updatePacked<float>(float *, int, const float *, int, const float *, int, int, int, int, bool, const CholeskyKernels<float> &);
+	template void updatePacked<double>(double *, int, const double *, int, const double *, int, int, int, int, bool, const CholeskyKernels<double> &);
+	template void factorDiagonalBlock<float>(MatrixView<float>, float *, int, int, const CholeskyKernels<float> &);
+	template void factorDiagonalBlock<double>(MatrixView<double>, double *, int, int, const CholeskyKernels<double> &);
+	template void solvePanel<float>(MatrixView<float>, const float *, int, int, int, int, const CholeskyKernels<float> &);
+	template void solvePanel<double>(MatrixView<double>, const double *, int, int, int, int, const CholeskyKernels<double> &);
+	template void updateBlock<float>(MatrixView<float>, const float *, MatrixView<float>, int, int, int, int, int, int, const CholeskyKernels<float> &);
+	template void updateBlock<double>(MatrixView<double>, const double *, MatrixView<double>, int, int, int, int, int, int, const CholeskyKernels<double> &);
+
+}
@@ -0,0 +1,206 @@
+#ifndef _LINALG_CHOLESKY_FIXED_HPP_
+#define _LINALG_CHOLESKY_FIXED_HPP_
+
+#include "matrix.hpp"
+#include <cmath>
+
+// Cholesky for matrices whose size is known at compile time (pose covariances, filter states)
+// Every loop is expanded by template recursion, so each element update is straight-line code with
+// constant offsets and the whole factorization lives in registers and on the stack
+
+namespace linalg{
+namespace util {
+
+	// Calls f.template apply<I>() for I = Begin..End-1
+	// Each call is its own instantiation, so inner loop bounds depending on I are compile-time constants as well
+	template<int Begin, int End>
+	struct StaticFor
+	{
+		template<class F>
+		static inline void run(F & f)
+		{
+			f.template apply<Begin>();
+			StaticFor<Begin + 1, End>::run(f);
+		}
+	};
+
+	template<int End>
+	struct StaticFor<End, End>
+	{
+		template<class F>
+		static inline void run(F &) {}
+	};
+
+	// Sum of u[k * uStride] * v[k * vStride] (* d[k * dStride]) for k = Begin..End-1,
+	// added in the same order as the runtime-sized loops
+	template<int Begin, int End>
+	struct StaticDot
+	{
+		template<typename T>
+		static inline T run(const T * u, int uStride, const T * v, int vStride)
+		{
+			return StaticDot<Begin, End - 1>::run(u, uStride, v, vStride) + u[(End - 1) * uStride] * v[(End - 1) * vStride];
+		}
+
+		template<typename T>
+		static inline T run(const T * u, int uStride, const T * v, int vStride, const T * d, int dStride)
+		{
+			return StaticDot<Begin, End - 1>::run(u, uStride, v, vStride, d, dStride)
+				+ u[(End - 1) * uStride] * v[(End - 1) * vStride] * d[(End - 1) * dStride];
+		}
+	};
+
+	template<int Begin>
+	struct StaticDot<Begin, Begin>
+	{
+		template<typename T>
+		static inline T run(const T *, int, const T *, int) { return 0; }
+
+		template<typename T>
+		static inline T run(const T *, int, const T *, int, const T *, int) { return 0; }
+	};
+}
+
+/// Fixed-size counterpart of Cholesky, with the same storage conventions:
+/// LL^T keeps L in the lower triangle, LDL^T keeps unit L below the diagonal and D on it
+/// solve() uses whichever factorization was computed last
+template<int N, typename T = float>
+class FixedCholesky
+{
+public:
+	typedef FixedMatrix<T, N, N> MatrixType;
+	typedef FixedMatrix<T, N, 1> VectorType;
+
+	/// Compute the LDL^T decomposition of mat, given mat
+	void calculateCholeskyLDLt(const MatrixType & M)
+	{
+		m_chol = M;
+		m_isLDLt = true;
+		LDLtColumn column = { m_chol.data };
+		util::StaticFor<0, N>::run(column);
+	}
+
+	/// Compute the LL^T decomposition of mat, given mat
+	void calculateCholeskyLLt(const MatrixType & M)
+	{
+		m_chol = M;
+		m_isLDLt = false;
+		LLtColumn column = { m_chol.data };
+		util::StaticFor<0, N>::run(column);
+	}
+
+	/// Solves A x = b with the stored factor by forward and back substitution
+	VectorType solve(const VectorType & b) const
+	{
+		VectorType x = b;
+		if (m_isLDLt)
+		{
+			Forward<true> forward = { m_chol.data, &x.data[0][0] };
+			util::StaticFor<0, N>::run(forward);
+			for (int i = 0; i < N; i++)
+				x.data[i][0] /= m_chol.data[i][i];
+			Backward<true> backward = { m_chol.data, &x.data[0][0] };
+			util::StaticFor<0, N>::run(backward);
+		}
+		else
+		{
+			Forward<false> forward = { m_chol.data, &x.data[0][0] };
+			util::StaticFor<0, N>::run(forward);
+			Backward<false> backward = { m_chol.data, &x.data[0][0] };
+			util::StaticFor<0, N>::run(backward);
+		}
+		return x;
+	}
+
+	MatrixType getCholeskyMatrix() const
+	{
+		//This populates the upper-triangular L^T part of the LDL^T matrix
+		MatrixType chol = m_chol;
+		for (int i = 0; i < N; i++)
+			for (int j = i + 1; j < N; j++)
+				chol(i, j) = m_chol(j, i);
+		return chol;
+	}
+
+private:
+	// L(I, J) for every I > J, once column J's diagonal is known
+	template<int J>
+	struct LLtRow
+	{
+		T (&L)[N][N];
+		T invDiag;
+		template<int I> void apply()
+		{
+			L[I][J] = invDiag * (L[I][J] - util::StaticDot<0, J>::run(L[I], 1, L[J], 1));
+		}
+	};
+
+	struct LLtColumn
+	{
+		T (&L)[N][N];
+		template<int J> void apply()
+		{
+			L[J][J] = std::sqrt(L[J][J] - util::StaticDot<0, J>::run(L[J], 1, L[J], 1));
+			LLtRow<J> row = { L, 1 / L[J][J] };
+			util::StaticFor<J + 1, N>::run(row);
+		}
+	};
+
+	// D is read from the diagonal, i.e. with stride N + 1
+	template<int J>
+	struct LDLtRow
+	{
+		T (&L)[N][N];
+		T invDiag;
+		template<int I> void apply()
+		{
+			L[I][J] = invDiag * (L[I][J] - util::StaticDot<0, J>::run(L[I], 1, L[J], 1, &L[0][0], N + 1));
+		}
+	};
+
+	struct LDLtColumn
+	{
+		T (&L)[N][N];
+		template<int J> void apply()
+		{
+			L[J][J] = L[J][J] - util::StaticDot<0, J>::run(L[J], 1, L[J], 1, &L[0][0], N + 1);
+			LDLtRow<J> row = { L, 1 / L[J][J] };
+			util::StaticFor<J + 1, N>::run(row);
+		}
+	};
+
+	// L y = b, in place
+	template<bool UNIT>
+	struct Forward
+	{
+		const T (&L)[N][N];
+		T * x;
+		template<int I> void apply()
+		{
+			x[I] = x[I] - util::StaticDot<0, I>::run(L[I], 1, x, 1);
+			if (!UNIT)
+				x[I] /= L[I][I];
+		}
+	};
+
+	// L^T x = y, in place, rows from the last one up, reading L by columns
+	template<bool UNIT>
+	struct Backward
+	{
+		const T (&L)[N][N];
+		T * x;
+		template<int K> void apply()
+		{
+			const int I = N - 1 - K;
+			x[I] = x[I] - util::StaticDot<I + 1, N>::run(&L[0][I], N, x, 1);
+			if (!UNIT)
+				x[I] /= L[I][I];
+		}
+	};
+
+	MatrixType m_chol;
+	bool m_isLDLt = false;
+};
+
+}
+#endif
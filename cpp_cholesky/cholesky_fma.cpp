@@ -0,0 +1,350 @@
+#include <immintrin.h> //AVX2, FMA
+
+#include "cholesky_kernels.hpp"
+
+// Assumes the machine has AVX2 and FMA instructions
+// Cholesky only selects these kernels when cpuFeatures() reports both, see cpu_features.hpp
+// Same structure as cholesky_avx.cpp, with fused multiply-adds and more independent accumulators:
+// an FMA has a latency of 4-5 cycles and two can start per cycle, so a single accumulator would idle the units
+
+namespace linalg{
+
+	static inline float horizontalSumFMA(__m256 v)
+	{
+		__m128 sum = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+		sum = _mm_hadd_ps(sum, sum);
+		sum = _mm_hadd_ps(sum, sum);
+		return _mm_cvtss_f32(sum);
+	}
+
+	float sum3VecProductFMA(const float * u, const float * v, const float * d, int size)
+	{
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			acc0 = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i)), _mm256_loadu_ps(d + i), acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(u + i + 8), _mm256_loadu_ps(v + i + 8)), _mm256_loadu_ps(d + i + 8), acc1);
+		}
+		for (; i + 8 <= size; i += 8)
+			acc0 = _mm256_fmadd_ps(_mm256_mul_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i)), _mm256_loadu_ps(d + i), acc0);
+		float acc = horizontalSumFMA(_mm256_add_ps(acc0, acc1));
+
+		for (; i < size; i++)
+			acc += u[i] * v[i] * d[i];
+		return acc;
+	}
+
+	float sum2VecProductFMA(const float * u, const float * v, int size)
+	{
+		__m256 acc0 = _mm256_setzero_ps();
+		__m256 acc1 = _mm256_setzero_ps();
+		int i = 0;
+		for (; i + 16 <= size; i += 16)
+		{
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i), acc0);
+			acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(u + i + 8), _mm256_loadu_ps(v + i + 8), acc1);
+		}
+		for (; i + 8 <= size; i += 8)
+			acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(u + i), _mm256_loadu_ps(v + i), acc0);
+		float acc = horizontalSumFMA(_mm256_add_ps(acc0, acc1));
+
+		for (; i < size; i++)
+			acc += u[i] * v[i];
+		return acc;
+	}
+
+	void axpySubFMA(float a, const float * x, float * y, int size)
+	{
+		__m256 a8 = _mm256_set1_ps(a);
+		int i = 0;
+		for (; i + 8 <= size; i += 8)
+			_mm256_storeu_ps(y + i, _mm256_fnmadd_ps(a8, _mm256_loadu_ps(x + i), _mm256_loadu_ps(y + i)));
+		for (; i < size; i++)
+			y[i] -= a * x[i];
+	}
+
+	// Computes C -= A * B for MR rows of A against a packed panel B (k x n, row-major)
+	// MR x 24 results stay in registers: 12 accumulators for MR = 4, enough to keep both FMA units busy
+	template<int MR>
+	static inline void gemmSubRowsFMA(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int n, int k)
+	{
+		int j = 0;
+		for (; j + 24 <= n; j += 24)
+		{
+			__m256 acc0[MR], acc1[MR], acc2[MR];
+			for (int r = 0; r < MR; r++)
+			{
+				acc0[r] = _mm256_setzero_ps();
+				acc1[r] = _mm256_setzero_ps();
+				acc2[r] = _mm256_setzero_ps();
+			}
+			for (int p = 0; p < k; p++)
+			{
+				__m256 b0 = _mm256_loadu_ps(B + p * ldb + j);
+				__m256 b1 = _mm256_loadu_ps(B + p * ldb + j + 8);
+				__m256 b2 = _mm256_loadu_ps(B + p * ldb + j + 16);
+				for (int r = 0; r < MR; r++)
+				{
+					__m256 a = _mm256_broadcast_ss(A + r * lda + p);
+					acc0[r] = _mm256_fmadd_ps(a, b0, acc0[r]);
+					acc1[r] = _mm256_fmadd_ps(a, b1, acc1[r]);
+					acc2[r] = _mm256_fmadd_ps(a, b2, acc2[r]);
+				}
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				float * c = C + r * ldc + j;
+				_mm256_storeu_ps(c, _mm256_sub_ps(_mm256_loadu_ps(c), acc0[r]));
+				_mm256_storeu_ps(c + 8, _mm256_sub_ps(_mm256_loadu_ps(c + 8), acc1[r]));
+				_mm256_storeu_ps(c + 16, _mm256_sub_ps(_mm256_loadu_ps(c + 16), acc2[r]));
+			}
+		}
+		for (; j + 8 <= n; j += 8)
+		{
+			__m256 acc[MR];
+			for (int r = 0; r < MR; r++)
+				acc[r] = _mm256_setzero_ps();
+			for (int p = 0; p < k; p++)
+			{
+				__m256 b = _mm256_loadu_ps(B + p * ldb + j);
+				for (int r = 0; r < MR; r++)
+					acc[r] = _mm256_fmadd_ps(_mm256_broadcast_ss(A + r * lda + p), b, acc[r]);
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				float * c = C + r * ldc + j;
+				_mm256_storeu_ps(c, _mm256_sub_ps(_mm256_loadu_ps(c), acc[r]));
+			}
+		}
+		// Remaining columns, fewer than 8, must not touch memory beyond the row
+		for (; j < n; j++)
+			for (int r = 0; r < MR; r++)
+			{
+				float sum = 0;
+				for (int p = 0; p < k; p++)
+					sum += A[r * lda + p] * B[p * ldb + j];
+				C[r * ldc + j] -= sum;
+			}
+	}
+
+	void gemmSubFMA(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k)
+	{
+		int i = 0;
+		for (; i + 4 <= m; i += 4)
+			gemmSubRowsFMA<4>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+		for (; i < m; i++)
+			gemmSubRowsFMA<1>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+	}
+
+	// 8 sums in one register, lane r holding the sum of a[r]: one reduction for 8 dot products
+	static inline __m256 horizontalSum8FMA(const __m256 * a)
+	{
+		__m256 s0123 = _mm256_hadd_ps(_mm256_hadd_ps(a[0], a[1]), _mm256_hadd_ps(a[2], a[3]));
+		__m256 s4567 = _mm256_hadd_ps(_mm256_hadd_ps(a[4], a[5]), _mm256_hadd_ps(a[6], a[7]));
+		// Each 128-bit half now holds partial sums of its own half of the inputs
+		return _mm256_add_ps(_mm256_permute2f128_ps(s0123, s4567, 0x20), _mm256_permute2f128_ps(s0123, s4567, 0x31));
+	}
+
+	// out[r] = rows[r * stride + k] * v[k] (* d[k]) summed over k, for R rows
+	// v (times d) is loaded once per step for all rows, and the R independent accumulators
+	// cover the FMA latency without splitting any single dot product
+	template<int R, bool D>
+	static inline void dotRowsFMA(const float * rows, int stride, const float * v, const float * d, int size, float * out)
+	{
+		__m256 acc[R];
+		for (int r = 0; r < R; r++)
+			acc[r] = _mm256_setzero_ps();
+		int k = 0;
+		for (; k + 8 <= size; k += 8)
+		{
+			__m256 b = _mm256_loadu_ps(v + k);
+			if (D)
+				b = _mm256_mul_ps(b, _mm256_loadu_ps(d + k));
+			for (int r = 0; r < R; r++)
+				acc[r] = _mm256_fmadd_ps(_mm256_loadu_ps(rows + r * stride + k), b, acc[r]);
+		}
+		if (R == 8)
+			_mm256_storeu_ps(out, horizontalSum8FMA(acc));
+		else
+			for (int r = 0; r < R; r++)
+				out[r] = horizontalSumFMA(acc[r]);
+		for (; k < size; k++)
+		{
+			float b = D ? v[k] * d[k] : v[k];
+			for (int r = 0; r < R; r++)
+				out[r] += rows[r * stride + k] * b;
+		}
+	}
+
+	template<bool D>
+	static inline void dotRowsFMA(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		int r = 0;
+		for (; r + 8 <= numRows; r += 8)
+			dotRowsFMA<8, D>(rows + r * stride, stride, v, d, size, out + r);
+		if (r + 4 <= numRows)
+		{
+			dotRowsFMA<4, D>(rows + r * stride, stride, v, d, size, out + r);
+			r += 4;
+		}
+		for (; r < numRows; r++)
+			dotRowsFMA<1, D>(rows + r * stride, stride, v, d, size, out + r);
+	}
+
+	void sum2VecProductRowsFMA(const float * rows, int stride, const float * v, int size, int numRows, float * out)
+	{
+		dotRowsFMA<false>(rows, stride, v, NULL, size, numRows, out);
+	}
+
+	void sum3VecProductRowsFMA(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		dotRowsFMA<true>(rows, stride, v, d, size, numRows, out);
+	}
+
+	// Double precision versions, 4 lanes per register
+
+	static inline double horizontalSumFMA(__m256d v)
+	{
+		__m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+		return _mm_cvtsd_f64(_mm_hadd_pd(sum, sum));
+	}
+
+	// 4 sums in one register, lane r holding the sum of a[r]
+	static inline __m256d horizontalSum4FMA(const __m256d * a)
+	{
+		__m256d s01 = _mm256_hadd_pd(a[0], a[1]);
+		__m256d s23 = _mm256_hadd_pd(a[2], a[3]);
+		return _mm256_add_pd(_mm256_permute2f128_pd(s01, s23, 0x20), _mm256_permute2f128_pd(s01, s23, 0x31));
+	}
+
+	// out[r] = rows[r * stride + k] * v[k] (* d[k]) summed over k, for R rows, see the float version
+	template<int R, bool D>
+	static inline void dotRowsFMA(const double * rows, int stride, const double * v, const double * d, int size, double * out)
+	{
+		__m256d acc[R];
+		for (int r = 0; r < R; r++)
+			acc[r] = _mm256_setzero_pd();
+		int k = 0;
+		for (; k + 4 <= size; k += 4)
+		{
+			__m256d b = _mm256_loadu_pd(v + k);
+			if (D)
+				b = _mm256_mul_pd(b, _mm256_loadu_pd(d + k));
+			for (int r = 0; r < R; r++)
+				acc[r] = _mm256_fmadd_pd(_mm256_loadu_pd(rows + r * stride + k), b, acc[r]);
+		}
+		for (int r = 0; r + 4 <= R; r += 4)
+			_mm256_storeu_pd(out + r, horizontalSum4FMA(acc + r));
+		if (R < 4)
+			for (int r = 0; r < R; r++)
+				out[r] = horizontalSumFMA(acc[r]);
+		for (; k < size; k++)
+		{
+			double b = D ? v[k] * d[k] : v[k];
+			for (int r = 0; r < R; r++)
+				out[r] += rows[r * stride + k] * b;
+		}
+	}
+
+	template<bool D>
+	static inline void dotRowsFMA(const double * rows, int stride, const double * v, const double * d, int size, int numRows, double * out)
+	{
+		int r = 0;
+		for (; r + 8 <= numRows; r += 8)
+			dotRowsFMA<8, D>(rows + r * stride, stride, v, d, size, out + r);
+		if (r + 4 <= numRows)
+		{
+			dotRowsFMA<4, D>(rows + r * stride, stride, v, d, size, out + r);
+			r += 4;
+		}
+		for (; r < numRows; r++)
+			dotRowsFMA<1, D>(rows + r * stride, stride, v, d, size, out + r);
+	}
+
+	double sum3VecProductFMA(const double * u, const double * v, const double * d, int size)
+	{
+		double sum;
+		dotRowsFMA<1, true>(u, 0, v, d, size, &sum);
+		return sum;
+	}
+
+	double sum2VecProductFMA(const double * u, const double * v, int size)
+	{
+		double sum;
+		dotRowsFMA<1, false>(u, 0, v, NULL, size, &sum);
+		return sum;
+	}
+
+	void sum2VecProductRowsFMA(const double * rows, int stride, const double * v, int size, int numRows, double * out)
+	{
+		dotRowsFMA<false>(rows, stride, v, NULL, size, numRows, out);
+	}
+
+	void sum3VecProductRowsFMA(const double * rows, int stride, const double * v, const double * d, int size, int numRows, double * out)
+	{
+		dotRowsFMA<true>(rows, stride, v, d, size, numRows, out);
+	}
+
+	void axpySubFMA(double a, const double * x, double * y, int size)
+	{
+		__m256d a4 = _mm256_set1_pd(a);
+		int i = 0;
+		for (; i + 4 <= size; i += 4)
+			_mm256_storeu_pd(y + i, _mm256_fnmadd_pd(a4, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+		for (; i < size; i++)
+			y[i] -= a * x[i];
+	}
+
+	// Computes C -= A * B for MR rows of A against a packed panel B (k x n, row-major), MR x 8 results in registers
+	template<int MR>
+	static inline void gemmSubRowsFMA(const double * A, int lda, const double * B, int ldb, double * C, int ldc, int n, int k)
+	{
+		int j = 0;
+		for (; j + 8 <= n; j += 8)
+		{
+			__m256d acc0[MR], acc1[MR];
+			for (int r = 0; r < MR; r++)
+			{
+				acc0[r] = _mm256_setzero_pd();
+				acc1[r] = _mm256_setzero_pd();
+			}
+			for (int p = 0; p < k; p++)
+			{
+				__m256d b0 = _mm256_loadu_pd(B + p * ldb + j);
+				__m256d b1 = _mm256_loadu_pd(B + p * ldb + j + 4);
+				for (int r = 0; r < MR; r++)
+				{
+					__m256d a = _mm256_broadcast_sd(A + r * lda + p);
+					acc0[r] = _mm256_fmadd_pd(a, b0, acc0[r]);
+					acc1[r] = _mm256_fmadd_pd(a, b1, acc1[r]);
+				}
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				double * c = C + r * ldc + j;
+				_mm256_storeu_pd(c, _mm256_sub_pd(_mm256_loadu_pd(c), acc0[r]));
+				_mm256_storeu_pd(c + 4, _mm256_sub_pd(_mm256_loadu_pd(c + 4), acc1[r]));
+			}
+		}
+		for (; j < n; j++)
+			for (int r = 0; r < MR; r++)
+			{
+				double sum = 0;
+				for (int p = 0; p < k; p++)
+					sum += A[r * lda + p] * B[p * ldb + j];
+				C[r * ldc + j] -= sum;
+			}
+	}
+
+	void gemmSubFMA(const double * A, int lda, const double * B, int ldb, double * C, int ldc, int m, int n, int k)
+	{
+		int i = 0;
+		for (; i + 4 <= m; i += 4)
+			gemmSubRowsFMA<4>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+		for (; i < m; i++)
+			gemmSubRowsFMA<1>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+	}
+
+}
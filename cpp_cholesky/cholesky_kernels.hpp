@@ -0,0 +1,103 @@
+#ifndef _LINALG_CHOLESKY_KERNELS_HPP_
+#define _LINALG_CHOLESKY_KERNELS_HPP_
+
+// Declarations of the SIMD kernels, each family lives in its own translation unit compiled with its own -m flags
+// Kernel files include only this header: inline code from other headers compiled with wider instruction sets
+// could otherwise be picked by the linker for the whole program and break machines without them
+
+#define BATCH_LANES 16 // one cache line of floats, two AVX or one AVX-512 register
+#define BATCH_MAX_SIZE 64
+
+namespace linalg{
+
+	// Vectors applied per pass over the factor by rank-k updates
+	const int CHOLESKY_UPDATE_VECS = 8;
+	// Rows of L handled per call of the multi-row dot products, one register of results with AVX
+	const int CHOLESKY_DOT_ROWS = 8;
+
+	// The *Rows kernels compute numRows dot products in one call, sharing the loads of v (and d):
+	// out[r] = sum over k < size of rows[r * stride + k] * v[k] (* d[k]), r < numRows
+
+	// SSE3, cholesky_sse.cpp
+	float sumPairwiseProductSSE(const float * u, const float * v, const float * d, int size);
+	float sum2VecProductSSE(const float * u, const float * v, int size);
+	void axpySubSSE(float a, const float * x, float * y, int size);
+	void sum2VecProductRowsSSE(const float * rows, int stride, const float * v, int size, int numRows, float * out);
+	void sum3VecProductRowsSSE(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out);
+	void gemmSubSSE(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k);
+	// dst (cols x rows, stride ldd) = src^T for a rows x cols block (stride lds), rows and cols multiples of 4 floats
+	// or 2 doubles; the swap sets a (rows x cols) = b^T and b (cols x rows) = a^T at once, a == b transposes a square
+	// block in place; see transpose.cpp
+	void transposeSSE(const float * src, int lds, float * dst, int ldd, int rows, int cols);
+	void transposeSwapSSE(float * a, float * b, int ld, int rows, int cols);
+	void transposeSSE(const double * src, int lds, double * dst, int ldd, int rows, int cols);
+	void transposeSwapSSE(double * a, double * b, int ld, int rows, int cols);
+
+	// AVX, cholesky_avx.cpp
+	float sum3VecProductAVX(const float * u, const float * v, const float * d, int size);
+	float sum2VecProductAVX(const float * u, const float * v, int size);
+	// y -= a * x
+	void axpySubAVX(float a, const float * x, float * y, int size);
+	void sum2VecProductRowsAVX(const float * rows, int stride, const float * v, int size, int numRows, float * out);
+	void sum3VecProductRowsAVX(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out);
+	// Applies numVecs rank-1 modifications to 8 rows of L, columns 0..cols-1 (a multiple of 8), see cholesky_update.cpp
+	void updateRowsAVX(float * L, int stride, int cols, float * x, int numVecs, const float * params, int paramStride, bool ldlt);
+	// C -= A * B, A is m x k (stride lda), B is a packed k x n panel (stride ldb), C is m x n (stride ldc)
+	void gemmSubAVX(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k);
+	// Double precision overloads
+	double sum3VecProductAVX(const double * u, const double * v, const double * d, int size);
+	double sum2VecProductAVX(const double * u, const double * v, int size);
+	void sum2VecProductRowsAVX(const double * rows, int stride, const double * v, int size, int numRows, double * out);
+	void sum3VecProductRowsAVX(const double * rows, int stride, const double * v, const double * d, int size, int numRows, double * out);
+	void axpySubAVX(double a, const double * x, double * y, int size);
+	void gemmSubAVX(const double * A, int lda, const double * B, int ldb, double * C, int ldc, int m, int n, int k);
+	// As the SSE transposes, multiples of 8 floats or 4 doubles
+	void transposeAVX(const float * src, int lds, float * dst, int ldd, int rows, int cols);
+	void transposeSwapAVX(float * a, float * b, int ld, int rows, int cols);
+	void transposeAVX(const double * src, int lds, double * dst, int ldd, int rows, int cols);
+	void transposeSwapAVX(double * a, double * b, int ld, int rows, int cols);
+
+	// AVX2 + FMA, cholesky_fma.cpp
+	float sum3VecProductFMA(const float * u, const float * v, const float * d, int size);
+	float sum2VecProductFMA(const float * u, const float * v, int size);
+	void sum2VecProductRowsFMA(const float * rows, int stride, const float * v, int size, int numRows, float * out);
+	void sum3VecProductRowsFMA(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out);
+	void axpySubFMA(float a, const float * x, float * y, int size);
+	void gemmSubFMA(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k);
+	// Double precision overloads
+	double sum3VecProductFMA(const double * u, const double * v, const double * d, int size);
+	double sum2VecProductFMA(const double * u, const double * v, int size);
+	void sum2VecProductRowsFMA(const double * rows, int stride, const double * v, int size, int numRows, double * out);
+	void sum3VecProductRowsFMA(const double * rows, int stride, const double * v, const double * d, int size, int numRows, double * out);
+	void axpySubFMA(double a, const double * x, double * y, int size);
+	void gemmSubFMA(const double * A, int lda, const double * B, int ldb, double * C, int ldc, int m, int n, int k);
+
+	// AVX-512F, cholesky_avx512.cpp
+	float sum3VecProductAVX512(const float * u, const float * v, const float * d, int size);
+	float sum2VecProductAVX512(const float * u, const float * v, int size);
+	void sum2VecProductRowsAVX512(const float * rows, int stride, const float * v, int size, int numRows, float * out);
+	void sum3VecProductRowsAVX512(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out);
+	void axpySubAVX512(float a, const float * x, float * y, int size);
+	void gemmSubAVX512(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k);
+
+	// Packed GEMM micro-kernels, see gemm.cpp: C (GEMM_MR x NR) = (C +) Ap Bp over kc steps, Ap holds GEMM_MR
+	// and Bp NR elements per step, both aligned to 32 bytes; NR is GEMM_NR_FLOAT or GEMM_NR_DOUBLE
+	const int GEMM_MR = 6;
+	const int GEMM_NR_FLOAT = 16;
+	const int GEMM_NR_DOUBLE = 8;
+	// AVX, gemm_avx.cpp
+	void gemmMicroAVX(int kc, const float * Ap, const float * Bp, float * C, int ldc, bool accumulate);
+	void gemmMicroAVX(int kc, const double * Ap, const double * Bp, double * C, int ldc, bool accumulate);
+	// AVX2 and FMA, gemm_fma.cpp
+	void gemmMicroFMA(int kc, const float * Ap, const float * Bp, float * C, int ldc, bool accumulate);
+	void gemmMicroFMA(int kc, const double * Ap, const double * Bp, double * C, int ldc, bool accumulate);
+
+	// Batched factorizations of lane-interleaved matrices, see cholesky_batched.hpp
+	// data points to groups * size * size * BATCH_LANES floats, only the lower triangle is read and written
+	void batchedCholeskyLLtAVX(float * data, int size, int groups);
+	void batchedCholeskyLDLtAVX(float * data, int size, int groups);
+	void batchedCholeskyLLtAVX512(float * data, int size, int groups);
+	void batchedCholeskyLDLtAVX512(float * data, int size, int groups);
+
+}
+#endif
@@ -0,0 +1,332 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "cholesky_outofcore.hpp"
+
+// Left-looking out-of-core factorization, for every tile column k:
+//   1. read tiles (i, k), i >= k, into the in-memory panel
+//   2. for every tile column j < k: pack L(k, j) transposed once, then subtract L(i, j) L(k, j)^T from every
+//      panel tile, streaming the tiles L(i, j) through the cache
+//   3. factor the diagonal tile, solve the tiles below it, write the panel back to the file
+// Every tile left of the panel is read once per tile column, about nt^3 / 6 tile reads in total, but the
+// scan of step 2 runs forward on even and backward on odd tile columns: the tiles read last for column k
+// are then the first ones needed for column k + 1 and still in the cache, so every cached tile saves one
+// read per column. Tiles written in step 3 go into the cache too, they are the first ones read next
+// The order of the reads is known in advance, the prefetch threads run up to half the cache ahead of it
+
+namespace linalg{
+
+	// Position in the read order of step 2: tile column j = jAt(k, a), and for b > 0 tile row i = iAt(k, b)
+	// (b == 0 is the tile L(k, j) itself)
+	static inline int jAt(int k, int a) { return (k & 1) ? k - 1 - a : a; }
+	static inline int iAt(int nt, int k, int b) { return (k & 1) ? nt - b : k + b; }
+
+	// The read order of step 2 over all tile columns, as (i, j) pairs
+	struct TileOrder
+	{
+		explicit TileOrder(int nt) : nt(nt), k(1), a(0), b(0) {}
+
+		bool next(int & i, int & j)
+		{
+			if (k >= nt)
+				return false;
+			j = jAt(k, a);
+			i = b == 0 ? k : iAt(nt, k, b);
+			if (++b == nt - k)
+			{
+				b = 0;
+				if (++a == k)
+				{
+					a = 0;
+					k++;
+				}
+			}
+			return true;
+		}
+
+		int nt, k, a, b;
+	};
+
+	// LRU cache of file tiles with asynchronous loads
+	// A tile handed out by acquire() stays in place until release(), tiles in flight are never evicted
+	template<typename T>
+	class TileCache
+	{
+	public:
+		TileCache(TiledMatrixFile<T> & file, int capacity, int numThreads, OutOfCoreStats & stats)
+			: m_file(file), m_tileElems((size_t)file.tileSize * file.tileSize), m_slots(capacity),
+			m_storage((size_t)capacity * m_tileElems), m_stats(stats)
+		{
+			for (int s = 0; s < capacity; s++)
+				m_slots[s].data = &m_storage[s * m_tileElems];
+			for (int t = 0; t < numThreads; t++)
+				m_threads.push_back(std::thread(&TileCache::loaderLoop, this));
+		}
+
+		~TileCache()
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stop = true;
+			}
+			m_requested.notify_all();
+			for (std::thread & t : m_threads)
+				t.join();
+		}
+
+		/// Tile (i, j), waits for it if it is not in the cache
+		const T * acquire(int i, int j)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			int key = tileKey(i, j);
+			auto it = m_index.find(key);
+			if (it != m_index.end())
+			{
+				Slot & slot = m_slots[it->second];
+				slot.pins++;
+				m_loaded.wait(lock, [&] { return slot.state == READY; });
+				slot.lastUse = ++m_tick;
+				m_stats.cacheHits++;
+				return slot.data;
+			}
+			m_stats.cacheMisses++;
+			int s;
+			m_loaded.wait(lock, [&] { return (s = victim()) >= 0; });
+			assign(s, i, j);
+			m_slots[s].pins = 1;
+			lock.unlock();
+			load(s, i, j);
+			lock.lock();
+			m_slots[s].state = READY;
+			m_loaded.notify_all();
+			return m_slots[s].data;
+		}
+
+		void release(int i, int j)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_slots[m_index[tileKey(i, j)]].pins--;
+			m_loaded.notify_all();
+		}
+
+		/// Starts loading tile (i, j) if it is not in the cache and a slot can be freed without waiting
+		void prefetch(int i, int j)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			int key = tileKey(i, j);
+			if (m_threads.empty() || m_index.count(key))
+				return;
+			int s = victim();
+			if (s < 0)
+				return;
+			assign(s, i, j);
+			m_queue.push_back(s);
+			m_requested.notify_one();
+		}
+
+		/// New contents of tile (i, j), already written to the file
+		void update(int i, int j, const T * data)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			int key = tileKey(i, j);
+			auto it = m_index.find(key);
+			int s;
+			if (it != m_index.end())
+			{
+				// A load in flight may have copied the old contents
+				s = it->second;
+				m_loaded.wait(lock, [&] { return m_slots[s].state == READY; });
+			}
+			else
+			{
+				s = victim();
+				if (s < 0)
+					return;
+				assign(s, i, j);
+				m_slots[s].state = READY;
+			}
+			memcpy(m_slots[s].data, data, m_tileElems * sizeof(T));
+		}
+
+	private:
+		enum State { EMPTY, LOADING, READY };
+
+		struct Slot
+		{
+			int key = -1;
+			int tileRow = 0;
+			int tileCol = 0;
+			State state = EMPTY;
+			int pins = 0;
+			size_t lastUse = 0;
+			T * data = NULL;
+		};
+
+		int tileKey(int i, int j) const { return i * (i + 1) / 2 + j; }
+
+		// Empty slot, or the least recently used one not in use, -1 if there is none; m_mutex held
+		int victim() const
+		{
+			int best = -1;
+			for (int s = 0; s < (int)m_slots.size(); s++)
+			{
+				const Slot & slot = m_slots[s];
+				if (slot.state == EMPTY)
+					return s;
+				if (slot.state == READY && slot.pins == 0 && (best < 0 || slot.lastUse < m_slots[best].lastUse))
+					best = s;
+			}
+			return best;
+		}
+
+		// Gives slot s to tile (i, j), marked as loading and as just used; m_mutex held
+		void assign(int s, int i, int j)
+		{
+			Slot & slot = m_slots[s];
+			if (slot.key >= 0)
+				m_index.erase(slot.key);
+			int key = tileKey(i, j);
+			slot.key = key;
+			slot.tileRow = i;
+			slot.tileCol = j;
+			slot.state = LOADING;
+			slot.lastUse = ++m_tick;
+			m_index[key] = s;
+		}
+
+		// Copies tile (i, j) out of the file mapping, without m_mutex
+		void load(int s, int i, int j)
+		{
+			memcpy(m_slots[s].data, m_file.tile(i, j), m_tileElems * sizeof(T));
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.bytesRead += m_tileElems * sizeof(T);
+		}
+
+		void loaderLoop()
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			for (;;)
+			{
+				m_requested.wait(lock, [&] { return m_stop || !m_queue.empty(); });
+				if (m_stop)
+					return;
+				int s = m_queue.front();
+				m_queue.pop_front();
+				// Slot s is LOADING, so nobody else touches it
+				int i = m_slots[s].tileRow;
+				int j = m_slots[s].tileCol;
+				lock.unlock();
+				load(s, i, j);
+				lock.lock();
+				m_slots[s].state = READY;
+				m_loaded.notify_all();
+			}
+		}
+
+		TiledMatrixFile<T> & m_file;
+		size_t m_tileElems;
+		std::vector<Slot> m_slots;
+		std::vector<T> m_storage;
+		std::unordered_map<int, int> m_index; // tile key -> slot
+		size_t m_tick = 0;
+		std::deque<int> m_queue; // slots to load
+		std::vector<std::thread> m_threads;
+		std::mutex m_mutex;
+		std::condition_variable m_requested;
+		std::condition_variable m_loaded;
+		bool m_stop = false;
+		OutOfCoreStats & m_stats;
+	};
+
+	template<typename T>
+	bool outOfCoreCholesky(TiledMatrixFile<T> & A, size_t cacheBytes, int numPrefetchThreads, OutOfCoreStats & stats, const CholeskyKernels<T> & kernels)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		int nb = A.tileSize;
+		int nt = A.numTiles;
+		size_t tileElems = (size_t)nb * nb;
+		size_t tileBytes = tileElems * sizeof(T);
+		// One tile is in use at a time, the rest is room to prefetch into and to keep tiles for the next column
+		int capacity = (int)std::max<size_t>(4, cacheBytes / tileBytes);
+		int depth = capacity / 2;
+
+		std::vector<T> panel(nt * tileElems);
+		std::vector<T> packed(tileElems);
+		bool positive = true;
+		// The loaders add the tiles they read to stats under the cache's lock, the panel reads are added once they stopped
+		size_t panelBytesRead = 0;
+		{
+			TileCache<T> cache(A, capacity, numPrefetchThreads, stats);
+			TileOrder ahead(nt);
+			size_t issued = 0, consumed = 0;
+			auto next = [&](int i, int j)
+			{
+				consumed++;
+				int pi, pj;
+				while (issued < consumed + depth && ahead.next(pi, pj))
+				{
+					cache.prefetch(pi, pj);
+					issued++;
+				}
+				return cache.acquire(i, j);
+			};
+
+			for (int k = 0; k < nt && positive; k++)
+			{
+				int kb = A.tileRows(k);
+				// 1. The panel, tile i of the column at panel[(i - k) * tileElems]
+				for (int i = k; i < nt; i++)
+					memcpy(&panel[(i - k) * tileElems], A.tile(i, k), tileBytes);
+				panelBytesRead += (nt - k) * tileBytes;
+
+				// 2. Updates from the tile columns on the left
+				for (int a = 0; a < k; a++)
+				{
+					int j = jAt(k, a);
+					const T * Lkj = next(k, j);
+					packTransposed(Lkj, nb, (const T *)NULL, kb, nb, &packed[0], nb);
+					updatePacked(&panel[0], nb, Lkj, nb, &packed[0], nb, kb, kb, nb, true, kernels);
+					cache.release(k, j);
+					for (int b = 1; b < nt - k; b++)
+					{
+						int i = iAt(nt, k, b);
+						const T * Lij = next(i, j);
+						updatePacked(&panel[(i - k) * tileElems], nb, Lij, nb, &packed[0], nb, A.tileRows(i), kb, nb, false, kernels);
+						cache.release(i, j);
+					}
+					stats.flops += 2.0 * (A.rows - k * nb) * kb * nb;
+				}
+
+				// 3. Diagonal tile, the tiles below it, and back to the file
+				factorBlock(&panel[0], nb, (T *)NULL, kb, kernels);
+				for (int r = 0; r < kb; r++)
+					if (!(panel[r * nb + r] > 0))
+						positive = false;
+				for (int i = k + 1; i < nt; i++)
+					solveBlock(&panel[(i - k) * tileElems], nb, &panel[0], nb, (const T *)NULL, A.tileRows(i), kb, kernels);
+				stats.flops += (double)kb * kb * kb / 3 + (double)(A.rows - k * nb - kb) * kb * kb;
+				for (int i = k; i < nt; i++)
+				{
+					memcpy(A.tile(i, k), &panel[(i - k) * tileElems], tileBytes);
+					cache.update(i, k, &panel[(i - k) * tileElems]);
+				}
+				stats.bytesWritten += (nt - k) * tileBytes;
+			}
+		}
+		stats.bytesRead += panelBytesRead;
+		A.sync();
+		stats.seconds = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+		return positive;
+	}
+
+	template bool outOfCoreCholesky<float>(TiledMatrixFile<float> &, size_t, int, OutOfCoreStats &, const CholeskyKernels<float> &);
+	template bool outOfCoreCholesky<double>(TiledMatrixFile<double> &, size_t, int, OutOfCoreStats &, const CholeskyKernels<double> &);
+
+}
@@ -0,0 +1,69 @@
+#ifndef _LINALG_CHOLESKY_OUTOFCORE_HPP_
+#define _LINALG_CHOLESKY_OUTOFCORE_HPP_
+
+#include "cholesky.hpp"
+#include "tiled_file.hpp"
+
+// Out-of-core LL^T of a matrix in a TiledMatrixFile, for matrices larger than RAM
+// Left-looking by tile columns (see cholesky_outofcore.cpp): the tile column being factored is kept in
+// memory, the tiles left of it are streamed through a cache of bounded size, filled ahead of use by
+// prefetch threads so that reading the file overlaps the updates
+// In memory: the tile column (n x tileSize elements), the cache, and two tiles of scratch
+
+namespace linalg{
+
+	/// Traffic and speed of one out-of-core factorization
+	struct OutOfCoreStats
+	{
+		size_t bytesRead = 0; // copied out of the file mapping, tiles read again after eviction included
+		size_t bytesWritten = 0;
+		size_t cacheHits = 0; // tiles found in the cache or already on their way in
+		size_t cacheMisses = 0; // tiles the factorization had to wait for
+		double flops = 0;
+		double seconds = 0;
+
+		double gflops() const { return seconds > 0 ? flops / seconds * 1e-9 : 0; }
+	};
+
+	// Factorization in place in the file, with a tile cache of cacheBytes and numPrefetchThreads loader threads
+	// (0 reads every tile on demand). Returns false if A is not positive definite, the file is then partially overwritten
+	template<typename T>
+	bool outOfCoreCholesky(TiledMatrixFile<T> & A, size_t cacheBytes, int numPrefetchThreads, OutOfCoreStats & stats, const CholeskyKernels<T> & kernels);
+
+/// LL^T of a matrix in a TiledMatrixFile, the factor replaces the matrix in the file
+template<typename T>
+class OutOfCoreCholesky
+{
+public:
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	/// BLOCKED, PARALLEL, AUTO and BLAS all run the widest kernels
+	explicit OutOfCoreCholesky(CholeskyImpl impl = CholeskyImpl::AUTO)
+	{
+		if (!isSupported(impl))
+			throw std::runtime_error("OutOfCoreCholesky: instruction set not supported by this CPU");
+		m_kernels = CholeskyKernels<T>::select(kernelImpl(impl));
+	}
+
+	/// Memory for tiles left of the current tile column, at least a few tiles are always used
+	void setCacheBytes(size_t bytes) { m_cacheBytes = bytes; }
+	void setNumPrefetchThreads(int numThreads) { m_numPrefetchThreads = std::max(0, numThreads); }
+
+	/// Factor A in place, returns false if it is not positive definite
+	bool calculateCholeskyLLt(TiledMatrixFile<T> & A)
+	{
+		m_stats = OutOfCoreStats();
+		return outOfCoreCholesky(A, m_cacheBytes, m_numPrefetchThreads, m_stats, m_kernels);
+	}
+
+	/// Statistics of the last calculateCholeskyLLt call
+	const OutOfCoreStats & getStats() const { return m_stats; }
+
+private:
+	CholeskyKernels<T> m_kernels;
+	size_t m_cacheBytes = (size_t)256 << 20;
+	int m_numPrefetchThreads = 2;
+	OutOfCoreStats m_stats;
+};
+
+}
+#endif
@@ -0,0 +1,165 @@
+#include <algorithm>
+
+#include "cholesky_packed.hpp"
+
+// Tiled factorization and substitutions on PackedLowerMatrix storage
+// Same steps as cholesky_blocked.cpp with the panel width equal to the tile size: factor tile (k, k),
+// solve the tiles below it, then update the trailing tiles, all through the raw block kernels
+// A tile is never split, so all operands are contiguous tileSize x tileSize blocks
+
+namespace linalg{
+
+	template<typename T>
+	void packedCholesky(PackedLowerMatrix<T> & A, T * diag, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int nb = A.tileSize;
+		int nt = A.numTiles;
+		// Tile (j, k) transposed (and scaled by D), shared by the updates of all tiles of column j
+		work.resize((size_t)nb * nb);
+		T * packed = &work[0];
+
+		for (int k = 0; k < nt; k++)
+		{
+			int kb = A.tileRows(k);
+			T * dk = diag ? diag + k * nb : diag;
+			factorBlock(A.tile(k, k), nb, dk, kb, kernels);
+			for (int i = k + 1; i < nt; i++)
+				solveBlock(A.tile(i, k), nb, A.tile(k, k), nb, dk, A.tileRows(i), kb, kernels);
+
+			for (int j = k + 1; j < nt; j++)
+			{
+				packTransposed(A.tile(j, k), nb, dk, A.tileRows(j), kb, packed, nb);
+				for (int i = j; i < nt; i++)
+					updatePacked(A.tile(i, j), nb, A.tile(i, k), nb, packed, nb,
+						A.tileRows(i), A.tileRows(j), kb, i == j, kernels);
+			}
+		}
+	}
+
+	template<typename T>
+	void packedCholeskySolve(const PackedLowerMatrix<T> & L, const T * diag, T * b, const CholeskyKernels<T> & kernels)
+	{
+		int nb = L.tileSize;
+		int nt = L.numTiles;
+		T sums[CHOLESKY_DOT_ROWS];
+
+		// L y = b, by tile rows
+		for (int i = 0; i < nt; i++)
+		{
+			int rows = L.tileRows(i);
+			T * bi = b + i * nb;
+			for (int k = 0; k < i; k++)
+			{
+				const T * Lik = L.tile(i, k);
+				for (int r = 0; r < rows; r += CHOLESKY_DOT_ROWS)
+				{
+					int numRows = std::min(CHOLESKY_DOT_ROWS, rows - r);
+					kernels.sum2VecProductRows(&Lik[r * nb], nb, b + k * nb, nb, numRows, sums);
+					for (int q = 0; q < numRows; q++)
+						bi[r + q] -= sums[q];
+				}
+			}
+			const T * Lii = L.tile(i, i);
+			for (int r = 0; r < rows; r++)
+			{
+				bi[r] -= kernels.sum2VecProduct(&Lii[r * nb], bi, r);
+				if (!diag)
+					bi[r] /= Lii[r * nb + r];
+			}
+		}
+		// LDL^T: L has a unit diagonal, D^-1 y
+		if (diag)
+			for (int i = 0; i < L.rows; i++)
+				b[i] /= diag[i];
+		// L^T x = y, once x(i) is known remove its contribution from the rows above
+		for (int i = nt - 1; i >= 0; i--)
+		{
+			int rows = L.tileRows(i);
+			T * bi = b + i * nb;
+			const T * Lii = L.tile(i, i);
+			for (int r = rows - 1; r >= 0; r--)
+			{
+				if (!diag)
+					bi[r] /= Lii[r * nb + r];
+				kernels.axpySub(bi[r], &Lii[r * nb], bi, r);
+			}
+			for (int k = 0; k < i; k++)
+			{
+				const T * Lik = L.tile(i, k);
+				for (int r = 0; r < rows; r++)
+					kernels.axpySub(bi[r], &Lik[r * nb], b + k * nb, nb);
+			}
+		}
+	}
+
+	template<typename T>
+	void packedCholeskySolve(const PackedLowerMatrix<T> & L, const T * diag, Matrix<T> & B, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int nb = L.tileSize;
+		int nt = L.numTiles;
+		int ldb = B.stride;
+		int cols = B.cols;
+		work.resize((size_t)nb * nb);
+
+		// L Y = B, by tile rows
+		for (int i = 0; i < nt; i++)
+		{
+			int rows = L.tileRows(i);
+			T * Bi = &B.data[i * nb * ldb];
+			for (int k = 0; k < i; k++)
+				kernels.gemmSub(L.tile(i, k), nb, &B.data[k * nb * ldb], ldb, Bi, ldb, rows, cols, nb);
+			const T * Lii = L.tile(i, i);
+			for (int r = 0; r < rows; r++)
+			{
+				kernels.gemmSub(&Lii[r * nb], nb, Bi, ldb, &Bi[r * ldb], ldb, 1, cols, r);
+				if (!diag)
+				{
+					T inv = 1 / Lii[r * nb + r];
+					for (int c = 0; c < cols; c++)
+						Bi[r * ldb + c] *= inv;
+				}
+			}
+		}
+		// LDL^T: L has a unit diagonal, D^-1 Y
+		if (diag)
+			for (int i = 0; i < L.rows; i++)
+			{
+				T inv = 1 / diag[i];
+				for (int c = 0; c < cols; c++)
+					B(i, c) *= inv;
+			}
+		// L^T X = Y, by tile rows from the bottom up
+		for (int i = nt - 1; i >= 0; i--)
+		{
+			int rows = L.tileRows(i);
+			T * Bi = &B.data[i * nb * ldb];
+			const T * Lii = L.tile(i, i);
+			for (int r = rows - 1; r >= 0; r--)
+			{
+				T * Xr = &Bi[r * ldb];
+				if (!diag)
+				{
+					T inv = 1 / Lii[r * nb + r];
+					for (int c = 0; c < cols; c++)
+						Xr[c] *= inv;
+				}
+				for (int q = 0; q < r; q++)
+					kernels.axpySub(Lii[r * nb + q], Xr, &Bi[q * ldb], cols);
+			}
+			// Tile rows above: Y_k -= L(i, k)^T X_i
+			for (int k = 0; k < i; k++)
+			{
+				packTransposed(L.tile(i, k), nb, (const T *)NULL, rows, nb, &work[0], nb);
+				kernels.gemmSub(&work[0], nb, Bi, ldb, &B.data[k * nb * ldb], ldb, nb, cols, rows);
+			}
+		}
+	}
+
+	template void packedCholesky<float>(PackedLowerMatrix<float> &, float *, std::vector<float> &, const CholeskyKernels<float> &);
+	template void packedCholesky<double>(PackedLowerMatrix<double> &, double *, std::vector<double> &, const CholeskyKernels<double> &);
+	template void packedCholeskySolve<float>(const PackedLowerMatrix<float> &, const float *, float *, const CholeskyKernels<float> &);
+	template void packedCholeskySolve<double>(const PackedLowerMatrix<double> &, const double *, double *, const CholeskyKernels<double> &);
+	template void packedCholeskySolve<float>(const PackedLowerMatrix<float> &, const float *, Matrix<float> &, std::vector<float> &, const CholeskyKernels<float> &);
+	template void packedCholeskySolve<double>(const PackedLowerMatrix<double> &, const double *, Matrix<double> &, std::vector<double> &, const CholeskyKernels<double> &);
+
+}
@@ -0,0 +1,88 @@
+#ifndef _LINALG_CHOLESKY_PACKED_HPP_
+#define _LINALG_CHOLESKY_PACKED_HPP_
+
+#include "cholesky.hpp"
+
+// Cholesky on PackedLowerMatrix storage (see matrix.hpp): half the memory of Cholesky, which keeps
+// the full padded square, plus another full copy in getCholeskyMatrix()
+// Tiles are contiguous, so the blocked kernels run on them directly with the tile size as stride,
+// and every tile read by the trailing update is one sequential stream
+
+namespace linalg{
+
+	// Right-looking tiled factorization in place, diag == NULL selects LL^T (see cholesky_packed.cpp)
+	// work holds one packed tile, it is resized as needed and can be kept across calls
+	template<typename T>
+	void packedCholesky(PackedLowerMatrix<T> & A, T * diag, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+	// Solves A x = b in place with a factor stored as by packedCholesky
+	template<typename T>
+	void packedCholeskySolve(const PackedLowerMatrix<T> & L, const T * diag, T * b, const CholeskyKernels<T> & kernels);
+	// Solves A X = B in place for the columns of B, work is resized as needed
+	template<typename T>
+	void packedCholeskySolve(const PackedLowerMatrix<T> & L, const T * diag, Matrix<T> & B, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+/// Same storage conventions as Cholesky, but only the lower triangle is kept, in tiles
+/// Passing the input as an rvalue factors it in place, without any copy
+template<typename T>
+class PackedCholesky
+{
+public:
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	/// BLOCKED, PARALLEL, AUTO and BLAS all run the widest kernels
+	explicit PackedCholesky(int size, CholeskyImpl impl, int tileSize = CHOLESKY_BLOCK_SIZE)
+		: m_chol(size, std::min(tileSize, CHOLESKY_MAX_BLOCK_SIZE)), diag(size)
+	{
+		if (!isSupported(impl))
+			throw std::runtime_error("PackedCholesky: instruction set not supported by this CPU");
+		m_kernels = CholeskyKernels<T>::select(kernelImpl(impl));
+	}
+
+	/// Compute the LDL^T decomposition of mat, given mat
+	void calculateCholeskyLDLt(const PackedLowerMatrix<T> & M) { m_chol = M; factor(true); }
+	void calculateCholeskyLDLt(PackedLowerMatrix<T> && M) { m_chol = std::move(M); factor(true); }
+	void calculateCholeskyLDLt(const Matrix<T> & M) { m_chol.pack(M); factor(true); }
+
+	/// Compute the LL^T decomposition of mat, given mat
+	void calculateCholeskyLLt(const PackedLowerMatrix<T> & M) { m_chol = M; factor(false); }
+	void calculateCholeskyLLt(PackedLowerMatrix<T> && M) { m_chol = std::move(M); factor(false); }
+	void calculateCholeskyLLt(const Matrix<T> & M) { m_chol.pack(M); factor(false); }
+
+	/// Solves A x = b in place, using the factor of the last calculateCholeskyLLt/LDLt call
+	void solve(std::vector<T> & b) const
+	{
+		assert((int)b.size() == m_chol.rows);
+		packedCholeskySolve(m_chol, m_isLDLt ? &diag[0] : NULL, &b[0], m_kernels);
+	}
+
+	/// Solves A X = B in place for all columns of B at once
+	void solve(Matrix<T> & B)
+	{
+		assert(B.rows == m_chol.rows);
+		packedCholeskySolve(m_chol, m_isLDLt ? &diag[0] : NULL, B, m_solveWork, m_kernels);
+	}
+
+	/// Unpacked factor, with the upper triangle mirrored as in Cholesky::getCholeskyMatrix
+	Matrix<T> getCholeskyMatrix() const { return m_chol.toMatrix(); }
+
+	const PackedLowerMatrix<T> & getPackedMatrix() const { return m_chol; }
+
+private:
+	void factor(bool ldlt)
+	{
+		m_isLDLt = ldlt;
+		// A moved in matrix brings its own size
+		diag.resize(m_chol.rows);
+		packedCholesky(m_chol, ldlt ? &diag[0] : (T *)NULL, m_factorWork, m_kernels);
+	}
+
+	PackedLowerMatrix<T> m_chol;
+	std::vector<T> diag;
+	CholeskyKernels<T> m_kernels;
+	bool m_isLDLt = false;
+	std::vector<T> m_factorWork; // transposed tile shared by the updates of one tile column
+	std::vector<T> m_solveWork; // transposed tiles for multi right-hand side solves
+};
+
+}
+#endif
@@ -0,0 +1,74 @@
+#include <algorithm>
+#include <cmath>
+
+#include "cholesky_pivoted.hpp"
+
+// Step k of the pivoted factorization:
+//   1. pivot on the largest diagonal entry d(p) of the Schur complement, swap rows k and p of L
+//   2. fetch column perm[k] of A for the rows not yet pivoted
+//   3. L(i, k) = (A(perm[i], perm[k]) - L(i, 0:k) . L(k, 0:k)) / sqrt(d(k)), CHOLESKY_DOT_ROWS rows per kernel call
+//   4. d(i) -= L(i, k)^2
+// The Schur complement itself is never formed, only its diagonal d
+
+namespace linalg{
+
+	template<typename T>
+	int pivotedCholesky(const MatrixEntry<T> & entry, int n, int maxRank, T tolerance, MatrixView<T> L, int * perm, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		assert(L.rows == n && L.cols >= std::min(maxRank, n));
+		maxRank = std::min(maxRank, n);
+		work.resize(2 * (size_t)n);
+		T * d = &work[0];
+		T * column = &work[n];
+		T sums[CHOLESKY_DOT_ROWS];
+
+		T trace = 0;
+		for (int i = 0; i < n; i++)
+		{
+			perm[i] = i;
+			d[i] = entry(i, i);
+			trace += d[i];
+		}
+		T residual = trace;
+
+		int k = 0;
+		for (; k < maxRank && residual > tolerance * trace; k++)
+		{
+			int p = (int)(std::max_element(d + k, d + n) - d);
+			if (!(d[p] > 0))
+				break;
+			if (p != k)
+			{
+				std::swap(d[k], d[p]);
+				std::swap(perm[k], perm[p]);
+				for (int q = 0; q < k; q++)
+					std::swap(L(k, q), L(p, q));
+			}
+
+			T pivot = std::sqrt(d[k]);
+			T invPivot = 1 / pivot;
+			L(k, k) = pivot;
+			d[k] = 0;
+			for (int i = k + 1; i < n; i++)
+				column[i] = entry(perm[i], perm[k]);
+			residual = 0;
+			for (int i = k + 1; i < n; i += CHOLESKY_DOT_ROWS)
+			{
+				int numRows = std::min(CHOLESKY_DOT_ROWS, n - i);
+				kernels.sum2VecProductRows(&L(i, 0), L.stride, &L(k, 0), k, numRows, sums);
+				for (int q = 0; q < numRows; q++)
+				{
+					T l = (column[i + q] - sums[q]) * invPivot;
+					L(i + q, k) = l;
+					d[i + q] -= l * l;
+					residual += std::max(d[i + q], (T)0);
+				}
+			}
+		}
+		return k;
+	}
+
+	template int pivotedCholesky<float>(const MatrixEntry<float> &, int, int, float, MatrixView<float>, int *, std::vector<float> &, const CholeskyKernels<float> &);
+	template int pivotedCholesky<double>(const MatrixEntry<double> &, int, int, double, MatrixView<double>, int *, std::vector<double> &, const CholeskyKernels<double> &);
+
+}
@@ -0,0 +1,92 @@
+#ifndef _LINALG_CHOLESKY_PIVOTED_HPP_
+#define _LINALG_CHOLESKY_PIVOTED_HPP_
+
+#include <functional>
+
+#include "cholesky.hpp"
+
+// Partial Cholesky with diagonal pivoting, P A P^T ~ L L^T with L n x k lower trapezoidal, for symmetric
+// positive semi-definite A of low numerical rank (kernel matrices)
+// Each step takes the largest remaining diagonal entry of the Schur complement as pivot, so it also runs on
+// semi-definite input, and stops at the target rank or once the trace of the Schur complement, which is
+// ||A - L L^T|| in the trace norm, falls below tolerance * trace(A)
+// Reads the diagonal and k columns of A, i.e. O(n k) entries, in O(n k^2) time, see Harbrecht, Peters &
+// Schneider, "On the low-rank approximation by the pivoted Cholesky decomposition", 2012
+
+namespace linalg{
+
+	// entry(i, j) returns A(i, j) of the original order
+	template<typename T>
+	using MatrixEntry = std::function<T(int, int)>;
+
+	// Factorization of the n x n matrix given by entry into the first columns of L (n x maxRank), rows in pivot
+	// order: row r of L belongs to row perm[r] of A (see cholesky_pivoted.cpp)
+	// work holds the Schur complement diagonal and a column of A, it is resized as needed
+	// Returns the rank k, the columns of L right of it are not written
+	template<typename T>
+	int pivotedCholesky(const MatrixEntry<T> & entry, int n, int maxRank, T tolerance, MatrixView<T> L, int * perm, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+/// Low-rank factor of a matrix given by its entries, nothing but the factor and O(n) scratch is stored
+template<typename T>
+class PivotedCholesky
+{
+public:
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	/// BLOCKED, PARALLEL, AUTO and BLAS all run the widest kernels
+	PivotedCholesky(int size, int maxRank, CholeskyImpl impl) : m_chol(size, std::min(maxRank, size)), m_perm(size)
+	{
+		if (!isSupported(impl))
+			throw std::runtime_error("PivotedCholesky: instruction set not supported by this CPU");
+		m_kernels = CholeskyKernels<T>::select(kernelImpl(impl));
+	}
+
+	/// Factor of the matrix given by entry, tolerance on the trace of the remainder relative to trace(A)
+	/// Returns the rank of the factor, at most maxRank
+	int calculateCholeskyLLt(const MatrixEntry<T> & entry, T tolerance)
+	{
+		m_rank = pivotedCholesky(entry, m_chol.rows, m_chol.cols, tolerance, m_chol.view(), &m_perm[0], m_work, m_kernels);
+		return m_rank;
+	}
+
+	/// Factor of M, of which only the diagonal and the pivot columns are read
+	int calculateCholeskyLLt(const Matrix<T> & M, T tolerance)
+	{
+		assert(M.rows == m_chol.rows && M.cols == M.rows);
+		return calculateCholeskyLLt([&M](int i, int j) { return M(i, j); }, tolerance);
+	}
+
+	int getRank() const { return m_rank; }
+
+	/// Row r of the factor belongs to row getPermutation()[r] of A, the first getRank() entries are the pivots
+	const std::vector<int> & getPermutation() const { return m_perm; }
+
+	/// n x rank factor in pivot order, P A P^T ~ L L^T
+	Matrix<T> getCholeskyMatrix() const
+	{
+		Matrix<T> L(m_chol.rows, m_rank);
+		for (int i = 0; i < m_chol.rows; i++)
+			for (int j = 0; j < m_rank; j++)
+				L(i, j) = j <= i ? m_chol(i, j) : 0;
+		return L;
+	}
+
+	/// n x rank factor G in the original order, A ~ G G^T
+	Matrix<T> getFactor() const
+	{
+		Matrix<T> G(m_chol.rows, m_rank);
+		for (int i = 0; i < m_chol.rows; i++)
+			for (int j = 0; j < m_rank; j++)
+				G(m_perm[i], j) = j <= i ? m_chol(i, j) : 0;
+		return G;
+	}
+
+private:
+	Matrix<T> m_chol;
+	std::vector<int> m_perm;
+	int m_rank = 0;
+	CholeskyKernels<T> m_kernels;
+	std::vector<T> m_work; // Schur complement diagonal and one column of A
+};
+
+}
+#endif
@@ -0,0 +1,112 @@
+#include <algorithm>
+
+#include "cholesky.hpp"
+
+// Forward and back substitution with a factor stored as by Cholesky: L in the lower triangle,
+// and for LDL^T, D on the diagonal with an implicit unit diagonal in L
+// Only the lower triangle is read, L^T is applied by walking rows of L, never its columns
+// Many right-hand sides are stored as the columns of an n x m matrix, so every step is a row operation
+// on contiguous memory: the off-diagonal blocks go through the packed GEMM kernel used by the factorization
+
+namespace linalg{
+
+	// Number of right-hand sides solved together, so that a block of rows of B stays in cache
+	static const int SOLVE_RHS_COLS = 256;
+
+	template<typename T>
+	void choleskySolve(MatrixView<T> L, const T * diag, T * b, const CholeskyKernels<T> & kernels)
+	{
+		int n = L.rows;
+		int stride = L.stride;
+
+		// L y = b, row i needs y(0..i-1)
+		for (int i = 0; i < n; i++)
+		{
+			b[i] -= kernels.sum2VecProduct(&L.data[i * stride], b, i);
+			if (!diag)
+				b[i] /= L(i, i);
+		}
+		// LDL^T: L has a unit diagonal, D^-1 y
+		if (diag)
+			for (int i = 0; i < n; i++)
+				b[i] /= diag[i];
+		// L^T x = y, once x(i) is known remove its contribution from the rows above
+		for (int i = n - 1; i >= 0; i--)
+		{
+			if (!diag)
+				b[i] /= L(i, i);
+			kernels.axpySub(b[i], &L.data[i * stride], b, i);
+		}
+	}
+
+	template<typename T>
+	void choleskySolve(MatrixView<T> L, const T * diag, MatrixView<T> B, int blockSize, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int n = L.rows;
+		int stride = L.stride;
+		int ldb = B.stride;
+		work.resize((size_t)blockSize * n);
+
+		for (int jc = 0; jc < B.cols; jc += SOLVE_RHS_COLS)
+		{
+			int cols = std::min(SOLVE_RHS_COLS, B.cols - jc);
+			T * X = &B.data[jc];
+
+			// Forward substitution, L Y = B, by blocks of rows
+			for (int i0 = 0; i0 < n; i0 += blockSize)
+			{
+				int i1 = std::min(i0 + blockSize, n);
+				// Contribution of all solved rows above the block, packed panel is Y(0:i0, :) itself
+				kernels.gemmSub(&L.data[i0 * stride], stride, X, ldb, &X[i0 * ldb], ldb, i1 - i0, cols, i0);
+				for (int i = i0; i < i1; i++)
+				{
+					kernels.gemmSub(&L.data[i * stride + i0], stride, &X[i0 * ldb], ldb, &X[i * ldb], ldb, 1, cols, i - i0);
+					if (!diag)
+					{
+						T inv = 1 / L(i, i);
+						for (int c = 0; c < cols; c++)
+							X[i * ldb + c] *= inv;
+					}
+				}
+			}
+			// LDL^T: L has a unit diagonal, D^-1 Y
+			if (diag)
+				for (int i = 0; i < n; i++)
+				{
+					T inv = 1 / diag[i];
+					for (int c = 0; c < cols; c++)
+						X[i * ldb + c] *= inv;
+				}
+
+			// Back substitution, L^T X = Y, by blocks of rows from the bottom up
+			for (int i1 = n; i1 > 0; i1 -= blockSize)
+			{
+				int i0 = std::max(i1 - blockSize, 0);
+				int kb = i1 - i0;
+				for (int i = i1 - 1; i >= i0; i--)
+				{
+					T * Xi = &X[i * ldb];
+					if (!diag)
+					{
+						T inv = 1 / L(i, i);
+						for (int c = 0; c < cols; c++)
+							Xi[c] *= inv;
+					}
+					for (int k = i0; k < i; k++)
+						kernels.axpySub(L(i, k), Xi, &X[k * ldb], cols);
+				}
+				// Rows above the block: Y(0:i0, :) -= L(i0:i1, 0:i0)^T X(i0:i1, :), with L's block packed transposed
+				for (int r = 0; r < i0; r++)
+					for (int p = 0; p < kb; p++)
+						work[r * kb + p] = L(i0 + p, r);
+				kernels.gemmSub(&work[0], kb, &X[i0 * ldb], ldb, X, ldb, i0, cols, kb);
+			}
+		}
+	}
+
+	template void choleskySolve<float>(MatrixView<float>, const float *, float *, const CholeskyKernels<float> &);
+	template void choleskySolve<double>(MatrixView<double>, const double *, double *, const CholeskyKernels<double> &);
+	template void choleskySolve<float>(MatrixView<float>, const float *, MatrixView<float>, int, std::vector<float> &, const CholeskyKernels<float> &);
+	template void choleskySolve<double>(MatrixView<double>, const double *, MatrixView<double>, int, std::vector<double> &, const CholeskyKernels<double> &);
+
+}
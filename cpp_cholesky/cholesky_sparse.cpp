@@ -0,0 +1,497 @@
+#include <algorithm>
+#include <set>
+
+#include "cholesky_sparse.hpp"
+
+// Symbolic analysis follows Davis, "Direct Methods for Sparse Linear Systems", 2006: elimination tree by
+// Liu's algorithm, postordered so that every subtree and every supernode is a contiguous range of columns,
+// and the row patterns of L as row subtrees of the elimination tree (ereach)
+// Supernodes are fundamental (each column's pattern is its successor's plus itself), relaxed to merge small
+// chains of columns at the cost of a few stored zeros
+// The numeric factorization is left-looking: supernode s first receives the updates of every earlier supernode d
+// with rows in its columns, then its diagonal block is factored and its rows below solved against it
+// An update is one product of two dense slices of d, computed by the packed GEMM of the blocked factorization
+// into scratch, then scattered into s. Supernodes waiting to update s are linked in a list per supernode
+
+namespace linalg{
+
+	// Relaxed supernodes: a column joins the supernode of its only child as long as the supernode has at most
+	// SPARSE_RELAX_COLS columns and the merge stores at most SPARSE_RELAX_ZEROS zeros
+	// Tiny supernodes spend their time in update bookkeeping rather than in the kernels
+	static const int SPARSE_RELAX_COLS = 16;
+	static const int SPARSE_RELAX_ZEROS = 32;
+
+	static const size_t NO_POSITION = (size_t)-1;
+
+	// Adjacency lists of the symmetric pattern, diagonal excluded, from either or both triangles
+	static void symmetricPattern(const std::vector<int> & colPtr, const std::vector<int> & rowIdx, int n, std::vector<std::vector<int>> & adj)
+	{
+		adj.assign(n, std::vector<int>());
+		for (int j = 0; j < n; j++)
+			for (int k = colPtr[j]; k < colPtr[j + 1]; k++)
+			{
+				int i = rowIdx[k];
+				if (i == j)
+					continue;
+				adj[i].push_back(j);
+				adj[j].push_back(i);
+			}
+		for (std::vector<int> & a : adj)
+		{
+			std::sort(a.begin(), a.end());
+			a.erase(std::unique(a.begin(), a.end()), a.end());
+		}
+	}
+
+	// Quotient graph: eliminated variables become elements, a variable i keeps the variables A[i] and the elements
+	// E[i] it is adjacent to, and element e the variables L[e] it connects. Eliminating p merges p and the elements
+	// next to it into the new element p, so the graph never grows beyond the pattern of A
+	// Degrees are the approximate external degrees of AMD: |A_i| + |L_p \ i| + sum of |L_e \ L_p| over the other
+	// elements of i, where |L_e \ L_p| is found for all e at once by counting the members of L_p in each L_e
+	std::vector<int> amdOrdering(const std::vector<int> & colPtr, const std::vector<int> & rowIdx, int n)
+	{
+		enum { VARIABLE, ELEMENT, ABSORBED };
+		std::vector<std::vector<int>> A, E(n), L(n);
+		symmetricPattern(colPtr, rowIdx, n, A);
+		std::vector<char> status(n, VARIABLE);
+		std::vector<int> degree(n), w(n, -1), mark(n, -1);
+		std::set<std::pair<int, int>> queue;
+		for (int i = 0; i < n; i++)
+		{
+			degree[i] = (int)A[i].size();
+			queue.insert(std::make_pair(degree[i], i));
+		}
+
+		std::vector<int> perm, Lp, touched;
+		perm.reserve(n);
+		for (int k = 0; k < n; k++)
+		{
+			int p = queue.begin()->second;
+			queue.erase(queue.begin());
+			perm.push_back(p);
+
+			// L_p: variables next to p and next to its elements, which are absorbed into p
+			Lp.clear();
+			mark[p] = k;
+			for (int i : A[p])
+				if (mark[i] != k)
+				{
+					mark[i] = k;
+					Lp.push_back(i);
+				}
+			for (int e : E[p])
+			{
+				if (status[e] != ELEMENT)
+					continue;
+				for (int i : L[e])
+					if (mark[i] != k)
+					{
+						mark[i] = k;
+						Lp.push_back(i);
+					}
+				status[e] = ABSORBED;
+				std::vector<int>().swap(L[e]);
+			}
+			status[p] = ELEMENT;
+			std::vector<int>().swap(A[p]);
+			std::vector<int>().swap(E[p]);
+
+			// Edges between members of L_p are implied by element p from now on
+			for (int i : Lp)
+			{
+				std::vector<int> & Ai = A[i];
+				Ai.erase(std::remove_if(Ai.begin(), Ai.end(), [&](int j) { return mark[j] == k; }), Ai.end());
+				std::vector<int> & Ei = E[i];
+				Ei.erase(std::remove_if(Ei.begin(), Ei.end(), [&](int e) { return status[e] != ELEMENT; }), Ei.end());
+			}
+
+			// w[e] = |L_e \ L_p|, elements with nothing outside L_p are absorbed into p as well
+			touched.clear();
+			for (int i : Lp)
+				for (int e : E[i])
+				{
+					if (w[e] < 0)
+					{
+						w[e] = (int)L[e].size();
+						touched.push_back(e);
+					}
+					w[e]--;
+				}
+			for (int e : touched)
+				if (w[e] == 0)
+				{
+					status[e] = ABSORBED;
+					std::vector<int>().swap(L[e]);
+				}
+
+			int lpSize = (int)Lp.size();
+			int remaining = n - k - 1;
+			for (int i : Lp)
+			{
+				std::vector<int> & Ei = E[i];
+				Ei.erase(std::remove_if(Ei.begin(), Ei.end(), [&](int e) { return status[e] != ELEMENT; }), Ei.end());
+				int d = (int)A[i].size() + lpSize - 1;
+				for (int e : Ei)
+					d += w[e];
+				Ei.push_back(p);
+				d = std::min(d, degree[i] + lpSize - 1);
+				d = std::min(d, remaining - 1);
+				if (d != degree[i])
+				{
+					queue.erase(std::make_pair(degree[i], i));
+					degree[i] = d;
+					queue.insert(std::make_pair(d, i));
+				}
+			}
+			for (int e : touched)
+				w[e] = -1;
+			L[p] = Lp;
+		}
+		return perm;
+	}
+
+	// rowsOf[i]: columns k < i with C(i, k) != 0 in C = P A P^T, invPerm[original index] = pivot
+	template<typename T>
+	static void permutedRowPattern(const SparseMatrix<T> & A, const std::vector<int> & invPerm, std::vector<std::vector<int>> & rowsOf)
+	{
+		rowsOf.assign(A.rows, std::vector<int>());
+		for (int j = 0; j < A.cols; j++)
+			for (int k = A.colPtr[j]; k < A.colPtr[j + 1]; k++)
+			{
+				int pi = invPerm[A.rowIdx[k]];
+				int pj = invPerm[j];
+				if (pi != pj)
+					rowsOf[std::max(pi, pj)].push_back(std::min(pi, pj));
+			}
+	}
+
+	// Liu's algorithm with path compression through ancestor
+	static std::vector<int> eliminationTree(const std::vector<std::vector<int>> & rowsOf)
+	{
+		int n = (int)rowsOf.size();
+		std::vector<int> parent(n, -1), ancestor(n, -1);
+		for (int i = 0; i < n; i++)
+			for (int k : rowsOf[i])
+				for (int j = k; j != -1 && j < i; )
+				{
+					int next = ancestor[j];
+					ancestor[j] = i;
+					if (next == -1)
+						parent[j] = i;
+					j = next;
+				}
+		return parent;
+	}
+
+	// Depth-first postorder of the forest, children in increasing order
+	static std::vector<int> postorder(const std::vector<int> & parent)
+	{
+		int n = (int)parent.size();
+		std::vector<int> head(n, -1), next(n, -1), post, stack;
+		for (int j = n - 1; j >= 0; j--)
+			if (parent[j] >= 0)
+			{
+				next[j] = head[parent[j]];
+				head[parent[j]] = j;
+			}
+		post.reserve(n);
+		for (int root = 0; root < n; root++)
+		{
+			if (parent[root] != -1)
+				continue;
+			stack.push_back(root);
+			while (!stack.empty())
+			{
+				int j = stack.back();
+				int child = head[j];
+				if (child == -1)
+				{
+					stack.pop_back();
+					post.push_back(j);
+				}
+				else
+				{
+					head[j] = next[child];
+					stack.push_back(child);
+				}
+			}
+		}
+		return post;
+	}
+
+	// Columns j < i with L(i, j) != 0: the paths from the entries of row i up the elimination tree to i
+	static void rowPattern(int i, const std::vector<std::vector<int>> & rowsOf, const std::vector<int> & parent, std::vector<int> & mark, std::vector<int> & out)
+	{
+		out.clear();
+		mark[i] = i;
+		for (int k : rowsOf[i])
+			for (int j = k; mark[j] != i; j = parent[j])
+			{
+				mark[j] = i;
+				out.push_back(j);
+			}
+	}
+
+	template<typename T>
+	SparseSymbolic sparseAnalyze(const SparseMatrix<T> & A, SparseOrdering ordering)
+	{
+		assert(A.rows == A.cols);
+		int n = A.rows;
+		SparseSymbolic S;
+		S.n = n;
+
+		std::vector<int> perm(n);
+		if (ordering == SparseOrdering::AMD)
+			perm = amdOrdering(A.colPtr, A.rowIdx, n);
+		else
+			for (int k = 0; k < n; k++)
+				perm[k] = k;
+
+		// Same elimination, postordered
+		std::vector<int> invPerm(n);
+		std::vector<std::vector<int>> rowsOf;
+		for (int k = 0; k < n; k++)
+			invPerm[perm[k]] = k;
+		permutedRowPattern(A, invPerm, rowsOf);
+		std::vector<int> post = postorder(eliminationTree(rowsOf));
+		S.perm.resize(n);
+		for (int k = 0; k < n; k++)
+			S.perm[k] = perm[post[k]];
+		for (int k = 0; k < n; k++)
+			invPerm[S.perm[k]] = k;
+		permutedRowPattern(A, invPerm, rowsOf);
+		S.parent = eliminationTree(rowsOf);
+
+		std::vector<int> colCount(n, 1), mark(n, -1), pattern;
+		for (int i = 0; i < n; i++)
+		{
+			rowPattern(i, rowsOf, S.parent, mark, pattern);
+			for (int j : pattern)
+				colCount[j]++;
+		}
+		S.nonZerosL = 0;
+		for (int j = 0; j < n; j++)
+			S.nonZerosL += colCount[j];
+
+		// Supernodes: j joins the supernode of j - 1 if j - 1 is its only child
+		std::vector<int> numChildren(n, 0);
+		for (int j = 0; j < n; j++)
+			if (S.parent[j] >= 0)
+				numChildren[S.parent[j]]++;
+		S.superStart.assign(1, 0);
+		for (int j = 1; j < n; j++)
+		{
+			int cols = j - S.superStart.back();
+			// Rows of j missing from j - 1, stored as zeros in the columns of the supernode if j joins it
+			int zeros = colCount[j] + 1 - colCount[j - 1];
+			bool chain = S.parent[j - 1] == j && numChildren[j] == 1;
+			if (!chain || (zeros > 0 && (cols + 1 > SPARSE_RELAX_COLS || zeros * cols > SPARSE_RELAX_ZEROS)))
+				S.superStart.push_back(j);
+		}
+		S.superStart.push_back(n);
+		int ns = S.numSupernodes();
+		S.columnSuper.resize(n);
+		for (int s = 0; s < ns; s++)
+			for (int j = S.superStart[s]; j < S.superStart[s + 1]; j++)
+				S.columnSuper[j] = s;
+
+		// Rows of supernode s: its first column, then every row whose pattern meets one of its columns,
+		// found in increasing order. Counted in a first pass, stored in a second one
+		S.superRowPtr.assign(ns + 1, 0);
+		std::vector<int> lastRow(ns, -1);
+		for (int pass = 0; pass < 2; pass++)
+		{
+			std::vector<int> fill(S.superRowPtr.begin(), S.superRowPtr.end() - 1);
+			std::fill(lastRow.begin(), lastRow.end(), -1);
+			auto addRow = [&](int s, int i)
+			{
+				if (lastRow[s] == i)
+					return;
+				lastRow[s] = i;
+				if (pass == 0)
+					S.superRowPtr[s + 1]++;
+				else
+					S.superRows[fill[s]++] = i;
+			};
+			for (int i = 0; i < n; i++)
+			{
+				if (S.superStart[S.columnSuper[i]] == i)
+					addRow(S.columnSuper[i], i);
+				rowPattern(i, rowsOf, S.parent, mark, pattern);
+				for (int j : pattern)
+					addRow(S.columnSuper[j], i);
+			}
+			if (pass == 0)
+			{
+				for (int s = 0; s < ns; s++)
+					S.superRowPtr[s + 1] += S.superRowPtr[s];
+				S.superRows.resize(S.superRowPtr[ns]);
+			}
+		}
+
+		S.superValPtr.assign(ns + 1, 0);
+		for (int s = 0; s < ns; s++)
+			S.superValPtr[s + 1] = S.superValPtr[s] + (size_t)S.superNumRows(s) * S.superStride(s);
+
+		// Where each entry of the lower triangle of A lands
+		S.entryPos.assign(A.nonZeros(), NO_POSITION);
+		for (int j = 0; j < n; j++)
+			for (int k = A.colPtr[j]; k < A.colPtr[j + 1]; k++)
+			{
+				if (A.rowIdx[k] < j)
+					continue;
+				int r = std::max(invPerm[A.rowIdx[k]], invPerm[j]);
+				int c = std::min(invPerm[A.rowIdx[k]], invPerm[j]);
+				int s = S.columnSuper[c];
+				const int * rows = &S.superRows[S.superRowPtr[s]];
+				int local = (int)(std::lower_bound(rows, rows + S.superNumRows(s), r) - rows);
+				S.entryPos[k] = S.superValPtr[s] + (size_t)local * S.superStride(s) + (c - S.superStart[s]);
+			}
+		return S;
+	}
+
+	template<typename T>
+	bool sparseFactorize(const SparseSymbolic & S, const SparseMatrix<T> & A, std::vector<T> & L, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int ns = S.numSupernodes();
+		L.assign(S.superValPtr[ns], (T)0);
+		for (size_t k = 0; k < S.entryPos.size(); k++)
+			if (S.entryPos[k] != NO_POSITION)
+				L[S.entryPos[k]] += A.values[k];
+
+		int maxCols = 0, maxRows = 0;
+		for (int s = 0; s < ns; s++)
+		{
+			maxCols = std::max(maxCols, S.superCols(s));
+			maxRows = std::max(maxRows, S.superNumRows(s));
+		}
+		int maxStride = util::getColStride(maxCols);
+		// One update: the slice of d in the columns of s packed transposed, and its product with the rows below
+		std::vector<T> packed((size_t)maxCols * maxStride), C((size_t)maxRows * maxStride);
+		// relRow: row of L -> row of the current supernode; head/next: lists of supernodes waiting to update
+		// each supernode; pos[d]: first row of d not yet used by an update
+		std::vector<int> relRow(S.n), head(ns, -1), next(ns, -1), pos(ns, 0);
+
+		for (int s = 0; s < ns; s++)
+		{
+			int f = S.superStart[s];
+			int cols = S.superCols(s);
+			int rows = S.superNumRows(s);
+			int ld = S.superStride(s);
+			const int * Rs = &S.superRows[S.superRowPtr[s]];
+			T * Ls = &L[S.superValPtr[s]];
+			for (int r = 0; r < rows; r++)
+				relRow[Rs[r]] = r;
+
+			for (int d = head[s]; d != -1; )
+			{
+				int nextD = next[d];
+				int wd = S.superCols(d);
+				int md = S.superNumRows(d);
+				int ldd = S.superStride(d);
+				const int * Rd = &S.superRows[S.superRowPtr[d]];
+				const T * Ld = &L[S.superValPtr[d]];
+				int p0 = pos[d];
+				int p1 = p0;
+				while (p1 < md && Rd[p1] < f + cols)
+					p1++;
+				int ucols = p1 - p0;
+				int urows = md - p0;
+				int ldc = util::getColStride(ucols);
+
+				// C = -L_d(p0:md, :) L_d(p0:p1, :)^T, lower triangle
+				packTransposed(&Ld[p0 * ldd], ldd, (const T *)NULL, ucols, wd, &packed[0], ldc);
+				std::fill(C.begin(), C.begin() + (size_t)urows * ldc, (T)0);
+				updatePacked(&C[0], ldc, &Ld[p0 * ldd], ldd, &packed[0], ldc, urows, ucols, wd, true, kernels);
+				for (int i = 0; i < urows; i++)
+				{
+					T * dst = &Ls[relRow[Rd[p0 + i]] * ld];
+					for (int j = 0, jEnd = std::min(i + 1, ucols); j < jEnd; j++)
+						dst[Rd[p0 + j] - f] += C[i * ldc + j];
+				}
+
+				pos[d] = p1;
+				if (p1 < md)
+				{
+					int t = S.columnSuper[Rd[p1]];
+					next[d] = head[t];
+					head[t] = d;
+				}
+				d = nextD;
+			}
+
+			blockedCholeskyLLt(MatrixView<T>(Ls, cols, cols, ld), CHOLESKY_BLOCK_SIZE, work, kernels);
+			for (int c = 0; c < cols; c++)
+				if (!(Ls[c * ld + c] > 0))
+					return false;
+			if (rows > cols)
+			{
+				solveBlock(&Ls[cols * ld], ld, Ls, ld, (const T *)NULL, rows - cols, cols, kernels);
+				pos[s] = cols;
+				int t = S.columnSuper[Rs[cols]];
+				next[s] = head[t];
+				head[t] = s;
+			}
+		}
+		return true;
+	}
+
+	template<typename T>
+	void sparseSolve(const SparseSymbolic & S, const std::vector<T> & L, T * b, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int n = S.n;
+		int ns = S.numSupernodes();
+		work.resize(n);
+		T * y = &work[0];
+		T sums[CHOLESKY_DOT_ROWS];
+		for (int k = 0; k < n; k++)
+			y[k] = b[S.perm[k]];
+
+		// L y = P b: the diagonal block of each supernode, then its rows below
+		for (int s = 0; s < ns; s++)
+		{
+			int cols = S.superCols(s);
+			int rows = S.superNumRows(s);
+			int ld = S.superStride(s);
+			const int * Rs = &S.superRows[S.superRowPtr[s]];
+			const T * Ls = &L[S.superValPtr[s]];
+			T * ys = y + S.superStart[s];
+			for (int c = 0; c < cols; c++)
+				ys[c] = (ys[c] - kernels.sum2VecProduct(&Ls[c * ld], ys, c)) / Ls[c * ld + c];
+			for (int r = cols; r < rows; r += CHOLESKY_DOT_ROWS)
+			{
+				int numRows = std::min(CHOLESKY_DOT_ROWS, rows - r);
+				kernels.sum2VecProductRows(&Ls[r * ld], ld, ys, cols, numRows, sums);
+				for (int q = 0; q < numRows; q++)
+					y[Rs[r + q]] -= sums[q];
+			}
+		}
+		// L^T x = y, in reverse
+		for (int s = ns - 1; s >= 0; s--)
+		{
+			int cols = S.superCols(s);
+			int rows = S.superNumRows(s);
+			int ld = S.superStride(s);
+			const int * Rs = &S.superRows[S.superRowPtr[s]];
+			const T * Ls = &L[S.superValPtr[s]];
+			T * ys = y + S.superStart[s];
+			for (int r = cols; r < rows; r++)
+				kernels.axpySub(y[Rs[r]], &Ls[r * ld], ys, cols);
+			for (int c = cols - 1; c >= 0; c--)
+			{
+				ys[c] /= Ls[c * ld + c];
+				kernels.axpySub(ys[c], &Ls[c * ld], ys, c);
+			}
+		}
+		for (int k = 0; k < n; k++)
+			b[S.perm[k]] = y[k];
+	}
+
+	template SparseSymbolic sparseAnalyze<float>(const SparseMatrix<float> &, SparseOrdering);
+	template SparseSymbolic sparseAnalyze<double>(const SparseMatrix<double> &, SparseOrdering);
+	template bool sparseFactorize<float>(const SparseSymbolic &, const SparseMatrix<float> &, std::vector<float> &, std::vector<float> &, const CholeskyKernels<float> &);
+	template bool sparseFactorize<double>(const SparseSymbolic &, const SparseMatrix<double> &, std::vector<double> &, std::vector<double> &, const CholeskyKernels<double> &);
+	template void sparseSolve<float>(const SparseSymbolic &, const std::vector<float> &, float *, std::vector<float> &, const CholeskyKernels<float> &);
+	template void sparseSolve<double>(const SparseSymbolic &, const std::vector<double> &, double *, std::vector<double> &, const CholeskyKernels<double> &);
+
+}
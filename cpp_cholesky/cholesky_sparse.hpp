@@ -0,0 +1,135 @@
+#ifndef _LINALG_CHOLESKY_SPARSE_HPP_
+#define _LINALG_CHOLESKY_SPARSE_HPP_
+
+#include "cholesky.hpp"
+#include "sparse_matrix.hpp"
+
+// Supernodal sparse Cholesky, LL^T of P A P^T for a symmetric positive definite sparse A
+// Three steps, as in CHOLMOD (Chen, Davis, Hager & Rajamanickam, "Algorithm 887: CHOLMOD", 2008):
+//   - ordering: a fill-reducing permutation P, approximate minimum degree by default
+//   - symbolic analysis: elimination tree, column counts and supernodes, i.e. runs of columns of L with the
+//     same row structure, which are stored as dense blocks. Depends on the pattern of A only, and is kept
+//     across numeric factorizations of matrices with the same pattern
+//   - numeric factorization: left-looking over the supernodes, all arithmetic in the dense kernels of
+//     the blocked factorization (see cholesky_sparse.cpp)
+
+namespace linalg{
+
+	enum class SparseOrdering { NATURAL, AMD };
+
+	/// Fill-reducing ordering of the pattern of the symmetric matrix whose lower (or both) triangle(s) A holds
+	/// Returns perm, pivot k is row/column perm[k] of A
+	/// Approximate minimum degree on the quotient graph, see Amestoy, Davis & Duff, "An approximate minimum
+	/// degree ordering algorithm", 1996; without supervariable detection
+	std::vector<int> amdOrdering(const std::vector<int> & colPtr, const std::vector<int> & rowIdx, int n);
+
+	/// Result of the symbolic analysis, see cholesky_sparse.cpp
+	struct SparseSymbolic
+	{
+		int n = 0;
+		std::vector<int> perm; // pivot k is row/column perm[k] of A
+		std::vector<int> parent; // elimination tree of the permuted matrix, -1 for roots
+		// Supernode s holds columns superStart[s] .. superStart[s + 1] - 1 of L, its row indices are
+		// superRows[superRowPtr[s] .. superRowPtr[s + 1] - 1], increasing and starting with its own columns
+		std::vector<int> superStart;
+		std::vector<int> superRowPtr;
+		std::vector<int> superRows;
+		std::vector<int> columnSuper; // supernode of each column
+		// Supernode s is a row-major block of (rows x stride), stride = cols rounded up to 4, at superValPtr[s]
+		std::vector<size_t> superValPtr;
+		// Position in the supernode storage of each entry of A, -1 for entries of the upper triangle
+		std::vector<size_t> entryPos;
+		size_t nonZerosL = 0; // entries of L, not counting the zeros stored in the supernodes
+
+		int numSupernodes() const { return (int)superStart.size() - 1; }
+		int superCols(int s) const { return superStart[s + 1] - superStart[s]; }
+		int superNumRows(int s) const { return superRowPtr[s + 1] - superRowPtr[s]; }
+		int superStride(int s) const { return util::getColStride(superCols(s)); }
+	};
+
+	// Ordering, elimination tree, supernodes and the map from the entries of A to the supernode storage
+	template<typename T>
+	SparseSymbolic sparseAnalyze(const SparseMatrix<T> & A, SparseOrdering ordering);
+
+	// Left-looking supernodal factorization, L is stored in the layout of S
+	// Returns false if A is not positive definite
+	template<typename T>
+	bool sparseFactorize(const SparseSymbolic & S, const SparseMatrix<T> & A, std::vector<T> & L, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+	// Solves A x = b in place with the factor of sparseFactorize, work holds n elements
+	template<typename T>
+	void sparseSolve(const SparseSymbolic & S, const std::vector<T> & L, T * b, std::vector<T> & work, const CholeskyKernels<T> & kernels);
+
+/// Sparse counterpart of Cholesky for the LL^T decomposition
+/// analyze() once per sparsity pattern, then factorize() for every matrix with that pattern
+template<typename T>
+class SparseCholesky
+{
+public:
+	/// Instruction set of the dense kernels used inside the supernodes
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	explicit SparseCholesky(CholeskyImpl impl = CholeskyImpl::AUTO, SparseOrdering ordering = SparseOrdering::AMD)
+		: m_ordering(ordering)
+	{
+		if (!isSupported(impl))
+			throw std::runtime_error("SparseCholesky: instruction set not supported by this CPU");
+		m_kernels = CholeskyKernels<T>::select(kernelImpl(impl));
+	}
+
+	/// Ordering and symbolic analysis, reads only the pattern of A
+	void analyze(const SparseMatrix<T> & A) { m_symbolic = sparseAnalyze(A, m_ordering); }
+
+	/// Numeric factorization of A, which must have the pattern given to analyze()
+	/// Returns false if A is not positive definite
+	bool factorize(const SparseMatrix<T> & A)
+	{
+		assert(A.rows == m_symbolic.n && (size_t)A.nonZeros() == m_symbolic.entryPos.size());
+		return sparseFactorize(m_symbolic, A, m_L, m_work, m_kernels);
+	}
+
+	bool compute(const SparseMatrix<T> & A)
+	{
+		analyze(A);
+		return factorize(A);
+	}
+
+	/// Solves A x = b in place, using the factor of the last factorize() call
+	void solve(std::vector<T> & b)
+	{
+		assert((int)b.size() == m_symbolic.n);
+		sparseSolve(m_symbolic, m_L, &b[0], m_work, m_kernels);
+	}
+
+	const SparseSymbolic & getSymbolic() const { return m_symbolic; }
+	size_t nonZerosL() const { return m_symbolic.nonZerosL; }
+
+	/// L of P A P^T as a dense matrix, for checks on small problems
+	Matrix<T> getCholeskyMatrix() const
+	{
+		const SparseSymbolic & S = m_symbolic;
+		Matrix<T> chol = SparseMatrix<T>(S.n, S.n).toDense();
+		for (int s = 0; s < S.numSupernodes(); s++)
+		{
+			const T * Ls = &m_L[S.superValPtr[s]];
+			for (int r = 0; r < S.superNumRows(s); r++)
+				for (int c = 0; c < S.superCols(s); c++)
+				{
+					int i = S.superRows[S.superRowPtr[s] + r];
+					int j = S.superStart[s] + c;
+					if (i >= j)
+						chol(i, j) = Ls[r * S.superStride(s) + c];
+				}
+		}
+		return chol;
+	}
+
+private:
+	SparseOrdering m_ordering;
+	CholeskyKernels<T> m_kernels;
+	SparseSymbolic m_symbolic;
+	std::vector<T> m_L; // supernodes, see SparseSymbolic
+	std::vector<T> m_work; // update and solve scratch
+};
+
+}
+#endif
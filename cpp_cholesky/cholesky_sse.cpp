@@ -1,11 +1,11 @@
 #include <xmmintrin.h> //SSE
 #include <pmmintrin.h> //SSE3 for hadd
 
-#include "cholesky.hpp"
+#include "cholesky_kernels.hpp"
 
 // Assumes the machine has SSE/SSE3 instructions
-// If you are not sure of this (i.e. you run on very old machines), 
-// you may wish to add runtime checks around this code
+// Cholesky only selects these kernels when cpuFeatures() reports SSE3, see cpu_features.hpp
+// Rows of a Matrix are 16-byte aligned, but blocks starting at arbitrary columns are not, hence unaligned loads
 
 namespace linalg{
 
@@ -22,10 +22,10 @@ namespace linalg{
 		{	
 			__m128 lane[4];
 			// computes u[i] * v[i] * d[i]
-			lane[0] = _mm_mul_ps(_mm_mul_ps(_mm_load_ps(u + i * 16), _mm_load_ps(v + i * 16)), _mm_load_ps(d + i * 16));
-			lane[1] = _mm_mul_ps(_mm_mul_ps(_mm_load_ps(u + i * 16 + 4), _mm_load_ps(v + i * 16 + 4)), _mm_load_ps(d + i * 16 + 4));
-			lane[2] = _mm_mul_ps(_mm_mul_ps(_mm_load_ps(u + i * 16 + 8), _mm_load_ps(v + i * 16 + 8)), _mm_load_ps(d + i * 16 + 8));
-			lane[3] = _mm_mul_ps(_mm_mul_ps(_mm_load_ps(u + i * 16 + 12), _mm_load_ps(v + i * 16 + 12)), _mm_load_ps(d + i * 16 + 12));
+			lane[0] = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(u + i * 16), _mm_loadu_ps(v + i * 16)), _mm_loadu_ps(d + i * 16));
+			lane[1] = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(u + i * 16 + 4), _mm_loadu_ps(v + i * 16 + 4)), _mm_loadu_ps(d + i * 16 + 4));
+			lane[2] = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(u + i * 16 + 8), _mm_loadu_ps(v + i * 16 + 8)), _mm_loadu_ps(d + i * 16 + 8));
+			lane[3] = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(u + i * 16 + 12), _mm_loadu_ps(v + i * 16 + 12)), _mm_loadu_ps(d + i * 16 + 12));
 
 			lane[0] = _mm_add_ps(lane[0], lane[1]);
 			lane[2] = _mm_add_ps(lane[2], lane[3]);
@@ -37,9 +37,9 @@ namespace linalg{
 		__m128 singleLane = _mm_setzero_ps();
 		for (int it = 0; it < groups_4; it++)
 		{
-			__m128 a1 = _mm_load_ps(u + 16 * groups_16 + 4 * it);
-			__m128 b1 = _mm_load_ps(v + 16 * groups_16 + 4 * it);
-			__m128 c1 = _mm_load_ps(d + 16 * groups_16 + 4 * it);
+			__m128 a1 = _mm_loadu_ps(u + 16 * groups_16 + 4 * it);
+			__m128 b1 = _mm_loadu_ps(v + 16 * groups_16 + 4 * it);
+			__m128 c1 = _mm_loadu_ps(d + 16 * groups_16 + 4 * it);
 			singleLane = _mm_add_ps(singleLane, _mm_mul_ps(_mm_mul_ps(a1, b1),c1));
 		}
 		result = _mm_add_ps(result, singleLane);
@@ -56,5 +56,227 @@ namespace linalg{
 		return acc;
     }
 
+	float sum2VecProductSSE(const float * u, const float * v, int size)
+	{
+		float acc = 0;
+		int groups_4 = size / 4;
+		// Two accumulators hide the latency of the additions
+		__m128 lane0 = _mm_setzero_ps();
+		__m128 lane1 = _mm_setzero_ps();
+		int it = 0;
+		for (; it + 1 < groups_4; it += 2)
+		{
+			lane0 = _mm_add_ps(lane0, _mm_mul_ps(_mm_loadu_ps(u + 4 * it), _mm_loadu_ps(v + 4 * it)));
+			lane1 = _mm_add_ps(lane1, _mm_mul_ps(_mm_loadu_ps(u + 4 * it + 4), _mm_loadu_ps(v + 4 * it + 4)));
+		}
+		if (it < groups_4)
+			lane0 = _mm_add_ps(lane0, _mm_mul_ps(_mm_loadu_ps(u + 4 * it), _mm_loadu_ps(v + 4 * it)));
+		__m128 result = _mm_add_ps(lane0, lane1);
+		result = _mm_hadd_ps(result, result);
+		result = _mm_hadd_ps(result, result);
+		_mm_store_ss(&acc, result);
+
+		for (int i = groups_4 * 4; i < size; i++)
+			acc += u[i] * v[i];
+		return acc;
+	}
+
+	void axpySubSSE(float a, const float * x, float * y, int size)
+	{
+		__m128 a4 = _mm_set1_ps(a);
+		int i = 0;
+		for (; i + 4 <= size; i += 4)
+			_mm_storeu_ps(y + i, _mm_sub_ps(_mm_loadu_ps(y + i), _mm_mul_ps(a4, _mm_loadu_ps(x + i))));
+		for (; i < size; i++)
+			y[i] -= a * x[i];
+	}
+
+	// Computes C -= A * B for MR rows of A against a packed panel B (k x n, row-major), 8 columns at a time
+	template<int MR>
+	static inline void gemmSubRowsSSE(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int n, int k)
+	{
+		int j = 0;
+		for (; j + 8 <= n; j += 8)
+		{
+			__m128 acc0[MR], acc1[MR];
+			for (int r = 0; r < MR; r++)
+			{
+				acc0[r] = _mm_setzero_ps();
+				acc1[r] = _mm_setzero_ps();
+			}
+			for (int p = 0; p < k; p++)
+			{
+				__m128 b0 = _mm_loadu_ps(B + p * ldb + j);
+				__m128 b1 = _mm_loadu_ps(B + p * ldb + j + 4);
+				for (int r = 0; r < MR; r++)
+				{
+					__m128 a = _mm_set1_ps(A[r * lda + p]);
+					acc0[r] = _mm_add_ps(acc0[r], _mm_mul_ps(a, b0));
+					acc1[r] = _mm_add_ps(acc1[r], _mm_mul_ps(a, b1));
+				}
+			}
+			for (int r = 0; r < MR; r++)
+			{
+				float * c = C + r * ldc + j;
+				_mm_storeu_ps(c, _mm_sub_ps(_mm_loadu_ps(c), acc0[r]));
+				_mm_storeu_ps(c + 4, _mm_sub_ps(_mm_loadu_ps(c + 4), acc1[r]));
+			}
+		}
+		for (; j < n; j++)
+			for (int r = 0; r < MR; r++)
+			{
+				float sum = 0;
+				for (int p = 0; p < k; p++)
+					sum += A[r * lda + p] * B[p * ldb + j];
+				C[r * ldc + j] -= sum;
+			}
+	}
+
+	void gemmSubSSE(const float * A, int lda, const float * B, int ldb, float * C, int ldc, int m, int n, int k)
+	{
+		int i = 0;
+		for (; i + 4 <= m; i += 4)
+			gemmSubRowsSSE<4>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+		for (; i < m; i++)
+			gemmSubRowsSSE<1>(A + i * lda, lda, B, ldb, C + i * ldc, ldc, n, k);
+	}
+
+	// 4 sums in one register, lane r holding the sum of a[r]
+	static inline __m128 horizontalSum4SSE(const __m128 * a)
+	{
+		return _mm_hadd_ps(_mm_hadd_ps(a[0], a[1]), _mm_hadd_ps(a[2], a[3]));
+	}
+
+	// out[r] = rows[r * stride + k] * v[k] (* d[k]) summed over k, for R rows
+	// v (times d) is loaded once per step for all rows and every row has its own accumulator
+	template<int R, bool D>
+	static inline void dotRowsSSE(const float * rows, int stride, const float * v, const float * d, int size, float * out)
+	{
+		__m128 acc[R];
+		for (int r = 0; r < R; r++)
+			acc[r] = _mm_setzero_ps();
+		int k = 0;
+		for (; k + 4 <= size; k += 4)
+		{
+			__m128 b = _mm_loadu_ps(v + k);
+			if (D)
+				b = _mm_mul_ps(b, _mm_loadu_ps(d + k));
+			for (int r = 0; r < R; r++)
+				acc[r] = _mm_add_ps(acc[r], _mm_mul_ps(_mm_loadu_ps(rows + r * stride + k), b));
+		}
+		for (int r = 0; r + 4 <= R; r += 4)
+			_mm_storeu_ps(out + r, horizontalSum4SSE(acc + r));
+		if (R < 4)
+			for (int r = 0; r < R; r++)
+			{
+				__m128 sum = _mm_hadd_ps(acc[r], acc[r]);
+				out[r] = _mm_cvtss_f32(_mm_hadd_ps(sum, sum));
+			}
+		for (; k < size; k++)
+		{
+			float b = D ? v[k] * d[k] : v[k];
+			for (int r = 0; r < R; r++)
+				out[r] += rows[r * stride + k] * b;
+		}
+	}
+
+	template<bool D>
+	static inline void dotRowsSSE(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		int r = 0;
+		for (; r + 8 <= numRows; r += 8)
+			dotRowsSSE<8, D>(rows + r * stride, stride, v, d, size, out + r);
+		if (r + 4 <= numRows)
+		{
+			dotRowsSSE<4, D>(rows + r * stride, stride, v, d, size, out + r);
+			r += 4;
+		}
+		for (; r < numRows; r++)
+			dotRowsSSE<1, D>(rows + r * stride, stride, v, d, size, out + r);
+	}
+
+	void sum2VecProductRowsSSE(const float * rows, int stride, const float * v, int size, int numRows, float * out)
+	{
+		dotRowsSSE<false>(rows, stride, v, NULL, size, numRows, out);
+	}
+
+	void sum3VecProductRowsSSE(const float * rows, int stride, const float * v, const float * d, int size, int numRows, float * out)
+	{
+		dotRowsSSE<true>(rows, stride, v, d, size, numRows, out);
+	}
+
+
+	// Transposes, tile by tile in registers, see transpose.cpp
+	void transposeSSE(const float * src, int lds, float * dst, int ldd, int rows, int cols)
+	{
+		for (int i = 0; i < rows; i += 4)
+			for (int j = 0; j < cols; j += 4)
+			{
+				const float * s = src + (size_t)i * lds + j;
+				__m128 r0 = _mm_loadu_ps(s);
+				__m128 r1 = _mm_loadu_ps(s + lds);
+				__m128 r2 = _mm_loadu_ps(s + 2 * lds);
+				__m128 r3 = _mm_loadu_ps(s + 3 * lds);
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				float * d = dst + (size_t)j * ldd + i;
+				_mm_storeu_ps(d, r0);
+				_mm_storeu_ps(d + ldd, r1);
+				_mm_storeu_ps(d + 2 * ldd, r2);
+				_mm_storeu_ps(d + 3 * ldd, r3);
+			}
+	}
+
+	void transposeSwapSSE(float * a, float * b, int ld, int rows, int cols)
+	{
+		for (int i = 0; i < rows; i += 4)
+			for (int j = 0; j < (a == b ? i + 4 : cols); j += 4)
+			{
+				float * ta = a + (size_t)i * ld + j;
+				float * tb = b + (size_t)j * ld + i;
+				__m128 a0 = _mm_loadu_ps(ta), a1 = _mm_loadu_ps(ta + ld), a2 = _mm_loadu_ps(ta + 2 * ld), a3 = _mm_loadu_ps(ta + 3 * ld);
+				__m128 b0 = _mm_loadu_ps(tb), b1 = _mm_loadu_ps(tb + ld), b2 = _mm_loadu_ps(tb + 2 * ld), b3 = _mm_loadu_ps(tb + 3 * ld);
+				_MM_TRANSPOSE4_PS(a0, a1, a2, a3);
+				_MM_TRANSPOSE4_PS(b0, b1, b2, b3);
+				_mm_storeu_ps(tb, a0);
+				_mm_storeu_ps(tb + ld, a1);
+				_mm_storeu_ps(tb + 2 * ld, a2);
+				_mm_storeu_ps(tb + 3 * ld, a3);
+				_mm_storeu_ps(ta, b0);
+				_mm_storeu_ps(ta + ld, b1);
+				_mm_storeu_ps(ta + 2 * ld, b2);
+				_mm_storeu_ps(ta + 3 * ld, b3);
+			}
+	}
+
+	void transposeSSE(const double * src, int lds, double * dst, int ldd, int rows, int cols)
+	{
+		for (int i = 0; i < rows; i += 2)
+			for (int j = 0; j < cols; j += 2)
+			{
+				const double * s = src + (size_t)i * lds + j;
+				__m128d r0 = _mm_loadu_pd(s);
+				__m128d r1 = _mm_loadu_pd(s + lds);
+				double * d = dst + (size_t)j * ldd + i;
+				_mm_storeu_pd(d, _mm_unpacklo_pd(r0, r1));
+				_mm_storeu_pd(d + ldd, _mm_unpackhi_pd(r0, r1));
+			}
+	}
+
+	void transposeSwapSSE(double * a, double * b, int ld, int rows, int cols)
+	{
+		for (int i = 0; i < rows; i += 2)
+			for (int j = 0; j < (a == b ? i + 2 : cols); j += 2)
+			{
+				double * ta = a + (size_t)i * ld + j;
+				double * tb = b + (size_t)j * ld + i;
+				__m128d a0 = _mm_loadu_pd(ta), a1 = _mm_loadu_pd(ta + ld);
+				__m128d b0 = _mm_loadu_pd(tb), b1 = _mm_loadu_pd(tb + ld);
+				_mm_storeu_pd(tb, _mm_unpacklo_pd(a0, a1));
+				_mm_storeu_pd(tb + ld, _mm_unpackhi_pd(a0, a1));
+				_mm_storeu_pd(ta, _mm_unpacklo_pd(b0, b1));
+				_mm_storeu_pd(ta + ld, _mm_unpackhi_pd(b0, b1));
+			}
+	}
+
 }
       
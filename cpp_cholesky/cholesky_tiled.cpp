@@ -0,0 +1,121 @@
+#include <algorithm>
+
+#include "cholesky.hpp"
+
+// Task-parallel tiled Cholesky, as in PLASMA (Buttari et al., "A class of parallel tiled linear algebra
+// algorithms for multicore architectures", 2009)
+// The lower triangle is split into tileSize x tileSize tiles and every tile (i, j), j <= i, sees
+//   - updates k = 0..j-1: SYRK when i == j, GEMM otherwise, using the final tiles (i, k) and (j, k)
+//   - one final operation: POTRF when i == j, TRSM against tile (j, j) otherwise
+// Updates of the same tile are chained in order of k, so every run produces the same result
+// Each task counts its unfinished inputs and is spawned by whichever task completes the last one
+
+namespace linalg{
+
+namespace {
+
+	template<typename T>
+	class TiledCholesky
+	{
+	public:
+		TiledCholesky(MatrixView<T> A, T * diag, int tileSize, WorkStealingPool & pool, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+			: m_A(A), m_diag(diag), m_tileSize(tileSize), m_pool(pool), m_work(work), m_kernels(kernels),
+			m_numTiles((A.rows + tileSize - 1) / tileSize),
+			m_finalDeps(m_numTiles * m_numTiles), m_updateBase(m_numTiles * m_numTiles)
+		{
+			int nt = m_numTiles;
+			int numUpdates = 0;
+			for (int i = 0; i < nt; i++)
+				for (int j = 0; j <= i; j++)
+				{
+					m_finalDeps[i * nt + j].store((i == j ? 0 : 1) + (j > 0 ? 1 : 0));
+					m_updateBase[i * nt + j] = numUpdates;
+					numUpdates += j;
+				}
+
+			m_updateDeps = std::vector<std::atomic<int>>(numUpdates);
+			for (int i = 0; i < nt; i++)
+				for (int j = 0; j <= i; j++)
+					for (int k = 0; k < j; k++)
+						m_updateDeps[m_updateBase[i * nt + j] + k].store((i == j ? 1 : 2) + (k > 0 ? 1 : 0));
+
+			work.resize((size_t)pool.size() * tileSize * tileSize);
+		}
+
+		void run()
+		{
+			m_pool.spawn(0, [this](int worker) { finalTask(worker, 0, 0); });
+			m_pool.wait();
+		}
+
+	private:
+		int begin(int t) const { return t * m_tileSize; }
+		int end(int t) const { return std::min((t + 1) * m_tileSize, m_A.rows); }
+
+		void releaseFinal(int worker, int i, int j)
+		{
+			if (--m_finalDeps[i * m_numTiles + j] == 0)
+				m_pool.spawn(worker, [this, i, j](int w) { finalTask(w, i, j); });
+		}
+
+		void releaseUpdate(int worker, int i, int j, int k)
+		{
+			if (--m_updateDeps[m_updateBase[i * m_numTiles + j] + k] == 0)
+				m_pool.spawn(worker, [this, i, j, k](int w) { updateTask(w, i, j, k); });
+		}
+
+		// POTRF of tile (j, j) or TRSM of tile (i, j)
+		void finalTask(int worker, int i, int j)
+		{
+			if (i == j)
+			{
+				factorDiagonalBlock(m_A, m_diag, begin(j), end(j), m_kernels);
+				for (int m = j + 1; m < m_numTiles; m++)
+					releaseFinal(worker, m, j);
+				return;
+			}
+
+			solvePanel(m_A, m_diag, begin(i), end(i), begin(j), end(j), m_kernels);
+			// Tile (i, j) is an input to every update of row i and column i with panel j
+			for (int m = j + 1; m <= i; m++)
+				releaseUpdate(worker, i, m, j);
+			for (int m = i + 1; m < m_numTiles; m++)
+				releaseUpdate(worker, m, i, j);
+		}
+
+		// Tile (i, j) -= tile (i, k) * tile (j, k)^T
+		void updateTask(int worker, int i, int j, int k)
+		{
+			MatrixView<T> packed(&m_work[(size_t)worker * m_tileSize * m_tileSize], m_tileSize, m_tileSize, m_tileSize);
+			updateBlock(m_A, m_diag, packed, begin(i), end(i), begin(j), end(j), begin(k), end(k), m_kernels);
+			if (k + 1 == j)
+				releaseFinal(worker, i, j);
+			else
+				releaseUpdate(worker, i, j, k + 1);
+		}
+
+		MatrixView<T> m_A;
+		T * m_diag;
+		int m_tileSize;
+		WorkStealingPool & m_pool;
+		std::vector<T> & m_work; // per worker scratch for packing the transposed tile
+		const CholeskyKernels<T> & m_kernels;
+		int m_numTiles;
+		std::vector<std::atomic<int>> m_finalDeps;
+		std::vector<int> m_updateBase;
+		std::vector<std::atomic<int>> m_updateDeps;
+	};
+
+}
+
+	template<typename T>
+	void tiledCholesky(MatrixView<T> A, T * diag, int tileSize, WorkStealingPool & pool, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		tileSize = std::min(tileSize, CHOLESKY_MAX_BLOCK_SIZE);
+		TiledCholesky<T>(A, diag, tileSize, pool, work, kernels).run();
+	}
+
+	template void tiledCholesky<float>(MatrixView<float>, float *, int, WorkStealingPool &, std::vector<float> &, const CholeskyKernels<float> &);
+	template void tiledCholesky<double>(MatrixView<double>, double *, int, WorkStealingPool &, std::vector<double> &, const CholeskyKernels<double> &);
+
+}
@@ -0,0 +1,125 @@
+#include <algorithm>
+
+#include "cholesky.hpp"
+
+// Rank-k update and downdate of a stored factor: finds the factor of A + sign * V V^T in O(k n^2)
+// LL^T uses the hyperbolic/Givens rotation form, see e.g. Seeger, "Low rank updates for the Cholesky
+// decomposition", 2004; LDL^T uses method C1 of Gill, Golub, Murray & Saunders, "Methods for modifying
+// matrix factorizations", 1974
+// Both are usually written column by column, which walks L along its columns. Here each row of L is
+// brought up to date in turn instead: row i only needs the rotations of the columns left of it, which
+// were fixed when the rows above were processed. Rows are handled 8 at a time with the 8x8 tile of L
+// transposed in AVX registers (scalar loops without AVX), and up to CHOLESKY_UPDATE_VECS vectors are applied per pass over L,
+// so a rank-k update reads and writes the factor k / CHOLESKY_UPDATE_VECS times instead of k times
+
+namespace linalg{
+
+	// Rotation parameters per vector j, column k: params[(j * numParams + q) * n + k]
+	// LL^T: 1 / c, sign * sn / c, c, sn; LDL^T: p, b
+	template<typename T>
+	static inline void applyLLt(T & l, T & x, const T * p, int n)
+	{
+		l = l * p[0] + p[n] * x;
+		x = p[2 * n] * x - p[3 * n] * l;
+	}
+
+	template<typename T>
+	static inline void applyLDLt(T & l, T & x, const T * p, int n)
+	{
+		x -= p[0] * l;
+		l += p[n] * x;
+	}
+
+	template<typename T>
+	static bool updateSweep(MatrixView<T> L, T * diag, MatrixView<const T> V, int j0, int numVecs, T sign, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		int n = L.rows;
+		int stride = L.stride;
+		bool ldlt = (diag != NULL);
+		int numParams = ldlt ? 2 : 4;
+		work.resize((size_t)numVecs * numParams * n);
+		T * params = &work[0];
+		// Carried vector entries of the 8 rows in flight, x[j * 8 + r]
+		T x[CHOLESKY_UPDATE_VECS * 8];
+		// LDL^T scaling of each vector, starts at sign
+		T alpha[CHOLESKY_UPDATE_VECS];
+		for (int j = 0; j < numVecs; j++)
+			alpha[j] = sign;
+
+		for (int i0 = 0; i0 < n; i0 += 8)
+		{
+			int rows = std::min(8, n - i0);
+			for (int j = 0; j < numVecs; j++)
+				for (int r = 0; r < 8; r++)
+					x[j * 8 + r] = r < rows ? V(i0 + r, j0 + j) : 0;
+
+			// Columns left of the block, all parameters are known
+			if (rows == 8 && kernels.updateRows)
+				kernels.updateRows(&L.data[i0 * stride], stride, i0, x, numVecs, params, n, ldlt);
+			else
+				for (int r = 0; r < rows; r++)
+					for (int j = 0; j < numVecs; j++)
+						for (int k = 0; k < i0; k++)
+							if (ldlt)
+								applyLDLt(L(i0 + r, k), x[j * 8 + r], &params[j * numParams * n + k], n);
+							else
+								applyLLt(L(i0 + r, k), x[j * 8 + r], &params[j * numParams * n + k], n);
+
+			// Triangle of the block, row by row, and the diagonal which sets the parameters of column i
+			for (int r = 0; r < rows; r++)
+			{
+				int i = i0 + r;
+				for (int j = 0; j < numVecs; j++)
+				{
+					T & xi = x[j * 8 + r];
+					T * pj = &params[j * numParams * n];
+					for (int k = i0; k < i; k++)
+						if (ldlt)
+							applyLDLt(L(i, k), xi, &pj[k], n);
+						else
+							applyLLt(L(i, k), xi, &pj[k], n);
+
+					if (ldlt)
+					{
+						T d = diag[i] + alpha[j] * xi * xi;
+						if (!(d > 0))
+							return false;
+						pj[i] = xi;
+						pj[n + i] = xi * alpha[j] / d;
+						alpha[j] = diag[i] * alpha[j] / d;
+						diag[i] = L(i, i) = d;
+					}
+					else
+					{
+						T r2 = L(i, i) * L(i, i) + sign * xi * xi;
+						if (!(r2 > 0))
+							return false;
+						T rr = std::sqrt(r2);
+						T c = rr / L(i, i);
+						T sn = xi / L(i, i);
+						pj[i] = 1 / c;
+						pj[n + i] = sign * sn / c;
+						pj[2 * n + i] = c;
+						pj[3 * n + i] = sn;
+						L(i, i) = rr;
+					}
+				}
+			}
+		}
+		return true;
+	}
+
+	template<typename T>
+	bool choleskyUpdate(MatrixView<T> L, T * diag, MatrixView<const T> V, T sign, std::vector<T> & work, const CholeskyKernels<T> & kernels)
+	{
+		assert(V.rows == L.rows);
+		for (int j0 = 0; j0 < V.cols; j0 += CHOLESKY_UPDATE_VECS)
+			if (!updateSweep(L, diag, V, j0, std::min(CHOLESKY_UPDATE_VECS, V.cols - j0), sign, work, kernels))
+				return false;
+		return true;
+	}
+
+	template bool choleskyUpdate<float>(MatrixView<float>, float *, MatrixView<const float>, float, std::vector<float> &, const CholeskyKernels<float> &);
+	template bool choleskyUpdate<double>(MatrixView<double>, double *, MatrixView<const double>, double, std::vector<double> &, const CholeskyKernels<double> &);
+
+}
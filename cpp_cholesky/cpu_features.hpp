@@ -0,0 +1,80 @@
+#ifndef _LINALG_CPU_FEATURES_HPP_
+#define _LINALG_CPU_FEATURES_HPP_
+
+#include <cpuid.h>
+#include <iostream>
+
+// Runtime detection of the SIMD instruction sets, so that one binary can choose the widest kernels
+// a machine supports and never executes instructions an older machine does not have
+// AVX and AVX-512 also need the OS to save the wider registers on context switches, checked with xgetbv
+
+namespace linalg{
+
+	struct CpuFeatures
+	{
+		bool sse3;
+		bool sse41;
+		bool popcnt;
+		bool avx;
+		bool f16c;
+		bool fma;
+		bool avx2;
+		bool avx512f;
+	};
+
+namespace util {
+
+	static inline unsigned long long readXCR0()
+	{
+		unsigned int lo, hi;
+		// xgetbv, encoded as bytes so that no -mxsave flag is needed
+		__asm__ volatile(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+		return ((unsigned long long)hi << 32) | lo;
+	}
+
+	static inline CpuFeatures detectCpuFeatures()
+	{
+		CpuFeatures f = {};
+		unsigned int eax, ebx, ecx, edx;
+		if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+			return f;
+
+		f.sse3 = (ecx & bit_SSE3) != 0;
+		f.sse41 = (ecx & bit_SSE4_1) != 0;
+		f.popcnt = (ecx & bit_POPCNT) != 0;
+
+		unsigned long long xcr0 = (ecx & bit_OSXSAVE) ? readXCR0() : 0;
+		bool ymmState = (xcr0 & 0x6) == 0x6;   // SSE and AVX state
+		bool zmmState = (xcr0 & 0xE6) == 0xE6; // plus opmask and both halves of the ZMM registers
+
+		f.avx = (ecx & bit_AVX) && ymmState;
+		f.f16c = f.avx && (ecx & bit_F16C);
+		f.fma = f.avx && (ecx & bit_FMA);
+
+		if (__get_cpuid_max(0, NULL) >= 7)
+		{
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			f.avx2 = f.avx && (ebx & bit_AVX2);
+			f.avx512f = zmmState && (ebx & bit_AVX512F);
+		}
+		return f;
+	}
+}
+
+	/// Features of the machine running the program, detected once
+	inline const CpuFeatures & cpuFeatures()
+	{
+		static const CpuFeatures features = util::detectCpuFeatures();
+		return features;
+	}
+
+	inline void printCpuFeatures(std::ostream & os)
+	{
+		const CpuFeatures & f = cpuFeatures();
+		os << "CPU features:" << (f.sse3 ? " SSE3" : "") << (f.sse41 ? " SSE4.1" : "") << (f.popcnt ? " POPCNT" : "")
+			<< (f.avx ? " AVX" : "") << (f.f16c ? " F16C" : "") << (f.fma ? " FMA" : "") << (f.avx2 ? " AVX2" : "")
+			<< (f.avx512f ? " AVX-512F" : "") << std::endl;
+	}
+
+}
+#endif
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "matrix.hpp"
+#include "cpu_features.hpp"
+#include "cholesky_kernels.hpp"
+#include "cpp_benchmark/perf_counters.hpp"
+
+// Cache-blocked GEMM with packed panels, see Goto & van de Geijn, "Anatomy of high-performance matrix
+// multiplication", 2008
+//   for every NC columns of B (L3):
+//     for every KC rows of B: pack the KC x NC panel of B into NR-column strips
+//       for every MC rows of op(A) (L2): pack the MC x KC block of op(A) into MR-row strips
+//         for every NR x MR tile of C: micro-kernel, both operands streamed contiguously from the packed copies
+// Packing also takes care of the transposition of A for A^T B and of the zero padding of partial tiles,
+// so the micro-kernel only ever sees full MR x NR tiles. Partial tiles of C go through a local buffer
+// Threads take disjoint bands of rows of C, each with its own packed copies; for the lower triangle the
+// bands are of equal area rather than of equal height
+
+namespace linalg{
+
+	template<typename T>
+	struct GemmBlocking;
+
+	template<>
+	struct GemmBlocking<float>
+	{
+		static const int NR = GEMM_NR_FLOAT;
+		static const int MC = 120;
+		static const int KC = 256;
+		static const int NC = 3072;
+	};
+
+	template<>
+	struct GemmBlocking<double>
+	{
+		static const int NR = GEMM_NR_DOUBLE;
+		static const int MC = 96;
+		static const int KC = 256;
+		static const int NC = 2048;
+	};
+
+	template<typename T>
+	using GemmMicro = void (*)(int kc, const T * Ap, const T * Bp, T * C, int ldc, bool accumulate);
+
+	// Plain C++ micro-kernel for machines without AVX
+	template<typename T>
+	static void gemmMicroCPP(int kc, const T * Ap, const T * Bp, T * C, int ldc, bool accumulate)
+	{
+		const int NR = GemmBlocking<T>::NR;
+		T c[GEMM_MR][NR] = {};
+		for (int p = 0; p < kc; p++)
+			for (int r = 0; r < GEMM_MR; r++)
+				for (int j = 0; j < NR; j++)
+					c[r][j] += Ap[p * GEMM_MR + r] * Bp[p * NR + j];
+		for (int r = 0; r < GEMM_MR; r++)
+			for (int j = 0; j < NR; j++)
+				C[r * ldc + j] = accumulate ? C[r * ldc + j] + c[r][j] : c[r][j];
+	}
+
+	template<typename T>
+	static GemmMicro<T> selectMicroKernel()
+	{
+		const CpuFeatures & f = cpuFeatures();
+		if (f.fma && f.avx2)
+			return &gemmMicroFMA;
+		if (f.avx)
+			return &gemmMicroAVX;
+		return &gemmMicroCPP<T>;
+	}
+
+	// Rows ic .. ic + mc - 1, columns pc .. pc + kc - 1 of op(A) as MR-row strips, Ap[strip][p][r]
+	template<typename T>
+	static void packA(bool transA, const T * A, int lda, int ic, int mc, int pc, int kc, T * Ap)
+	{
+		for (int i0 = 0; i0 < mc; i0 += GEMM_MR)
+		{
+			int rows = std::min(GEMM_MR, mc - i0);
+			T * strip = Ap + i0 * kc;
+			for (int p = 0; p < kc; p++)
+				for (int r = 0; r < GEMM_MR; r++)
+				{
+					int i = ic + i0 + r;
+					strip[p * GEMM_MR + r] = r >= rows ? 0 : transA ? A[(size_t)(pc + p) * lda + i] : A[(size_t)i * lda + pc + p];
+				}
+		}
+	}
+
+	// Rows pc .. pc + kc - 1, columns jc .. jc + nc - 1 of B as NR-column strips, Bp[strip][p][j]
+	template<typename T>
+	static void packB(const T * B, int ldb, int pc, int kc, int jc, int nc, T * Bp)
+	{
+		const int NR = GemmBlocking<T>::NR;
+		for (int j0 = 0; j0 < nc; j0 += NR)
+		{
+			int cols = std::min(NR, nc - j0);
+			T * strip = Bp + j0 * kc;
+			for (int p = 0; p < kc; p++)
+			{
+				const T * row = B + (size_t)(pc + p) * ldb + jc + j0;
+				for (int j = 0; j < NR; j++)
+					strip[p * NR + j] = j < cols ? row[j] : 0;
+			}
+		}
+	}
+
+	// Rows r0 .. r1 - 1 of C
+	template<typename T>
+	static void gemmRows(GemmMicro<T> micro, bool transA, bool lower, int r0, int r1, int n, int k, const T * A, int lda, const T * B, int ldb, T * C, int ldc)
+	{
+		typedef GemmBlocking<T> Blk;
+		const int NR = Blk::NR;
+		// Columns right of the last row are above the diagonal
+		if (lower)
+			n = std::min(n, r1);
+		if (r1 <= r0 || n <= 0)
+			return;
+		BENCH_COUNTERS_SCOPE("gemm");
+		T * Ap = util::alignedCalloc<T>(Blk::MC * Blk::KC, sizeof(T), MEM_ALIGNMENT);
+		T * Bp = util::alignedCalloc<T>((Blk::NC + NR) * Blk::KC, sizeof(T), MEM_ALIGNMENT);
+		T edge[GEMM_MR * NR];
+
+		for (int jc = 0; jc < n; jc += Blk::NC)
+		{
+			int nc = std::min(Blk::NC, n - jc);
+			for (int pc = 0; pc < k; pc += Blk::KC)
+			{
+				int kc = std::min(Blk::KC, k - pc);
+				bool accumulate = pc > 0;
+				packB(B, ldb, pc, kc, jc, nc, Bp);
+				for (int ic = r0; ic < r1; ic += Blk::MC)
+				{
+					int mc = std::min(Blk::MC, r1 - ic);
+					if (lower && jc > ic + mc - 1)
+						continue;
+					packA(transA, A, lda, ic, mc, pc, kc, Ap);
+					for (int jr = 0; jr < nc; jr += NR)
+					{
+						int col = jc + jr;
+						int cols = std::min(NR, nc - jr);
+						for (int ir = 0; ir < mc; ir += GEMM_MR)
+						{
+							int row = ic + ir;
+							int rows = std::min(GEMM_MR, mc - ir);
+							if (lower && col > row + rows - 1)
+								continue;
+							T * Cij = C + (size_t)row * ldc + col;
+							if (rows == GEMM_MR && cols == NR)
+							{
+								micro(kc, Ap + ir * kc, Bp + jr * kc, Cij, ldc, accumulate);
+								continue;
+							}
+							micro(kc, Ap + ir * kc, Bp + jr * kc, edge, NR, false);
+							for (int r = 0; r < rows; r++)
+								for (int j = 0; j < cols; j++)
+									Cij[r * ldc + j] = accumulate ? Cij[r * ldc + j] + edge[r * NR + j] : edge[r * NR + j];
+						}
+					}
+				}
+			}
+		}
+		free(Ap);
+		free(Bp);
+	}
+
+	template<typename T>
+	static void gemmImpl(bool transA, bool lower, int m, int n, int k, const T * A, int lda, const T * B, int ldb, T * C, int ldc, int numThreads)
+	{
+		assert(!lower || m == n);
+		static const GemmMicro<T> micro = selectMicroKernel<T>();
+		if (k == 0)
+		{
+			for (int i = 0; i < m; i++)
+				for (int j = 0; j < (lower ? i + 1 : n); j++)
+					C[(size_t)i * ldc + j] = 0;
+			return;
+		}
+		// No point in bands of less than one block of rows
+		numThreads = std::max(1, std::min(numThreads, (m + GemmBlocking<T>::MC - 1) / GemmBlocking<T>::MC));
+		if (numThreads == 1)
+		{
+			gemmRows(micro, transA, lower, 0, m, n, k, A, lda, B, ldb, C, ldc);
+			return;
+		}
+		// Band t ends at row m * t / T, or at m * sqrt(t / T) for equal parts of the triangle, in whole micro-tiles
+		std::vector<int> bounds(numThreads + 1, 0);
+		for (int t = 1; t <= numThreads; t++)
+		{
+			double f = (double)t / numThreads;
+			int r = (int)(m * (lower ? std::sqrt(f) : f));
+			bounds[t] = t == numThreads ? m : std::min(m, (r + GEMM_MR - 1) / GEMM_MR * GEMM_MR);
+		}
+		std::vector<std::thread> threads;
+		for (int t = 1; t < numThreads; t++)
+			threads.push_back(std::thread([=] { gemmRows(micro, transA, lower, bounds[t], bounds[t + 1], n, k, A, lda, B, ldb, C, ldc); }));
+		gemmRows(micro, transA, lower, bounds[0], bounds[1], n, k, A, lda, B, ldb, C, ldc);
+		for (std::thread & thread : threads)
+			thread.join();
+	}
+
+namespace util {
+
+	void gemm(bool transA, bool lower, int m, int n, int k, const float * A, int lda, const float * B, int ldb, float * C, int ldc, int numThreads)
+	{
+		gemmImpl(transA, lower, m, n, k, A, lda, B, ldb, C, ldc, numThreads);
+	}
+
+	void gemm(bool transA, bool lower, int m, int n, int k, const double * A, int lda, const double * B, int ldb, double * C, int ldc, int numThreads)
+	{
+		gemmImpl(transA, lower, m, n, k, A, lda, B, ldb, C, ldc, numThreads);
+	}
+
+}
+}
@@ -0,0 +1,69 @@
+#include <immintrin.h> //AVX2, FMA
+
+#include "cholesky_kernels.hpp"
+
+// Assumes the machine has AVX2 and FMA instructions, gemm.cpp only selects these kernels when cpuFeatures() reports both
+// GEMM_MR rows of two registers each: 12 accumulators, 2 registers of Bp and 1 broadcast of Ap out of 16,
+// enough independent FMAs per step to hide their latency
+
+namespace linalg{
+
+	void gemmMicroFMA(int kc, const float * Ap, const float * Bp, float * C, int ldc, bool accumulate)
+	{
+		__m256 c[GEMM_MR][2];
+		for (int r = 0; r < GEMM_MR; r++)
+			c[r][0] = c[r][1] = _mm256_setzero_ps();
+		for (int p = 0; p < kc; p++)
+		{
+			__m256 b0 = _mm256_load_ps(Bp + p * GEMM_NR_FLOAT);
+			__m256 b1 = _mm256_load_ps(Bp + p * GEMM_NR_FLOAT + 8);
+			for (int r = 0; r < GEMM_MR; r++)
+			{
+				__m256 a = _mm256_broadcast_ss(Ap + p * GEMM_MR + r);
+				c[r][0] = _mm256_fmadd_ps(a, b0, c[r][0]);
+				c[r][1] = _mm256_fmadd_ps(a, b1, c[r][1]);
+			}
+		}
+		for (int r = 0; r < GEMM_MR; r++)
+		{
+			float * Cr = C + r * ldc;
+			if (accumulate)
+			{
+				c[r][0] = _mm256_add_ps(c[r][0], _mm256_loadu_ps(Cr));
+				c[r][1] = _mm256_add_ps(c[r][1], _mm256_loadu_ps(Cr + 8));
+			}
+			_mm256_storeu_ps(Cr, c[r][0]);
+			_mm256_storeu_ps(Cr + 8, c[r][1]);
+		}
+	}
+
+	void gemmMicroFMA(int kc, const double * Ap, const double * Bp, double * C, int ldc, bool accumulate)
+	{
+		__m256d c[GEMM_MR][2];
+		for (int r = 0; r < GEMM_MR; r++)
+			c[r][0] = c[r][1] = _mm256_setzero_pd();
+		for (int p = 0; p < kc; p++)
+		{
+			__m256d b0 = _mm256_load_pd(Bp + p * GEMM_NR_DOUBLE);
+			__m256d b1 = _mm256_load_pd(Bp + p * GEMM_NR_DOUBLE + 4);
+			for (int r = 0; r < GEMM_MR; r++)
+			{
+				__m256d a = _mm256_broadcast_sd(Ap + p * GEMM_MR + r);
+				c[r][0] = _mm256_fmadd_pd(a, b0, c[r][0]);
+				c[r][1] = _mm256_fmadd_pd(a, b1, c[r][1]);
+			}
+		}
+		for (int r = 0; r < GEMM_MR; r++)
+		{
+			double * Cr = C + r * ldc;
+			if (accumulate)
+			{
+				c[r][0] = _mm256_add_pd(c[r][0], _mm256_loadu_pd(Cr));
+				c[r][1] = _mm256_add_pd(c[r][1], _mm256_loadu_pd(Cr + 4));
+			}
+			_mm256_storeu_pd(Cr, c[r][0]);
+			_mm256_storeu_pd(Cr + 4, c[r][1]);
+		}
+	}
+
+}
@@ -7,6 +7,9 @@
 #include <cstring> //for memcpy
 #include <iomanip>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <vector>
 
 #define MEM_ALIGNMENT 128 //upto AVX-512 code-friendly, valid values are 8,16,32,64,128
 
@@ -21,18 +24,34 @@
 namespace linalg{
 namespace util {
 
-	static unsigned int roundTo(unsigned int value, unsigned int roundTo)
+	static size_t roundTo(size_t value, size_t roundTo)
 	{
 		return (value + (roundTo - 1)) & ~(roundTo - 1);
 	}
 
+	// One counter for the whole program, inline rather than static so that all translation units share it
+	inline std::atomic<size_t> & allocationCounter()
+	{
+		static std::atomic<size_t> count(0);
+		return count;
+	}
+
+	/// Number of blocks alignedCalloc has requested from the system so far: storage of every Matrix,
+	/// PackedLowerMatrix, MatrixBatch and Arena, plus every operator new in a program that counts those too by
+	/// replacing the global operator new (testCholesky.cpp does). Flat across iterations once a loop reuses its memory
+	inline size_t allocationCount()
+	{
+		return allocationCounter().load();
+	}
+
 	template<typename T> 
-	static inline T * alignedCalloc(unsigned int n, size_t size, size_t alignment)
+	static inline T * alignedCalloc(size_t n, size_t size, size_t alignment)
 	{
 		void * mem;
 		mem = aligned_alloc(alignment, roundTo(n * size, alignment));
 		if (!mem)
 			throw std::bad_alloc();
+		allocationCounter()++;
 		return static_cast<T*>(mem);
 	}
 
@@ -45,9 +64,111 @@ namespace util {
 	}
 }
 
+// Bump allocator for Matrix storage and scratch: allocate() hands out MEM_ALIGNMENT aligned slices of one block
+// and reset() takes them all back at once, freeing is a no-op
+// Requests past the end of the block get a block of their own until the next reset(), which then grows the main
+// block to the high-water mark: a loop that resets the arena at the start of every iteration stops allocating after
+// its second one, whose reset() grows the block
+// Matrices built on an arena must not be used after its next reset()
+class Arena
+{
+public:
+	explicit Arena(size_t capacity = 0)
+	{
+		if (capacity)
+			grow(capacity);
+	}
+
+	~Arena()
+	{
+		releaseOverflow();
+		free(m_block);
+	}
+
+	Arena(const Arena &) = delete;
+	Arena & operator=(const Arena &) = delete;
+
+	template<typename T>
+	T * allocate(size_t n)
+	{
+		size_t bytes = (n * sizeof(T) + MEM_ALIGNMENT - 1) & ~(size_t)(MEM_ALIGNMENT - 1);
+		size_t offset = m_used;
+		m_used += bytes;
+		m_highWater = std::max(m_highWater, m_used);
+		if (m_used <= m_capacity)
+			return reinterpret_cast<T *>(m_block + offset);
+		m_overflow.push_back(util::alignedCalloc<char>(bytes, 1, MEM_ALIGNMENT));
+		return reinterpret_cast<T *>(m_overflow.back());
+	}
+
+	void reset()
+	{
+		if (!m_overflow.empty())
+		{
+			releaseOverflow();
+			free(m_block);
+			grow(m_highWater);
+		}
+		m_used = 0;
+	}
+
+	size_t used() const { return m_used; }
+	size_t capacity() const { return m_capacity; }
+
+private:
+	void grow(size_t capacity)
+	{
+		m_block = util::alignedCalloc<char>(capacity, 1, MEM_ALIGNMENT);
+		m_capacity = capacity;
+	}
+
+	void releaseOverflow()
+	{
+		for (char * block : m_overflow)
+			free(block);
+		m_overflow.clear();
+	}
+
+	char * m_block = NULL;
+	size_t m_capacity = 0;
+	size_t m_used = 0;
+	size_t m_highWater = 0;
+	std::vector<char *> m_overflow;
+};
+
+// Non-owning window on row-major storage: all of a Matrix, a sub-block of one, or a caller's buffer
+// Views are copied by value and never allocate or free, the storage must outlive them
+// Like a pointer, a const view still gives write access to the elements
+template<typename T>
+class MatrixView
+{
+public:
+	MatrixView(T * d, int r, int c, int s) : rows(r), cols(c), stride(s), data(d)
+	{
+		assert(stride >= cols);
+	}
+
+	/// r x c block starting at (r0, c0), sharing the storage and stride of this view
+	MatrixView block(int r0, int c0, int r, int c) const
+	{
+		assert(r0 >= 0 && c0 >= 0 && r0 + r <= rows && c0 + c <= cols);
+		return MatrixView(data + r0 * stride + c0, r, c, stride);
+	}
+
+	T & operator()(int r, int c) const { return data[r * stride + c]; }
+
+	int rows;
+	int cols;
+	int stride;
+
+	T * data;
+};
+
 // Data is stored row-wise, each row is padded to nearest multiple of 4
 // If a matrix has 3 cols, the fourth entry in first row is assumed to be padding
 // fifth entry is the first column of the second row
+// Storage comes from the heap, or from an Arena when one is given: it is then never freed by the matrix,
+// and later reallocations (assignment of a different size) come from the same arena
 template<typename T>
 class Matrix
 {
@@ -57,44 +178,225 @@ public:
 		data = linalg::util::alignedCalloc<T>(rows * stride, sizeof(T), MEM_ALIGNMENT);
 	}
 
+	Matrix(int r, int c, Arena & arena) : rows(r), cols(c), stride(util::getColStride(cols)), m_arena(&arena)
+	{
+		data = arena.allocate<T>(rows * stride);
+	}
+
 	Matrix(const Matrix & mat) : rows(mat.rows), cols(mat.cols), stride(mat.stride)
 	{
 		data = linalg::util::alignedCalloc<T>(mat.rows * mat.stride, sizeof(T), MEM_ALIGNMENT);
 		memcpy(data, mat.data, rows * stride * sizeof(T));
 	}
 
+	//Takes over the storage, mat is left empty (0 x 0, no data)
+	Matrix(Matrix && mat) noexcept : rows(mat.rows), cols(mat.cols), stride(mat.stride), data(mat.data), m_arena(mat.m_arena)
+	{
+		mat.rows = mat.cols = mat.stride = 0;
+		mat.data = 0;
+	}
+
 	~Matrix() 
 	{
-		free(data);
+		release();
 	}
 
+	//Reuses the storage when the shapes match, an empty (moved from) matrix gets new storage
 	Matrix & operator=(const Matrix & mat)
 	{
-		assert(this->rows == mat.rows);
-		assert(this->cols == mat.cols);
+		if (this == &mat)
+			return *this;
+		if (rows * stride != mat.rows * mat.stride)
+		{
+			release();
+			data = m_arena ? m_arena->allocate<T>(mat.rows * mat.stride) : linalg::util::alignedCalloc<T>(mat.rows * mat.stride, sizeof(T), MEM_ALIGNMENT);
+		}
+		rows = mat.rows;
+		cols = mat.cols;
+		stride = mat.stride;
 		memcpy(data, mat.data, rows * stride * sizeof(T));
         return *this;
 	}
 
-	//data can only be owned by one copy
-	Matrix & operator=(Matrix && mat)
+	//data can only be owned by one copy, mat is left empty
+	Matrix & operator=(Matrix && mat) noexcept
 	{
-        assert(rows == mat.rows);
-        assert(cols == mat.cols);
-        free(data);
+		if (this == &mat)
+			return *this;
+        release();
+		rows = mat.rows;
+		cols = mat.cols;
+		stride = mat.stride;
         data = mat.data;
+		m_arena = mat.m_arena;
+		mat.rows = mat.cols = mat.stride = 0;
         mat.data = 0;
         return *this;
 	}
 
 	T & operator()(int r, int c) { return data[r * stride + c]; }
 	const T & operator()(int r, int c) const { return data[r * stride + c]; }
+
+	MatrixView<T> view() { return MatrixView<T>(data, rows, cols, stride); }
+	MatrixView<const T> view() const { return MatrixView<const T>(data, rows, cols, stride); }
+	/// r x c block starting at (r0, c0)
+	MatrixView<T> block(int r0, int c0, int r, int c) { return view().block(r0, c0, r, c); }
 	
 	int rows;
 	int cols;
     int stride; // same as leading dimension (lda) in MKL/LAPACK terms
 
 	T * data;
+
+private:
+	void release()
+	{
+		if (!m_arena)
+			free(data);
+	}
+
+	Arena * m_arena = NULL; // NULL for heap storage
+};
+
+// Matrix whose size is known at compile time, stored on the stack without padding
+// Used for small systems where the heap allocation and runtime loop bounds of Matrix dominate
+template<typename T, int R, int C>
+class FixedMatrix
+{
+public:
+	enum { rows = R, cols = C };
+
+	FixedMatrix() {}
+
+	explicit FixedMatrix(const Matrix<T> & M)
+	{
+		assert(M.rows == R && M.cols == C);
+		for (int r = 0; r < R; r++)
+			for (int c = 0; c < C; c++)
+				data[r][c] = M(r, c);
+	}
+
+	Matrix<T> toMatrix() const
+	{
+		Matrix<T> M(R, C);
+		for (int r = 0; r < R; r++)
+			for (int c = 0; c < C; c++)
+				M(r, c) = data[r][c];
+		return M;
+	}
+
+	T & operator()(int r, int c) { return data[r][c]; }
+	const T & operator()(int r, int c) const { return data[r][c]; }
+
+	T data[R][C];
+};
+
+// Lower triangle of a symmetric or triangular n x n matrix, cut into tileSize x tileSize tiles
+// Tile (i, j), j <= i, is a contiguous row-major block of tileSize^2 elements and tiles are stored row after row,
+// so the matrix takes about n^2 / 2 elements instead of the n x stride of Matrix
+// Tiles on the last tile row/column are zero padded past n
+template<typename T>
+class PackedLowerMatrix
+{
+public:
+	PackedLowerMatrix(int n, int tileSize) : rows(n), cols(n), tileSize(tileSize), numTiles((n + tileSize - 1) / tileSize)
+	{
+		// Tile rows keep the 16-byte alignment of Matrix rows
+		assert(tileSize % 4 == 0);
+		data = linalg::util::alignedCalloc<T>(size(), sizeof(T), MEM_ALIGNMENT);
+		memset(data, 0, size() * sizeof(T));
+	}
+
+	PackedLowerMatrix(const Matrix<T> & M, int tileSize) : PackedLowerMatrix(M.rows, tileSize)
+	{
+		pack(M);
+	}
+
+	PackedLowerMatrix(const PackedLowerMatrix & P) : rows(P.rows), cols(P.cols), tileSize(P.tileSize), numTiles(P.numTiles)
+	{
+		data = linalg::util::alignedCalloc<T>(size(), sizeof(T), MEM_ALIGNMENT);
+		memcpy(data, P.data, size() * sizeof(T));
+	}
+
+	//Takes over the storage, P is left empty (0 x 0, no data)
+	PackedLowerMatrix(PackedLowerMatrix && P) noexcept : rows(P.rows), cols(P.cols), tileSize(P.tileSize), numTiles(P.numTiles), data(P.data)
+	{
+		P.rows = P.cols = P.numTiles = 0;
+		P.data = 0;
+	}
+
+	~PackedLowerMatrix()
+	{
+		free(data);
+	}
+
+	PackedLowerMatrix & operator=(const PackedLowerMatrix & P)
+	{
+		assert(rows == P.rows && tileSize == P.tileSize);
+		memcpy(data, P.data, size() * sizeof(T));
+		return *this;
+	}
+
+	//data can only be owned by one copy, takes over the shape of P, which is left empty
+	PackedLowerMatrix & operator=(PackedLowerMatrix && P) noexcept
+	{
+		if (this == &P)
+			return *this;
+		free(data);
+		rows = P.rows;
+		cols = P.cols;
+		tileSize = P.tileSize;
+		numTiles = P.numTiles;
+		data = P.data;
+		P.rows = P.cols = P.numTiles = 0;
+		P.data = 0;
+		return *this;
+	}
+
+	/// Copies the lower triangle of M, its upper triangle is not read
+	void pack(const Matrix<T> & M)
+	{
+		assert(M.rows == rows && M.cols == cols);
+		for (int r = 0; r < rows; r++)
+			for (int c = 0; c <= r; c++)
+				(*this)(r, c) = M(r, c);
+	}
+
+	/// Unpacks into a full matrix, the upper triangle mirrors the lower one
+	Matrix<T> toMatrix() const
+	{
+		Matrix<T> M(rows, cols);
+		for (int r = 0; r < rows; r++)
+			for (int c = 0; c <= r; c++)
+				M(r, c) = M(c, r) = (*this)(r, c);
+		return M;
+	}
+
+	T * tile(int i, int j) { return data + tileOffset(i, j); }
+	const T * tile(int i, int j) const { return data + tileOffset(i, j); }
+	/// Rows (and columns) of tile row i that lie inside the matrix
+	int tileRows(int i) const { return std::min(tileSize, rows - i * tileSize); }
+
+	/// Element (r, c) of the lower triangle, r >= c
+	T & operator()(int r, int c) { return tile(r / tileSize, c / tileSize)[(r % tileSize) * tileSize + c % tileSize]; }
+	const T & operator()(int r, int c) const { return tile(r / tileSize, c / tileSize)[(r % tileSize) * tileSize + c % tileSize]; }
+
+	/// Number of stored elements, padding included
+	size_t size() const { return (size_t)numTiles * (numTiles + 1) / 2 * tileSize * tileSize; }
+
+	int rows;
+	int cols;
+	int tileSize;
+	int numTiles;
+
+	T * data;
+
+private:
+	size_t tileOffset(int i, int j) const
+	{
+		assert(j <= i);
+		return ((size_t)i * (i + 1) / 2 + j) * tileSize * tileSize;
+	}
 };
 
 // initialise Matrix from an array, but arr must include same padding as eventual matrix
@@ -104,7 +406,20 @@ void setMatrix(Matrix<T> & m, const T * arr)
 	memcpy(m.data, arr, m.rows * m.stride * sizeof(T));
 }
 
-// Calculates out of place transpose, using BLAS, if available
+namespace util {
+	/// dst (cols x rows, stride ldd) = src^T (rows x cols, stride lds)
+	/// Cache-oblivious recursion down to SIMD tile kernels picked at runtime (see transpose.cpp)
+	void transpose(const float * src, int lds, float * dst, int ldd, int rows, int cols);
+	void transpose(const double * src, int lds, double * dst, int ldd, int rows, int cols);
+	/// In-place transpose of the n x n matrix A
+	void transposeInPlace(float * A, int lda, int n);
+	void transposeInPlace(double * A, int lda, int n);
+	/// Copies the strict lower triangle of the n x n matrix A onto its upper triangle, transposed
+	void mirrorLower(float * A, int lda, int n);
+	void mirrorLower(double * A, int lda, int n);
+}
+
+// Calculates out of place transpose, using BLAS, if available, else the cache-oblivious one for float and double
 template<typename T>
 inline Matrix<T> transpose(const Matrix<T> & M)
 {
@@ -115,7 +430,71 @@ inline Matrix<T> transpose(const Matrix<T> & M)
 	return MT;
 }
 
-#ifdef HAVE_MKL
+//In-place transpose of a square matrix
+template<typename T>
+inline void transposeInPlace(Matrix<T> & M)
+{
+	assert(M.rows == M.cols);
+	for (int i = 0; i < M.rows; i++)
+		for (int j = 0; j < i; j++)
+			std::swap(M(i, j), M(j, i));
+}
+
+template<>
+inline void transposeInPlace(Matrix<float> & M)
+{
+	assert(M.rows == M.cols);
+	util::transposeInPlace(M.data, M.stride, M.rows);
+}
+
+template<>
+inline void transposeInPlace(Matrix<double> & M)
+{
+	assert(M.rows == M.cols);
+	util::transposeInPlace(M.data, M.stride, M.rows);
+}
+
+//Makes a square matrix symmetric from its lower triangle, the upper triangle is overwritten
+template<typename T>
+inline void mirrorLower(Matrix<T> & M)
+{
+	assert(M.rows == M.cols);
+	for (int i = 0; i < M.rows; i++)
+		for (int j = 0; j < i; j++)
+			M(j, i) = M(i, j);
+}
+
+template<>
+inline void mirrorLower(Matrix<float> & M)
+{
+	assert(M.rows == M.cols);
+	util::mirrorLower(M.data, M.stride, M.rows);
+}
+
+template<>
+inline void mirrorLower(Matrix<double> & M)
+{
+	assert(M.rows == M.cols);
+	util::mirrorLower(M.data, M.stride, M.rows);
+}
+
+#ifndef HAVE_MKL
+template<>
+inline Matrix<float> transpose(const Matrix<float> & M)
+{
+	Matrix<float> MT(M.cols, M.rows);
+	util::transpose(M.data, M.stride, MT.data, MT.stride, M.rows, M.cols);
+	return MT;
+}
+
+template<>
+inline Matrix<double> transpose(const Matrix<double> & M)
+{
+	Matrix<double> MT(M.cols, M.rows);
+	util::transpose(M.data, M.stride, MT.data, MT.stride, M.rows, M.cols);
+	return MT;
+}
+#else
 template<>
 inline Matrix<float> transpose(const Matrix<float> & M)
 {
@@ -133,9 +512,19 @@ inline Matrix<double> transpose(const Matrix<double> & M)
 }
 #endif
 
-//Calculates C = A*B, using BLAS, if available
+namespace util {
+	/// C (m x n) = op(A) B, op(A) = A (m x k) or, with transA, A^T with A k x m; all row-major with the given strides
+	/// With lower only the lower triangle of C is computed (m == n), for A^T A half the work; tiles crossing the
+	/// diagonal also write their (correct) entries just above it
+	/// Cache-blocked with packed panels, micro-kernel picked at runtime, rows split over numThreads (see gemm.cpp)
+	void gemm(bool transA, bool lower, int m, int n, int k, const float * A, int lda, const float * B, int ldb, float * C, int ldc, int numThreads = 1);
+	void gemm(bool transA, bool lower, int m, int n, int k, const double * A, int lda, const double * B, int ldb, double * C, int ldc, int numThreads = 1);
+}
+
+//Calculates C = A*B, using BLAS, if available, else the blocked gemm for float and double
+//numThreads only applies to the latter, MKL picks its own
 template<typename T>
-inline void product(const Matrix<T> & A, const Matrix<T> &B, Matrix<T> & C)
+inline void product(const Matrix<T> & A, const Matrix<T> &B, Matrix<T> & C, int numThreads = 1)
 {
 	for (int i = 0; i < A.rows; i++)
 	{
@@ -149,22 +538,77 @@ inline void product(const Matrix<T> & A, const Matrix<T> &B, Matrix<T> & C)
 	}
 }
 
-#ifdef HAVE_MKL
+#ifndef HAVE_MKL
+template<>
+inline void product(const Matrix<float> & A, const Matrix<float> &B, Matrix<float> & C, int numThreads)
+{
+	util::gemm(false, false, A.rows, B.cols, A.cols, A.data, A.stride, B.data, B.stride, C.data, C.stride, numThreads);
+}
+
+template<>
+inline void product(const Matrix<double> & A, const Matrix<double> &B, Matrix<double> & C, int numThreads)
+{
+	util::gemm(false, false, A.rows, B.cols, A.cols, A.data, A.stride, B.data, B.stride, C.data, C.stride, numThreads);
+}
+#else
 template<>
-inline void product(const Matrix<float> & A, const Matrix<float> &B, Matrix<float> & C)
+inline void product(const Matrix<float> & A, const Matrix<float> &B, Matrix<float> & C, int)
 {
-	cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, A.rows, B.rows, C.rows, 1.0,
+	cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, A.rows, B.cols, A.cols, 1.0,
 		A.data, A.stride, B.data, B.stride, 0, C.data, C.stride);
 }
 
 template<>
-inline void product(const Matrix<double> & A, const Matrix<double> &B, Matrix<double> & C)
+inline void product(const Matrix<double> & A, const Matrix<double> &B, Matrix<double> & C, int)
 {
-	cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, A.rows, B.rows, C.rows, 1.0,
+	cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans, A.rows, B.cols, A.cols, 1.0,
 		A.data, A.stride, B.data, B.stride, 0, C.data, C.stride);
 }
 #endif 
 
+//Calculates the lower triangle of C = A^T*A, using BLAS, if available; the upper triangle is left as is,
+//except for a few entries next to the diagonal
+template<typename T>
+inline void syrk(const Matrix<T> & A, Matrix<T> & C, int numThreads = 1)
+{
+	for (int i = 0; i < A.cols; i++)
+	{
+		for (int j = 0; j <= i; j++)
+		{
+			T sum = 0;
+			for (int k = 0; k < A.rows; k++)
+				sum += A(k, i) * A(k, j);
+			C(i, j) = sum;
+		}
+	}
+}
+
+#ifndef HAVE_MKL
+template<>
+inline void syrk(const Matrix<float> & A, Matrix<float> & C, int numThreads)
+{
+	util::gemm(true, true, A.cols, A.cols, A.rows, A.data, A.stride, A.data, A.stride, C.data, C.stride, numThreads);
+}
+
+template<>
+inline void syrk(const Matrix<double> & A, Matrix<double> & C, int numThreads)
+{
+	util::gemm(true, true, A.cols, A.cols, A.rows, A.data, A.stride, A.data, A.stride, C.data, C.stride, numThreads);
+}
+#else
+template<>
+inline void syrk(const Matrix<float> & A, Matrix<float> & C, int)
+{
+	cblas_ssyrk(CblasRowMajor, CblasLower, CblasTrans, A.cols, A.rows, 1.0, A.data, A.stride, 0, C.data, C.stride);
+}
+
+template<>
+inline void syrk(const Matrix<double> & A, Matrix<double> & C, int)
+{
+	cblas_dsyrk(CblasRowMajor, CblasLower, CblasTrans, A.cols, A.rows, 1.0, A.data, A.stride, 0, C.data, C.stride);
+}
+#endif
+
 template<class T>
 inline void print(std::string name, const Matrix<T> & m)
 {
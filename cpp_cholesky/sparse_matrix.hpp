@@ -0,0 +1,114 @@
+#ifndef _LINALG_SPARSE_MATRIX_HPP_
+#define _LINALG_SPARSE_MATRIX_HPP_
+
+#include "matrix.hpp"
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+namespace linalg{
+
+template<typename T>
+struct Triplet
+{
+	int row;
+	int col;
+	T value;
+};
+
+// Compressed sparse column storage: the row indices and values of column j are
+// rowIdx[colPtr[j] .. colPtr[j + 1] - 1] and values[same range], rows sorted increasingly within a column
+// Symmetric matrices may keep both triangles or only the lower one, SparseCholesky reads only the lower triangle
+template<typename T>
+class SparseMatrix
+{
+public:
+	SparseMatrix() : rows(0), cols(0), colPtr(1, 0) {}
+	SparseMatrix(int r, int c) : rows(r), cols(c), colPtr(c + 1, 0) {}
+
+	/// Entries given in any order, duplicates are summed
+	static SparseMatrix fromTriplets(int rows, int cols, std::vector<Triplet<T>> triplets)
+	{
+		std::sort(triplets.begin(), triplets.end(), [](const Triplet<T> & a, const Triplet<T> & b)
+			{ return a.col < b.col || (a.col == b.col && a.row < b.row); });
+		SparseMatrix S(rows, cols);
+		S.rowIdx.reserve(triplets.size());
+		S.values.reserve(triplets.size());
+		for (size_t k = 0; k < triplets.size(); k++)
+		{
+			const Triplet<T> & t = triplets[k];
+			assert(t.row >= 0 && t.row < rows && t.col >= 0 && t.col < cols);
+			if (k > 0 && t.row == triplets[k - 1].row && t.col == triplets[k - 1].col)
+			{
+				S.values.back() += t.value;
+				continue;
+			}
+			S.rowIdx.push_back(t.row);
+			S.values.push_back(t.value);
+			S.colPtr[t.col + 1]++;
+		}
+		for (int j = 0; j < cols; j++)
+			S.colPtr[j + 1] += S.colPtr[j];
+		return S;
+	}
+
+	/// Entries of M with absolute value above dropTolerance, the lower triangle only if lower
+	static SparseMatrix fromDense(const Matrix<T> & M, T dropTolerance = 0, bool lower = false)
+	{
+		SparseMatrix S(M.rows, M.cols);
+		for (int j = 0; j < M.cols; j++)
+		{
+			for (int i = lower ? j : 0; i < M.rows; i++)
+				if (std::abs(M(i, j)) > dropTolerance)
+				{
+					S.rowIdx.push_back(i);
+					S.values.push_back(M(i, j));
+				}
+			S.colPtr[j + 1] = (int)S.rowIdx.size();
+		}
+		return S;
+	}
+
+	/// Dense copy, a lower triangular S is mirrored if symmetric
+	Matrix<T> toDense(bool symmetric = false) const
+	{
+		Matrix<T> M(rows, cols);
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < cols; j++)
+				M(i, j) = 0;
+		for (int j = 0; j < cols; j++)
+			for (int k = colPtr[j]; k < colPtr[j + 1]; k++)
+			{
+				M(rowIdx[k], j) = values[k];
+				if (symmetric)
+					M(j, rowIdx[k]) = values[k];
+			}
+		return M;
+	}
+
+	/// y = S x, with the strict lower triangle applied twice if S holds the lower triangle of a symmetric matrix
+	void multiply(const T * x, T * y, bool symmetricLower = false) const
+	{
+		std::fill(y, y + rows, (T)0);
+		for (int j = 0; j < cols; j++)
+			for (int k = colPtr[j]; k < colPtr[j + 1]; k++)
+			{
+				int i = rowIdx[k];
+				y[i] += values[k] * x[j];
+				if (symmetricLower && i != j)
+					y[j] += values[k] * x[i];
+			}
+	}
+
+	int nonZeros() const { return colPtr[cols]; }
+
+	int rows;
+	int cols;
+
+	std::vector<int> colPtr;
+	std::vector<int> rowIdx;
+	std::vector<T> values;
+};
+
+}
+#endif
@@ -1,22 +1,111 @@
 // needs c++11
 #include <chrono>
 #include <iostream>
+#include <sstream>
 #include <cstdlib>
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
 #include "cholesky.hpp"
+#include "cholesky_batched.hpp"
+#include "cholesky_packed.hpp"
+#include "cholesky_sparse.hpp"
+#include "cholesky_banded.hpp"
+#include "cholesky_pivoted.hpp"
+#include "cholesky_outofcore.hpp"
+#include "cholesky_fixed.hpp"
+
+#include "cpp_benchmark/benchmark.hpp"
 
 using namespace linalg;
-namespace cn = std::chrono;
 
-cn::time_point<cn::high_resolution_clock> startTimer()
+// Every operator new of the program, from any thread, adds to util::allocationCount() as alignedCalloc does,
+// so that the workspace checks also see std::vector, std::function and the like
+// Every form of operator delete frees, the sized ones are those of C++14 and later
+void * operator new(size_t size)
+{
+	void * mem = malloc(size ? size : 1);
+	if (!mem)
+		throw std::bad_alloc();
+	util::allocationCounter()++;
+	return mem;
+}
+
+void * operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void * operator new(size_t size, const std::nothrow_t &) noexcept
+{
+	try
+	{
+		return operator new(size);
+	}
+	catch (const std::bad_alloc &)
+	{
+		return NULL;
+	}
+}
+
+void * operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+// Not inlined: GCC would see free() called on the result of operator new and warn of a mismatch
+__attribute__((noinline)) void operator delete(void * mem) noexcept
+{
+	free(mem);
+}
+
+void operator delete[](void * mem) noexcept
+{
+	operator delete(mem);
+}
+
+void operator delete(void * mem, size_t) noexcept
+{
+	operator delete(mem);
+}
+
+void operator delete[](void * mem, size_t) noexcept
 {
-	return cn::high_resolution_clock::now();
+	operator delete(mem);
 }
 
-double endTimer(cn::time_point<cn::high_resolution_clock> t1)
+void operator delete(void * mem, const std::nothrow_t &) noexcept
 {
-	auto t2 = cn::high_resolution_clock::now();
-	cn::duration<double> diff = t2 - t1;
-	return diff.count() * 1000;
+	operator delete(mem);
+}
+
+void operator delete[](void * mem, const std::nothrow_t &) noexcept
+{
+	operator delete(mem);
+}
+
+// Flops of one factorization of an n x n matrix, and of solves with numRhs right-hand sides, which also read
+// the factor once per right-hand side
+bench::Work choleskyWork(int n)
+{
+	return { (double)n * n * n / 3, (double)n * n * sizeof(float) };
+}
+
+bench::Work solveWork(int n, int numRhs)
+{
+	return { 2.0 * n * n * numRhs, (double)n * n * sizeof(float) * numRhs };
+}
+
+// A table cell: the time f returns, or n/a without calling it where the CPU lacks the instructions it needs
+std::string timeCell(bool supported, const std::function<double()> & f)
+{
+	std::ostringstream os;
+	if (supported)
+		os << f();
+	else
+		os << "n/a";
+	return os.str();
 }
 
 Matrix<float> genTestMatrix()
@@ -59,19 +148,19 @@ Matrix<float> genRandomPosDefMatrix(int size)
 	for (int i = 0; i < size; i++)
 		for (int j = 0; j < size; j++)
 			M(i, j) = (float)rand() / RAND_MAX;
-	// prod = M^T M to guarantee positive-definite
-	Matrix<float> MT = transpose(M);
+	// prod = M^T M to guarantee positive-definite, lower triangle only, then mirrored
 	Matrix<float> prod(size, size);
-	product<float>(MT, M, prod);
+	syrk<float>(M, prod, std::max(1u, std::thread::hardware_concurrency()));
+	mirrorLower(prod);
 	return prod;
 }
 
-bool accuracyCheck()
+bool accuracyCheck(CholeskyImpl impl)
 {
 	Matrix<float> M = genTestMatrix();
 	Matrix<float> E_LLt = genExpectedLLt();
 
-	Cholesky chol = Cholesky(M.rows, CholeskyImpl::AVX);
+	Cholesky chol = Cholesky(M.rows, impl);
 	chol.calculateCholeskyLLt(M);
 	Matrix<float> LLt = chol.getCholeskyMatrix();
 	bool correct = true;
@@ -90,6 +179,1488 @@ bool accuracyCheck()
 	return correct;
 }
 
+// M^T M is poorly conditioned, adding to the diagonal keeps rounding differences between implementations small
+Matrix<float> genWellConditionedPosDefMatrix(int size)
+{
+	Matrix<float> M = genRandomPosDefMatrix(size);
+	for (int i = 0; i < size; i++)
+		M(i, i) += size;
+	return M;
+}
+
+// Compares an implementation against the plain C++ one on a matrix spanning several AVX lanes/blocks
+// Results differ by rounding only, as the optimized versions sum the same products in a different order
+bool referenceAccuracyCheck(CholeskyImpl impl, int size, int blockSize, bool multiRowDot = true)
+{
+	Matrix<float> M = genWellConditionedPosDefMatrix(size);
+	float tolerance = 1e-3f;
+	bool correct = true;
+
+	Cholesky ref(size, CholeskyImpl::CPP);
+	Cholesky blocked(size, impl);
+	blocked.setBlockSize(blockSize);
+	blocked.setNumThreads(4); // more threads than tiles in flight exercises the scheduler even on small machines
+	blocked.setMultiRowDot(multiRowDot);
+
+	ref.calculateCholeskyLLt(M);
+	blocked.calculateCholeskyLLt(M);
+	Matrix<float> E_LLt = ref.getCholeskyMatrix();
+	Matrix<float> LLt = blocked.getCholeskyMatrix();
+
+	ref.calculateCholeskyLDLt(M);
+	blocked.calculateCholeskyLDLt(M);
+	Matrix<float> E_LDLt = ref.getCholeskyMatrix();
+	Matrix<float> LDLt = blocked.getCholeskyMatrix();
+
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+		{
+			if (std::abs(LLt(i, j) - E_LLt(i, j)) > tolerance * std::max(1.f, std::abs(E_LLt(i, j))))
+				correct = false;
+			if (std::abs(LDLt(i, j) - E_LDLt(i, j)) > tolerance * std::max(1.f, std::abs(E_LDLt(i, j))))
+				correct = false;
+		}
+
+	return correct;
+}
+
+// Factorizations without copies: in place on a sub-block of a larger buffer, and by moving the matrix
+// in and the factor out, which must hand back the very same storage
+bool inPlaceAccuracyCheck(CholeskyImpl impl, int size, int blockSize)
+{
+	Matrix<float> M = genWellConditionedPosDefMatrix(size);
+	float tolerance = 1e-3f;
+	Cholesky ref(size, CholeskyImpl::CPP);
+	Cholesky chol(size, impl);
+	chol.setBlockSize(blockSize);
+	chol.setNumThreads(4);
+
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		ldlt ? ref.calculateCholeskyLDLt(M) : ref.calculateCholeskyLLt(M);
+		Matrix<float> E = ref.getCholeskyMatrix();
+
+		// M at offset (3, 5) of a buffer filled with a sentinel, nothing outside the block may change
+		Matrix<float> buffer(size + 6, size + 9);
+		for (int i = 0; i < buffer.rows; i++)
+			for (int j = 0; j < buffer.cols; j++)
+				buffer(i, j) = -7;
+		MatrixView<float> A = buffer.block(3, 5, size, size);
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j <= i; j++)
+				A(i, j) = M(i, j);
+		ldlt ? chol.calculateCholeskyLDLtInPlace(A) : chol.calculateCholeskyLLtInPlace(A);
+		for (int i = 0; i < buffer.rows; i++)
+			for (int j = 0; j < buffer.cols; j++)
+			{
+				bool inside = i >= 3 && i < size + 3 && j >= 5 && j < size + 5;
+				bool lower = inside && j - 5 <= i - 3;
+				if (lower && std::abs(buffer(i, j) - E(i - 3, j - 5)) > tolerance * std::max(1.f, std::abs(E(i - 3, j - 5))))
+					return false;
+				if (!inside && buffer(i, j) != -7)
+					return false;
+			}
+		// Solves read the caller's storage
+		std::vector<float> b(size, 1.0f), c(size, 1.0f);
+		chol.solve(b);
+		ref.solve(c);
+		for (int i = 0; i < size; i++)
+			if (std::abs(b[i] - c[i]) > tolerance * std::max(1.f, std::abs(c[i])))
+				return false;
+
+		Matrix<float> N(M);
+		const float * storage = N.data;
+		ldlt ? chol.calculateCholeskyLDLt(std::move(N)) : chol.calculateCholeskyLLt(std::move(N));
+		Matrix<float> L = chol.releaseCholeskyMatrix();
+		if (N.data != NULL || L.data != storage)
+			return false;
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max(1.f, std::abs(E(i, j))))
+					return false;
+	}
+	// A copy after the factor was released gets new storage
+	chol.calculateCholeskyLLt(M);
+	ref.calculateCholeskyLLt(M);
+	Matrix<float> E = ref.getCholeskyMatrix();
+	Matrix<float> L = chol.getCholeskyMatrix();
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max(1.f, std::abs(E(i, j))))
+				return false;
+	return true;
+}
+
+// Steady state of a request loop: once every call has run once, factorizations of the workspace size or smaller,
+// solves and updates must not allocate, and must still agree with an object built for the exact size
+bool workspaceCheck(CholeskyImpl impl, int size)
+{
+	float tolerance = 1e-3f;
+	Matrix<float> M[2] = { genWellConditionedPosDefMatrix(size), genWellConditionedPosDefMatrix(size / 2 + 3) };
+	std::vector<float> b[2] = { std::vector<float>(size, 1.0f), std::vector<float>(size / 2 + 3, 1.0f) };
+	Cholesky chol(size, impl);
+	chol.setBlockSize(32);
+	chol.setNumThreads(2);
+	Arena arena;
+
+	size_t allocations = 0;
+	for (int it = 0; it < 3; it++)
+	{
+		// Right-hand sides of this iteration live in the arena
+		arena.reset();
+		Matrix<float> X(size, 4, arena);
+		for (int m = 0; m < 2; m++)
+		{
+			int n = M[m].rows;
+			for (int i = 0; i < n; i++)
+				for (int j = 0; j < 4; j++)
+					X(i, j) = 1;
+			chol.calculateCholeskyLDLt(M[m]);
+			chol.update(b[m]);
+			chol.calculateCholeskyLLt(M[m]);
+			chol.solve(b[m]);
+			chol.solve(X.block(0, 0, n, 4));
+		}
+		// First pass sizes the workspaces, the second one the arena, which grows on reset()
+		if (it == 1)
+			allocations = util::allocationCount();
+	}
+	// PARALLEL allocates its task graph on every factorization: the dependency counters of the tiles and the
+	// std::function tasks of the pool's queues. Only its workspaces and results are checked
+	if (impl != CholeskyImpl::PARALLEL && util::allocationCount() != allocations)
+		return false;
+
+	// The last factorization was of the small matrix, in the corner of the workspace
+	Cholesky ref(M[1].rows, impl);
+	ref.calculateCholeskyLLt(M[1]);
+	Matrix<float> E = ref.getCholeskyMatrix();
+	Matrix<float> L = chol.releaseCholeskyMatrix();
+	for (int i = 0; i < M[1].rows; i++)
+		for (int j = 0; j < M[1].rows; j++)
+			if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max(1.f, std::abs(E(i, j))))
+				return false;
+	return true;
+}
+
+// Checks FixedCholesky against the same fixtures as the runtime-sized class, and solve() on A x = b with known x
+bool fixedAccuracyCheck()
+{
+	typedef FixedCholesky<3, float> Chol3;
+	Chol3::MatrixType M(genTestMatrix());
+	Chol3::MatrixType E_LLt(genExpectedLLt());
+	Chol3::MatrixType E_LDLt(genExpectedLDLt());
+	Chol3::VectorType x, b;
+	for (int i = 0; i < 3; i++)
+		x(i, 0) = (float)(i + 1);
+	for (int i = 0; i < 3; i++)
+	{
+		b(i, 0) = 0;
+		for (int j = 0; j < 3; j++)
+			b(i, 0) += M(i, j) * x(j, 0);
+	}
+
+	bool correct = true;
+	Chol3 chol;
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		if (ldlt)
+			chol.calculateCholeskyLDLt(M);
+		else
+			chol.calculateCholeskyLLt(M);
+		Chol3::MatrixType F = chol.getCholeskyMatrix();
+		const Chol3::MatrixType & E = ldlt ? E_LDLt : E_LLt;
+		for (int i = 0; i < 3; i++)
+			for (int j = 0; j < 3; j++)
+				if (F(i, j) != E(i, j))
+					correct = false;
+
+		Chol3::VectorType y = chol.solve(b);
+		for (int i = 0; i < 3; i++)
+			if (std::abs(y(i, 0) - x(i, 0)) > 1e-4f)
+				correct = false;
+
+		if (!correct)
+		{
+			print("Matrix", M.toMatrix());
+			print(ldlt ? "Expected LDLt" : "Expected LLt", E.toMatrix());
+			print(ldlt ? "Actual LDLt" : "Actual LLt", F.toMatrix());
+			return false;
+		}
+	}
+
+	// Double precision on a larger size against the runtime-sized float class
+	Matrix<float> Mf = genWellConditionedPosDefMatrix(15);
+	Cholesky ref(15, CholeskyImpl::CPP);
+	ref.calculateCholeskyLLt(Mf);
+	Matrix<float> E = ref.getCholeskyMatrix();
+	FixedCholesky<15, double> chol15;
+	FixedMatrix<double, 15, 15> Md;
+	for (int i = 0; i < 15; i++)
+		for (int j = 0; j < 15; j++)
+			Md(i, j) = Mf(i, j);
+	chol15.calculateCholeskyLLt(Md);
+	FixedMatrix<double, 15, 15> F = chol15.getCholeskyMatrix();
+	for (int i = 0; i < 15; i++)
+		for (int j = 0; j < 15; j++)
+			if (std::abs(F(i, j) - E(i, j)) > 1e-4 * std::max(1.f, std::abs(E(i, j))))
+				correct = false;
+
+	return correct;
+}
+
+// Times count factorizations of a compile-time sized matrix against the runtime-sized class
+template<int N>
+void benchmarkFixedSize(bench::Harness & h, int count)
+{
+	if (h.sweep({ N }).empty())
+		return;
+	char sep = ',';
+	Matrix<float> M = genWellConditionedPosDefMatrix(N);
+	typename FixedCholesky<N>::MatrixType MF(M);
+	FixedCholesky<N> fixed;
+	// Accumulate a result so that the fixed-size loop is not optimized away, printed as the Checksum column
+	float acc = 0;
+	bench::Work work = { choleskyWork(N).flops * count, choleskyWork(N).bytes * count };
+
+	std::cout << N;
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		std::string kind = ldlt ? "LDLt" : "LLt";
+		std::cout << sep << timeCell(isSupported(CholeskyImpl::AVX), [&] { return h.time("Fixed", "AVX-loop-" + kind, N, [&]
+		{
+			for (int m = 0; m < count; m++)
+				ldlt ? Cholesky(N, CholeskyImpl::AVX).calculateCholeskyLDLt(M) : Cholesky(N, CholeskyImpl::AVX).calculateCholeskyLLt(M);
+		}, work); });
+
+		std::cout << sep << h.time("Fixed", "Fixed-" + kind, N, [&]
+		{
+			for (int m = 0; m < count; m++)
+			{
+				MF(0, 0) += 1e-7f;
+				ldlt ? fixed.calculateCholeskyLDLt(MF) : fixed.calculateCholeskyLLt(MF);
+				acc += fixed.getCholeskyMatrix()(N - 1, N - 1);
+			}
+		}, work);
+	}
+	std::cout << sep << acc << std::endl;
+}
+
+void benchmarkFixed(bench::Harness & h)
+{
+	const int count = 8192;
+	char sep = ',';
+	std::cout << "Size" << sep << "AVX-loop-LLt" << sep << "Fixed-LLt" << sep << "AVX-loop-LDLt" << sep << "Fixed-LDLt" << sep << "Checksum" << std::endl;
+	benchmarkFixedSize<6>(h, count);
+	benchmarkFixedSize<9>(h, count);
+	benchmarkFixedSize<15>(h, count);
+}
+
+// B = M X for a known X, then checks that solve() recovers X from the LL^T and the LDL^T factor
+bool solveAccuracyCheck(CholeskyImpl impl, int size, int numRhs)
+{
+	float tolerance = 1e-3f;
+	Matrix<float> M = genWellConditionedPosDefMatrix(size);
+	Matrix<float> X(size, numRhs);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < numRhs; j++)
+			X(i, j) = (float)((i + 3 * j) % 7) - 3;
+	Matrix<float> B(size, numRhs);
+	product<float>(M, X, B);
+
+	Cholesky chol(size, impl);
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		if (ldlt)
+			chol.calculateCholeskyLDLt(M);
+		else
+			chol.calculateCholeskyLLt(M);
+
+		Matrix<float> Y(B);
+		chol.solve(Y);
+		std::vector<float> y(size);
+		for (int i = 0; i < size; i++)
+			y[i] = B(i, numRhs - 1);
+		chol.solve(y);
+
+		for (int i = 0; i < size; i++)
+		{
+			for (int j = 0; j < numRhs; j++)
+				if (std::abs(Y(i, j) - X(i, j)) > tolerance)
+					return false;
+			if (std::abs(y[i] - X(i, numRhs - 1)) > tolerance)
+				return false;
+		}
+	}
+	return true;
+}
+
+// Factors M, updates with V V^T and compares with the factor of M + V V^T, then downdates back to M
+bool updateAccuracyCheck(int size, int rank)
+{
+	float tolerance = 1e-3f;
+	Matrix<float> M = genWellConditionedPosDefMatrix(size);
+	Matrix<float> V(size, rank);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < rank; j++)
+			V(i, j) = (float)((i * 7 + j * 3) % 11) / 11 - 0.5f;
+	Matrix<float> MV(M);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			for (int k = 0; k < rank; k++)
+				MV(i, j) += V(i, k) * V(j, k);
+
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		Cholesky chol(size, CholeskyImpl::AUTO), ref(size, CholeskyImpl::CPP), refV(size, CholeskyImpl::CPP);
+		if (ldlt)
+		{
+			chol.calculateCholeskyLDLt(M);
+			ref.calculateCholeskyLDLt(M);
+			refV.calculateCholeskyLDLt(MV);
+		}
+		else
+		{
+			chol.calculateCholeskyLLt(M);
+			ref.calculateCholeskyLLt(M);
+			refV.calculateCholeskyLLt(MV);
+		}
+
+		// Rank-k for the first pass, rank-1 one vector at a time for the second
+		bool ok = true;
+		if (ldlt)
+		{
+			for (int k = 0; k < rank && ok; k++)
+			{
+				std::vector<float> v(size);
+				for (int i = 0; i < size; i++)
+					v[i] = V(i, k);
+				ok = chol.update(v);
+			}
+		}
+		else
+		{
+			ok = chol.update(V);
+		}
+		Matrix<float> F = chol.getCholeskyMatrix();
+		Matrix<float> E = refV.getCholeskyMatrix();
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				if (!ok || std::abs(F(i, j) - E(i, j)) > tolerance * std::max(1.f, std::abs(E(i, j))))
+					return false;
+
+		ok = chol.downdate(V);
+		F = chol.getCholeskyMatrix();
+		E = ref.getCholeskyMatrix();
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				if (!ok || std::abs(F(i, j) - E(i, j)) > tolerance * std::max(1.f, std::abs(E(i, j))))
+					return false;
+	}
+
+	// Downdating by more than A holds must be reported
+	Cholesky chol(size, CholeskyImpl::AUTO);
+	chol.calculateCholeskyLLt(M);
+	std::vector<float> big(size, 0.f);
+	big[0] = 2 * std::sqrt(M(0, 0));
+	return !chol.downdate(big);
+}
+
+// Times one factorization followed by solves with a single and with many right-hand sides
+void benchmarkSolve(bench::Harness & h)
+{
+	const int numRhs = 512;
+	char sep = ',';
+	std::cout << "Size" << sep << "BLK-LLt" << sep << "Solve-1" << sep << "Solve-" << numRhs << "-loop" << sep << "Solve-" << numRhs << std::endl;
+	for (int size : h.sweep(64, 1024))
+	{
+		Matrix<float> M = genWellConditionedPosDefMatrix(size);
+		Matrix<float> B(size, numRhs);
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < numRhs; j++)
+				B(i, j) = (float)rand() / RAND_MAX;
+		std::vector<float> b(size, 1.f);
+
+		Cholesky chol(size, CholeskyImpl::BLOCKED);
+		double time1 = h.time("Solve", "BLK-LLt", size, [&] { chol.calculateCholeskyLLt(M); }, choleskyWork(size));
+		double time2 = h.time("Solve", "Solve-1", size, [&] { chol.solve(b); }, solveWork(size, 1));
+
+		// Each right-hand side on its own, as done before solve(B) existed
+		double time3 = h.time("Solve", "Solve-" + std::to_string(numRhs) + "-loop", size, [&]
+		{
+			for (int j = 0; j < numRhs; j++)
+			{
+				for (int r = 0; r < size; r++)
+					b[r] = B(r, j);
+				chol.solve(b);
+			}
+		}, solveWork(size, numRhs));
+
+		Matrix<float> X(B);
+		double time4 = h.time("Solve", "Solve-" + std::to_string(numRhs), size, [&]
+		{
+			X = B;
+			chol.solve(X);
+		}, solveWork(size, numRhs));
+
+		std::cout << size << sep << time1 << sep << time2 << sep << time3 << sep << time4 << std::endl;
+	}
+}
+
+// Every matrix of the batch is a differently shifted copy of a random matrix, checked against the single-matrix class
+bool batchedAccuracyCheck(BatchImpl impl, int size, int count)
+{
+	float tolerance = 1e-4f;
+	MatrixBatch B(size, count);
+	Matrix<float> M = genWellConditionedPosDefMatrix(size);
+	for (int m = 0; m < count; m++)
+	{
+		for (int i = 0; i < size; i++)
+			M(i, i) += 1;
+		B.setMatrix(m, M);
+	}
+
+	BatchedCholesky batched(size, count, impl);
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		if (ldlt)
+			batched.calculateCholeskyLDLt(B);
+		else
+			batched.calculateCholeskyLLt(B);
+
+		for (int m = 0; m < count; m++)
+		{
+			Cholesky ref(size, CholeskyImpl::CPP);
+			if (ldlt)
+				ref.calculateCholeskyLDLt(B.getMatrix(m));
+			else
+				ref.calculateCholeskyLLt(B.getMatrix(m));
+			Matrix<float> E = ref.getCholeskyMatrix();
+			Matrix<float> F = batched.getCholeskyMatrix(m);
+			for (int i = 0; i < size; i++)
+				for (int j = 0; j < size; j++)
+					if (std::abs(F(i, j) - E(i, j)) > tolerance * std::max(1.f, std::abs(E(i, j))))
+						return false;
+		}
+	}
+	return true;
+}
+
+// Times factoring count small matrices, one Cholesky object per matrix as in the main benchmark, against one batched call
+void benchmarkBatched(bench::Harness & h)
+{
+	const int count = 8192;
+	char sep = ',';
+
+	std::cout << "Size" << sep << "AVX-loop-LLt" << sep << "BatchCPP-LLt" << sep << "BatchAVX-LLt" << sep << "BatchAVX512-LLt"
+		<< sep << "AVX-loop-LDLt" << sep << "BatchCPP-LDLt" << sep << "BatchAVX-LDLt" << sep << "BatchAVX512-LDLt" << std::endl;
+
+	for (int size : h.sweep({ 3, 4, 6, 8, 12, 16, 24, 32 }))
+	{
+		std::vector<Matrix<float>> Ms;
+		bench::Work work = { choleskyWork(size).flops * count, choleskyWork(size).bytes * count };
+		Ms.reserve(count);
+		MatrixBatch B(size, count);
+		for (int m = 0; m < count; m++)
+		{
+			Ms.push_back(genWellConditionedPosDefMatrix(size));
+			B.setMatrix(m, Ms.back());
+		}
+
+		std::cout << size;
+		for (int ldlt = 0; ldlt < 2; ldlt++)
+		{
+			std::string kind = ldlt ? "LDLt" : "LLt";
+			std::cout << sep << timeCell(isSupported(CholeskyImpl::AVX), [&] { return h.time("Batched", "AVX-loop-" + kind, size, [&]
+			{
+				for (int m = 0; m < count; m++)
+					ldlt ? Cholesky(size, CholeskyImpl::AVX).calculateCholeskyLDLt(Ms[m]) : Cholesky(size, CholeskyImpl::AVX).calculateCholeskyLLt(Ms[m]);
+			}, work); });
+
+			for (BatchImpl impl : { BatchImpl::CPP, BatchImpl::AVX, BatchImpl::AVX512 })
+			{
+				if (!isSupported(impl))
+				{
+					std::cout << sep << "n/a";
+					continue;
+				}
+				BatchedCholesky batched(size, count, impl);
+				std::string name = impl == BatchImpl::CPP ? "BatchCPP-" : impl == BatchImpl::AVX ? "BatchAVX-" : "BatchAVX512-";
+				std::cout << sep << h.time("Batched", name + kind, size, [&] { ldlt ? batched.calculateCholeskyLDLt(B) : batched.calculateCholeskyLLt(B); }, work);
+			}
+		}
+		std::cout << std::endl;
+	}
+}
+
+Matrix<double> toDouble(const Matrix<float> & M)
+{
+	Matrix<double> D(M.rows, M.cols);
+	for (int i = 0; i < M.rows; i++)
+		for (int j = 0; j < M.cols; j++)
+			D(i, j) = M(i, j);
+	return D;
+}
+
+// Double precision factorizations against the plain C++ one, then solves and a rank-1 update checked
+// against known answers, at tolerances only double precision can meet
+bool doubleAccuracyCheck(CholeskyImpl impl, int size, int blockSize)
+{
+	double tolerance = 1e-10;
+	Matrix<double> M = toDouble(genWellConditionedPosDefMatrix(size));
+	CholeskyDouble ref(size, CholeskyImpl::CPP);
+	CholeskyDouble chol(size, impl);
+	chol.setBlockSize(blockSize);
+	chol.setNumThreads(4);
+
+	Matrix<double> X(size, 3);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < 3; j++)
+			X(i, j) = (double)((i + 3 * j) % 7) - 3;
+	Matrix<double> B(size, 3);
+	product<double>(M, X, B);
+
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		ldlt ? ref.calculateCholeskyLDLt(M) : ref.calculateCholeskyLLt(M);
+		ldlt ? chol.calculateCholeskyLDLt(M) : chol.calculateCholeskyLLt(M);
+		Matrix<double> E = ref.getCholeskyMatrix();
+		Matrix<double> L = chol.getCholeskyMatrix();
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max(1.0, std::abs(E(i, j))))
+					return false;
+
+		Matrix<double> Y(B);
+		chol.solve(Y);
+		std::vector<double> y(size);
+		for (int i = 0; i < size; i++)
+			y[i] = B(i, 0);
+		chol.solve(y);
+		for (int i = 0; i < size; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				if (std::abs(Y(i, j) - X(i, j)) > tolerance)
+					return false;
+			if (std::abs(y[i] - X(i, 0)) > tolerance)
+				return false;
+		}
+	}
+
+	// LDL^T factor of M is still stored, update it to the factor of M + v v^T
+	std::vector<double> v(size);
+	Matrix<double> Mv(M);
+	for (int i = 0; i < size; i++)
+		v[i] = (double)(i % 5) / 5;
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			Mv(i, j) += v[i] * v[j];
+	chol.update(v);
+	ref.calculateCholeskyLDLt(Mv);
+	Matrix<double> E = ref.getCholeskyMatrix();
+	Matrix<double> L = chol.getCholeskyMatrix();
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max(1.0, std::abs(E(i, j))))
+				return false;
+	return true;
+}
+
+// A float factorization alone gets about 1e-6 relative accuracy, refinement must reach double accuracy
+bool mixedPrecisionCheck(CholeskyImpl impl, int size)
+{
+	Matrix<double> M = toDouble(genWellConditionedPosDefMatrix(size));
+	std::vector<double> x(size), b(size, 0.0);
+	for (int i = 0; i < size; i++)
+		x[i] = 1 + (double)(i % 11) / 7;
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			b[i] += M(i, j) * x[j];
+
+	MixedPrecisionCholesky chol(size, impl);
+	chol.calculateCholeskyLLt(M);
+	int iterations = chol.solve(b);
+	if (iterations < 1)
+		return false;
+	for (int i = 0; i < size; i++)
+		if (std::abs(b[i] - x[i]) > 1e-12 * std::abs(x[i]))
+			return false;
+	return true;
+}
+
+// Largest relative error of x against the exact solution, all ones
+static double maxRelativeError(const std::vector<double> & x)
+{
+	double err = 0;
+	for (double xi : x)
+		err = std::max(err, std::abs(xi - 1));
+	return err;
+}
+
+// Factor and solve in float, in double, and in float with double precision refinement
+// Errors are against the exact solution of a well conditioned double precision system
+void benchmarkPrecision(bench::Harness & h)
+{
+	char sep = ',';
+	std::cout << "Size" << sep << "Float-LLt+solve" << sep << "Double-LLt+solve" << sep << "Mixed-LLt+solve" << sep
+		<< "Mixed-iterations" << sep << "Float-error" << sep << "Double-error" << sep << "Mixed-error" << std::endl;
+	for (int size : h.sweep(128, 1024))
+	{
+		Matrix<double> M = toDouble(genWellConditionedPosDefMatrix(size));
+		bench::Work work = { choleskyWork(size).flops + solveWork(size, 1).flops, 0 };
+		Matrix<float> Mf = genWellConditionedPosDefMatrix(size);
+		std::vector<double> b(size, 0.0);
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				b[i] += M(i, j);
+
+		std::vector<float> xf(size);
+		Cholesky cholF(size, CholeskyImpl::AUTO);
+		double time1 = h.time("Precision", "Float-LLt+solve", size, [&]
+		{
+			for (int r = 0; r < size; r++)
+				xf[r] = (float)b[r];
+			cholF.calculateCholeskyLLt(Mf);
+			cholF.solve(xf);
+		}, work);
+
+		std::vector<double> xd(size);
+		CholeskyDouble cholD(size, CholeskyImpl::AUTO);
+		double time2 = h.time("Precision", "Double-LLt+solve", size, [&]
+		{
+			xd = b;
+			cholD.calculateCholeskyLLt(M);
+			cholD.solve(xd);
+		}, work);
+
+		std::vector<double> xm(size);
+		int iterations = 0;
+		MixedPrecisionCholesky cholM(size, CholeskyImpl::AUTO);
+		double time3 = h.time("Precision", "Mixed-LLt+solve", size, [&]
+		{
+			xm = b;
+			cholM.calculateCholeskyLLt(M);
+			iterations = cholM.solve(xm);
+		}, work);
+
+		std::vector<double> xfd(xf.begin(), xf.end());
+		std::cout << size << sep << time1 << sep << time2 << sep << time3 << sep << iterations << sep
+			<< maxRelativeError(xfd) << sep << maxRelativeError(xd) << sep << maxRelativeError(xm) << std::endl;
+	}
+}
+
+// Packed factorizations against the plain C++ one on full storage, and packed solves against known answers
+// Sizes that are not a multiple of the tile size exercise the partial last row of tiles
+template<typename T>
+bool packedAccuracyCheck(const Matrix<T> & M, int tileSize, T tolerance)
+{
+	int size = M.rows;
+	BasicCholesky<T> ref(size, CholeskyImpl::CPP);
+	PackedCholesky<T> chol(size, CholeskyImpl::AUTO, tileSize);
+
+	// Round trip of the storage itself
+	PackedLowerMatrix<T> P(M, tileSize);
+	Matrix<T> U = P.toMatrix();
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			if (U(i, j) != M(i, j))
+				return false;
+
+	Matrix<T> X(size, 3);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < 3; j++)
+			X(i, j) = (T)((i + 3 * j) % 7) - 3;
+	Matrix<T> B(size, 3);
+	product<T>(M, X, B);
+
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		ldlt ? ref.calculateCholeskyLDLt(M) : ref.calculateCholeskyLLt(M);
+		// Once from full storage, once by moving the packed copy in, after a move construction
+		PackedLowerMatrix<T> Q(P);
+		PackedLowerMatrix<T> R(std::move(Q));
+		if (Q.data || Q.size() != 0)
+			return false;
+		ldlt ? chol.calculateCholeskyLDLt(M) : chol.calculateCholeskyLLt(std::move(R));
+		Matrix<T> E = ref.getCholeskyMatrix();
+		Matrix<T> L = chol.getCholeskyMatrix();
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max((T)1, std::abs(E(i, j))))
+					return false;
+
+		Matrix<T> Y(B);
+		chol.solve(Y);
+		std::vector<T> y(size);
+		for (int i = 0; i < size; i++)
+			y[i] = B(i, 0);
+		chol.solve(y);
+		for (int i = 0; i < size; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				if (std::abs(Y(i, j) - X(i, j)) > tolerance * 10)
+					return false;
+			if (std::abs(y[i] - X(i, 0)) > tolerance * 10)
+				return false;
+		}
+	}
+	return true;
+}
+
+bool packedAccuracyCheck(int size, int tileSize)
+{
+	Matrix<float> M = genWellConditionedPosDefMatrix(size);
+	return packedAccuracyCheck<float>(M, tileSize, 1e-4f) && packedAccuracyCheck<double>(toDouble(M), tileSize, 1e-10);
+}
+
+// Blocked factorization on full storage against the packed one, with the bytes each stores
+void benchmarkPacked(bench::Harness & h)
+{
+	char sep = ',';
+	std::cout << "Size" << sep << "BLK-LLt" << sep << "Packed-LLt" << sep << "Full-MB" << sep << "Packed-MB" << sep << "Packed-solve" << std::endl;
+	for (int size : h.sweep(128, 2048))
+	{
+		Matrix<float> M = genRandomPosDefMatrix(size);
+		PackedLowerMatrix<float> P(M, CHOLESKY_BLOCK_SIZE);
+
+		Cholesky chol(size, CholeskyImpl::BLOCKED);
+		double time1 = h.time("Packed", "BLK-LLt", size, [&] { chol.calculateCholeskyLLt(M); }, choleskyWork(size));
+
+		PackedCholesky<float> packed(size, CholeskyImpl::AUTO);
+		double time2 = h.time("Packed", "Packed-LLt", size, [&] { packed.calculateCholeskyLLt(P); }, choleskyWork(size));
+
+		std::vector<float> b(size, 1.0f);
+		double time3 = h.time("Packed", "Packed-solve", size, [&] { packed.solve(b); }, solveWork(size, 1));
+
+		double fullMB = (double)M.rows * M.stride * sizeof(float) / (1 << 20);
+		double packedMB = (double)P.numTiles * (P.numTiles + 1) / 2 * P.tileSize * P.tileSize * sizeof(float) / (1 << 20);
+		std::cout << size << sep << time1 << sep << time2 << sep << fullMB << sep << packedMB << sep << time3 << std::endl;
+	}
+}
+
+// A new object per factorization, as the main table does, against one object whose workspace is reused,
+// with the number of allocations per factorization
+void benchmarkWorkspace(bench::Harness & h)
+{
+	char sep = ',';
+	std::cout << "Size" << sep << "Fresh-AVX-LLt" << sep << "Reused-AVX-LLt" << sep << "Fresh-BLK-LLt" << sep << "Reused-BLK-LLt" << sep
+		<< "Fresh-allocs" << sep << "Reused-allocs" << std::endl;
+	for (int size : h.sweep(64, 1024))
+	{
+		Matrix<float> M = genRandomPosDefMatrix(size);
+		size_t allocs[2] = { 0, 0 };
+		std::cout << size;
+		for (CholeskyImpl impl : { CholeskyImpl::AVX, CholeskyImpl::BLOCKED })
+		{
+			if (!isSupported(impl))
+			{
+				std::cout << sep << "n/a" << sep << "n/a";
+				continue;
+			}
+			std::string name = impl == CholeskyImpl::AVX ? "AVX-LLt" : "BLK-LLt";
+			// Counted over one call each, outside the harness, which allocates for its results
+			size_t a1 = util::allocationCount();
+			Cholesky(size, impl).calculateCholeskyLLt(M);
+			allocs[0] = util::allocationCount() - a1;
+			std::cout << sep << h.time("Workspace", "Fresh-" + name, size, [&] { Cholesky(size, impl).calculateCholeskyLLt(M); }, choleskyWork(size));
+
+			// The first call of the reused object allocates its workspace, outside the count
+			Cholesky chol(size, impl);
+			chol.calculateCholeskyLLt(M);
+			size_t a2 = util::allocationCount();
+			chol.calculateCholeskyLLt(M);
+			allocs[1] = util::allocationCount() - a2;
+			std::cout << sep << h.time("Workspace", "Reused-" + name, size, [&] { chol.calculateCholeskyLLt(M); }, choleskyWork(size));
+		}
+		std::cout << sep << allocs[0] << sep << allocs[1] << std::endl;
+	}
+}
+
+// 5-point Laplacian of an nx x ny grid plus shift * I, positive definite for shift > 0
+// Both triangles, or the lower one only
+template<typename T>
+SparseMatrix<T> genGridLaplacian(int nx, int ny, T shift, bool lower)
+{
+	std::vector<Triplet<T>> entries;
+	for (int y = 0; y < ny; y++)
+		for (int x = 0; x < nx; x++)
+		{
+			int i = y * nx + x;
+			Triplet<T> d = { i, i, 4 + shift };
+			entries.push_back(d);
+			int neighbours[2] = { x + 1 < nx ? i + 1 : -1, y + 1 < ny ? i + nx : -1 };
+			for (int j : neighbours)
+			{
+				if (j < 0)
+					continue;
+				Triplet<T> t = { j, i, -1 };
+				entries.push_back(t);
+				if (!lower)
+				{
+					Triplet<T> u = { i, j, -1 };
+					entries.push_back(u);
+				}
+			}
+		}
+	return SparseMatrix<T>::fromTriplets(nx * ny, nx * ny, entries);
+}
+
+// Factor against the dense factorization of P A P^T, solves against known answers, a refactorization with
+// new values on the same analysis, and an indefinite matrix
+template<typename T>
+bool sparseAccuracyCheck(const SparseMatrix<T> & A, bool lower, SparseOrdering ordering, T tolerance)
+{
+	int n = A.rows;
+	SparseCholesky<T> chol(CholeskyImpl::AUTO, ordering);
+	if (!chol.compute(A))
+		return false;
+
+	const std::vector<int> & perm = chol.getSymbolic().perm;
+	Matrix<T> Ad = A.toDense(true);
+	Matrix<T> PAP(n, n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			PAP(i, j) = Ad(perm[i], perm[j]);
+	BasicCholesky<T> ref(n, CholeskyImpl::CPP);
+	ref.calculateCholeskyLLt(PAP);
+	Matrix<T> E = ref.getCholeskyMatrix();
+	Matrix<T> L = chol.getCholeskyMatrix();
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j <= i; j++)
+			if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max((T)1, std::abs(E(i, j))))
+				return false;
+
+	// The same pattern with other values, A + A + I
+	SparseMatrix<T> B(A);
+	for (int j = 0; j < n; j++)
+		for (int k = B.colPtr[j]; k < B.colPtr[j + 1]; k++)
+			B.values[k] = 2 * B.values[k] + (B.rowIdx[k] == j ? 1 : 0);
+	for (int pass = 0; pass < 2; pass++)
+	{
+		const SparseMatrix<T> & M = pass ? B : A;
+		if (pass && !chol.factorize(B))
+			return false;
+		std::vector<T> x(n), b(n);
+		for (int i = 0; i < n; i++)
+			x[i] = (T)(i % 7) - 3;
+		M.multiply(&x[0], &b[0], lower);
+		chol.solve(b);
+		for (int i = 0; i < n; i++)
+			if (std::abs(b[i] - x[i]) > tolerance * 10)
+				return false;
+	}
+
+	SparseMatrix<T> N(A);
+	for (T & v : N.values)
+		v = -v;
+	return !chol.factorize(N);
+}
+
+bool sparseAccuracyCheck()
+{
+	SparseMatrix<float> grid = genGridLaplacian<float>(17, 13, 0.1f, false);
+	SparseMatrix<double> gridLower = genGridLaplacian<double>(17, 13, 0.1, true);
+	// Random pattern from the dense generator, made diagonally dominant
+	int n = 120;
+	Matrix<float> M = genRandomPosDefMatrix(n);
+	for (int i = 0; i < n; i++)
+	{
+		M(i, i) = 1;
+		for (int j = 0; j < i; j++)
+			if ((i * 7 + j * 13) % 23 != 0)
+				M(i, j) = M(j, i) = 0;
+	}
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			if (i != j)
+				M(i, i) += std::abs(M(i, j));
+	SparseMatrix<float> random = SparseMatrix<float>::fromDense(M, 0.0f, true);
+
+	// AMD must find less fill than the natural (banded) order of the grid
+	SparseCholesky<float> natural(CholeskyImpl::AUTO, SparseOrdering::NATURAL), amd(CholeskyImpl::AUTO, SparseOrdering::AMD);
+	natural.analyze(grid);
+	amd.analyze(grid);
+	if (amd.nonZerosL() >= natural.nonZerosL())
+		return false;
+
+	for (SparseOrdering ordering : { SparseOrdering::NATURAL, SparseOrdering::AMD })
+		if (!sparseAccuracyCheck<float>(grid, false, ordering, 1e-3f) || !sparseAccuracyCheck<double>(gridLower, true, ordering, 1e-10) ||
+			!sparseAccuracyCheck<float>(random, true, ordering, 1e-3f))
+			return false;
+	return true;
+}
+
+// Sparse factorization of grid Laplacians, with the fill of both orderings, against dense BLOCKED
+// Sizes are the matrix dimensions, the grid sides their square roots
+void benchmarkSparse(bench::Harness & h)
+{
+	char sep = ',';
+	std::cout << "Size" << sep << "NNZ-A" << sep << "NNZ-L-natural" << sep << "NNZ-L-AMD" << sep << "Supernodes" << sep
+		<< "Analyze" << sep << "Factorize" << sep << "Solve" << sep << "Dense-BLK-LLt" << std::endl;
+	for (int n : h.sweep(1024, 16384, 4))
+	{
+		int side = (int)std::lround(std::sqrt((double)n));
+		n = side * side;
+		SparseMatrix<float> A = genGridLaplacian<float>(side, side, 0.1f, true);
+		SparseCholesky<float> natural(CholeskyImpl::AUTO, SparseOrdering::NATURAL);
+		natural.analyze(A);
+
+		SparseCholesky<float> chol;
+		double time1 = h.time("Sparse", "Analyze", n, [&] { chol.analyze(A); });
+		double time2 = h.time("Sparse", "Factorize", n, [&] { chol.factorize(A); });
+		std::vector<float> b(n, 1.0f);
+		double time3 = h.time("Sparse", "Solve", n, [&] { chol.solve(b); }, { 4.0 * chol.nonZerosL(), 2.0 * chol.nonZerosL() * sizeof(float) });
+
+		std::cout << n << sep << A.nonZeros() << sep << natural.nonZerosL() << sep << chol.nonZerosL() << sep
+			<< chol.getSymbolic().numSupernodes() << sep << time1 << sep << time2 << sep << time3 << sep;
+		if (n <= 4096)
+		{
+			Matrix<float> M = A.toDense(true);
+			Cholesky dense(n, CholeskyImpl::BLOCKED);
+			std::cout << h.time("Sparse", "Dense-BLK-LLt", n, [&] { dense.calculateCholeskyLLt(M); }, choleskyWork(n));
+		}
+		else
+			std::cout << "n/a";
+		std::cout << std::endl;
+	}
+}
+
+// Random symmetric matrix, zero where keep(i, j) is false, made positive definite by diagonal dominance
+template<typename Keep>
+Matrix<float> genStructuredPosDefMatrix(int size, Keep keep)
+{
+	Matrix<float> M(size, size);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j <= i; j++)
+			M(i, j) = M(j, i) = keep(i, j) ? (float)rand() / RAND_MAX : 0;
+	for (int i = 0; i < size; i++)
+	{
+		M(i, i) = 1;
+		for (int j = 0; j < size; j++)
+			if (i != j)
+				M(i, i) += std::abs(M(i, j));
+	}
+	return M;
+}
+
+Matrix<float> genBandedPosDefMatrix(int size, int bandwidth)
+{
+	return genStructuredPosDefMatrix(size, [=](int i, int j) { return std::abs(i - j) <= bandwidth; });
+}
+
+Matrix<float> genBlockTridiagonalPosDefMatrix(int numBlocks, int blockSize)
+{
+	return genStructuredPosDefMatrix(numBlocks * blockSize, [=](int i, int j) { return std::abs(i / blockSize - j / blockSize) <= 1; });
+}
+
+// Banded and block-tridiagonal factorizations against the plain C++ one on full storage, solves against
+// known answers, and an indefinite matrix
+template<typename T, typename Chol, typename Structured>
+bool structuredAccuracyCheck(Chol & chol, const Matrix<T> & M, const Structured & S, T tolerance)
+{
+	int size = M.rows;
+	BasicCholesky<T> ref(size, CholeskyImpl::CPP);
+	std::vector<T> x(size), b(size);
+	for (int i = 0; i < size; i++)
+		x[i] = (T)(i % 7) - 3;
+	for (int i = 0; i < size; i++)
+	{
+		b[i] = 0;
+		for (int j = 0; j < size; j++)
+			b[i] += M(i, j) * x[j];
+	}
+
+	for (int ldlt = 0; ldlt < 2; ldlt++)
+	{
+		ldlt ? ref.calculateCholeskyLDLt(M) : ref.calculateCholeskyLLt(M);
+		if (!(ldlt ? chol.calculateCholeskyLDLt(S) : chol.calculateCholeskyLLt(S)))
+			return false;
+		Matrix<T> E = ref.getCholeskyMatrix();
+		Matrix<T> L = chol.getCholeskyMatrix();
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j <= i; j++)
+				if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max((T)1, std::abs(E(i, j))))
+					return false;
+		std::vector<T> y(b);
+		chol.solve(y);
+		for (int i = 0; i < size; i++)
+			if (std::abs(y[i] - x[i]) > tolerance * 10)
+				return false;
+	}
+
+	Structured N(S);
+	for (size_t k = 0; k < N.size(); k++)
+		N.data[k] = -N.data[k];
+	return !chol.calculateCholeskyLLt(N) && !chol.calculateCholeskyLDLt(N);
+}
+
+// Bandwidths and block sizes that are not multiples of the SIMD width, blocks wider than the panels
+bool structuredAccuracyCheck()
+{
+	for (int bandwidth : { 0, 1, 13, 40 })
+	{
+		int size = 150;
+		Matrix<float> M = genBandedPosDefMatrix(size, bandwidth);
+		BandedCholesky<float> chol(size, bandwidth, CholeskyImpl::AUTO);
+		BandedCholesky<double> cholD(size, bandwidth, CholeskyImpl::AUTO);
+		if (!structuredAccuracyCheck<float>(chol, M, BandedLowerMatrix<float>(M, bandwidth), 1e-4f) ||
+			!structuredAccuracyCheck<double>(cholD, toDouble(M), BandedLowerMatrix<double>(toDouble(M), bandwidth), 1e-10))
+			return false;
+	}
+	for (int blockSize : { 1, 5, 37 })
+	{
+		int numBlocks = 7;
+		Matrix<float> M = genBlockTridiagonalPosDefMatrix(numBlocks, blockSize);
+		BlockTridiagonalCholesky<float> chol(numBlocks, blockSize, CholeskyImpl::AUTO);
+		BlockTridiagonalCholesky<double> cholD(numBlocks, blockSize, CholeskyImpl::AUTO);
+		chol.setBlockSize(16);
+		cholD.setBlockSize(16);
+		if (!structuredAccuracyCheck<float>(chol, M, BlockTridiagonalMatrix<float>(M, blockSize), 1e-4f) ||
+			!structuredAccuracyCheck<double>(cholD, toDouble(M), BlockTridiagonalMatrix<double>(toDouble(M), blockSize), 1e-10))
+			return false;
+	}
+	return true;
+}
+
+// Banded and block-tridiagonal factorizations against the dense blocked one on the same matrix
+// Block-tridiagonal runs with blocks of the bandwidth, i.e. on a matrix of twice that bandwidth
+void benchmarkStructured(bench::Harness & h)
+{
+	char sep = ',';
+	std::cout << "Size" << sep << "Bandwidth" << sep << "Banded-LLt" << sep << "Banded-LDLt" << sep << "Banded-solve" << sep
+		<< "BlockTri-LLt" << sep << "Dense-BLK-LLt" << sep << "Banded-MB" << sep << "Full-MB" << std::endl;
+	for (int size : h.sweep(1024, 4096, 4))
+		for (int bandwidth = 8; bandwidth <= 128 && bandwidth < size; bandwidth *= 4)
+		{
+			Matrix<float> M = genBandedPosDefMatrix(size, bandwidth);
+			BandedLowerMatrix<float> P(M, bandwidth);
+			std::string bw = "-bw" + std::to_string(bandwidth);
+			// n b^2 multiply-adds for the factorization, 4 n b for a solve
+			bench::Work bandedWork = { (double)size * bandwidth * bandwidth, (double)P.size() * sizeof(float) };
+			double times[3];
+			BandedCholesky<float> banded(size, bandwidth, CholeskyImpl::AUTO);
+			for (int ldlt = 0; ldlt < 2; ldlt++)
+				times[ldlt] = h.time("Structured", (ldlt ? "Banded-LDLt" : "Banded-LLt") + bw, size,
+					[&] { ldlt ? banded.calculateCholeskyLDLt(P) : banded.calculateCholeskyLLt(P); }, bandedWork);
+			std::vector<float> b(size, 1.0f);
+			times[2] = h.time("Structured", "Banded-solve" + bw, size, [&] { banded.solve(b); }, { 4.0 * size * bandwidth, bandedWork.bytes });
+
+			BlockTridiagonalMatrix<float> B(genBlockTridiagonalPosDefMatrix(size / bandwidth, bandwidth), bandwidth);
+			BlockTridiagonalCholesky<float> blockTri(size / bandwidth, bandwidth, CholeskyImpl::AUTO);
+			double time3 = h.time("Structured", "BlockTri-LLt" + bw, size, [&] { blockTri.calculateCholeskyLLt(B); });
+
+			Cholesky dense(size, CholeskyImpl::BLOCKED);
+			double time4 = h.time("Structured", "Dense-BLK-LLt" + bw, size, [&] { dense.calculateCholeskyLLt(M); }, choleskyWork(size));
+
+			double bandedMB = (double)P.size() * sizeof(float) / (1 << 20);
+			double fullMB = (double)M.rows * M.stride * sizeof(float) / (1 << 20);
+			std::cout << size << sep << bandwidth << sep << times[0] << sep << times[1] << sep << times[2] << sep
+				<< time3 << sep << time4 << sep << bandedMB << sep << fullMB << std::endl;
+		}
+}
+
+// Gaussian kernel matrix of size points in [0, 1)^2, entries computed on request
+// Positive semi-definite with quickly decaying eigenvalues, the use case of the pivoted factorization
+template<typename T>
+struct GaussianKernel
+{
+	GaussianKernel(int size, T width) : x(size), y(size), scale(-1 / (2 * width * width))
+	{
+		for (int i = 0; i < size; i++)
+		{
+			x[i] = (T)rand() / RAND_MAX;
+			y[i] = (T)rand() / RAND_MAX;
+		}
+	}
+
+	T operator()(int i, int j) const
+	{
+		T dx = x[i] - x[j];
+		T dy = y[i] - y[j];
+		return std::exp(scale * (dx * dx + dy * dy));
+	}
+
+	std::vector<T> x, y;
+	T scale;
+};
+
+// ||A - G G^T|| in the trace norm, which for semi-definite A is the trace of A - G G^T
+template<typename T, typename Entry>
+T residualTrace(const Entry & A, const Matrix<T> & G)
+{
+	T trace = 0;
+	for (int i = 0; i < G.rows; i++)
+	{
+		T g = 0;
+		for (int j = 0; j < G.cols; j++)
+			g += G(i, j) * G(i, j);
+		trace += A(i, i) - g;
+	}
+	return trace;
+}
+
+// Exact rank of a semi-definite low-rank matrix, where the unpivoted factorization takes the square root
+// of zero pivots, the full factorization of a definite matrix, and the trace tolerance on a kernel matrix
+template<typename T>
+bool pivotedAccuracyCheck(int size, int rank, T tolerance)
+{
+	Matrix<T> W(size, rank);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < rank; j++)
+			W(i, j) = (T)rand() / RAND_MAX - (T)0.5;
+	Matrix<T> A(size, size);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+		{
+			A(i, j) = 0;
+			for (int q = 0; q < rank; q++)
+				A(i, j) += W(i, q) * W(j, q);
+		}
+
+	PivotedCholesky<T> chol(size, size, CholeskyImpl::AUTO);
+	if (chol.calculateCholeskyLLt(A, tolerance) != rank)
+		return false;
+	Matrix<T> G = chol.getFactor();
+	Matrix<T> L = chol.getCholeskyMatrix();
+	const std::vector<int> & perm = chol.getPermutation();
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+		{
+			T a = 0, b = 0;
+			for (int q = 0; q < rank; q++)
+			{
+				a += G(i, q) * G(j, q);
+				b += L(i, q) * L(j, q);
+			}
+			if (std::abs(a - A(i, j)) > tolerance * 100 || std::abs(b - A(perm[i], perm[j])) > tolerance * 100)
+				return false;
+		}
+
+	// Definite: all n columns, P A P^T = L L^T exactly
+	Matrix<float> Mf = genWellConditionedPosDefMatrix(size);
+	Matrix<T> M(size, size);
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j < size; j++)
+			M(i, j) = Mf(i, j);
+	if (chol.calculateCholeskyLLt(M, 0) != size)
+		return false;
+	G = chol.getFactor();
+	for (int i = 0; i < size; i++)
+		for (int j = 0; j <= i; j++)
+		{
+			T a = 0;
+			for (int q = 0; q < size; q++)
+				a += G(i, q) * G(j, q);
+			if (std::abs(a - M(i, j)) > tolerance * std::abs(M(i, j)) * 10)
+				return false;
+		}
+
+	// Kernel matrix through the callback, the stopping rule bounds the remainder
+	GaussianKernel<T> K(size, (T)0.3);
+	PivotedCholesky<T> low(size, 64, CholeskyImpl::AUTO);
+	T traceTolerance = (T)1e-2;
+	int k = low.calculateCholeskyLLt(K, traceTolerance);
+	return k < 64 && residualTrace(K, low.getFactor()) <= traceTolerance * size * (T)1.01;
+}
+
+// Rank-k factors of kernel matrices through the callback, against the dense blocked factorization
+// of the full matrix (with a shift, as the kernel matrix itself is numerically semi-definite)
+void benchmarkPivoted(bench::Harness & h)
+{
+	char sep = ',';
+	std::cout << "Size" << sep << "Rank" << sep << "Pivoted-LLt" << sep << "Rel-residual-trace" << sep << "Dense-BLK-LLt" << std::endl;
+	for (int size : h.sweep(1024, 4096))
+	{
+		GaussianKernel<float> K(size, 0.2f);
+		double denseTime = 0;
+		{
+			Matrix<float> M(size, size);
+			for (int i = 0; i < size; i++)
+				for (int j = 0; j < size; j++)
+					M(i, j) = K(i, j) + (i == j ? 1e-2f : 0);
+			Cholesky dense(size, CholeskyImpl::BLOCKED);
+			denseTime = h.time("Pivoted", "Dense-BLK-LLt", size, [&] { dense.calculateCholeskyLLt(M); }, choleskyWork(size));
+		}
+		for (int rank = 16; rank <= 256; rank *= 4)
+		{
+			PivotedCholesky<float> chol(size, rank, CholeskyImpl::AUTO);
+			double time2 = h.time("Pivoted", "Pivoted-LLt-rank" + std::to_string(rank), size, [&] { chol.calculateCholeskyLLt(K, 0); },
+				{ (double)size * rank * rank, 0 });
+			std::cout << size << sep << chol.getRank() << sep << time2 << sep << residualTrace(K, chol.getFactor()) / size << sep << denseTime << std::endl;
+		}
+	}
+}
+
+// Out-of-core factorization against the plain C++ one, with a cache of a few tiles so that tiles are evicted
+// and read again, with and without prefetch threads, and the file reopened from its header
+template<typename T>
+bool outOfCoreAccuracyCheck(const Matrix<T> & M, int tileSize, T tolerance)
+{
+	const char * path = "testCholesky_outofcore.tmp";
+	int size = M.rows;
+	BasicCholesky<T> ref(size, CholeskyImpl::CPP);
+	ref.calculateCholeskyLLt(M);
+	Matrix<T> E = ref.getCholeskyMatrix();
+	bool correct = true;
+	for (int numThreads = 0; numThreads <= 2 && correct; numThreads += 2)
+	{
+		{
+			TiledMatrixFile<T> file(path, size, tileSize);
+			file.pack(M);
+		}
+		TiledMatrixFile<T> file(path);
+		OutOfCoreCholesky<T> chol;
+		chol.setCacheBytes(6 * tileSize * tileSize * sizeof(T));
+		chol.setNumPrefetchThreads(numThreads);
+		if (!chol.calculateCholeskyLLt(file) || chol.getStats().bytesWritten == 0)
+			correct = false;
+		Matrix<T> L = file.toMatrix();
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j <= i; j++)
+				if (std::abs(L(i, j) - E(i, j)) > tolerance * std::max((T)1, std::abs(E(i, j))))
+					correct = false;
+	}
+	{
+		TiledMatrixFile<T> file(path, size, tileSize);
+		Matrix<T> N(M);
+		N(size / 2, size / 2) = -1;
+		file.pack(N);
+		if (OutOfCoreCholesky<T>().calculateCholeskyLLt(file))
+			correct = false;
+	}
+	std::remove(path);
+	return correct;
+}
+
+bool outOfCoreAccuracyCheck(int size, int tileSize)
+{
+	Matrix<float> M = genWellConditionedPosDefMatrix(size);
+	return outOfCoreAccuracyCheck<float>(M, tileSize, 1e-4f) && outOfCoreAccuracyCheck<double>(toDouble(M), tileSize, 1e-10);
+}
+
+// Out-of-core factorization with caches of several sizes against the in-memory blocked one, with the file traffic
+// The file is in the working directory and in the page cache after packing, so this measures the cost of the
+// streaming and caching itself rather than of the disk
+void benchmarkOutOfCore(bench::Harness & h)
+{
+	const char * path = "testCholesky_outofcore.tmp";
+	int tileSize = 256;
+	char sep = ',';
+	std::cout << "Size" << sep << "Cache-MB" << sep << "OOC-LLt" << sep << "OOC-GFLOPS" << sep << "MB-read" << sep << "MB-written" << sep
+		<< "Cache-hits" << sep << "Cache-misses" << sep << "Dense-BLK-LLt" << std::endl;
+	for (int size : h.sweep(2048, 4096))
+	{
+		Matrix<float> M = genStructuredPosDefMatrix(size, [](int, int) { return true; });
+		Cholesky dense(size, CholeskyImpl::BLOCKED);
+		double denseTime = h.time("OutOfCore", "Dense-BLK-LLt", size, [&] { dense.calculateCholeskyLLt(M); }, choleskyWork(size));
+
+		for (size_t cacheMB = 4; cacheMB <= 64; cacheMB *= 4)
+		{
+			OutOfCoreCholesky<float> chol;
+			chol.setCacheBytes(cacheMB << 20);
+			// Every call needs a freshly packed file, only the factorization itself is timed
+			std::vector<double> samples;
+			auto run = [&]
+			{
+				TiledMatrixFile<float> file(path, size, tileSize);
+				file.pack(M);
+				chol.calculateCholeskyLLt(file);
+				return chol.getStats().seconds * 1000;
+			};
+			for (int i = 0; i < h.config().warmups; i++)
+				run();
+			for (int i = 0; i < h.config().repetitions; i++)
+				samples.push_back(run());
+			const OutOfCoreStats & stats = chol.getStats();
+			double time = h.record("OutOfCore", "OOC-LLt-cache" + std::to_string(cacheMB) + "MB", size, samples,
+				{ stats.flops, (double)stats.bytesRead + stats.bytesWritten }).stats.median;
+			std::cout << size << sep << cacheMB << sep << time << sep << stats.gflops() << sep
+				<< stats.bytesRead / (1 << 20) << sep << stats.bytesWritten / (1 << 20) << sep << stats.cacheHits << sep
+				<< stats.cacheMisses << sep << denseTime << std::endl;
+		}
+	}
+	std::remove(path);
+}
+
+// Blocked gemm against a plain loop summing in double, on sizes that leave partial micro-tiles and blocks,
+// for A B, A^T B and the lower triangle of A^T A, on one thread and on bands of rows
+template<typename T>
+bool gemmAccuracyCheck(int m, int n, int k, bool transA, bool lower, int numThreads, T tolerance)
+{
+	srand(m + n + k);
+	Matrix<T> A(transA ? k : m, transA ? m : k);
+	Matrix<T> B(k, n);
+	for (int i = 0; i < A.rows; i++)
+		for (int j = 0; j < A.cols; j++)
+			A(i, j) = (T)rand() / RAND_MAX - (T)0.5;
+	for (int i = 0; i < k; i++)
+		for (int j = 0; j < n; j++)
+			B(i, j) = lower ? (i < A.rows && j < A.cols ? A(i, j) : 0) : (T)rand() / RAND_MAX - (T)0.5;
+	Matrix<T> C(m, n);
+	const T untouched = (T)12345;
+	for (int i = 0; i < m; i++)
+		for (int j = 0; j < n; j++)
+			C(i, j) = untouched;
+	util::gemm(transA, lower, m, n, k, A.data, A.stride, B.data, B.stride, C.data, C.stride, numThreads);
+	for (int i = 0; i < m; i++)
+	{
+		for (int j = 0; j < n; j++)
+		{
+			double sum = 0;
+			for (int p = 0; p < k; p++)
+				sum += (double)(transA ? A(p, i) : A(i, p)) * B(p, j);
+			if (lower && j > i)
+			{
+				// Above the diagonal: untouched, or the right value in a tile crossing it
+				if (C(i, j) != untouched && std::abs(C(i, j) - sum) > tolerance * k)
+					return false;
+				if (j >= i + GEMM_MR + GEMM_NR_FLOAT && C(i, j) != untouched)
+					return false;
+				continue;
+			}
+			if (std::abs(C(i, j) - sum) > tolerance * k)
+				return false;
+		}
+	}
+	return true;
+}
+
+bool gemmAccuracyCheck()
+{
+	for (int numThreads : { 1, 3 })
+	{
+		if (!gemmAccuracyCheck<float>(37, 53, 29, false, false, numThreads, 1e-6f) || !gemmAccuracyCheck<double>(37, 53, 29, false, false, numThreads, 1e-14) ||
+			!gemmAccuracyCheck<float>(301, 213, 517, false, false, numThreads, 1e-6f) || !gemmAccuracyCheck<double>(301, 213, 517, false, false, numThreads, 1e-14) ||
+			!gemmAccuracyCheck<float>(301, 213, 517, true, false, numThreads, 1e-6f) || !gemmAccuracyCheck<double>(131, 213, 300, true, false, numThreads, 1e-14) ||
+			!gemmAccuracyCheck<float>(301, 301, 517, true, true, numThreads, 1e-6f) || !gemmAccuracyCheck<double>(253, 253, 300, true, true, numThreads, 1e-14))
+			return false;
+	}
+	return true;
+}
+
+// The previous plain triple loop product against the blocked gemm on one and on all threads, and the lower
+// triangle of M^T M as genRandomPosDefMatrix builds it, in GFLOP/s (2 n^3 for a product, n^3 for syrk)
+void benchmarkGemm(bench::Harness & h)
+{
+	char sep = ',';
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	// With one hardware thread the multithreaded column would repeat Gemm1
+	std::cout << "Size" << sep << "Loop-GFLOPS" << sep << "Gemm1-GFLOPS" << sep;
+	if (maxThreads > 1)
+		std::cout << "Gemm" << maxThreads << "-GFLOPS" << sep;
+	std::cout << "Gemm1-double-GFLOPS" << sep << "Syrk" << maxThreads << "-GFLOPS" << sep << "genRandomPosDefMatrix" << std::endl;
+	for (int size : h.sweep(256, 2048))
+	{
+		Matrix<float> A = genStructuredPosDefMatrix(size, [](int, int) { return true; });
+		Matrix<float> B(A);
+		Matrix<float> C(size, size);
+		bench::Work work = { 2.0 * size * size * size, 0 };
+
+		// The loop takes seconds per call beyond 512
+		double loopGflops = 0;
+		if (size <= 512)
+			loopGflops = h.measure("Gemm", "Loop", size, [&]
+			{
+				for (int r = 0; r < A.rows; r++)
+					for (int c = 0; c < B.cols; c++)
+					{
+						float sum = 0;
+						for (int p = 0; p < A.cols; p++)
+							sum += A(r, p) * B(p, c);
+						C(r, c) = sum;
+					}
+			}, work).gflops();
+
+		double gflops1 = h.measure("Gemm", "Gemm1", size, [&] { product<float>(A, B, C, 1); }, work).gflops();
+		double gflopsAll = 0;
+		if (maxThreads > 1)
+			gflopsAll = h.measure("Gemm", "Gemm" + std::to_string(maxThreads), size, [&] { product<float>(A, B, C, maxThreads); }, work).gflops();
+		Matrix<double> Ad = toDouble(A), Bd = toDouble(B), Cd(size, size);
+		double gflopsDouble = h.measure("Gemm", "Gemm1-double", size, [&] { product<double>(Ad, Bd, Cd); }, work).gflops();
+		double gflopsSyrk = h.measure("Gemm", "Syrk" + std::to_string(maxThreads), size, [&] { syrk<float>(A, C, maxThreads); },
+			{ work.flops / 2, 0 }).gflops();
+		double genTime = h.time("Gemm", "genRandomPosDefMatrix", size, [&] { genRandomPosDefMatrix(size); });
+
+		std::cout << size << sep << loopGflops << sep << gflops1 << sep;
+		if (maxThreads > 1)
+			std::cout << gflopsAll << sep;
+		std::cout << gflopsDouble << sep << gflopsSyrk << sep << genTime << std::endl;
+	}
+}
+
+// Out-of-place, in-place and mirroring transposes against element-wise copies, on sizes with partial tiles,
+// below and above the size at which the recursion splits
+template<typename T>
+bool transposeAccuracyCheck(int rows, int cols)
+{
+	Matrix<T> M(rows, cols);
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < cols; j++)
+			M(i, j) = (T)(i * cols + j);
+	Matrix<T> MT = transpose(M);
+	for (int i = 0; i < rows; i++)
+		for (int j = 0; j < cols; j++)
+			if (MT(j, i) != M(i, j))
+				return false;
+
+	int n = std::min(rows, cols);
+	Matrix<T> S(n, n);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			S(i, j) = M(i, j);
+	transposeInPlace(S);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			if (S(j, i) != M(i, j))
+				return false;
+	mirrorLower(S);
+	for (int i = 0; i < n; i++)
+		for (int j = 0; j < n; j++)
+			if (S(i, j) != M(std::min(i, j), std::max(i, j)))
+				return false;
+	return true;
+}
+
+bool transposeAccuracyCheck()
+{
+	return transposeAccuracyCheck<float>(1, 1) && transposeAccuracyCheck<float>(37, 53) && transposeAccuracyCheck<float>(301, 517) &&
+		transposeAccuracyCheck<double>(37, 53) && transposeAccuracyCheck<double>(517, 301);
+}
+
+// Element-wise loops against the cache-oblivious kernels in GB/s (bytes read plus written), out of place, in place
+// and for the mirroring of getCholeskyMatrix
+void benchmarkTranspose(bench::Harness & h)
+{
+	char sep = ',';
+	std::cout << "Size" << sep << "Loop-GBs" << sep << "Transpose-GBs" << sep << "Loop-InPlace-GBs" << sep << "InPlace-GBs" << sep
+		<< "Loop-Mirror-GBs" << sep << "Mirror-GBs";
+#ifdef HAVE_MKL
+	std::cout << sep << "MKL-omatcopy-GBs";
+#endif
+	std::cout << std::endl;
+	for (int size : h.sweep(256, 2048))
+	{
+		Matrix<float> M(size, size);
+		for (int i = 0; i < size; i++)
+			for (int j = 0; j < size; j++)
+				M(i, j) = (float)(i - j);
+		Matrix<float> MT(size, size);
+		bench::Work work = { 0, 2.0 * size * size * sizeof(float) };
+		bench::Work half = { 0, work.bytes / 2 };
+		auto gbs = [&](const std::string & label, const std::function<void()> & f, bench::Work w) { return h.measure("Transpose", label, size, f, w).gbs(); };
+
+		std::cout << size << sep << gbs("Loop", [&] { for (int i = 0; i < size; i++) for (int j = 0; j < size; j++) MT(j, i) = M(i, j); }, work)
+			<< sep << gbs("Transpose", [&] { util::transpose(M.data, M.stride, MT.data, MT.stride, size, size); }, work)
+			<< sep << gbs("Loop-InPlace", [&] { for (int i = 0; i < size; i++) for (int j = 0; j < i; j++) std::swap(M(i, j), M(j, i)); }, work)
+			<< sep << gbs("InPlace", [&] { transposeInPlace(M); }, work)
+			<< sep << gbs("Loop-Mirror", [&] { for (int i = 0; i < size; i++) for (int j = 0; j < i; j++) M(j, i) = M(i, j); }, half)
+			<< sep << gbs("Mirror", [&] { mirrorLower(M); }, half);
+#ifdef HAVE_MKL
+		std::cout << sep << gbs("MKL-omatcopy", [&] { mkl_somatcopy('R', 'T', size, size, 1.0, M.data, M.stride, MT.data, MT.stride); }, work);
+#endif
+		std::cout << std::endl;
+	}
+}
+
 #ifdef HAVE_MKL
 void callMKLBlockCholesky(Matrix<float> M)
 {
@@ -100,12 +1671,55 @@ void callMKLBlockCholesky(Matrix<float> M)
 }
 #endif
 
+// Every instruction set the CPU supports, through the column loops and a multi right-hand side solve, in float and double
+// AUTO is checked on both sides of the size at which it switches to the blocked algorithm
+bool kernelAccuracyCheck()
+{
+	for (CholeskyImpl impl : { CholeskyImpl::SSE, CholeskyImpl::AVX, CholeskyImpl::FMA, CholeskyImpl::AVX512 })
+	{
+		if (!isSupported(impl))
+			continue;
+		if (!accuracyCheck(impl) || !referenceAccuracyCheck(impl, 53, 16) || !referenceAccuracyCheck(impl, 53, 16, false) ||
+			!solveAccuracyCheck(impl, 53, 37) || !doubleAccuracyCheck(impl, 53, 16))
+			return false;
+	}
+	return referenceAccuracyCheck(CholeskyImpl::AUTO, 53, 16) && referenceAccuracyCheck(CholeskyImpl::AUTO, CHOLESKY_AUTO_BLOCKED_SIZE + 3, 32);
+}
+
 int main(int argc, const char * argv[])
 {
-	// Timings are stable across 5/10/20 runs, so use 5 runs
-	// Timings are not very reliable for small matrices
+	// Timings are not very reliable for small matrices, which are repeated within each sample
+	// See cpp_benchmark/benchmark.hpp for the options, e.g. --max-size 512 --only Cholesky,Solve --csv results.csv
+	bench::Config defaults;
+	defaults.repetitions = 5;
+	bench::Harness h(argc, argv, defaults);
+
+	printCpuFeatures(std::cout);
 
-	if (!accuracyCheck())
+	// Checks of AVX, as of AVX-512, only run on CPUs that have it; AUTO stands in for it everywhere
+	if (!accuracyCheck(CholeskyImpl::AUTO) || !accuracyCheck(CholeskyImpl::BLOCKED) || 
+		(isSupported(CholeskyImpl::AVX) && (!accuracyCheck(CholeskyImpl::AVX) || !referenceAccuracyCheck(CholeskyImpl::AVX, 53, 16) ||
+			!solveAccuracyCheck(CholeskyImpl::AVX, 53, 37) || !inPlaceAccuracyCheck(CholeskyImpl::AVX, 53, 16) || !workspaceCheck(CholeskyImpl::AVX, 53))) ||
+		!referenceAccuracyCheck(CholeskyImpl::BLOCKED, 53, 16) ||
+		!referenceAccuracyCheck(CholeskyImpl::PARALLEL, 53, 8) || !referenceAccuracyCheck(CholeskyImpl::PARALLEL, 300, 32) ||
+		!batchedAccuracyCheck(BatchImpl::CPP, 7, 37) ||
+		(isSupported(BatchImpl::AVX) && (!batchedAccuracyCheck(BatchImpl::AVX, 7, 37) || !batchedAccuracyCheck(BatchImpl::AVX, 20, 16))) ||
+		(isSupported(BatchImpl::AVX512) && (!batchedAccuracyCheck(BatchImpl::AVX512, 7, 37) || !batchedAccuracyCheck(BatchImpl::AVX512, 20, 16))) ||
+		!fixedAccuracyCheck() ||
+		!solveAccuracyCheck(CholeskyImpl::CPP, 53, 1) || !solveAccuracyCheck(CholeskyImpl::AUTO, 53, 37) ||
+		!solveAccuracyCheck(CholeskyImpl::BLOCKED, 300, 300) ||
+		!updateAccuracyCheck(53, 11) || !updateAccuracyCheck(64, 3) || !kernelAccuracyCheck() ||
+		!doubleAccuracyCheck(CholeskyImpl::CPP, 53, 16) || !doubleAccuracyCheck(CholeskyImpl::AUTO, 53, 16) ||
+		!doubleAccuracyCheck(CholeskyImpl::BLOCKED, 53, 16) || !doubleAccuracyCheck(CholeskyImpl::PARALLEL, 300, 32) ||
+		!mixedPrecisionCheck(CholeskyImpl::AUTO, 53) || !mixedPrecisionCheck(CholeskyImpl::BLOCKED, 300) ||
+		!packedAccuracyCheck(53, 16) || !packedAccuracyCheck(300, 32) ||
+		!inPlaceAccuracyCheck(CholeskyImpl::CPP, 53, 16) || !inPlaceAccuracyCheck(CholeskyImpl::AUTO, 53, 16) ||
+		!inPlaceAccuracyCheck(CholeskyImpl::BLOCKED, 53, 16) || !inPlaceAccuracyCheck(CholeskyImpl::PARALLEL, 300, 32) ||
+		!workspaceCheck(CholeskyImpl::CPP, 53) || !workspaceCheck(CholeskyImpl::AUTO, 53) ||
+		!workspaceCheck(CholeskyImpl::BLOCKED, 300) || !workspaceCheck(CholeskyImpl::PARALLEL, 300) ||
+		!sparseAccuracyCheck() || !structuredAccuracyCheck() ||
+		!pivotedAccuracyCheck<float>(150, 7, 1e-4f) || !pivotedAccuracyCheck<double>(150, 7, 1e-10) ||
+		!outOfCoreAccuracyCheck(300, 32) || !gemmAccuracyCheck() || !transposeAccuracyCheck())
 	{
 		throw std::runtime_error("Accuracy check failed, exiting");
 		return 1;
@@ -114,75 +1728,121 @@ int main(int argc, const char * argv[])
 	{
 		std::cout << "accuracy check passed\n";
 	}
-	int numRuns = 2; 
-	int startMSize = 4;
-	int endMSize = 4096;
-
 	char sep = ',';
 
-	std::cout << "Size" << sep << "CPP-LLt" << sep << "AVX-LLt" << sep << "CPP-LDLt" << sep << "AVX-LDLt";
+	// Strong scaling sweep of the task-parallel factorization: 1, 2, 4, ... threads up to all hardware threads
+	std::vector<int> threadCounts;
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	for (int t = 1; t < maxThreads; t *= 2)
+		threadCounts.push_back(t);
+	threadCounts.push_back(maxThreads);
+
+	if (h.enabled("Cholesky"))
+	{
+		std::cout << "Size" << sep << "CPP-LLt" << sep << "AVX-LLt" << sep << "BLK-LLt" << sep << "CPP-LDLt" << sep << "AVX-LDLt" << sep << "BLK-LDLt";
 #ifdef HAVE_MKL
-	std::cout << sep << "BLAS-LLt" << sep << "LAPACK";
+		std::cout << sep << "BLAS-LLt" << sep << "LAPACK";
 #endif
-	std::cout << std::endl;
+		for (int t : threadCounts)
+			std::cout << sep << "PAR" << t << "-LLt";
+		std::cout << sep << "SSE-LLt" << sep << "FMA-LLt" << sep << "AVX512-LLt" << sep << "AUTO-LLt";
+		std::cout << sep << "AVX-1row-LLt" << sep << "AVX-1row-LDLt";
+		std::cout << sep << "Update1-LLt" << sep << "Update16-LLt" << sep << "Update1-LDLt";
+		std::cout << std::endl;
+	}
 
-	for (int mSize = startMSize; mSize <= endMSize; mSize *= 2)
+	for (int mSize : h.enabled("Cholesky") ? h.sweep(4, 4096) : std::vector<int>())
 	{
 		Matrix<float> M = genRandomPosDefMatrix(mSize);
-	
-		//Warmup run
-		Cholesky(mSize, CholeskyImpl::CPP).calculateCholeskyLLt(M);
-		auto t1 = startTimer();
-		for (int i = 0; i < numRuns; i++)
-			Cholesky(mSize, CholeskyImpl::CPP).calculateCholeskyLLt(M);
-		double time1 = endTimer(t1) / numRuns;
-		
-		//Warmup run
-		Cholesky(mSize, CholeskyImpl::AVX).calculateCholeskyLLt(M);
-		auto t2 = startTimer();
-		for (int i = 0; i < numRuns; i++)
-			Cholesky(mSize, CholeskyImpl::AVX).calculateCholeskyLLt(M);
-		double time2 = endTimer(t2) / numRuns;
-
-		//Warmup run
-		Cholesky(mSize, CholeskyImpl::CPP).calculateCholeskyLDLt(M);
-		auto t3 = startTimer();
-		for (int i = 0; i < numRuns; i++)
-			Cholesky(mSize, CholeskyImpl::CPP).calculateCholeskyLDLt(M);
-		double time3 = endTimer(t3) / numRuns;
-
-		//Warmup run
-		Cholesky(mSize, CholeskyImpl::AVX).calculateCholeskyLDLt(M);
-		auto t4 = startTimer();
-		for (int i = 0; i < numRuns; i++)
-			Cholesky(mSize, CholeskyImpl::AVX).calculateCholeskyLDLt(M);
-		double time4 = endTimer(t4) / numRuns;
-		
-#ifdef HAVE_MKL
-		//Warmup run
-		Cholesky(mSize, CholeskyImpl::BLAS).calculateCholeskyLLt(M);
-		auto t5 = startTimer();
-		for (int i = 0; i < numRuns; i++)
-			Cholesky(mSize, CholeskyImpl::BLAS).calculateCholeskyLLt(M);
-		double time5 = endTimer(t5) / numRuns;
-
-		//Warmup run
-		callMKLBlockCholesky(M);
-		auto t6 = startTimer();
-		for (int i = 0; i < numRuns; i++)
-			callMKLBlockCholesky(M);
-		double time6 = endTimer(t6) / numRuns;
+		bench::Work work = choleskyWork(mSize);
+		auto time = [&](const std::string & label, const std::function<void()> & f) { return h.time("Cholesky", label, mSize, f, work); };
 
+		// A new object per call, as the classes were used before they kept their workspace
+		double time1 = time("CPP-LLt", [&] { Cholesky(mSize, CholeskyImpl::CPP).calculateCholeskyLLt(M); });
+		// AVX columns are n/a on CPUs without it
+		bool avx = isSupported(CholeskyImpl::AVX);
+		std::string time2 = timeCell(avx, [&] { return time("AVX-LLt", [&] { Cholesky(mSize, CholeskyImpl::AVX).calculateCholeskyLLt(M); }); });
+		double timeb1 = time("BLK-LLt", [&] { Cholesky(mSize, CholeskyImpl::BLOCKED).calculateCholeskyLLt(M); });
+		double time3 = time("CPP-LDLt", [&] { Cholesky(mSize, CholeskyImpl::CPP).calculateCholeskyLDLt(M); });
+		std::string time4 = timeCell(avx, [&] { return time("AVX-LDLt", [&] { Cholesky(mSize, CholeskyImpl::AVX).calculateCholeskyLDLt(M); }); });
+		double timeb2 = time("BLK-LDLt", [&] { Cholesky(mSize, CholeskyImpl::BLOCKED).calculateCholeskyLDLt(M); });
+#ifdef HAVE_MKL
+		double time5 = time("BLAS-LLt", [&] { Cholesky(mSize, CholeskyImpl::BLAS).calculateCholeskyLLt(M); });
+		double time6 = time("LAPACK", [&] { callMKLBlockCholesky(M); });
 #endif
 		
 		// times are in milliseconds
-		std::cout << mSize << sep << time1 << sep << time2 << sep << time3 << sep << time4 << sep;
+		std::cout << mSize << sep << time1 << sep << time2 << sep << timeb1 << sep << time3 << sep << time4 << sep << timeb2 << sep;
 #ifdef HAVE_MKL
-		std::cout << time5 << sep << time6;
-		//std::cout << "\tLAPACK\t" << diff6 / (numRuns) << "\t";
+		std::cout << time5 << sep << time6 << sep;
 #endif
+		for (int t : threadCounts)
+		{
+			// The pool is kept by the Cholesky object, so thread startup is not timed
+			Cholesky chol(mSize, CholeskyImpl::PARALLEL);
+			chol.setNumThreads(t);
+			std::cout << time("PAR" + std::to_string(t) + "-LLt", [&] { chol.calculateCholeskyLLt(M); }) << sep;
+		}
+
+		// The other instruction sets of the column-by-column algorithm, and the runtime choice
+		for (CholeskyImpl impl : { CholeskyImpl::SSE, CholeskyImpl::FMA, CholeskyImpl::AVX512, CholeskyImpl::AUTO })
+		{
+			if (!isSupported(impl))
+			{
+				std::cout << "n/a" << sep;
+				continue;
+			}
+			Cholesky chol(mSize, impl);
+			const char * name = impl == CholeskyImpl::SSE ? "SSE-LLt" : impl == CholeskyImpl::FMA ? "FMA-LLt" : impl == CholeskyImpl::AVX512 ? "AVX512-LLt" : "AUTO-LLt";
+			std::cout << time(name, [&] { chol.calculateCholeskyLLt(M); }) << sep;
+		}
+
+		// The AVX columns above compute CHOLESKY_DOT_ROWS entries per kernel call, these one entry per call
+		for (int ldlt = 0; ldlt < 2; ldlt++)
+		{
+			if (!avx)
+			{
+				std::cout << "n/a" << sep;
+				continue;
+			}
+			Cholesky chol(mSize, CholeskyImpl::AVX);
+			chol.setMultiRowDot(false);
+			std::cout << time(ldlt ? "AVX-1row-LDLt" : "AVX-1row-LLt", [&] { ldlt ? chol.calculateCholeskyLDLt(M) : chol.calculateCholeskyLLt(M); }) << sep;
+		}
+
+		// Low-rank modifications of an existing factor, to compare with refactorizing (BLK columns)
+		std::vector<float> v(mSize);
+		Matrix<float> V(mSize, 16);
+		for (int i = 0; i < mSize; i++)
+		{
+			v[i] = (float)rand() / RAND_MAX;
+			for (int j = 0; j < 16; j++)
+				V(i, j) = (float)rand() / RAND_MAX;
+		}
+		for (int kind = 0; kind < 3; kind++)
+		{
+			Cholesky chol(mSize, CholeskyImpl::BLOCKED);
+			if (kind == 2)
+				chol.calculateCholeskyLDLt(M);
+			else
+				chol.calculateCholeskyLLt(M);
+			const char * name = kind == 0 ? "Update1-LLt" : kind == 1 ? "Update16-LLt" : "Update1-LDLt";
+			std::cout << h.time("Cholesky", name, mSize, [&] { kind == 1 ? chol.update(V) : chol.update(v); }) << sep;
+		}
 		std::cout << std::endl;
 	}
+
+	// Tables by name, for --only
+	const std::pair<const char *, void (*)(bench::Harness &)> tables[] = {
+		{ "Batched", benchmarkBatched }, { "Fixed", benchmarkFixed }, { "Solve", benchmarkSolve }, { "Precision", benchmarkPrecision },
+		{ "Packed", benchmarkPacked }, { "Workspace", benchmarkWorkspace }, { "Sparse", benchmarkSparse }, { "Structured", benchmarkStructured },
+		{ "Pivoted", benchmarkPivoted }, { "OutOfCore", benchmarkOutOfCore }, { "Gemm", benchmarkGemm }, { "Transpose", benchmarkTranspose } };
+	for (const auto & table : tables)
+		if (h.enabled(table.first))
+			table.second(h);
+
+	// Cycles, IPC and miss rates of every measurement and library region, with --counters
+	h.printCounters(std::cout);
 	
 	return 0;
 }
\ No newline at end of file
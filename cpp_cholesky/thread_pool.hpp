@@ -0,0 +1,155 @@
+#ifndef _LINALG_THREAD_POOL_HPP_
+#define _LINALG_THREAD_POOL_HPP_
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace linalg{
+
+/// Work-stealing thread pool built on std::thread only
+/// Every worker owns a deque: it pushes and pops its own tasks at the back (LIFO, cache-warm),
+/// idle workers steal from the front of the other deques (FIFO, oldest and usually largest work)
+/// The thread calling wait() acts as worker 0, so a pool of size 1 starts no threads at all
+/// Tasks receive the index of the worker running them, to spawn follow-up tasks and to use per-worker scratch memory
+class WorkStealingPool
+{
+public:
+	typedef std::function<void(int worker)> Task;
+
+	explicit WorkStealingPool(int numThreads) : m_pending(0), m_queued(0), m_stop(false)
+	{
+		if (numThreads < 1)
+			numThreads = 1;
+		for (int i = 0; i < numThreads; i++)
+			m_queues.emplace_back(new Queue());
+		for (int i = 1; i < numThreads; i++)
+			m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+	}
+
+	~WorkStealingPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_sleepLock);
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		for (auto & t : m_threads)
+			t.join();
+	}
+
+	WorkStealingPool(const WorkStealingPool &) = delete;
+	WorkStealingPool & operator=(const WorkStealingPool &) = delete;
+
+	int size() const { return (int)m_queues.size(); }
+
+	/// Queue a task on the given worker, call from inside a task with its own worker index
+	/// or from the owning thread (worker 0) before wait()
+	void spawn(int worker, Task task)
+	{
+		m_pending++;
+		m_queued++;
+		{
+			Queue & q = *m_queues[worker];
+			std::lock_guard<std::mutex> lock(q.lock);
+			q.tasks.push_back(std::move(task));
+		}
+		// Taking the lock orders the notification after a sleeper's predicate check
+		{
+			std::lock_guard<std::mutex> lock(m_sleepLock);
+		}
+		m_wake.notify_one();
+	}
+
+	/// Run tasks on the calling thread until every spawned task, including the ones spawned by tasks, has finished
+	void wait()
+	{
+		while (m_pending > 0)
+		{
+			if (!runOne(0))
+			{
+				std::unique_lock<std::mutex> lock(m_sleepLock);
+				m_wake.wait(lock, [this] { return m_queued > 0 || m_pending == 0; });
+			}
+		}
+	}
+
+private:
+	struct Queue
+	{
+		std::mutex lock;
+		std::deque<Task> tasks;
+	};
+
+	bool popOwn(int worker, Task & task)
+	{
+		Queue & q = *m_queues[worker];
+		std::lock_guard<std::mutex> lock(q.lock);
+		if (q.tasks.empty())
+			return false;
+		task = std::move(q.tasks.back());
+		q.tasks.pop_back();
+		return true;
+	}
+
+	bool steal(int worker, Task & task)
+	{
+		int n = size();
+		for (int i = 1; i < n; i++)
+		{
+			Queue & q = *m_queues[(worker + i) % n];
+			std::lock_guard<std::mutex> lock(q.lock);
+			if (!q.tasks.empty())
+			{
+				task = std::move(q.tasks.front());
+				q.tasks.pop_front();
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool runOne(int worker)
+	{
+		Task task;
+		if (!popOwn(worker, task) && !steal(worker, task))
+			return false;
+		m_queued--;
+		task(worker);
+		if (--m_pending == 0)
+		{
+			std::lock_guard<std::mutex> lock(m_sleepLock);
+			m_wake.notify_all();
+		}
+		return true;
+	}
+
+	void workerLoop(int worker)
+	{
+		while (true)
+		{
+			if (runOne(worker))
+				continue;
+			std::unique_lock<std::mutex> lock(m_sleepLock);
+			m_wake.wait(lock, [this] { return m_queued > 0 || m_stop; });
+			if (m_stop)
+				return;
+		}
+	}
+
+	std::vector<std::unique_ptr<Queue>> m_queues;
+	std::vector<std::thread> m_threads;
+	std::atomic<int> m_pending; // spawned but not finished
+	std::atomic<int> m_queued;  // spawned but not started
+	bool m_stop;
+	std::mutex m_sleepLock;
+	std::condition_variable m_wake;
+};
+
+}
+#endif
@@ -0,0 +1,149 @@
+#ifndef _LINALG_TILED_FILE_HPP_
+#define _LINALG_TILED_FILE_HPP_
+
+#include "matrix.hpp"
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace linalg{
+
+// Lower triangle of a symmetric n x n matrix in a file, as square tiles in the order of PackedLowerMatrix:
+// tile (i, j), j <= i, is the (i (i + 1) / 2 + j)-th one, row-major with the tile size as stride
+// The file starts with a header page, every tile starts on a multiple of MEM_ALIGNMENT bytes, so a tile
+// copied to or from aligned memory is one aligned stream, and the whole file is mapped into memory
+// Matrices larger than RAM are fine: pages come and go as the kernel sees fit, see OutOfCoreCholesky
+// for bounded, explicit caching
+template<typename T>
+class TiledMatrixFile
+{
+public:
+	static const size_t HEADER_BYTES = 4096;
+
+	/// New file of zeros, an existing file is overwritten
+	/// Throws std::runtime_error if the file cannot be created or mapped
+	TiledMatrixFile(const std::string & path, int n, int tileSize) : rows(n), cols(n), tileSize(tileSize), numTiles((n + tileSize - 1) / tileSize)
+	{
+		assert(tileSize % 4 == 0);
+		m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+		if (m_fd < 0)
+			throw std::runtime_error("TiledMatrixFile: cannot create " + path);
+		if (ftruncate(m_fd, (off_t)fileBytes()) != 0)
+		{
+			::close(m_fd);
+			throw std::runtime_error("TiledMatrixFile: cannot resize " + path);
+		}
+		map(path);
+		Header * h = (Header *)m_map;
+		h->magic = MAGIC;
+		h->elementSize = sizeof(T);
+		h->n = n;
+		h->tileSize = tileSize;
+	}
+
+	/// Existing file, written by the constructor above with the same element type
+	/// Throws std::runtime_error if it cannot be opened or is not such a file
+	explicit TiledMatrixFile(const std::string & path)
+	{
+		m_fd = ::open(path.c_str(), O_RDWR);
+		if (m_fd < 0)
+			throw std::runtime_error("TiledMatrixFile: cannot open " + path);
+		Header h;
+		if (pread(m_fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || h.magic != MAGIC || h.elementSize != sizeof(T))
+		{
+			::close(m_fd);
+			throw std::runtime_error("TiledMatrixFile: not a tiled matrix file " + path);
+		}
+		rows = cols = h.n;
+		tileSize = h.tileSize;
+		numTiles = (rows + tileSize - 1) / tileSize;
+		map(path);
+	}
+
+	TiledMatrixFile(const TiledMatrixFile &) = delete;
+	TiledMatrixFile & operator=(const TiledMatrixFile &) = delete;
+
+	~TiledMatrixFile()
+	{
+		munmap(m_map, fileBytes());
+		::close(m_fd);
+	}
+
+	/// Copies the lower triangle of M, its upper triangle is not read
+	void pack(const Matrix<T> & M)
+	{
+		assert(M.rows == rows && M.cols == cols);
+		for (int r = 0; r < rows; r++)
+			for (int c = 0; c <= r; c++)
+				(*this)(r, c) = M(r, c);
+	}
+
+	/// Full matrix, the upper triangle mirrors the lower one
+	Matrix<T> toMatrix() const
+	{
+		Matrix<T> M(rows, cols);
+		for (int r = 0; r < rows; r++)
+			for (int c = 0; c <= r; c++)
+				M(r, c) = M(c, r) = (*this)(r, c);
+		return M;
+	}
+
+	/// Writes dirty pages back to the file, blocking
+	void sync() { msync(m_map, fileBytes(), MS_SYNC); }
+
+	T * tile(int i, int j) { return (T *)(m_map + tileOffset(i, j)); }
+	const T * tile(int i, int j) const { return (const T *)(m_map + tileOffset(i, j)); }
+	/// Rows (and columns) of tile row i that lie inside the matrix
+	int tileRows(int i) const { return std::min(tileSize, rows - i * tileSize); }
+
+	/// Element (r, c) of the lower triangle, r >= c
+	T & operator()(int r, int c) { return tile(r / tileSize, c / tileSize)[(r % tileSize) * tileSize + c % tileSize]; }
+	const T & operator()(int r, int c) const { return tile(r / tileSize, c / tileSize)[(r % tileSize) * tileSize + c % tileSize]; }
+
+	/// Bytes of one tile in the file, padding to MEM_ALIGNMENT included
+	size_t tileBytes() const { return ((size_t)tileSize * tileSize * sizeof(T) + MEM_ALIGNMENT - 1) / MEM_ALIGNMENT * MEM_ALIGNMENT; }
+	size_t fileBytes() const { return HEADER_BYTES + (size_t)numTiles * (numTiles + 1) / 2 * tileBytes(); }
+
+	int rows;
+	int cols;
+	int tileSize;
+	int numTiles;
+
+private:
+	static const unsigned MAGIC = 0x4c54494c; // "LITL"
+
+	struct Header
+	{
+		unsigned magic;
+		unsigned elementSize;
+		int n;
+		int tileSize;
+	};
+
+	size_t tileOffset(int i, int j) const
+	{
+		assert(j <= i && i < numTiles);
+		return HEADER_BYTES + ((size_t)i * (i + 1) / 2 + j) * tileBytes();
+	}
+
+	void map(const std::string & path)
+	{
+		void * p = mmap(NULL, fileBytes(), PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+		if (p == MAP_FAILED)
+		{
+			::close(m_fd);
+			throw std::runtime_error("TiledMatrixFile: cannot map " + path);
+		}
+		m_map = (char *)p;
+	}
+
+	int m_fd;
+	char * m_map;
+};
+
+}
+#endif
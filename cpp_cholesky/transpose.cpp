@@ -0,0 +1,196 @@
+#include <algorithm>
+
+#include "matrix.hpp"
+#include "cpu_features.hpp"
+#include "cholesky_kernels.hpp"
+
+// Cache-oblivious transposes: the larger dimension is halved until a block and its transposed copy fit in L1
+// together, whatever the cache sizes, so every cache line is read and written once instead of every store of
+// an element-wise loop missing once the columns of the destination no longer fit in cache
+// Leaves go through the SIMD tile kernels, which transpose 8x8 floats (AVX) or 4x4 (SSE) in registers; splits
+// are on multiples of the tile, so only the last rows and columns of the matrix are left to scalar loops
+// In place, the two halves of the off-diagonal blocks are swapped and transposed by the same recursion, and
+// mirroring the lower triangle is the out-of-place transpose of the blocks below the diagonal into those above
+
+namespace linalg{
+
+	// Bytes of one leaf block, with the destination as large, in a 32KB L1
+	const size_t TRANSPOSE_LEAF_BYTES = 16384;
+
+	template<typename T>
+	struct TransposeKernels
+	{
+		int tile; // rows and columns handed to the kernels are multiples of it
+		void (*transpose)(const T * src, int lds, T * dst, int ldd, int rows, int cols);
+		void (*swap)(T * a, T * b, int ld, int rows, int cols);
+	};
+
+	template<typename T>
+	static void transposeCPP(const T * src, int lds, T * dst, int ldd, int rows, int cols)
+	{
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < cols; j++)
+				dst[(size_t)j * ldd + i] = src[(size_t)i * lds + j];
+	}
+
+	template<typename T>
+	static void transposeSwapCPP(T * a, T * b, int ld, int rows, int cols)
+	{
+		for (int i = 0; i < rows; i++)
+			for (int j = 0; j < (a == b ? i : cols); j++)
+				std::swap(a[(size_t)i * ld + j], b[(size_t)j * ld + i]);
+	}
+
+	template<typename T>
+	static TransposeKernels<T> selectTransposeKernels()
+	{
+		const CpuFeatures & f = cpuFeatures();
+		if (f.avx)
+			return { (int)(32 / sizeof(T)), &transposeAVX, &transposeSwapAVX };
+		if (f.sse3)
+			return { (int)(16 / sizeof(T)), &transposeSSE, &transposeSwapSSE };
+		return { 1, &transposeCPP<T>, &transposeSwapCPP<T> };
+	}
+
+	template<typename T>
+	static const TransposeKernels<T> & transposeKernels()
+	{
+		static const TransposeKernels<T> kernels = selectTransposeKernels<T>();
+		return kernels;
+	}
+
+	template<typename T>
+	static bool isLeaf(int rows, int cols)
+	{
+		return (size_t)rows * cols * sizeof(T) <= TRANSPOSE_LEAF_BYTES;
+	}
+
+	// About half of size, on a multiple of the tile
+	static int splitPoint(int size, int tile)
+	{
+		int h = size / 2 / tile * tile;
+		return h > 0 ? h : size / 2;
+	}
+
+	template<typename T>
+	static void transposeRec(const TransposeKernels<T> & k, const T * src, int lds, T * dst, int ldd, int rows, int cols)
+	{
+		if (isLeaf<T>(rows, cols))
+		{
+			int rt = rows / k.tile * k.tile;
+			int ct = cols / k.tile * k.tile;
+			k.transpose(src, lds, dst, ldd, rt, ct);
+			transposeCPP(src + ct, lds, dst + (size_t)ct * ldd, ldd, rows, cols - ct);
+			transposeCPP(src + (size_t)rt * lds, lds, dst + rt, ldd, rows - rt, ct);
+		}
+		else if (rows >= cols)
+		{
+			int h = splitPoint(rows, k.tile);
+			transposeRec(k, src, lds, dst, ldd, h, cols);
+			transposeRec(k, src + (size_t)h * lds, lds, dst + h, ldd, rows - h, cols);
+		}
+		else
+		{
+			int h = splitPoint(cols, k.tile);
+			transposeRec(k, src, lds, dst, ldd, rows, h);
+			transposeRec(k, src + h, lds, dst + (size_t)h * ldd, ldd, rows, cols - h);
+		}
+	}
+
+	// a (rows x cols) and b (cols x rows) distinct blocks of one matrix
+	template<typename T>
+	static void swapRec(const TransposeKernels<T> & k, T * a, T * b, int ld, int rows, int cols)
+	{
+		if (isLeaf<T>(rows, cols))
+		{
+			int rt = rows / k.tile * k.tile;
+			int ct = cols / k.tile * k.tile;
+			k.swap(a, b, ld, rt, ct);
+			transposeSwapCPP(a + ct, b + (size_t)ct * ld, ld, rows, cols - ct);
+			transposeSwapCPP(a + (size_t)rt * ld, b + rt, ld, rows - rt, ct);
+		}
+		else if (rows >= cols)
+		{
+			int h = splitPoint(rows, k.tile);
+			swapRec(k, a, b, ld, h, cols);
+			swapRec(k, a + (size_t)h * ld, b + h, ld, rows - h, cols);
+		}
+		else
+		{
+			int h = splitPoint(cols, k.tile);
+			swapRec(k, a, b, ld, rows, h);
+			swapRec(k, a + h, b + (size_t)h * ld, ld, rows, cols - h);
+		}
+	}
+
+	template<typename T>
+	static void transposeInPlaceRec(const TransposeKernels<T> & k, T * A, int lda, int n)
+	{
+		if (isLeaf<T>(n, n))
+		{
+			int nt = n / k.tile * k.tile;
+			k.swap(A, A, lda, nt, nt);
+			transposeSwapCPP(A + nt, A + (size_t)nt * lda, lda, nt, n - nt);
+			transposeSwapCPP(A + (size_t)nt * lda + nt, A + (size_t)nt * lda + nt, lda, n - nt, n - nt);
+			return;
+		}
+		int h = splitPoint(n, k.tile);
+		transposeInPlaceRec(k, A, lda, h);
+		transposeInPlaceRec(k, A + (size_t)h * lda + h, lda, n - h);
+		swapRec(k, A + h, A + (size_t)h * lda, lda, h, n - h);
+	}
+
+	template<typename T>
+	static void mirrorLowerRec(const TransposeKernels<T> & k, T * A, int lda, int n)
+	{
+		if (isLeaf<T>(n, n))
+		{
+			// Strip left of every diagonal tile into the strip above it, then the diagonal tiles and the last rows
+			int nt = n / k.tile * k.tile;
+			for (int i = k.tile; i < nt; i += k.tile)
+				k.transpose(A + (size_t)i * lda, lda, A + i, lda, k.tile, i);
+			for (int i = 0; i < n; i++)
+				for (int j = i < nt ? i / k.tile * k.tile : 0; j < i; j++)
+					A[(size_t)j * lda + i] = A[(size_t)i * lda + j];
+			return;
+		}
+		int h = splitPoint(n, k.tile);
+		mirrorLowerRec(k, A, lda, h);
+		mirrorLowerRec(k, A + (size_t)h * lda + h, lda, n - h);
+		transposeRec(k, A + (size_t)h * lda, lda, A + h, lda, n - h, h);
+	}
+
+namespace util {
+
+	void transpose(const float * src, int lds, float * dst, int ldd, int rows, int cols)
+	{
+		transposeRec(transposeKernels<float>(), src, lds, dst, ldd, rows, cols);
+	}
+
+	void transpose(const double * src, int lds, double * dst, int ldd, int rows, int cols)
+	{
+		transposeRec(transposeKernels<double>(), src, lds, dst, ldd, rows, cols);
+	}
+
+	void transposeInPlace(float * A, int lda, int n)
+	{
+		transposeInPlaceRec(transposeKernels<float>(), A, lda, n);
+	}
+
+	void transposeInPlace(double * A, int lda, int n)
+	{
+		transposeInPlaceRec(transposeKernels<double>(), A, lda, n);
+	}
+
+	void mirrorLower(float * A, int lda, int n)
+	{
+		mirrorLowerRec(transposeKernels<float>(), A, lda, n);
+	}
+
+	void mirrorLower(double * A, int lda, int n)
+	{
+		mirrorLowerRec(transposeKernels<double>(), A, lda, n);
+	}
+
+}
+}
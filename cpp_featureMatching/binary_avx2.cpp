@@ -0,0 +1,64 @@
+#include <immintrin.h> //AVX2
+
+#include "feature_kernels.hpp"
+
+// Assumes the machine has AVX2, binary_features.cpp only selects this kernel when cpuFeatures() reports it
+// A 256-bit descriptor is one register. Popcount by nibble lookup (Mula): shuffle_epi8 looks up the bit counts of
+// the low and the high nibble of every byte in a 16-entry table, sad_epu8 against zero adds the byte counts into
+// four 64-bit sums. Four descriptors at a time share the horizontal reduction of these sums
+
+namespace features{
+
+	// Bit count of every byte
+	static inline __m256i popcountBytes(__m256i x)
+	{
+		const __m256i table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+		const __m256i nibble = _mm256_set1_epi8(0x0f);
+		__m256i lo = _mm256_and_si256(x, nibble);
+		__m256i hi = _mm256_and_si256(_mm256_srli_epi16(x, 4), nibble);
+		return _mm256_add_epi8(_mm256_shuffle_epi8(table, lo), _mm256_shuffle_epi8(table, hi));
+	}
+
+	// Four 64-bit partial counts of query ^ d
+	static inline __m256i partialCounts(__m256i query, const unsigned long long * d)
+	{
+		__m256i x = _mm256_xor_si256(query, _mm256_loadu_si256((const __m256i *)d));
+		return _mm256_sad_epu8(popcountBytes(x), _mm256_setzero_si256());
+	}
+
+	template<bool Indexed>
+	static void hamming(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist)
+	{
+		static_assert(BINARY_WORDS == 4, "one register per descriptor");
+		__m256i q = _mm256_loadu_si256((const __m256i *)query);
+		auto row = [&](int i) { return descriptors + (size_t)(Indexed ? ids[i] : i) * BINARY_WORDS; };
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			__m256i a = partialCounts(q, row(i));
+			__m256i b = partialCounts(q, row(i + 1));
+			__m256i c = partialCounts(q, row(i + 2));
+			__m256i d = partialCounts(q, row(i + 3));
+			// The counts fit in 32 bits: a and b, c and d share 64-bit lanes, then the lanes are added up
+			__m256i ab = _mm256_or_si256(a, _mm256_slli_epi64(b, 32));
+			__m256i cd = _mm256_or_si256(c, _mm256_slli_epi64(d, 32));
+			__m256i s = _mm256_add_epi32(_mm256_unpacklo_epi64(ab, cd), _mm256_unpackhi_epi64(ab, cd));
+			_mm_storeu_si128((__m128i *)(dist + i), _mm_add_epi32(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1)));
+		}
+		for (; i < count; i++)
+		{
+			__m256i s = partialCounts(q, row(i));
+			__m128i h = _mm_add_epi64(_mm256_castsi256_si128(s), _mm256_extracti128_si256(s, 1));
+			dist[i] = _mm_cvtsi128_si32(_mm_add_epi64(h, _mm_unpackhi_epi64(h, h)));
+		}
+	}
+
+	void hammingAVX2(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist)
+	{
+		if (ids)
+			hamming<true>(query, descriptors, ids, count, dist);
+		else
+			hamming<false>(query, descriptors, ids, count, dist);
+	}
+
+}
@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <stdexcept>
+#include <thread>
+
+#include "binary_features.hpp"
+#include "top_k.hpp"
+#include "cpp_cholesky/cpu_features.hpp"
+#include "cpp_benchmark/perf_counters.hpp"
+
+// BinaryMatcher is organized as QuantizedFeatures: the database split across threads, every chunk that fits in L2
+// compared with all the queries in turn
+// MultiIndexHash: with the descriptors split into m substrings, by the pigeonhole principle two descriptors at
+// distance d <= m s + j have a pair of substrings at distance <= s in one of the tables 0 .. j, or at distance
+// <= s - 1 in one of the others. Looking up the buckets within s of the query's substring in every table in turn,
+// for s = 0, 1, ..., after table j every descriptor within m s + j has been a candidate, and the search stops once
+// the k-th best distance found, or maxDistance, is within that (Norouzi, Punjani and Fleet)
+// Candidates found in several tables are compared once; the buckets of a table are the ranges of a counting sort of
+// the descriptors by substring
+
+namespace features{
+
+	// Bytes of descriptors compared with all the queries before moving on
+	const size_t BINARY_CHUNK_BYTES = 256 * 1024;
+
+	typedef void (*HammingKernel)(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist);
+
+	static int popcount64(unsigned long long x)
+	{
+		x = x - ((x >> 1) & 0x5555555555555555ull);
+		x = (x & 0x3333333333333333ull) + ((x >> 2) & 0x3333333333333333ull);
+		x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0full;
+		return (int)((x * 0x0101010101010101ull) >> 56);
+	}
+
+	// Plain C++ kernel for machines without POPCNT
+	static void hammingCPP(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const unsigned long long * d = descriptors + (size_t)(ids ? ids[i] : i) * BINARY_WORDS;
+			int sum = 0;
+			for (int w = 0; w < BINARY_WORDS; w++)
+				sum += popcount64(query[w] ^ d[w]);
+			dist[i] = sum;
+		}
+	}
+
+	bool isSupported(HammingImpl impl)
+	{
+		const linalg::CpuFeatures & f = linalg::cpuFeatures();
+		return impl == HammingImpl::POPCNT ? f.popcnt : impl == HammingImpl::AVX2 ? f.avx2 : true;
+	}
+
+	// The kernel of impl, AUTO resolved
+	static HammingKernel hammingKernel(HammingImpl impl)
+	{
+		if (!isSupported(impl))
+			throw std::runtime_error("Hamming distances: instruction set not supported by this CPU");
+		if (impl == HammingImpl::AUTO)
+			impl = isSupported(HammingImpl::AVX2) ? HammingImpl::AVX2 : isSupported(HammingImpl::POPCNT) ? HammingImpl::POPCNT : HammingImpl::CPP;
+		return impl == HammingImpl::AVX2 ? &hammingAVX2 : impl == HammingImpl::POPCNT ? &hammingPOPCNT : &hammingCPP;
+	}
+
+	void hammingDistances(const BinaryDescriptor & query, const BinaryDescriptor * descriptors, int count, int * dist, HammingImpl impl)
+	{
+		HammingKernel kernel = hammingKernel(impl);
+		if (count > 0)
+			kernel(query.bits, descriptors[0].bits, NULL, count, dist);
+	}
+
+	BinaryMatcher::BinaryMatcher(const BinaryDescriptor * descriptors, int count, HammingImpl impl)
+		: m_descriptors(descriptors, descriptors + count), m_impl(impl)
+	{
+		hammingKernel(impl);
+	}
+
+	void BinaryMatcher::match(const BinaryDescriptor * queries, int numQueries, int k, std::vector<Match> & matches, int maxDistance) const
+	{
+		HammingKernel kernel = hammingKernel(m_impl);
+		int count = size();
+		matches.assign((size_t)numQueries * k, Match{ -1, std::numeric_limits<float>::infinity() });
+		if (numQueries == 0 || k <= 0 || count == 0)
+			return;
+
+		int numThreads = m_numThreads > 0 ? m_numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+		numThreads = std::min(numThreads, count);
+		int chunk = (int)(BINARY_CHUNK_BYTES / sizeof(BinaryDescriptor));
+		std::vector<TopK> tops(numThreads, TopK(numQueries, k));
+		auto scan = [&](int t)
+		{
+			BENCH_COUNTERS_SCOPE("binary-matcher");
+			int i0 = (int)((long)count * t / numThreads);
+			int i1 = (int)((long)count * (t + 1) / numThreads);
+			TopK & top = tops[t];
+			std::vector<int> dist(chunk);
+			// Distances are whole numbers; the k-th distance is infinite until k are found
+			const float limit = maxDistance + 0.5f;
+			std::vector<float> bounds(numQueries, limit);
+			for (int c0 = i0; c0 < i1; c0 += chunk)
+			{
+				int n = std::min(chunk, i1 - c0);
+				for (int q = 0; q < numQueries; q++)
+				{
+					kernel(queries[q].bits, m_descriptors[c0].bits, NULL, n, &dist[0]);
+					for (int i = 0; i < n; i++)
+						if (dist[i] < bounds[q])
+							bounds[q] = std::min(limit, top.insert(q, (float)dist[i], c0 + i));
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		for (int t = 1; t < numThreads; t++)
+			threads.push_back(std::thread(scan, t));
+		scan(0);
+		for (std::thread & thread : threads)
+			thread.join();
+		TopK & top = tops[0];
+		for (int t = 1; t < numThreads; t++)
+			top.merge(tops[t], numQueries);
+		for (int q = 0; q < numQueries; q++)
+			for (int r = 0; r < k && top.index[(size_t)q * k + r] >= 0; r++)
+				matches[(size_t)q * k + r] = Match{ top.index[(size_t)q * k + r], top.dist[(size_t)q * k + r] };
+	}
+
+	MultiIndexHash::MultiIndexHash(const BinaryDescriptor * descriptors, int count, int substringBits, HammingImpl impl)
+		: m_descriptors(descriptors, descriptors + count), m_bits(substringBits), m_numTables(BINARY_WORDS * 64 / substringBits), m_impl(impl)
+	{
+		assert(substringBits >= 1 && substringBits <= 16 && 64 % substringBits == 0);
+		hammingKernel(impl);
+		size_t numBuckets = (size_t)1 << m_bits;
+		m_offsets.assign((size_t)m_numTables * (numBuckets + 1), 0);
+		m_ids.resize((size_t)m_numTables * count);
+		for (int t = 0; t < m_numTables; t++)
+		{
+			int * offsets = &m_offsets[t * (numBuckets + 1)];
+			for (int i = 0; i < count; i++)
+				offsets[substring(descriptors[i], t) + 1]++;
+			for (size_t b = 0; b < numBuckets; b++)
+				offsets[b + 1] += offsets[b];
+			// Filled through the starts, which end up as the starts of the next buckets, then shifted back
+			int * ids = &m_ids[(size_t)t * count];
+			for (int i = 0; i < count; i++)
+				ids[offsets[substring(descriptors[i], t)]++] = i;
+			for (size_t b = numBuckets; b > 0; b--)
+				offsets[b] = offsets[b - 1];
+			offsets[0] = 0;
+		}
+	}
+
+	unsigned MultiIndexHash::substring(const BinaryDescriptor & d, int table) const
+	{
+		int bit = table * m_bits;
+		return (unsigned)(d.bits[bit / 64] >> (bit % 64)) & ((1u << m_bits) - 1);
+	}
+
+	void MultiIndexHash::match(const BinaryDescriptor * queries, int numQueries, int k, std::vector<Match> & matches, int maxDistance) const
+	{
+		HammingKernel kernel = hammingKernel(m_impl);
+		int count = size();
+		matches.assign((size_t)numQueries * k, Match{ -1, std::numeric_limits<float>::infinity() });
+		if (numQueries == 0 || k <= 0 || count == 0)
+			return;
+
+		// Threads take contiguous ranges of queries, and only touch their lists
+		TopK top(numQueries, k);
+		int numThreads = m_numThreads > 0 ? m_numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+		numThreads = std::min(numThreads, numQueries);
+		size_t numBuckets = (size_t)1 << m_bits;
+		auto run = [&](int t)
+		{
+			BENCH_COUNTERS_SCOPE("multi-index-hash");
+			// The last query that made every descriptor a candidate
+			std::vector<int> seen(count, -1);
+			std::vector<int> candidates;
+			std::vector<int> dist;
+			std::vector<unsigned> keys(m_numTables);
+			for (int q = (int)((long)numQueries * t / numThreads); q < (int)((long)numQueries * (t + 1) / numThreads); q++)
+			{
+				for (int table = 0; table < m_numTables; table++)
+					keys[table] = substring(queries[q], table);
+				const float limit = maxDistance + 0.5f;
+				float bound = limit;
+				bool done = false;
+				for (int s = 0; s <= m_bits && !done; s++)
+					for (int table = 0; table < m_numTables && !done; table++)
+					{
+						// The buckets at distance s: every mask of s bits, in increasing order (Gosper)
+						const int * offsets = &m_offsets[table * (numBuckets + 1)];
+						const int * ids = &m_ids[(size_t)table * count];
+						candidates.clear();
+						for (unsigned mask = (1u << s) - 1; mask < numBuckets; )
+						{
+							unsigned key = keys[table] ^ mask;
+							for (int j = offsets[key]; j < offsets[key + 1]; j++)
+								if (seen[ids[j]] != q)
+								{
+									seen[ids[j]] = q;
+									candidates.push_back(ids[j]);
+								}
+							if (mask == 0)
+								break;
+							unsigned low = mask & (0u - mask);
+							unsigned next = mask + low;
+							mask = (((next ^ mask) >> 2) / low) | next;
+						}
+						if (!candidates.empty())
+						{
+							dist.resize(candidates.size());
+							kernel(queries[q].bits, m_descriptors[0].bits, &candidates[0], (int)candidates.size(), &dist[0]);
+							for (size_t i = 0; i < candidates.size(); i++)
+								if (dist[i] < bound)
+									bound = std::min(limit, top.insert(q, (float)dist[i], candidates[i]));
+						}
+						// Every descriptor within m s + table bits has been a candidate
+						done = bound < m_numTables * s + table + 1;
+					}
+			}
+		};
+		std::vector<std::thread> threads;
+		for (int t = 1; t < numThreads; t++)
+			threads.push_back(std::thread(run, t));
+		run(0);
+		for (std::thread & thread : threads)
+			thread.join();
+
+		for (int q = 0; q < numQueries; q++)
+			for (int r = 0; r < k && top.index[(size_t)q * k + r] >= 0; r++)
+				matches[(size_t)q * k + r] = Match{ top.index[(size_t)q * k + r], top.dist[(size_t)q * k + r] };
+	}
+
+}
@@ -0,0 +1,94 @@
+#ifndef _FEATURES_BINARY_FEATURES_HPP_
+#define _FEATURES_BINARY_FEATURES_HPP_
+
+#include <vector>
+
+#include "feature_kernels.hpp"
+#include "feature_matcher.hpp"
+
+// 256-bit binary descriptors (ORB, BRIEF) matched by Hamming distance, the popcount of the XOR of two descriptors
+// BinaryMatcher compares every query with every descriptor, MultiIndexHash only with those sharing a nearly equal
+// substring with the query, and both return the exact k nearest (see binary_features.cpp)
+
+namespace features{
+
+	/// 256 bits, bit b in bits[b / 64]
+	struct BinaryDescriptor
+	{
+		unsigned long long bits[BINARY_WORDS];
+	};
+
+	/// Kernels of the Hamming distances
+	enum class HammingImpl
+	{
+		AUTO, // the fastest supported: AVX2, else POPCNT, else CPP
+		CPP, // bit tricks, any machine
+		POPCNT, // one popcnt instruction per 64-bit word
+		AVX2 // nibble lookup with shuffle_epi8, one descriptor per register
+	};
+
+	bool isSupported(HammingImpl impl);
+
+	/// dist[i] = Hamming distance of query to descriptors[i]
+	/// Throws std::runtime_error if impl needs instructions this CPU does not have
+	void hammingDistances(const BinaryDescriptor & query, const BinaryDescriptor * descriptors, int count, int * dist, HammingImpl impl = HammingImpl::AUTO);
+
+	/// Brute force k nearest neighbours
+	class BinaryMatcher
+	{
+	public:
+		/// Copies count descriptors
+		/// Throws std::runtime_error if impl needs instructions this CPU does not have
+		BinaryMatcher(const BinaryDescriptor * descriptors, int count, HammingImpl impl = HammingImpl::AUTO);
+
+		int size() const { return (int)m_descriptors.size(); }
+
+		/// Threads the database is split across, 0 (the default) for all hardware threads
+		void setNumThreads(int numThreads) { m_numThreads = numThreads; }
+
+		/// The k nearest descriptors of every query, nearest first, into matches[q * k + r], distances in bits
+		/// Only descriptors within maxDistance bits count, index -1 where fewer are found; equal distances come in any order
+		void match(const BinaryDescriptor * queries, int numQueries, int k, std::vector<Match> & matches, int maxDistance = BINARY_WORDS * 64) const;
+
+	private:
+		std::vector<BinaryDescriptor> m_descriptors;
+		HammingImpl m_impl;
+		int m_numThreads = 0;
+	};
+
+	/// Multi-index hashing (Norouzi, Punjani and Fleet): the descriptors are split into substrings, every substring
+	/// indexes a table of buckets. Descriptors within distance r of a query share a substring within distance
+	/// r / numTables() of the query's, so growing the radius of the lookups bucket by bucket finds the nearest
+	/// ones after comparing few candidates, as long as they are near; far ones cost more than brute force
+	class MultiIndexHash
+	{
+	public:
+		/// Copies and indexes count descriptors, substringBits 1, 2, 4, 8 or 16: about log2(count) is best
+		/// Throws std::runtime_error if impl needs instructions this CPU does not have
+		MultiIndexHash(const BinaryDescriptor * descriptors, int count, int substringBits = 16, HammingImpl impl = HammingImpl::AUTO);
+
+		int size() const { return (int)m_descriptors.size(); }
+		int numTables() const { return m_numTables; }
+
+		/// Threads the queries are split across, 0 (the default) for all hardware threads
+		void setNumThreads(int numThreads) { m_numThreads = numThreads; }
+
+		/// Same results as BinaryMatcher::match, up to the order of equal distances
+		/// The radius of the lookups grows up to the k-th distance or maxDistance, whichever is smaller: a ratio test
+		/// needs the second nearest only where it is near
+		void match(const BinaryDescriptor * queries, int numQueries, int k, std::vector<Match> & matches, int maxDistance = BINARY_WORDS * 64) const;
+
+	private:
+		unsigned substring(const BinaryDescriptor & d, int table) const;
+
+		std::vector<BinaryDescriptor> m_descriptors;
+		int m_bits;
+		int m_numTables;
+		std::vector<int> m_offsets; // m_numTables x (2^m_bits + 1), the start of every bucket in m_ids
+		std::vector<int> m_ids; // m_numTables x size(), the descriptors of every bucket
+		HammingImpl m_impl;
+		int m_numThreads = 0;
+	};
+
+}
+#endif
@@ -0,0 +1,30 @@
+#include <cstddef>
+
+#include "feature_kernels.hpp"
+
+// Assumes the machine has POPCNT, binary_features.cpp only selects this kernel when cpuFeatures() reports it
+// With -mpopcnt __builtin_popcountll is one instruction; the query stays in registers
+
+namespace features{
+
+	template<bool Indexed>
+	static void hamming(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist)
+	{
+		static_assert(BINARY_WORDS == 4, "one popcount per word below");
+		unsigned long long q0 = query[0], q1 = query[1], q2 = query[2], q3 = query[3];
+		for (int i = 0; i < count; i++)
+		{
+			const unsigned long long * d = descriptors + (size_t)(Indexed ? ids[i] : i) * BINARY_WORDS;
+			dist[i] = __builtin_popcountll(q0 ^ d[0]) + __builtin_popcountll(q1 ^ d[1]) + __builtin_popcountll(q2 ^ d[2]) + __builtin_popcountll(q3 ^ d[3]);
+		}
+	}
+
+	void hammingPOPCNT(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist)
+	{
+		if (ids)
+			hamming<true>(query, descriptors, ids, count, dist);
+		else
+			hamming<false>(query, descriptors, ids, count, dist);
+	}
+
+}
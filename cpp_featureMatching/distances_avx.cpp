@@ -0,0 +1,22 @@
+#include <immintrin.h> //AVX
+
+#include "feature_kernels.hpp"
+
+// The single query loop of the Distances table in featureMatching.cpp, as the compiler vectorizes it with -mavx
+// Assumes the machine has AVX, featureMatching.cpp only calls it when cpuFeatures() reports it
+
+namespace features{
+
+	void distancesAVX(const float * query, const float * features, size_t stride, int count, int dim, float * dist)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			const float * feature = features + i * stride;
+			float sum = 0;
+			for (int j = 0; j < dim; j++)
+				sum += (query[j] - feature[j]) * (query[j] - feature[j]);
+			dist[i] = _mm_cvtss_f32(_mm_sqrt_ss(_mm_set_ss(sum)));
+		}
+	}
+
+}
@@ -1,29 +1,29 @@
 // needs c++11
-#include <chrono>
 #include <iostream>
 #include <vector>
 #include <utility>
 #include <cmath>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+
+#include "cpp_benchmark/benchmark.hpp"
+#include "cpp_cholesky/cpu_features.hpp"
+#include "feature_kernels.hpp"
+#include "feature_matcher.hpp"
+#include "quantized_features.hpp"
+#include "ivf_pq_index.hpp"
+#include "binary_features.hpp"
+#include "soa_vector.hpp"
 
 #define FEATURE_SIZE 128
 #define NUM_FEATURES 100000
 #define CODE_BLOAT 2048 // vary from 8 to 2048 in powers of 2
 #define DATA_TYPE float // or int
 
-namespace cn = std::chrono;
-
-cn::time_point<cn::high_resolution_clock> startTimer()
-{
-	return cn::high_resolution_clock::now();
-}
-
-double endTimer(cn::time_point<cn::high_resolution_clock> t1)
-{
-	auto t2 = cn::high_resolution_clock::now();
-	cn::duration<double> diff = t2 - t1;
-	return diff.count() * 1000;
-}
-
 //Aggregate struct 
 struct PointFeature 
 {
@@ -55,11 +55,19 @@ void genRandomFeature(DATA_TYPE * feature)
 	return;
 }
 
-void computeDistancesAggregateVector(const DATA_TYPE * testFeature, const std::vector<PointFeature> & ptFeatures, std::vector<float> & distances)
+// Distances of testFeature to count features at database[i * stride], the loop of the aggregate and parallel layouts
+// With float features and AVX the loop runs from distances_avx.cpp, compiled with -mavx; this file has no -m flags
+// so that nothing it shares with the other translation units is compiled for AVX
+void computeDistances(const DATA_TYPE * testFeature, const DATA_TYPE * database, size_t stride, int count, std::vector<float> & distances)
 {
-    for(int i = 0; i < ptFeatures.size(); i++)
+    if (std::is_same<DATA_TYPE, float>::value && linalg::cpuFeatures().avx)
     {
-        const DATA_TYPE * feature = &ptFeatures[i].feature[0];
+        features::distancesAVX((const float *)testFeature, (const float *)database, stride, count, FEATURE_SIZE, &distances[0]);
+        return;
+    }
+    for(int i = 0; i < count; i++)
+    {
+        const DATA_TYPE * feature = database + i * stride;
         DATA_TYPE sum = 0;
 		for (int j = 0; j < FEATURE_SIZE; j++)
 			sum += (testFeature[j] - feature[j]) * (testFeature[j] - feature[j]);
@@ -67,19 +75,590 @@ void computeDistancesAggregateVector(const DATA_TYPE * testFeature, const std::v
     }
 }
 
+void computeDistancesAggregateVector(const DATA_TYPE * testFeature, const std::vector<PointFeature> & ptFeatures, std::vector<float> & distances)
+{
+    // With --counters: the cache misses of striding over the point data
+    BENCH_COUNTERS_SCOPE("distances-aggregate");
+    computeDistances(testFeature, &ptFeatures[0].feature[0], sizeof(PointFeature) / sizeof(DATA_TYPE), (int)ptFeatures.size(), distances);
+}
+
 void computeDistancesParallelVector(const DATA_TYPE * testFeature, const std::vector<Feature> & features, std::vector<float> & distances)
 {
-    for(int i = 0; i < features.size(); i++)
+    BENCH_COUNTERS_SCOPE("distances-parallel");
+    computeDistances(testFeature, &features[0].feature[0], FEATURE_SIZE, (int)features.size(), distances);
+}
+
+void computeDistancesSoAVector(const DATA_TYPE * testFeature, const features::SoAVector<Point, Feature> & pointFeatures, std::vector<float> & distances)
+{
+    // Only the feature column is read, as from the hand-split parallel vectors
+    BENCH_COUNTERS_SCOPE("distances-soa");
+    int i = 0;
+    for(auto f : pointFeatures.fields<1>())
     {
-        const DATA_TYPE * feature = &features[i].feature[0];
+        const DATA_TYPE * feature = &std::get<0>(f).feature[0];
         DATA_TYPE sum = 0;
 		for (int j = 0; j < FEATURE_SIZE; j++)
 			sum += (testFeature[j] - feature[j]) * (testFeature[j] - feature[j]);
-        distances[i] = std::sqrt(sum);
+        distances[i++] = std::sqrt(sum);
     }
 }
 
-int main(int argc, const char * argv[])
+// Distinct random descriptors, genRandomFeature gives every feature the same values
+std::vector<float> genRandomFeatures(int count, int dim, unsigned seed)
+{
+	srand(seed);
+	std::vector<float> f((size_t)count * dim);
+	for (float & v : f)
+		v = (float)rand() / RAND_MAX;
+	return f;
+}
+
+// Descriptors around numClusters random centres, the same for every seed, +- spread in every dimension
+// Descriptors of real images are clustered like this, uniform random ones have no neighbourhoods for an index to find
+std::vector<float> genClusteredFeatures(int count, int dim, int numClusters, float spread, unsigned seed)
+{
+	std::vector<float> centres = genRandomFeatures(numClusters, dim, 1);
+	srand(seed);
+	std::vector<float> f((size_t)count * dim);
+	for (int i = 0; i < count; i++)
+	{
+		int c = rand() % numClusters;
+		for (int p = 0; p < dim; p++)
+			f[(size_t)i * dim + p] = centres[(size_t)c * dim + p] + spread * (2.f * rand() / RAND_MAX - 1);
+	}
+	return f;
+}
+
+// SoAVector against a vector of tuples through push_back, erase, resize and copies: columns in sync, aligned, zero
+// padded, and views and proxies reading and writing the right elements
+bool soaVectorCheck()
+{
+	struct Wide { double v[3]; };
+	features::SoAVector<int, Wide, float> soa;
+	std::vector<std::tuple<int, double, float>> expected;
+	auto check = [&](const features::SoAVector<int, Wide, float> & v, const char * step)
+	{
+		bool ok = v.size() == expected.size() && v.capacity() >= v.paddedSize() && v.paddedSize() % features::SOA_PADDING == 0 &&
+			(size_t)v.column<0>() % features::SOA_ALIGNMENT == 0 && (size_t)v.column<1>() % features::SOA_ALIGNMENT == 0 && (size_t)v.column<2>() % features::SOA_ALIGNMENT == 0;
+		for (size_t i = 0; ok && i < v.size(); i++)
+			ok = v.get<0>(i) == std::get<0>(expected[i]) && std::get<1>(v[i]).v[2] == std::get<1>(expected[i]) && v.get<2>(i) == std::get<2>(expected[i]);
+		for (size_t i = v.size(); ok && i < v.paddedSize(); i++)
+			ok = v.get<0>(i) == 0 && v.get<1>(i).v[0] == 0 && v.get<2>(i) == 0;
+		size_t n = 0;
+		for (auto f : v.fields<2, 0>())
+			ok = ok && std::get<0>(f) == std::get<2>(expected[n]) && std::get<1>(f) == std::get<0>(expected[n++]);
+		if (!ok || n != v.size())
+			std::cout << "SoAVector: " << step << std::endl;
+		return ok && n == v.size();
+	};
+
+	for (int i = 0; i < 100; i++)
+	{
+		Wide w = { { 0, 0, i * 0.5 } };
+		soa.push_back(i, w, i * 2.f);
+		expected.push_back(std::make_tuple(i, i * 0.5, i * 2.f));
+	}
+	if (!check(soa, "push_back"))
+		return false;
+	soa.erase(10, 30);
+	expected.erase(expected.begin() + 10, expected.begin() + 30);
+	soa.erase(0);
+	expected.erase(expected.begin());
+	soa.pop_back();
+	expected.pop_back();
+	if (!check(soa, "erase"))
+		return false;
+	// Through the proxies: a whole element, then one field of every element
+	Wide w = { { 0, 0, -1 } };
+	soa[5] = std::make_tuple(-5, w, -10.f);
+	expected[5] = std::make_tuple(-5, -1.0, -10.f);
+	for (auto f : soa.fields<0>())
+		std::get<0>(f) += 1000;
+	for (auto & e : expected)
+		std::get<0>(e) += 1000;
+	// Pushing an element of the vector itself, at a reallocation
+	while (soa.size() < soa.capacity())
+	{
+		soa.push_back(soa.get<0>(0), soa.get<1>(0), soa.get<2>(0));
+		expected.push_back(expected[0]);
+	}
+	soa.push_back(soa.get<0>(1), soa.get<1>(1), soa.get<2>(1));
+	expected.push_back(expected[1]);
+	if (!check(soa, "proxies"))
+		return false;
+	features::SoAVector<int, Wide, float> copy = soa;
+	if (!check(copy, "copy"))
+		return false;
+	soa.resize(3);
+	soa.resize(40);
+	expected.resize(3);
+	for (int i = 3; i < 40; i++)
+		expected.push_back(std::make_tuple(0, 0.0, 0.f));
+	if (!check(soa, "resize"))
+		return false;
+	copy = soa;
+	return check(copy, "assignment") && check(features::SoAVector<int, Wide, float>(std::move(soa)), "move");
+}
+
+// Random 256-bit descriptors
+std::vector<features::BinaryDescriptor> genRandomBinaryFeatures(int count, unsigned seed)
+{
+	srand(seed);
+	std::vector<features::BinaryDescriptor> f(count);
+	for (features::BinaryDescriptor & d : f)
+		for (unsigned long long & w : d.bits)
+			for (int b = 0; b < 64; b += 16)
+				w |= (unsigned long long)(rand() & 0xffff) << b;
+	return f;
+}
+
+// Copies of random descriptors of db with numFlips random bits flipped, as the same point seen in another image
+std::vector<features::BinaryDescriptor> genNoisyBinaryFeatures(const std::vector<features::BinaryDescriptor> & db, int count, int numFlips, unsigned seed)
+{
+	srand(seed);
+	std::vector<features::BinaryDescriptor> f(count);
+	for (features::BinaryDescriptor & d : f)
+	{
+		d = db[rand() % db.size()];
+		for (int i = 0; i < numFlips; i++)
+		{
+			int b = rand() % 256;
+			d.bits[b / 64] ^= 1ull << (b % 64);
+		}
+	}
+	return f;
+}
+
+// Matches against a brute force search in double precision, every rank by distance since near ties may come in either order
+// A few queries are copies of database features, found at distance 0
+bool matcherAccuracyCheck(int count, int dim, int numQueries, int k, int numThreads)
+{
+	std::vector<float> db = genRandomFeatures(count, dim, 1);
+	std::vector<float> queries = genRandomFeatures(numQueries, dim, 2);
+	for (int q = 0; q < numQueries; q += 3)
+		std::copy(&db[(size_t)(q % count) * dim], &db[(size_t)(q % count) * dim] + dim, &queries[(size_t)q * dim]);
+	features::FeatureMatcher matcher(&db[0], count, dim, dim);
+	matcher.setNumThreads(numThreads);
+	std::vector<features::Match> matches;
+	matcher.match(&queries[0], numQueries, dim, k, matches);
+
+	auto dist2 = [&](int q, int i)
+	{
+		double sum = 0;
+		for (int p = 0; p < dim; p++)
+			sum += ((double)queries[(size_t)q * dim + p] - db[(size_t)i * dim + p]) * ((double)queries[(size_t)q * dim + p] - db[(size_t)i * dim + p]);
+		return sum;
+	};
+	std::vector<double> ref(count);
+	for (int q = 0; q < numQueries; q++)
+	{
+		for (int i = 0; i < count; i++)
+			ref[i] = dist2(q, i);
+		std::sort(ref.begin(), ref.end());
+		for (int r = 0; r < k; r++)
+		{
+			const features::Match & m = matches[(size_t)q * k + r];
+			if (r >= count)
+			{
+				if (m.index != -1)
+					return false;
+				continue;
+			}
+			// Squared distances from the norms lose about eps * (|q|^2 + |f|^2)
+			if (m.index < 0 || m.index >= count || std::abs((double)m.distance * m.distance - ref[r]) > 1e-3 ||
+				std::abs(dist2(q, m.index) - ref[r]) > 1e-3)
+			{
+				std::cout << "matcher: query " << q << " rank " << r << " index " << m.index << " distance " << m.distance << " expected " << std::sqrt(ref[r]) << std::endl;
+				return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Quantized searches: distances within a tolerance of the true distance of the feature returned, and with every
+// feature re-ranked, the exact nearest neighbours
+bool quantizedAccuracyCheck(features::FeatureFormat format, int count, int dim, int numQueries, int k, int numThreads)
+{
+	std::vector<float> db = genRandomFeatures(count, dim, 5);
+	std::vector<float> queries = genRandomFeatures(numQueries, dim, 6);
+	features::QuantizedFeatures quantized(&db[0], count, dim, dim, format);
+	quantized.setNumThreads(numThreads);
+	// Every code off by up to half a step, fp16 by a relative 2^-11
+	double tolerance = format == features::FeatureFormat::FP16 ? 1e-2 : 0.1;
+	auto distance = [&](int q, int i)
+	{
+		double sum = 0;
+		for (int p = 0; p < dim; p++)
+			sum += ((double)queries[(size_t)q * dim + p] - db[(size_t)i * dim + p]) * ((double)queries[(size_t)q * dim + p] - db[(size_t)i * dim + p]);
+		return std::sqrt(sum);
+	};
+	std::vector<features::Match> matches;
+	quantized.search(&queries[0], numQueries, dim, k, matches);
+	for (int q = 0; q < numQueries; q++)
+		for (int r = 0; r < std::min(k, count); r++)
+		{
+			const features::Match & m = matches[(size_t)q * k + r];
+			if (m.index < 0 || m.index >= count || std::abs(m.distance - distance(q, m.index)) > tolerance ||
+				(r > 0 && m.distance < matches[(size_t)q * k + r - 1].distance))
+			{
+				std::cout << "quantized: query " << q << " rank " << r << " index " << m.index << " distance " << m.distance << std::endl;
+				return false;
+			}
+		}
+
+	quantized.setRerank(&db[0], dim, count);
+	quantized.search(&queries[0], numQueries, dim, k, matches);
+	features::FeatureMatcher matcher(&db[0], count, dim, dim);
+	std::vector<features::Match> exact;
+	matcher.match(&queries[0], numQueries, dim, k, exact);
+	for (size_t i = 0; i < matches.size(); i++)
+		if (matches[i].index != exact[i].index && std::abs(matches[i].distance - exact[i].distance) > 1e-4)
+		{
+			std::cout << "quantized re-rank: match " << i << " index " << matches[i].index << " expected " << exact[i].index << std::endl;
+			return false;
+		}
+	return true;
+}
+
+// Fraction of the exact k nearest neighbours found
+double recallAtK(const std::vector<features::Match> & found, const std::vector<features::Match> & exact, int numQueries, int k)
+{
+	int hits = 0;
+	for (int q = 0; q < numQueries; q++)
+		for (int r = 0; r < k; r++)
+			for (int s = 0; s < k; s++)
+				if (found[(size_t)q * k + r].index == exact[(size_t)q * k + s].index)
+				{
+					hits++;
+					break;
+				}
+	return (double)hits / ((double)numQueries * k);
+}
+
+// Formats against the float matcher: time, speedup, recall@k against the float results, and the same re-ranked
+void benchmarkQuantized(bench::Harness & h)
+{
+	const int k = 10;
+	const int rerank = 4 * k;
+	std::vector<float> db = genRandomFeatures(NUM_FEATURES, FEATURE_SIZE, 3);
+	features::FeatureMatcher matcher(&db[0], NUM_FEATURES, FEATURE_SIZE, FEATURE_SIZE);
+
+	char sep = ',';
+	std::cout << "Queries" << sep << "Format" << sep << "Bytes" << sep << "Search" << sep << "Speedup" << sep << "Recall@" << k << sep
+		<< "Rerank" << rerank << sep << "Speedup" << sep << "Rerank-recall@" << k << std::endl;
+	for (int numQueries : h.sweep({ 256 }))
+	{
+		std::vector<float> queries = genRandomFeatures(numQueries, FEATURE_SIZE, 4);
+		std::vector<features::Match> exact;
+		bench::Work work(2.0 * numQueries * NUM_FEATURES * FEATURE_SIZE, (double)NUM_FEATURES * FEATURE_SIZE * sizeof(float));
+		double floatTime = h.time("Quantized", "Float", numQueries, [&] { matcher.match(&queries[0], numQueries, FEATURE_SIZE, k, exact); }, work);
+		std::cout << numQueries << sep << "Float" << sep << FEATURE_SIZE * sizeof(float) << sep << floatTime << sep << 1 << sep << 1
+			<< sep << "n/a" << sep << "n/a" << sep << "n/a" << std::endl;
+
+		const std::pair<features::FeatureFormat, const char *> formats[] = {
+			{ features::FeatureFormat::UINT8, "UINT8" }, { features::FeatureFormat::INT8, "INT8" }, { features::FeatureFormat::FP16, "FP16" } };
+		for (const auto & format : formats)
+		{
+			features::QuantizedFeatures quantized(&db[0], NUM_FEATURES, FEATURE_SIZE, FEATURE_SIZE, format.first);
+			bench::Work qwork(work.flops, (double)NUM_FEATURES * quantized.bytesPerFeature());
+			std::vector<features::Match> matches;
+			std::string label = format.second;
+			double time = h.time("Quantized", label, numQueries, [&] { quantized.search(&queries[0], numQueries, FEATURE_SIZE, k, matches); }, qwork);
+			double recall = recallAtK(matches, exact, numQueries, k);
+			quantized.setRerank(&db[0], FEATURE_SIZE, rerank);
+			double rerankTime = h.time("Quantized", label + "-rerank", numQueries, [&] { quantized.search(&queries[0], numQueries, FEATURE_SIZE, k, matches); }, qwork);
+			std::cout << numQueries << sep << label << sep << quantized.bytesPerFeature() << sep << time << sep << floatTime / time << sep << recall << sep
+				<< rerankTime << sep << floatTime / rerankTime << sep << recallAtK(matches, exact, numQueries, k) << std::endl;
+		}
+	}
+}
+
+// IVF-PQ with every list probed: exact with at most 256 features, where every residual sub-vector is a
+// sub-centroid, sorted otherwise; recall@k at least minRecall; the same results after a round trip through a file
+bool ivfPqAccuracyCheck(int count, int dim, int numLists, int numSubspaces, int numQueries, int k, int numThreads, double minRecall)
+{
+	std::vector<float> db = genRandomFeatures(count, dim, 7);
+	std::vector<float> queries = genRandomFeatures(numQueries, dim, 8);
+	features::IvfPqParams params;
+	params.numLists = numLists;
+	params.numSubspaces = numSubspaces;
+	features::IvfPqIndex index(dim, params);
+	index.setNumThreads(numThreads);
+	index.train(&db[0], count, dim);
+	index.add(&db[0], count, dim);
+	index.setNprobe(numLists);
+	std::vector<features::Match> matches;
+	index.search(&queries[0], numQueries, dim, k, matches);
+
+	features::FeatureMatcher matcher(&db[0], count, dim, dim);
+	std::vector<features::Match> exact;
+	matcher.match(&queries[0], numQueries, dim, k, exact);
+	for (size_t i = 0; i < matches.size(); i++)
+	{
+		bool sorted = i % k == 0 || matches[i].distance >= matches[i - 1].distance;
+		bool found = (int)(i % k) >= count ? matches[i].index == -1 : matches[i].index >= 0 && matches[i].index < count;
+		bool same = count > 256 || matches[i].index == exact[i].index || std::abs(matches[i].distance - exact[i].distance) < 1e-3;
+		if (!sorted || !found || !same)
+		{
+			std::cout << "ivfpq: match " << i << " index " << matches[i].index << " distance " << matches[i].distance
+				<< " expected " << exact[i].index << " " << exact[i].distance << std::endl;
+			return false;
+		}
+	}
+
+	// Probing every list, only the product quantization loses neighbours
+	double recall = recallAtK(matches, exact, numQueries, k);
+	if (recall < minRecall)
+	{
+		std::cout << "ivfpq: recall@" << k << " " << recall << " below " << minRecall << std::endl;
+		return false;
+	}
+	const char * path = "ivfpq_check.index";
+	index.save(path);
+	features::IvfPqIndex loaded = features::IvfPqIndex::load(path);
+	std::remove(path);
+	loaded.setNprobe(numLists);
+	loaded.setNumThreads(numThreads);
+	std::vector<features::Match> reloaded;
+	loaded.search(&queries[0], numQueries, dim, k, reloaded);
+	for (size_t i = 0; i < matches.size(); i++)
+		if (reloaded[i].index != matches[i].index || reloaded[i].distance != matches[i].distance)
+		{
+			std::cout << "ivfpq: loaded index, match " << i << " index " << reloaded[i].index << " expected " << matches[i].index << std::endl;
+			return false;
+		}
+	return true;
+}
+
+// IVF-PQ against the float matcher on clustered descriptors: build time once, then the search time, speedup and
+// recall for a range of nprobe. Recall@k counts the exact k nearest found, 1-Recall@k the queries whose nearest
+// neighbour is found
+void benchmarkIvfPq(bench::Harness & h)
+{
+	const int k = 10;
+	// Fewer clusters than lists: k-means splits every cluster across several lists, so the neighbours of a query
+	// straddle lists and recall grows with nprobe
+	const int numClusters = 64;
+	const float spread = 0.1f;
+	std::vector<float> db = genClusteredFeatures(NUM_FEATURES, FEATURE_SIZE, numClusters, spread, 3);
+	features::FeatureMatcher matcher(&db[0], NUM_FEATURES, FEATURE_SIZE, FEATURE_SIZE);
+	features::IvfPqParams params;
+	params.numLists = 256;
+	params.numSubspaces = 64;
+	params.maxPointsPerCentroid = 64;
+	features::IvfPqIndex index(FEATURE_SIZE, params);
+
+	char sep = ',';
+	auto start = std::chrono::steady_clock::now();
+	index.train(&db[0], NUM_FEATURES, FEATURE_SIZE);
+	index.add(&db[0], NUM_FEATURES, FEATURE_SIZE);
+	double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	h.record("IVFPQ", "Build", NUM_FEATURES, { buildMs });
+	std::cout << "Lists" << sep << "Bytes" << sep << "Build" << std::endl;
+	std::cout << params.numLists << sep << params.numSubspaces << sep << buildMs << std::endl;
+
+	std::cout << "Queries" << sep << "Nprobe" << sep << "Search" << sep << "Speedup" << sep << "Recall@" << k << sep << "1-Recall@" << k << std::endl;
+	for (int numQueries : h.sweep({ 256 }))
+	{
+		std::vector<float> queries = genClusteredFeatures(numQueries, FEATURE_SIZE, numClusters, spread, 4);
+		std::vector<features::Match> exact;
+		double floatTime = h.time("IVFPQ", "Float", numQueries, [&] { matcher.match(&queries[0], numQueries, FEATURE_SIZE, k, exact); });
+		std::cout << numQueries << sep << "Float" << sep << floatTime << sep << 1 << sep << 1 << sep << 1 << std::endl;
+		for (int nprobe = 1; nprobe <= 64; nprobe *= 2)
+		{
+			index.setNprobe(nprobe);
+			std::vector<features::Match> matches;
+			double time = h.time("IVFPQ", "Nprobe-" + std::to_string(nprobe), numQueries, [&] { index.search(&queries[0], numQueries, FEATURE_SIZE, k, matches); });
+			int nearestFound = 0;
+			for (int q = 0; q < numQueries; q++)
+				for (int r = 0; r < k; r++)
+					if (matches[(size_t)q * k + r].index == exact[(size_t)q * k].index)
+						nearestFound++;
+			std::cout << numQueries << sep << nprobe << sep << time << sep << floatTime / time << sep << recallAtK(matches, exact, numQueries, k)
+				<< sep << (double)nearestFound / numQueries << std::endl;
+		}
+	}
+}
+
+// Binary matchers against a sort of all the distances: every rank by distance, since equal distances come in any
+// order, for every supported kernel, brute force and multi-index hashing with several substring sizes
+// Half the queries are near database descriptors, half random
+bool binaryAccuracyCheck(int count, int numQueries, int k, int numThreads)
+{
+	std::vector<features::BinaryDescriptor> db = genRandomBinaryFeatures(count, 9);
+	std::vector<features::BinaryDescriptor> queries = genNoisyBinaryFeatures(db, numQueries, 10, 10);
+	std::vector<features::BinaryDescriptor> far = genRandomBinaryFeatures(numQueries / 2, 11);
+	std::copy(far.begin(), far.end(), queries.begin());
+	auto distance = [&](int q, int i)
+	{
+		int sum = 0;
+		for (int w = 0; w < features::BINARY_WORDS; w++)
+			sum += __builtin_popcountll(queries[q].bits[w] ^ db[i].bits[w]);
+		return sum;
+	};
+	int maxDistance = 256;
+	auto check = [&](const std::vector<features::Match> & matches, const char * name)
+	{
+		std::vector<int> all(count);
+		for (int q = 0; q < numQueries; q++)
+		{
+			for (int i = 0; i < count; i++)
+				all[i] = distance(q, i);
+			std::sort(all.begin(), all.end());
+			for (int r = 0; r < k; r++)
+			{
+				const features::Match & m = matches[(size_t)q * k + r];
+				bool ok = r < count && all[r] <= maxDistance ? m.index >= 0 && m.index < count && m.distance == all[r] && distance(q, m.index) == all[r] : m.index == -1;
+				if (!ok)
+				{
+					std::cout << name << ": query " << q << " rank " << r << " index " << m.index << " distance " << m.distance << std::endl;
+					return false;
+				}
+			}
+		}
+		return true;
+	};
+
+	const features::HammingImpl impls[] = { features::HammingImpl::CPP, features::HammingImpl::POPCNT, features::HammingImpl::AVX2 };
+	std::vector<features::Match> matches;
+	for (features::HammingImpl impl : impls)
+	{
+		if (!features::isSupported(impl))
+			continue;
+		for (int radius : { 256, 100 })
+		{
+			maxDistance = radius;
+			features::BinaryMatcher matcher(&db[0], count, impl);
+			matcher.setNumThreads(numThreads);
+			matcher.match(&queries[0], numQueries, k, matches, maxDistance);
+			if (!check(matches, "binary matcher"))
+				return false;
+			for (int bits : { 16, 8, 4 })
+			{
+				features::MultiIndexHash mih(&db[0], count, bits, impl);
+				mih.setNumThreads(numThreads);
+				mih.match(&queries[0], numQueries, k, matches, maxDistance);
+				if (!check(matches, "multi-index hash"))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+// Binary descriptors: brute force with every kernel and multi-index hashing, speedups over the plain C++ brute force
+// The nearest neighbour of queries near database descriptors (24 of 256 bits flipped) and of random ones, and the
+// 2 nearest within 64 bits, as for a ratio test with a match threshold, of the near ones
+void benchmarkBinary(bench::Harness & h)
+{
+	const int maxDistance = 64;
+	std::vector<features::BinaryDescriptor> db = genRandomBinaryFeatures(NUM_FEATURES, 12);
+	const std::pair<features::HammingImpl, const char *> impls[] = {
+		{ features::HammingImpl::CPP, "CPP" }, { features::HammingImpl::POPCNT, "POPCNT" }, { features::HammingImpl::AVX2, "AVX2" } };
+	features::MultiIndexHash mih16(&db[0], NUM_FEATURES, 16);
+	features::MultiIndexHash mih8(&db[0], NUM_FEATURES, 8);
+
+	char sep = ',';
+	std::cout << "Queries" << sep << "Method" << sep << "Near-1NN" << sep << "Speedup" << sep << "Random-1NN" << sep << "Speedup" << sep
+		<< "Near-2NN<=" << maxDistance << sep << "Speedup" << std::endl;
+	for (int numQueries : h.sweep({ 256 }))
+	{
+		std::vector<features::BinaryDescriptor> near = genNoisyBinaryFeatures(db, numQueries, 24, 13);
+		std::vector<features::BinaryDescriptor> random = genRandomBinaryFeatures(numQueries, 14);
+		bench::Work work(0, (double)NUM_FEATURES * sizeof(features::BinaryDescriptor));
+		std::vector<features::Match> matches;
+		double nearBase = 0, randomBase = 0, ratioBase = 0;
+		auto row = [&](const std::string & label, const std::function<void(const std::vector<features::BinaryDescriptor> &, int, int)> & search)
+		{
+			double nearTime = h.time("Binary", label + "-near", numQueries, [&] { search(near, 1, 256); }, work);
+			double randomTime = h.time("Binary", label + "-random", numQueries, [&] { search(random, 1, 256); }, work);
+			double ratioTime = h.time("Binary", label + "-ratio", numQueries, [&] { search(near, 2, maxDistance); }, work);
+			if (nearBase == 0)
+			{
+				nearBase = nearTime;
+				randomBase = randomTime;
+				ratioBase = ratioTime;
+			}
+			std::cout << numQueries << sep << label << sep << nearTime << sep << nearBase / nearTime << sep << randomTime << sep << randomBase / randomTime
+				<< sep << ratioTime << sep << ratioBase / ratioTime << std::endl;
+		};
+		for (const auto & impl : impls)
+		{
+			if (!features::isSupported(impl.first))
+				continue;
+			features::BinaryMatcher matcher(&db[0], NUM_FEATURES, impl.first);
+			row(std::string("Brute-") + impl.second, [&](const std::vector<features::BinaryDescriptor> & queries, int k, int radius)
+				{ matcher.match(&queries[0], numQueries, k, matches, radius); });
+		}
+		row("MIH-16", [&](const std::vector<features::BinaryDescriptor> & queries, int k, int radius) { mih16.match(&queries[0], numQueries, k, matches, radius); });
+		row("MIH-8", [&](const std::vector<features::BinaryDescriptor> & queries, int k, int radius) { mih8.match(&queries[0], numQueries, k, matches, radius); });
+	}
+}
+
+// Many queries against the database, one at a time with the loop above and a partial sort, or with FeatureMatcher
+void benchmarkMatching(bench::Harness & h)
+{
+	const int k = 4;
+	std::vector<float> db = genRandomFeatures(NUM_FEATURES, FEATURE_SIZE, 3);
+	features::FeatureMatcher matcher(&db[0], NUM_FEATURES, FEATURE_SIZE, FEATURE_SIZE);
+	std::vector<Feature> dbFeatures(NUM_FEATURES);
+	for (int i = 0; i < NUM_FEATURES; i++)
+		std::copy(&db[(size_t)i * FEATURE_SIZE], &db[(size_t)i * FEATURE_SIZE] + FEATURE_SIZE, dbFeatures[i].feature);
+	int maxThreads = std::max(1, (int)std::thread::hardware_concurrency());
+	// With one hardware thread the multithreaded column would repeat Matcher-1T
+	std::vector<int> threadCounts(1, 1);
+	if (maxThreads > 1)
+		threadCounts.push_back(maxThreads);
+
+	char sep = ',';
+	std::cout << "Queries" << sep << "Loop";
+	for (int numThreads : threadCounts)
+		std::cout << sep << "Matcher-" << numThreads << "T";
+	std::cout << sep << "GFLOPS" << std::endl;
+	for (int numQueries : h.sweep(16, 1024, 4))
+	{
+		std::vector<float> queries = genRandomFeatures(numQueries, FEATURE_SIZE, 4);
+		// The dot products, and the database read once per call
+		bench::Work work(2.0 * numQueries * NUM_FEATURES * FEATURE_SIZE, (double)NUM_FEATURES * FEATURE_SIZE * sizeof(float));
+		std::cout << numQueries << sep;
+
+		// One query at a time takes seconds beyond a few dozen queries
+		if (numQueries <= 64)
+		{
+			std::vector<float> distances(NUM_FEATURES);
+			std::vector<int> order(NUM_FEATURES);
+			std::vector<int> best((size_t)numQueries * k);
+			std::cout << h.time("Matching", "Loop", numQueries, [&]
+			{
+				for (int q = 0; q < numQueries; q++)
+				{
+					computeDistancesParallelVector(&queries[(size_t)q * FEATURE_SIZE], dbFeatures, distances);
+					for (int i = 0; i < NUM_FEATURES; i++)
+						order[i] = i;
+					std::partial_sort(order.begin(), order.begin() + k, order.end(), [&](int a, int b) { return distances[a] < distances[b]; });
+					std::copy(order.begin(), order.begin() + k, best.begin() + (size_t)q * k);
+				}
+			}, work);
+		}
+		else
+			std::cout << "n/a";
+
+		std::vector<features::Match> matches;
+		double gflops = 0;
+		for (int numThreads : threadCounts)
+		{
+			matcher.setNumThreads(numThreads);
+			const bench::Result & r = h.measure("Matching", "Matcher-" + std::to_string(numThreads) + "T", numQueries,
+				[&] { matcher.match(&queries[0], numQueries, FEATURE_SIZE, k, matches); }, work);
+			std::cout << sep << r.stats.median;
+			gflops = r.gflops();
+		}
+		std::cout << sep << gflops << std::endl;
+	}
+}
+
+void benchmarkDistances(bench::Harness & h)
 {
 	// Generate some random features to populate aggregate point features
 	std::vector<PointFeature> pointFeatures;
@@ -93,11 +672,13 @@ int main(int argc, const char * argv[])
         pointFeatures.emplace_back(pt);
     }
     
-	// Generate some random features to populate parallel vectors of points and features
+	// Generate some random features to populate parallel vectors of points and features, split by hand and by SoAVector
     std::vector<Point> pts;
-    std::vector<Feature> features;
+    std::vector<Feature> featureList;
+    features::SoAVector<Point, Feature> soaPointFeatures;
     pts.reserve(NUM_FEATURES);
-    features.reserve(NUM_FEATURES);
+    featureList.reserve(NUM_FEATURES);
+    soaPointFeatures.reserve(NUM_FEATURES);
     for(int i = 0; i < NUM_FEATURES; i++)
     {
         Point pt;
@@ -106,33 +687,90 @@ int main(int argc, const char * argv[])
         Feature feat;
         genRandomFeature(&feat.feature[0]);
         pts.emplace_back(pt);
-        features.emplace_back(feat);
+        featureList.emplace_back(feat);
+        soaPointFeatures.push_back(pt, feat);
     }
 
-	// For numRuns, compute distance of each of the NUM_FEATURES features aganst the first feature
+	// Compute distance of each of the NUM_FEATURES features aganst the first feature
 	// Add the distance to a random DATA_TYPE to stop the compiler from optimizing away the loop
-	int numRuns = 100;
+	// Features read and distances written; the aggregate layout also drags the point data through the cache
+	bench::Work work(3.0 * NUM_FEATURES * FEATURE_SIZE, (double)NUM_FEATURES * (FEATURE_SIZE + 1) * sizeof(DATA_TYPE));
+
     std::vector<float> distances1(NUM_FEATURES,0);
     float a = 1.f;
-    auto t1 = startTimer();
-    for(int i = 0 ; i < numRuns; i++)
+    double time1 = h.time("Distances", "Aggregate", CODE_BLOAT, [&]
     {
         computeDistancesAggregateVector(&pointFeatures[0].feature[0], pointFeatures, distances1);
         a = a + distances1[0];
-    }
-    double time1 = endTimer(t1) / numRuns;
+    }, work);
     
     std::vector<float> distances2(NUM_FEATURES,0);
     float b = 1.f;
-    auto t2 = startTimer();
-    for(int i = 0 ; i < numRuns; i++)
+    double time2 = h.time("Distances", "Parallel", CODE_BLOAT, [&]
     {
-        computeDistancesParallelVector(&features[0].feature[0], features, distances2);
+        computeDistancesParallelVector(&featureList[0].feature[0], featureList, distances2);
         b = b + distances2[0];
-    }
-    double time2 = endTimer(t2) / numRuns;
+    }, work);
+
+    std::vector<float> distances3(NUM_FEATURES,0);
+    float d = 1.f;
+    double timeSoA = h.time("Distances", "SoA", CODE_BLOAT, [&]
+    {
+        computeDistancesSoAVector(&soaPointFeatures.get<1>(0).feature[0], soaPointFeatures, distances3);
+        d = d + distances3[0];
+    }, work);
+
+    // The same points with 256-bit binary descriptors in a parallel vector, distances of the first to all of them
+    std::vector<features::BinaryDescriptor> binaryFeatures = genRandomBinaryFeatures(NUM_FEATURES, 5);
+    std::vector<int> hamming(NUM_FEATURES);
+    bench::Work binaryWork(0, (double)NUM_FEATURES * (sizeof(features::BinaryDescriptor) + sizeof(int)));
+    int c = 0;
+    auto binaryTime = [&](features::HammingImpl impl, const char * label)
+    {
+        if (!features::isSupported(impl))
+            return std::numeric_limits<double>::quiet_NaN();
+        return h.time("Distances", label, CODE_BLOAT, [&]
+        {
+            features::hammingDistances(binaryFeatures[0], &binaryFeatures[0], NUM_FEATURES, &hamming[0], impl);
+            c = c + hamming[1];
+        }, binaryWork);
+    };
+    double time3 = binaryTime(features::HammingImpl::POPCNT, "Binary-POPCNT");
+    double time4 = binaryTime(features::HammingImpl::AVX2, "Binary-AVX2");
+
+    std::cout << CODE_BLOAT << "\t" << time1 << "\t" << time2 << "\t" << timeSoA << "\t" << time3 << "\t" << time4 << std::endl;
+}
+
+int main(int argc, const char * argv[])
+{
+	bench::Config defaults;
+	defaults.warmups = 2;
+	defaults.repetitions = 20;
+	bench::Harness h(argc, argv, defaults);
+
+	if (!matcherAccuracyCheck(1000, FEATURE_SIZE, 37, 5, 3) || !matcherAccuracyCheck(10, 20, 6, 16, 1) || !matcherAccuracyCheck(333, 7, 9, 1, 2) ||
+		!quantizedAccuracyCheck(features::FeatureFormat::UINT8, 1000, FEATURE_SIZE, 13, 5, 3) || !quantizedAccuracyCheck(features::FeatureFormat::UINT8, 101, 20, 6, 16, 1) ||
+		!quantizedAccuracyCheck(features::FeatureFormat::INT8, 1000, FEATURE_SIZE, 13, 5, 3) || !quantizedAccuracyCheck(features::FeatureFormat::INT8, 101, 7, 6, 3, 2) ||
+		!quantizedAccuracyCheck(features::FeatureFormat::FP16, 1000, FEATURE_SIZE, 13, 5, 3) || !quantizedAccuracyCheck(features::FeatureFormat::FP16, 101, 20, 6, 16, 1) ||
+		!ivfPqAccuracyCheck(200, FEATURE_SIZE, 4, 16, 13, 5, 3, 1) || !ivfPqAccuracyCheck(100, 20, 3, 8, 6, 16, 1, 1) || !ivfPqAccuracyCheck(3000, 36, 16, 6, 9, 4, 2, 0.4) ||
+		!binaryAccuracyCheck(3000, 20, 5, 3) || !binaryAccuracyCheck(7, 4, 10, 1) || !soaVectorCheck())
+	{
+		std::cout << "Accuracy check failed, exiting" << std::endl;
+		return 1;
+	}
+	std::cout << "accuracy check passed" << std::endl;
 
-    std::cout << CODE_BLOAT << "\t" << time1 << "\t" << time2 << std::endl;
+	if (h.enabled("Distances"))
+		benchmarkDistances(h);
+	if (h.enabled("Matching"))
+		benchmarkMatching(h);
+	if (h.enabled("Quantized"))
+		benchmarkQuantized(h);
+	if (h.enabled("IVFPQ"))
+		benchmarkIvfPq(h);
+	if (h.enabled("Binary"))
+		benchmarkBinary(h);
+	h.printCounters(std::cout);
 	
 	return 0;
 }
@@ -0,0 +1,62 @@
+#ifndef _FEATURES_FEATURE_KERNELS_HPP_
+#define _FEATURES_FEATURE_KERNELS_HPP_
+
+#include <cstddef>
+
+// Declarations of the SIMD kernels of the feature searches, each family in its own translation unit compiled with its own -m flags
+// Kernel files include only this header, as in cpp_cholesky/cholesky_kernels.hpp
+
+namespace features{
+
+	// Distances of one query to count features of dim floats at features[i * stride], dist[i] = |query - feature i|
+	// The single query loop of featureMatching.cpp, over the aggregate and the split layouts
+
+	// AVX, distances_avx.cpp
+	void distancesAVX(const float * query, const float * features, size_t stride, int count, int dim, float * dist);
+
+	// Matcher: queries and database features of one tile, MATCH_MR x MATCH_NR distances in 8 AVX accumulators
+	const int MATCH_MR = 4;
+	const int MATCH_NR = 16;
+
+	// Tile of squared distances |q|^2 + |f|^2 - 2 q.f of MATCH_MR queries (rows of Q, stride ldq) to the MATCH_NR
+	// features of one strip (strip[p * MATCH_NR + j] = dimension p of feature j), into dist[r * MATCH_NR + j]
+	// Returns the candidates, bit r * MATCH_NR + j set where dist[r * MATCH_NR + j] < bounds[r]
+	typedef unsigned long long MatchMask;
+
+	// AVX, feature_matcher_avx.cpp
+	MatchMask matchTileAVX(int dim, const float * Q, int ldq, const float * strip, const float * qNorms, const float * fNorms, const float * bounds, float * dist);
+
+	// AVX2 and FMA, feature_matcher_fma.cpp
+	MatchMask matchTileFMA(int dim, const float * Q, int ldq, const float * strip, const float * qNorms, const float * fNorms, const float * bounds, float * dist);
+
+	// Quantized features (see quantized_features.cpp), count rows of codes at codes[i * stride], dim a multiple of 32
+	// codes for the integer kernels and of 16 for fp16, the padding zero in the codes and in w or q
+	// dots[i] = sum over p < dim of codes[i * stride + p] * w[p], exact: no 16-bit pair sum can saturate as long as
+	// |w| <= 64 with uint8 codes and |w|, |codes| <= 127 with int8 codes
+	// dist[i] = sum over p < dim of (q[p] - codes[i * stride + p])^2, with the fp16 codes converted to float
+
+	// AVX2, F16C and FMA, quantized_avx2.cpp
+	void dotsU8AVX2(const unsigned char * codes, int stride, int count, const signed char * w, int dim, int * dots);
+	void dotsS8AVX2(const signed char * codes, int stride, int count, const signed char * w, int dim, int * dots);
+	void distancesF16AVX2(const unsigned short * codes, int stride, int count, const float * q, int dim, float * dist);
+
+	// IVF-PQ (see ivf_pq_index.cpp): the codes of an inverted list in blocks of PQ_BLOCK features, subspace by
+	// subspace, code m of feature j of block b at codes[(b * numSubspaces + m) * PQ_BLOCK + j]
+	// dist[b * PQ_BLOCK + j] = sum over m of lut[m * 256 + code m of feature j of block b]
+	const int PQ_BLOCK = 8;
+
+	// AVX2, ivf_pq_avx2.cpp
+	void pqScanAVX2(const unsigned char * codes, int numBlocks, int numSubspaces, const float * lut, float * dist);
+
+	// Binary descriptors (see binary_features.cpp) of BINARY_WORDS 64-bit words
+	// dist[i] = Hamming distance of query to descriptor ids[i], or to descriptor i if ids is NULL
+	const int BINARY_WORDS = 4;
+
+	// POPCNT, binary_popcnt.cpp
+	void hammingPOPCNT(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist);
+
+	// AVX2, binary_avx2.cpp
+	void hammingAVX2(const unsigned long long * query, const unsigned long long * descriptors, const int * ids, int count, int * dist);
+
+}
+#endif
@@ -0,0 +1,157 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <thread>
+
+#include "feature_matcher.hpp"
+#include "feature_kernels.hpp"
+#include "top_k.hpp"
+#include "cpp_cholesky/cpu_features.hpp"
+#include "cpp_benchmark/perf_counters.hpp"
+
+// Blocked like a GEMM of the queries with the transposed database:
+//   every thread takes a contiguous range of database strips (MATCH_NR features each)
+//   for every chunk of strips that fits in L2:
+//     for every MATCH_MR queries (in L1): the distance tile of each strip of the chunk
+// so every chunk is read from memory once per call, instead of once per query as by a loop over the queries
+// Every query keeps its k best candidates sorted, the k-th distance is a bound passed to the kernel, which compares
+// a whole tile against it in SIMD registers and returns a bit mask. Once the lists fill up almost every tile
+// comes back empty, and only the few candidates left are inserted one by one
+// Every thread has its own lists, merged at the end
+
+namespace features{
+
+	// Bytes of database strips streamed against each group of queries
+	const size_t MATCH_CHUNK_BYTES = 256 * 1024;
+
+	typedef MatchMask (*MatchKernel)(int dim, const float * Q, int ldq, const float * strip, const float * qNorms, const float * fNorms, const float * bounds, float * dist);
+
+	// Plain C++ kernel for machines without AVX
+	static MatchMask matchTileCPP(int dim, const float * Q, int ldq, const float * strip, const float * qNorms, const float * fNorms, const float * bounds, float * dist)
+	{
+		MatchMask mask = 0;
+		for (int r = 0; r < MATCH_MR; r++)
+			for (int j = 0; j < MATCH_NR; j++)
+			{
+				float dot = 0;
+				for (int p = 0; p < dim; p++)
+					dot += Q[r * ldq + p] * strip[p * MATCH_NR + j];
+				float d = qNorms[r] + fNorms[j] - 2 * dot;
+				dist[r * MATCH_NR + j] = d;
+				if (d < bounds[r])
+					mask |= (MatchMask)1 << (r * MATCH_NR + j);
+			}
+		return mask;
+	}
+
+	static MatchKernel selectMatchKernel()
+	{
+		const linalg::CpuFeatures & f = linalg::cpuFeatures();
+		if (f.fma && f.avx2)
+			return &matchTileFMA;
+		if (f.avx)
+			return &matchTileAVX;
+		return &matchTileCPP;
+	}
+
+	// Strips s0 .. s1 - 1 against all (padded) queries
+	static void matchStrips(MatchKernel kernel, int dim, const float * Q, int numQueries, const float * qNorms, const float * strips,
+		const float * norms, int s0, int s1, size_t chunkStrips, TopK & top)
+	{
+		BENCH_COUNTERS_SCOPE("matcher");
+		size_t stripElems = (size_t)dim * MATCH_NR;
+		std::vector<float> bounds(numQueries);
+		// Padding queries, with negative norms, have no candidates
+		for (int q = 0; q < numQueries; q++)
+			bounds[q] = (qNorms[q] < 0 ? -1 : 1) * std::numeric_limits<float>::infinity();
+		float dist[MATCH_MR * MATCH_NR];
+
+		for (int c0 = s0; c0 < s1; c0 += (int)chunkStrips)
+		{
+			int c1 = std::min(s1, c0 + (int)chunkStrips);
+			for (int q0 = 0; q0 < numQueries; q0 += MATCH_MR)
+				for (int s = c0; s < c1; s++)
+				{
+					MatchMask mask = kernel(dim, Q + (size_t)q0 * dim, dim, strips + s * stripElems, qNorms + q0, norms + (size_t)s * MATCH_NR, &bounds[q0], dist);
+					while (mask)
+					{
+						int bit = __builtin_ctzll(mask);
+						mask &= mask - 1;
+						int r = bit / MATCH_NR;
+						// The bound may have dropped since the kernel compared against it
+						if (dist[bit] < bounds[q0 + r])
+							bounds[q0 + r] = top.insert(q0 + r, dist[bit], s * MATCH_NR + bit % MATCH_NR);
+					}
+				}
+		}
+	}
+
+	FeatureMatcher::FeatureMatcher(const float * features, int count, int dim, int stride) : m_count(count), m_dim(dim),
+		m_numStrips((count + MATCH_NR - 1) / MATCH_NR)
+	{
+		m_strips.assign((size_t)m_numStrips * MATCH_NR * dim, 0.f);
+		m_norms.assign((size_t)m_numStrips * MATCH_NR, std::numeric_limits<float>::infinity());
+		for (int i = 0; i < count; i++)
+		{
+			const float * f = features + (size_t)i * stride;
+			float * strip = &m_strips[(size_t)(i / MATCH_NR) * MATCH_NR * dim];
+			float norm = 0;
+			for (int p = 0; p < dim; p++)
+			{
+				strip[p * MATCH_NR + i % MATCH_NR] = f[p];
+				norm += f[p] * f[p];
+			}
+			m_norms[i] = norm;
+		}
+	}
+
+	void FeatureMatcher::match(const float * queries, int numQueries, int stride, int k, std::vector<Match> & matches) const
+	{
+		static const MatchKernel kernel = selectMatchKernel();
+		matches.assign((size_t)numQueries * k, Match{ -1, std::numeric_limits<float>::infinity() });
+		if (numQueries == 0 || k <= 0 || m_count == 0)
+			return;
+
+		// Queries packed and padded to whole groups, the norms of the padding rows mark them
+		int padded = (numQueries + MATCH_MR - 1) / MATCH_MR * MATCH_MR;
+		std::vector<float> Q((size_t)padded * m_dim, 0.f);
+		std::vector<float> qNorms(padded, -std::numeric_limits<float>::infinity());
+		for (int q = 0; q < numQueries; q++)
+		{
+			float norm = 0;
+			for (int p = 0; p < m_dim; p++)
+			{
+				float v = queries[(size_t)q * stride + p];
+				Q[(size_t)q * m_dim + p] = v;
+				norm += v * v;
+			}
+			qNorms[q] = norm;
+		}
+
+		size_t chunkStrips = std::max<size_t>(1, MATCH_CHUNK_BYTES / ((size_t)m_dim * MATCH_NR * sizeof(float)));
+		int numThreads = m_numThreads > 0 ? m_numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+		numThreads = std::min(numThreads, m_numStrips);
+		std::vector<TopK> tops(numThreads, TopK(padded, k));
+		std::vector<std::thread> threads;
+		for (int t = 1; t < numThreads; t++)
+			threads.push_back(std::thread([&, t] { matchStrips(kernel, m_dim, &Q[0], padded, &qNorms[0], &m_strips[0], &m_norms[0],
+				(int)((long)m_numStrips * t / numThreads), (int)((long)m_numStrips * (t + 1) / numThreads), chunkStrips, tops[t]); }));
+		matchStrips(kernel, m_dim, &Q[0], padded, &qNorms[0], &m_strips[0], &m_norms[0], 0, m_numStrips / numThreads, chunkStrips, tops[0]);
+		for (std::thread & thread : threads)
+			thread.join();
+
+		// The lists of the other threads into the first one
+		TopK & top = tops[0];
+		for (int t = 1; t < numThreads; t++)
+			top.merge(tops[t], numQueries);
+		for (int q = 0; q < numQueries; q++)
+			for (int r = 0; r < k && top.index[(size_t)q * k + r] >= 0; r++)
+			{
+				// Rounding can take the expansion slightly below 0 for near duplicates
+				Match & m = matches[(size_t)q * k + r];
+				m.index = top.index[(size_t)q * k + r];
+				m.distance = std::sqrt(std::max(0.f, top.dist[(size_t)q * k + r]));
+			}
+	}
+
+}
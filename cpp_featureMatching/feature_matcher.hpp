@@ -0,0 +1,47 @@
+#ifndef _FEATURES_FEATURE_MATCHER_HPP_
+#define _FEATURES_FEATURE_MATCHER_HPP_
+
+#include <vector>
+
+// Many-to-many nearest neighbour matching of float descriptors by Euclidean distance
+// All the queries of a frame are matched at once: their distances to the database are computed as
+// |q|^2 + |f|^2 - 2 q.f, where the dot products of a batch of queries with a block of the database are one small
+// matrix product (see feature_matcher.cpp), and the norms of the database are computed once here
+// Candidates are ranked by squared distance, the square root is only taken for the k matches returned
+
+namespace features{
+
+	/// One of the nearest database features of a query
+	struct Match
+	{
+		int index; // -1 where the database has fewer than k features
+		float distance; // Euclidean
+	};
+
+	class FeatureMatcher
+	{
+	public:
+		/// Copies count features of dim floats, feature i at features[i * stride]
+		FeatureMatcher(const float * features, int count, int dim, int stride);
+
+		int size() const { return m_count; }
+		int dim() const { return m_dim; }
+
+		/// Threads the database is split across, 0 (the default) for all hardware threads
+		void setNumThreads(int numThreads) { m_numThreads = numThreads; }
+
+		/// The k nearest features of every query, nearest first, into matches[q * k + r]
+		/// Query q at queries[q * stride], dim floats
+		void match(const float * queries, int numQueries, int stride, int k, std::vector<Match> & matches) const;
+
+	private:
+		int m_count;
+		int m_dim;
+		int m_numStrips;
+		std::vector<float> m_strips; // MATCH_NR features per strip, dimension by dimension, the last one zero padded
+		std::vector<float> m_norms; // squared, infinite for the padding
+		int m_numThreads = 0;
+	};
+
+}
+#endif
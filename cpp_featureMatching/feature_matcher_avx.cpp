@@ -0,0 +1,44 @@
+#include <immintrin.h> //AVX
+
+#include "feature_kernels.hpp"
+
+// Same as the FMA kernel with separate multiplies and adds, for AVX machines without FMA
+
+namespace features{
+
+	MatchMask matchTileAVX(int dim, const float * Q, int ldq, const float * strip, const float * qNorms, const float * fNorms, const float * bounds, float * dist)
+	{
+		__m256 c[MATCH_MR][2];
+		for (int r = 0; r < MATCH_MR; r++)
+			c[r][0] = c[r][1] = _mm256_setzero_ps();
+		for (int p = 0; p < dim; p++)
+		{
+			__m256 b0 = _mm256_loadu_ps(strip + p * MATCH_NR);
+			__m256 b1 = _mm256_loadu_ps(strip + p * MATCH_NR + 8);
+			for (int r = 0; r < MATCH_MR; r++)
+			{
+				__m256 a = _mm256_broadcast_ss(Q + r * ldq + p);
+				c[r][0] = _mm256_add_ps(c[r][0], _mm256_mul_ps(a, b0));
+				c[r][1] = _mm256_add_ps(c[r][1], _mm256_mul_ps(a, b1));
+			}
+		}
+		__m256 n0 = _mm256_loadu_ps(fNorms);
+		__m256 n1 = _mm256_loadu_ps(fNorms + 8);
+		__m256 two = _mm256_set1_ps(2.f);
+		MatchMask mask = 0;
+		for (int r = 0; r < MATCH_MR; r++)
+		{
+			__m256 qn = _mm256_broadcast_ss(qNorms + r);
+			__m256 d0 = _mm256_sub_ps(_mm256_add_ps(qn, n0), _mm256_mul_ps(two, c[r][0]));
+			__m256 d1 = _mm256_sub_ps(_mm256_add_ps(qn, n1), _mm256_mul_ps(two, c[r][1]));
+			_mm256_storeu_ps(dist + r * MATCH_NR, d0);
+			_mm256_storeu_ps(dist + r * MATCH_NR + 8, d1);
+			__m256 bound = _mm256_broadcast_ss(bounds + r);
+			unsigned m = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(d0, bound, _CMP_LT_OQ))
+				| (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(d1, bound, _CMP_LT_OQ)) << 8;
+			mask |= (MatchMask)m << (r * MATCH_NR);
+		}
+		return mask;
+	}
+
+}
@@ -0,0 +1,46 @@
+#include <immintrin.h> //AVX2, FMA
+
+#include "feature_kernels.hpp"
+
+// Assumes the machine has AVX2 and FMA instructions, feature_matcher.cpp only selects this kernel when cpuFeatures() reports both
+// Same register blocking as the GEMM micro-kernels of cpp_cholesky: per dimension 2 loads of the strip, 4 broadcasts
+// of the queries and 8 FMAs into independent accumulators
+
+namespace features{
+
+	MatchMask matchTileFMA(int dim, const float * Q, int ldq, const float * strip, const float * qNorms, const float * fNorms, const float * bounds, float * dist)
+	{
+		__m256 c[MATCH_MR][2];
+		for (int r = 0; r < MATCH_MR; r++)
+			c[r][0] = c[r][1] = _mm256_setzero_ps();
+		for (int p = 0; p < dim; p++)
+		{
+			__m256 b0 = _mm256_loadu_ps(strip + p * MATCH_NR);
+			__m256 b1 = _mm256_loadu_ps(strip + p * MATCH_NR + 8);
+			for (int r = 0; r < MATCH_MR; r++)
+			{
+				__m256 a = _mm256_broadcast_ss(Q + r * ldq + p);
+				c[r][0] = _mm256_fmadd_ps(a, b0, c[r][0]);
+				c[r][1] = _mm256_fmadd_ps(a, b1, c[r][1]);
+			}
+		}
+		__m256 n0 = _mm256_loadu_ps(fNorms);
+		__m256 n1 = _mm256_loadu_ps(fNorms + 8);
+		__m256 minus2 = _mm256_set1_ps(-2.f);
+		MatchMask mask = 0;
+		for (int r = 0; r < MATCH_MR; r++)
+		{
+			__m256 qn = _mm256_broadcast_ss(qNorms + r);
+			__m256 d0 = _mm256_fmadd_ps(minus2, c[r][0], _mm256_add_ps(qn, n0));
+			__m256 d1 = _mm256_fmadd_ps(minus2, c[r][1], _mm256_add_ps(qn, n1));
+			_mm256_storeu_ps(dist + r * MATCH_NR, d0);
+			_mm256_storeu_ps(dist + r * MATCH_NR + 8, d1);
+			__m256 bound = _mm256_broadcast_ss(bounds + r);
+			unsigned m = (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(d0, bound, _CMP_LT_OQ))
+				| (unsigned)_mm256_movemask_ps(_mm256_cmp_ps(d1, bound, _CMP_LT_OQ)) << 8;
+			mask |= (MatchMask)m << (r * MATCH_NR);
+		}
+		return mask;
+	}
+
+}
@@ -0,0 +1,44 @@
+#include <immintrin.h> //AVX2
+
+#include "feature_kernels.hpp"
+
+// Assumes the machine has AVX2, ivf_pq_index.cpp only selects this kernel when cpuFeatures() reports it
+// The 8 codes of one subspace of a block are 8 contiguous bytes, widened to 8 indices of one gather from the
+// table of that subspace; two blocks at a time hide the latency of the gathers
+
+namespace features{
+
+	static inline __m256 lookup(const unsigned char * codes, const float * lut, __m256 acc)
+	{
+		__m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)codes));
+		return _mm256_add_ps(acc, _mm256_i32gather_ps(lut, idx, 4));
+	}
+
+	void pqScanAVX2(const unsigned char * codes, int numBlocks, int numSubspaces, const float * lut, float * dist)
+	{
+		size_t blockBytes = (size_t)numSubspaces * PQ_BLOCK;
+		int b = 0;
+		for (; b + 2 <= numBlocks; b += 2)
+		{
+			const unsigned char * c0 = codes + b * blockBytes;
+			const unsigned char * c1 = c0 + blockBytes;
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = acc0;
+			for (int m = 0; m < numSubspaces; m++)
+			{
+				acc0 = lookup(c0 + m * PQ_BLOCK, lut + m * 256, acc0);
+				acc1 = lookup(c1 + m * PQ_BLOCK, lut + m * 256, acc1);
+			}
+			_mm256_storeu_ps(dist + b * PQ_BLOCK, acc0);
+			_mm256_storeu_ps(dist + (b + 1) * PQ_BLOCK, acc1);
+		}
+		for (; b < numBlocks; b++)
+		{
+			const unsigned char * c = codes + b * blockBytes;
+			__m256 acc = _mm256_setzero_ps();
+			for (int m = 0; m < numSubspaces; m++)
+				acc = lookup(c + m * PQ_BLOCK, lut + m * 256, acc);
+			_mm256_storeu_ps(dist + b * PQ_BLOCK, acc);
+		}
+	}
+
+}
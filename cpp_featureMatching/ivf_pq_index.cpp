@@ -0,0 +1,456 @@
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+#include <stdexcept>
+#include <thread>
+
+#include "ivf_pq_index.hpp"
+#include "feature_kernels.hpp"
+#include "top_k.hpp"
+#include "cpp_cholesky/cpu_features.hpp"
+#include "cpp_benchmark/perf_counters.hpp"
+
+// Training: k-means of a sample of the features for the coarse centroids, then k-means of the residuals of the
+// sample to their centroids, subspace by subspace, for the sub-centroids. The assignment step of every k-means
+// iteration, and the assignment and encoding of added features, are nearest neighbour searches of FeatureMatcher
+// Search: the nprobe nearest centroids of every query by FeatureMatcher, then the queries split across threads:
+// for every list probed the lookup tables, 256 distances per subspace, and a scan of the codes of the list by the
+// table kernel
+// With c the centroid of a list and y the sub-centroids of a code, |q - x|^2 ~ |q - c - y|^2, which is
+//   |q - c|^2 + sum over the subspaces of (|y_m|^2 + 2 c_m.y_m) - 2 q_m.y_m
+// |q - c|^2 comes with the probes, the middle terms are precomputed for every list and the last ones are computed
+// once per query, so the tables of a list are one addition per entry instead of a distance
+// Where the precomputed tables would be too large the tables of |q_m - c_m - y_m|^2 are computed for every list
+
+namespace features{
+
+	// Features assigned and encoded at a time by add(), bounds the memory of the residuals
+	const int IVF_PQ_ADD_BATCH = 65536;
+
+	// Largest precomputed tables (numLists x numSubspaces x 256 floats)
+	const size_t IVF_PQ_PRECOMPUTED_BYTES = 256 << 20;
+
+	// Sub-centroids per subspace, codes are bytes
+	const int PQ_CENTROIDS = 256;
+
+	// File layout, in the byte order of the machine: the magic, then 32-bit integers and the arrays, see save()
+	const char IVF_PQ_MAGIC[8] = { 'I', 'V', 'F', 'P', 'Q', 'I', 'D', 'X' };
+	const int IVF_PQ_VERSION = 1;
+
+	typedef void (*PqScanKernel)(const unsigned char * codes, int numBlocks, int numSubspaces, const float * lut, float * dist);
+
+	// Plain C++ kernel for machines without AVX2
+	static void pqScanCPP(const unsigned char * codes, int numBlocks, int numSubspaces, const float * lut, float * dist)
+	{
+		for (int b = 0; b < numBlocks; b++)
+			for (int j = 0; j < PQ_BLOCK; j++)
+			{
+				float sum = 0;
+				for (int m = 0; m < numSubspaces; m++)
+					sum += lut[m * 256 + codes[((size_t)b * numSubspaces + m) * PQ_BLOCK + j]];
+				dist[b * PQ_BLOCK + j] = sum;
+			}
+	}
+
+	static PqScanKernel selectPqScanKernel()
+	{
+		return linalg::cpuFeatures().avx2 ? &pqScanAVX2 : &pqScanCPP;
+	}
+
+	// Lloyd's k-means of count points of dim floats at points[i * stride], k x dim centroids
+	// Initialized from distinct random points, all of them (repeated) if count <= k, which are then exact
+	// An empty cluster takes half of the largest one: its centroid and the largest one are moved apart slightly
+	static void kmeans(const float * points, int count, int dim, int stride, int k, int iterations, int numThreads, std::mt19937 & rng,
+		std::vector<float> & centroids)
+	{
+		centroids.assign((size_t)k * dim, 0.f);
+		std::vector<int> order(count);
+		std::iota(order.begin(), order.end(), 0);
+		std::shuffle(order.begin(), order.end(), rng);
+		for (int c = 0; c < k; c++)
+			std::copy(points + (size_t)order[c % count] * stride, points + (size_t)order[c % count] * stride + dim, &centroids[(size_t)c * dim]);
+		if (count <= k)
+			return;
+
+		const float eps = 1.f / 1024;
+		std::vector<Match> assigned;
+		std::vector<double> sums((size_t)k * dim);
+		std::vector<int> sizes(k);
+		for (int it = 0; it < iterations; it++)
+		{
+			FeatureMatcher matcher(&centroids[0], k, dim, dim);
+			matcher.setNumThreads(numThreads);
+			matcher.match(points, count, stride, 1, assigned);
+
+			std::fill(sums.begin(), sums.end(), 0.0);
+			std::fill(sizes.begin(), sizes.end(), 0);
+			for (int i = 0; i < count; i++)
+			{
+				int c = assigned[i].index;
+				sizes[c]++;
+				for (int p = 0; p < dim; p++)
+					sums[(size_t)c * dim + p] += points[(size_t)i * stride + p];
+			}
+			for (int c = 0; c < k; c++)
+				if (sizes[c] > 0)
+					for (int p = 0; p < dim; p++)
+						centroids[(size_t)c * dim + p] = (float)(sums[(size_t)c * dim + p] / sizes[c]);
+			for (int c = 0; c < k; c++)
+				if (sizes[c] == 0)
+				{
+					int largest = (int)(std::max_element(sizes.begin(), sizes.end()) - sizes.begin());
+					for (int p = 0; p < dim; p++)
+					{
+						float v = centroids[(size_t)largest * dim + p];
+						float sign = p % 2 ? -1.f : 1.f;
+						centroids[(size_t)c * dim + p] = v * (1 + sign * eps);
+						centroids[(size_t)largest * dim + p] = v * (1 - sign * eps);
+					}
+					sizes[c] = sizes[largest] / 2;
+					sizes[largest] -= sizes[c];
+				}
+		}
+	}
+
+	IvfPqIndex::IvfPqIndex(int dim, const IvfPqParams & params) : m_dim(dim), m_params(params),
+		m_subDim((dim + params.numSubspaces - 1) / params.numSubspaces)
+	{
+		assert(dim > 0 && params.numLists > 0 && params.numSubspaces > 0);
+	}
+
+	int IvfPqIndex::threads() const
+	{
+		return m_numThreads > 0 ? m_numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+	}
+
+	void IvfPqIndex::buildCoarseMatcher()
+	{
+		m_coarse.reset(new FeatureMatcher(&m_centroids[0], m_params.numLists, m_dim, m_dim));
+		m_coarse->setNumThreads(m_numThreads);
+	}
+
+	void IvfPqIndex::setNumThreads(int numThreads)
+	{
+		m_numThreads = numThreads;
+		if (m_coarse)
+			m_coarse->setNumThreads(numThreads);
+	}
+
+	void IvfPqIndex::train(const float * features, int count, int stride)
+	{
+		assert(count > 0);
+		const int M = m_params.numSubspaces;
+		const int padded = M * m_subDim;
+		std::mt19937 rng(m_params.seed);
+
+		// A random sample, in random order
+		int sampleSize = (int)std::min<long>(count, (long)m_params.numLists * m_params.maxPointsPerCentroid);
+		std::vector<int> order(count);
+		std::iota(order.begin(), order.end(), 0);
+		for (int i = 0; i < sampleSize; i++)
+			std::swap(order[i], order[i + rng() % (count - i)]);
+		std::vector<float> sample((size_t)sampleSize * m_dim);
+		for (int i = 0; i < sampleSize; i++)
+			std::copy(features + (size_t)order[i] * stride, features + (size_t)order[i] * stride + m_dim, &sample[(size_t)i * m_dim]);
+
+		kmeans(&sample[0], sampleSize, m_dim, m_dim, m_params.numLists, m_params.iterations, m_numThreads, rng, m_centroids);
+		buildCoarseMatcher();
+
+		// Residuals of (at most PQ_CENTROIDS * maxPointsPerCentroid of) the sample
+		int pqSize = std::min(sampleSize, PQ_CENTROIDS * m_params.maxPointsPerCentroid);
+		std::vector<Match> assigned;
+		m_coarse->match(&sample[0], pqSize, m_dim, 1, assigned);
+		std::vector<float> residuals((size_t)pqSize * padded, 0.f);
+		for (int i = 0; i < pqSize; i++)
+			for (int p = 0; p < m_dim; p++)
+				residuals[(size_t)i * padded + p] = sample[(size_t)i * m_dim + p] - m_centroids[(size_t)assigned[i].index * m_dim + p];
+
+		m_codebooks.assign((size_t)M * m_subDim * PQ_CENTROIDS, 0.f);
+		std::vector<float> codebook;
+		for (int m = 0; m < M; m++)
+		{
+			kmeans(&residuals[(size_t)m * m_subDim], pqSize, m_subDim, padded, PQ_CENTROIDS, m_params.iterations, m_numThreads, rng, codebook);
+			for (int c = 0; c < PQ_CENTROIDS; c++)
+				for (int d = 0; d < m_subDim; d++)
+					m_codebooks[((size_t)m * m_subDim + d) * PQ_CENTROIDS + c] = codebook[(size_t)c * m_subDim + d];
+		}
+
+		m_lists.assign(m_params.numLists, InvertedList());
+		m_count = 0;
+		precomputeTables();
+	}
+
+	void IvfPqIndex::precomputeTables()
+	{
+		const int M = m_params.numSubspaces;
+		m_precomputed.clear();
+		if ((size_t)m_params.numLists * M * PQ_CENTROIDS * sizeof(float) > IVF_PQ_PRECOMPUTED_BYTES)
+			return;
+		// |y|^2 + 2 c.y = sum over the dimensions of y (y + 2 c)
+		m_precomputed.assign((size_t)m_params.numLists * M * PQ_CENTROIDS, 0.f);
+		for (int l = 0; l < m_params.numLists; l++)
+			for (int m = 0; m < M; m++)
+				for (int d = 0; d < m_subDim; d++)
+				{
+					int p = m * m_subDim + d;
+					float c2 = p < m_dim ? 2 * m_centroids[(size_t)l * m_dim + p] : 0.f;
+					const float * cb = &m_codebooks[(size_t)p * PQ_CENTROIDS];
+					float * table = &m_precomputed[((size_t)l * M + m) * PQ_CENTROIDS];
+					for (int c = 0; c < PQ_CENTROIDS; c++)
+						table[c] += cb[c] * (cb[c] + c2);
+				}
+	}
+
+	// The list of every feature and its codes, codes[i * numSubspaces + m]
+	void IvfPqIndex::encode(const float * features, int count, int stride, std::vector<int> & lists, std::vector<unsigned char> & codes) const
+	{
+		const int M = m_params.numSubspaces;
+		const int padded = M * m_subDim;
+		std::vector<Match> assigned;
+		m_coarse->match(features, count, stride, 1, assigned);
+		lists.resize(count);
+		std::vector<float> residuals((size_t)count * padded, 0.f);
+		for (int i = 0; i < count; i++)
+		{
+			lists[i] = assigned[i].index;
+			for (int p = 0; p < m_dim; p++)
+				residuals[(size_t)i * padded + p] = features[(size_t)i * stride + p] - m_centroids[(size_t)lists[i] * m_dim + p];
+		}
+
+		codes.resize((size_t)count * M);
+		std::vector<float> codebook((size_t)PQ_CENTROIDS * m_subDim);
+		for (int m = 0; m < M; m++)
+		{
+			for (int c = 0; c < PQ_CENTROIDS; c++)
+				for (int d = 0; d < m_subDim; d++)
+					codebook[(size_t)c * m_subDim + d] = m_codebooks[((size_t)m * m_subDim + d) * PQ_CENTROIDS + c];
+			FeatureMatcher matcher(&codebook[0], PQ_CENTROIDS, m_subDim, m_subDim);
+			matcher.setNumThreads(m_numThreads);
+			matcher.match(&residuals[(size_t)m * m_subDim], count, padded, 1, assigned);
+			for (int i = 0; i < count; i++)
+				codes[(size_t)i * M + m] = (unsigned char)assigned[i].index;
+		}
+	}
+
+	void IvfPqIndex::add(const float * features, int count, int stride)
+	{
+		assert(trained());
+		const int M = m_params.numSubspaces;
+		std::vector<int> lists;
+		std::vector<unsigned char> codes;
+		for (int i0 = 0; i0 < count; i0 += IVF_PQ_ADD_BATCH)
+		{
+			int n = std::min(IVF_PQ_ADD_BATCH, count - i0);
+			encode(features + (size_t)i0 * stride, n, stride, lists, codes);
+			for (int i = 0; i < n; i++)
+			{
+				InvertedList & list = m_lists[lists[i]];
+				size_t pos = list.ids.size();
+				list.ids.push_back(m_count + i0 + i);
+				if (pos % PQ_BLOCK == 0)
+					list.codes.resize(list.codes.size() + (size_t)M * PQ_BLOCK, 0);
+				unsigned char * block = &list.codes[pos / PQ_BLOCK * M * PQ_BLOCK];
+				for (int m = 0; m < M; m++)
+					block[m * PQ_BLOCK + pos % PQ_BLOCK] = codes[(size_t)i * M + m];
+			}
+		}
+		m_count += count;
+	}
+
+	void IvfPqIndex::search(const float * queries, int numQueries, int stride, int k, std::vector<Match> & matches) const
+	{
+		static const PqScanKernel scan = selectPqScanKernel();
+		matches.assign((size_t)numQueries * k, Match{ -1, std::numeric_limits<float>::infinity() });
+		if (numQueries == 0 || k <= 0 || m_count == 0)
+			return;
+		assert(trained());
+
+		const int M = m_params.numSubspaces;
+		const int padded = M * m_subDim;
+		int nprobe = std::min(std::max(1, m_nprobe), m_params.numLists);
+		std::vector<Match> probes;
+		m_coarse->match(queries, numQueries, stride, nprobe, probes);
+
+		// Threads take contiguous ranges of queries, and only touch their lists
+		TopK top(numQueries, k);
+		int numThreads = std::min(threads(), numQueries);
+		auto run = [&](int t)
+		{
+			BENCH_COUNTERS_SCOPE("ivfpq-search");
+			const size_t tableSize = (size_t)M * PQ_CENTROIDS;
+			const bool precomputed = !m_precomputed.empty();
+			std::vector<float> residual(padded, 0.f);
+			std::vector<float> queryTerms(tableSize);
+			std::vector<float> lut(tableSize);
+			std::vector<float> dist;
+			for (int q = (int)((long)numQueries * t / numThreads); q < (int)((long)numQueries * (t + 1) / numThreads); q++)
+			{
+				const float * query = queries + (size_t)q * stride;
+				// Dimension by dimension over all the sub-centroids, which vectorizes
+				if (precomputed)
+				{
+					std::fill(queryTerms.begin(), queryTerms.end(), 0.f);
+					for (int p = 0; p < m_dim; p++)
+					{
+						float x = -2 * query[p];
+						const float * cb = &m_codebooks[(size_t)p * PQ_CENTROIDS];
+						float * table = &queryTerms[(size_t)(p / m_subDim) * PQ_CENTROIDS];
+						for (int c = 0; c < PQ_CENTROIDS; c++)
+							table[c] += x * cb[c];
+					}
+				}
+
+				float bound = std::numeric_limits<float>::infinity();
+				for (int r = 0; r < nprobe; r++)
+				{
+					const Match & probe = probes[(size_t)q * nprobe + r];
+					const InvertedList & list = m_lists[probe.index];
+					if (list.ids.empty())
+						continue;
+					float coarse = 0;
+					if (precomputed)
+					{
+						coarse = probe.distance * probe.distance;
+						const float * listTerms = &m_precomputed[(size_t)probe.index * tableSize];
+						for (size_t i = 0; i < tableSize; i++)
+							lut[i] = listTerms[i] + queryTerms[i];
+					}
+					else
+					{
+						for (int p = 0; p < m_dim; p++)
+							residual[p] = query[p] - m_centroids[(size_t)probe.index * m_dim + p];
+						std::fill(lut.begin(), lut.end(), 0.f);
+						for (int p = 0; p < padded; p++)
+						{
+							float x = residual[p];
+							const float * cb = &m_codebooks[(size_t)p * PQ_CENTROIDS];
+							float * table = &lut[(size_t)(p / m_subDim) * PQ_CENTROIDS];
+							for (int c = 0; c < PQ_CENTROIDS; c++)
+								table[c] += (x - cb[c]) * (x - cb[c]);
+						}
+					}
+
+					int numBlocks = (int)((list.ids.size() + PQ_BLOCK - 1) / PQ_BLOCK);
+					dist.resize((size_t)numBlocks * PQ_BLOCK);
+					scan(&list.codes[0], numBlocks, M, &lut[0], &dist[0]);
+					for (size_t j = 0; j < list.ids.size(); j++)
+						if (coarse + dist[j] < bound)
+							bound = top.insert(q, coarse + dist[j], list.ids[j]);
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		for (int t = 1; t < numThreads; t++)
+			threads.push_back(std::thread(run, t));
+		run(0);
+		for (std::thread & thread : threads)
+			thread.join();
+
+		for (int q = 0; q < numQueries; q++)
+			for (int r = 0; r < k && top.index[(size_t)q * k + r] >= 0; r++)
+				matches[(size_t)q * k + r] = Match{ top.index[(size_t)q * k + r], std::sqrt(std::max(0.f, top.dist[(size_t)q * k + r])) };
+	}
+
+	template<typename T>
+	static void writeArray(std::ofstream & os, const std::vector<T> & v)
+	{
+		if (!v.empty())
+			os.write((const char *)&v[0], v.size() * sizeof(T));
+	}
+
+	template<typename T>
+	static void readArray(std::ifstream & is, std::vector<T> & v, size_t n)
+	{
+		v.resize(n);
+		if (n > 0)
+			is.read((char *)&v[0], n * sizeof(T));
+	}
+
+	static void writeInt(std::ofstream & os, int x)
+	{
+		os.write((const char *)&x, sizeof(x));
+	}
+
+	static int readInt(std::ifstream & is)
+	{
+		int x = 0;
+		is.read((char *)&x, sizeof(x));
+		return x;
+	}
+
+	void IvfPqIndex::save(const std::string & path) const
+	{
+		assert(trained());
+		std::ofstream os(path, std::ios::binary);
+		os.write(IVF_PQ_MAGIC, sizeof(IVF_PQ_MAGIC));
+		writeInt(os, IVF_PQ_VERSION);
+		writeInt(os, m_dim);
+		writeInt(os, m_params.numLists);
+		writeInt(os, m_params.numSubspaces);
+		writeInt(os, m_params.iterations);
+		writeInt(os, m_params.maxPointsPerCentroid);
+		writeInt(os, (int)m_params.seed);
+		writeInt(os, m_count);
+		writeArray(os, m_centroids);
+		writeArray(os, m_codebooks);
+		// Every list: its size, its ids, its codes
+		for (const InvertedList & list : m_lists)
+		{
+			writeInt(os, (int)list.ids.size());
+			writeArray(os, list.ids);
+			writeArray(os, list.codes);
+		}
+		os.close();
+		if (!os)
+			throw std::runtime_error("IvfPqIndex: cannot write " + path);
+	}
+
+	IvfPqIndex IvfPqIndex::load(const std::string & path)
+	{
+		std::ifstream is(path, std::ios::binary);
+		if (!is)
+			throw std::runtime_error("IvfPqIndex: cannot open " + path);
+		char magic[sizeof(IVF_PQ_MAGIC)];
+		is.read(magic, sizeof(magic));
+		if (!is || memcmp(magic, IVF_PQ_MAGIC, sizeof(magic)) != 0 || readInt(is) != IVF_PQ_VERSION)
+			throw std::runtime_error("IvfPqIndex: not an index of this version: " + path);
+
+		int dim = readInt(is);
+		IvfPqParams params;
+		params.numLists = readInt(is);
+		params.numSubspaces = readInt(is);
+		params.iterations = readInt(is);
+		params.maxPointsPerCentroid = readInt(is);
+		params.seed = (unsigned)readInt(is);
+		int count = readInt(is);
+		if (!is || dim <= 0 || params.numLists <= 0 || params.numSubspaces <= 0 || count < 0)
+			throw std::runtime_error("IvfPqIndex: bad header in " + path);
+
+		IvfPqIndex index(dim, params);
+		readArray(is, index.m_centroids, (size_t)params.numLists * dim);
+		readArray(is, index.m_codebooks, (size_t)params.numSubspaces * index.m_subDim * PQ_CENTROIDS);
+		index.m_lists.resize(params.numLists);
+		long total = 0;
+		for (InvertedList & list : index.m_lists)
+		{
+			int size = readInt(is);
+			if (!is || size < 0)
+				break;
+			readArray(is, list.ids, size);
+			readArray(is, list.codes, (size_t)(size + PQ_BLOCK - 1) / PQ_BLOCK * params.numSubspaces * PQ_BLOCK);
+			total += size;
+		}
+		if (!is || total != count)
+			throw std::runtime_error("IvfPqIndex: truncated or corrupt " + path);
+		index.m_count = count;
+		index.buildCoarseMatcher();
+		index.precomputeTables();
+		return index;
+	}
+
+}
@@ -0,0 +1,97 @@
+#ifndef _FEATURES_IVF_PQ_INDEX_HPP_
+#define _FEATURES_IVF_PQ_INDEX_HPP_
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "feature_matcher.hpp"
+
+// Approximate nearest neighbour index for large feature databases, an inverted file with product quantization:
+//   a coarse k-means quantizer splits the database into lists, a search only scans the nprobe lists whose
+//   centroids are nearest to the query
+//   within a list every feature is stored as the product quantized residual to its centroid: the residual split into
+//   numSubspaces sub-vectors, each replaced by the byte index of the nearest of 256 sub-centroids
+// The distance of a query to a code is the sum of one table lookup per subspace, the tables of the squared distances
+// of the query residual to the sub-centroids are set up once per list probed, mostly from terms precomputed for
+// every list (see ivf_pq_index.cpp)
+// Training, adding and searching run on several threads, the distance computations of training and adding are
+// those of FeatureMatcher
+
+namespace features{
+
+	struct IvfPqParams
+	{
+		int numLists = 1024; // coarse centroids, about sqrt(database size)
+		int numSubspaces = 16; // bytes per code
+		int iterations = 10; // of k-means
+		int maxPointsPerCentroid = 256; // training points sampled per centroid
+		unsigned seed = 1234;
+	};
+
+	class IvfPqIndex
+	{
+	public:
+		/// Untrained index of features of dim floats
+		explicit IvfPqIndex(int dim, const IvfPqParams & params = IvfPqParams());
+
+		int dim() const { return m_dim; }
+		int size() const { return m_count; }
+		int numLists() const { return m_params.numLists; }
+		int numSubspaces() const { return m_params.numSubspaces; }
+		bool trained() const { return (bool)m_coarse; }
+
+		/// Threads of training, adding and searching, 0 (the default) for all hardware threads
+		void setNumThreads(int numThreads);
+
+		/// Lists scanned per query: recall against speed
+		void setNprobe(int nprobe) { m_nprobe = nprobe; }
+		int nprobe() const { return m_nprobe; }
+
+		/// Learns the coarse centroids and the sub-centroids from a sample of count features, feature i at
+		/// features[i * stride], typically the database itself; clears the index
+		void train(const float * features, int count, int stride);
+
+		/// Adds count features, given the indices size() .. size() + count - 1, the index must be trained
+		void add(const float * features, int count, int stride);
+
+		/// The k nearest features of every query by their approximate distance, nearest first, into matches[q * k + r]
+		/// Query q at queries[q * stride], dim floats; the index must be trained
+		void search(const float * queries, int numQueries, int stride, int k, std::vector<Match> & matches) const;
+
+		/// Writes the trained index and its features in the byte order of this machine
+		/// Throws std::runtime_error if the file cannot be written
+		void save(const std::string & path) const;
+
+		/// Reads an index written by save(), threads and nprobe at their defaults
+		/// Throws std::runtime_error if the file cannot be read or is not an index
+		static IvfPqIndex load(const std::string & path);
+
+	private:
+		// Features of one coarse centroid
+		struct InvertedList
+		{
+			std::vector<int> ids;
+			std::vector<unsigned char> codes; // blocks of PQ_BLOCK features, see feature_kernels.hpp, the last one zero padded
+		};
+
+		void encode(const float * features, int count, int stride, std::vector<int> & lists, std::vector<unsigned char> & codes) const;
+		void buildCoarseMatcher();
+		void precomputeTables();
+		int threads() const;
+
+		int m_dim;
+		IvfPqParams m_params;
+		int m_subDim; // dimensions per subspace, the residuals zero padded to numSubspaces * m_subDim
+		int m_count = 0;
+		std::vector<float> m_centroids; // numLists x m_dim
+		std::vector<float> m_codebooks; // numSubspaces x m_subDim x 256, dimension by dimension for the lookup tables
+		std::vector<float> m_precomputed; // numLists x numSubspaces x 256 list terms of the tables, empty if too large
+		std::vector<InvertedList> m_lists;
+		std::unique_ptr<FeatureMatcher> m_coarse; // over m_centroids, once trained
+		int m_numThreads = 0;
+		int m_nprobe = 8;
+	};
+
+}
+#endif
@@ -0,0 +1,113 @@
+#include <immintrin.h> //AVX2, F16C, FMA
+
+#include "feature_kernels.hpp"
+
+// Assumes the machine has AVX2, F16C and FMA, quantized_features.cpp only selects these kernels when cpuFeatures() reports all three
+// Four rows at a time share the loads of the query and one horizontal reduction
+// Integer dot products: maddubs multiplies unsigned by signed bytes and adds adjacent pairs into 16 bits, madd with
+// ones adds adjacent 16-bit pairs into 32 bits. For int8 codes the sign of w is moved onto the codes (sign_epi8)
+// so that |w| can be the unsigned operand
+
+namespace features{
+
+	// [sum of a, sum of b, sum of c, sum of d]
+	static inline __m128i reduce4(__m256i a, __m256i b, __m256i c, __m256i d)
+	{
+		__m256i h = _mm256_hadd_epi32(_mm256_hadd_epi32(a, b), _mm256_hadd_epi32(c, d));
+		return _mm_add_epi32(_mm256_castsi256_si128(h), _mm256_extracti128_si256(h, 1));
+	}
+
+	static inline __m128 reduce4(__m256 a, __m256 b, __m256 c, __m256 d)
+	{
+		__m256 h = _mm256_hadd_ps(_mm256_hadd_ps(a, b), _mm256_hadd_ps(c, d));
+		return _mm_add_ps(_mm256_castps256_ps128(h), _mm256_extractf128_ps(h, 1));
+	}
+
+	// Products of 32 codes with 32 weights, added to acc
+	static inline __m256i dotStepU8(__m256i codes, __m256i w, __m256i acc)
+	{
+		return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(codes, w), _mm256_set1_epi16(1)));
+	}
+
+	static inline __m256i dotStepS8(__m256i codes, __m256i w, __m256i acc)
+	{
+		return _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_maddubs_epi16(_mm256_abs_epi8(w), _mm256_sign_epi8(codes, w)), _mm256_set1_epi16(1)));
+	}
+
+	template<__m256i (*step)(__m256i, __m256i, __m256i), typename Code>
+	static void dots(const Code * codes, int stride, int count, const signed char * w, int dim, int * out)
+	{
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const Code * row = codes + (size_t)i * stride;
+			__m256i acc0 = _mm256_setzero_si256(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+			for (int p = 0; p < dim; p += 32)
+			{
+				__m256i wp = _mm256_loadu_si256((const __m256i *)(w + p));
+				acc0 = step(_mm256_loadu_si256((const __m256i *)(row + p)), wp, acc0);
+				acc1 = step(_mm256_loadu_si256((const __m256i *)(row + stride + p)), wp, acc1);
+				acc2 = step(_mm256_loadu_si256((const __m256i *)(row + 2 * stride + p)), wp, acc2);
+				acc3 = step(_mm256_loadu_si256((const __m256i *)(row + 3 * stride + p)), wp, acc3);
+			}
+			_mm_storeu_si128((__m128i *)(out + i), reduce4(acc0, acc1, acc2, acc3));
+		}
+		for (; i < count; i++)
+		{
+			const Code * row = codes + (size_t)i * stride;
+			__m256i acc = _mm256_setzero_si256();
+			for (int p = 0; p < dim; p += 32)
+				acc = step(_mm256_loadu_si256((const __m256i *)(row + p)), _mm256_loadu_si256((const __m256i *)(w + p)), acc);
+			__m256i zero = _mm256_setzero_si256();
+			out[i] = _mm_cvtsi128_si32(reduce4(acc, zero, zero, zero));
+		}
+	}
+
+	void dotsU8AVX2(const unsigned char * codes, int stride, int count, const signed char * w, int dim, int * out)
+	{
+		dots<dotStepU8>(codes, stride, count, w, dim, out);
+	}
+
+	void dotsS8AVX2(const signed char * codes, int stride, int count, const signed char * w, int dim, int * out)
+	{
+		dots<dotStepS8>(codes, stride, count, w, dim, out);
+	}
+
+	// (q - codes)^2 of 16 dimensions, added to acc
+	static inline __m256 distanceStepF16(const unsigned short * codes, __m256 q0, __m256 q1, __m256 acc)
+	{
+		__m256 d0 = _mm256_sub_ps(q0, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)codes)));
+		__m256 d1 = _mm256_sub_ps(q1, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i *)(codes + 8))));
+		return _mm256_fmadd_ps(d1, d1, _mm256_fmadd_ps(d0, d0, acc));
+	}
+
+	void distancesF16AVX2(const unsigned short * codes, int stride, int count, const float * q, int dim, float * dist)
+	{
+		int i = 0;
+		for (; i + 4 <= count; i += 4)
+		{
+			const unsigned short * row = codes + (size_t)i * stride;
+			__m256 acc0 = _mm256_setzero_ps(), acc1 = acc0, acc2 = acc0, acc3 = acc0;
+			for (int p = 0; p < dim; p += 16)
+			{
+				__m256 q0 = _mm256_loadu_ps(q + p);
+				__m256 q1 = _mm256_loadu_ps(q + p + 8);
+				acc0 = distanceStepF16(row + p, q0, q1, acc0);
+				acc1 = distanceStepF16(row + stride + p, q0, q1, acc1);
+				acc2 = distanceStepF16(row + 2 * stride + p, q0, q1, acc2);
+				acc3 = distanceStepF16(row + 3 * stride + p, q0, q1, acc3);
+			}
+			_mm_storeu_ps(dist + i, reduce4(acc0, acc1, acc2, acc3));
+		}
+		for (; i < count; i++)
+		{
+			const unsigned short * row = codes + (size_t)i * stride;
+			__m256 acc = _mm256_setzero_ps();
+			for (int p = 0; p < dim; p += 16)
+				acc = distanceStepF16(row + p, _mm256_loadu_ps(q + p), _mm256_loadu_ps(q + p + 8), acc);
+			__m256 zero = _mm256_setzero_ps();
+			dist[i] = _mm_cvtss_f32(reduce4(acc, zero, zero, zero));
+		}
+	}
+
+}
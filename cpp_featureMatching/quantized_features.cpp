@@ -0,0 +1,302 @@
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <thread>
+
+#include "quantized_features.hpp"
+#include "feature_kernels.hpp"
+#include "top_k.hpp"
+#include "cpp_cholesky/cpu_features.hpp"
+#include "cpp_benchmark/perf_counters.hpp"
+
+// Integer formats: with a[p] = q[p] - offset[p] and c[p] the code of a feature,
+//   |q - x|^2 = sum a[p]^2 - 2 sum (a[p] scale[p]) c[p] + sum (scale[p] c[p])^2
+// The first term depends on the query only and the last on the feature only (m_norms), the middle one is a dot
+// product of the codes with per-query weights w[p] = a[p] scale[p], which are quantized to int8 as well
+// (w ~ alpha * w8, |w8| <= 64 for uint8 codes so that no pair sum of maddubs saturates, 127 for int8 codes)
+// FP16: the kernel converts the codes and computes the float distance directly
+// The database is split across threads, and every chunk of it that fits in L2 is scanned by all the queries in turn
+
+namespace features{
+
+	// Bytes of codes scanned by all the queries before moving on
+	const size_t QUANTIZED_CHUNK_BYTES = 256 * 1024;
+
+	struct QuantizedKernels
+	{
+		void (*dotsU8)(const unsigned char * codes, int stride, int count, const signed char * w, int dim, int * dots);
+		void (*dotsS8)(const signed char * codes, int stride, int count, const signed char * w, int dim, int * dots);
+		void (*distancesF16)(const unsigned short * codes, int stride, int count, const float * q, int dim, float * dist);
+	};
+
+	// Round to nearest even, as _mm_cvtps_ph, so that machines without F16C store the same codes
+	static unsigned short floatToHalf(float f)
+	{
+		unsigned int x;
+		memcpy(&x, &f, sizeof(x));
+		unsigned int sign = (x >> 16) & 0x8000;
+		unsigned int mant = x & 0x7fffff;
+		int biased = (x >> 23) & 0xff;
+		if (biased == 0xff)
+			return (unsigned short)(sign | 0x7c00 | (mant ? 0x200 : 0));
+		int exp = biased - 127 + 15;
+		if (exp >= 31)
+			return (unsigned short)(sign | 0x7c00);
+		unsigned int half, rem, halfway;
+		if (exp <= 0)
+		{
+			// Subnormal: value / 2^-24 with the implicit bit
+			if (exp < -10)
+				return (unsigned short)sign;
+			mant |= 0x800000;
+			int shift = 14 - exp;
+			half = mant >> shift;
+			rem = mant & ((1u << shift) - 1);
+			halfway = 1u << (shift - 1);
+		}
+		else
+		{
+			half = (unsigned int)exp << 10 | mant >> 13;
+			rem = mant & 0x1fff;
+			halfway = 0x1000;
+		}
+		// A carry out of the mantissa correctly increments the exponent
+		if (rem > halfway || (rem == halfway && (half & 1)))
+			half++;
+		return (unsigned short)(sign | half);
+	}
+
+	static float halfToFloat(unsigned short h)
+	{
+		unsigned int sign = (unsigned int)(h & 0x8000) << 16;
+		int exp = (h >> 10) & 0x1f;
+		unsigned int mant = h & 0x3ff;
+		if (exp == 0)
+		{
+			float f = std::ldexp((float)mant, -24);
+			return sign ? -f : f;
+		}
+		unsigned int x = sign | (exp == 31 ? 0x7f800000 : (unsigned int)(exp - 15 + 127) << 23) | mant << 13;
+		float f;
+		memcpy(&f, &x, sizeof(f));
+		return f;
+	}
+
+	// Plain C++ kernels for machines without AVX2
+	template<typename Code>
+	static void dotsCPP(const Code * codes, int stride, int count, const signed char * w, int dim, int * dots)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			int sum = 0;
+			for (int p = 0; p < dim; p++)
+				sum += codes[(size_t)i * stride + p] * w[p];
+			dots[i] = sum;
+		}
+	}
+
+	static void distancesF16CPP(const unsigned short * codes, int stride, int count, const float * q, int dim, float * dist)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			float sum = 0;
+			for (int p = 0; p < dim; p++)
+			{
+				float d = q[p] - halfToFloat(codes[(size_t)i * stride + p]);
+				sum += d * d;
+			}
+			dist[i] = sum;
+		}
+	}
+
+	static QuantizedKernels selectQuantizedKernels()
+	{
+		const linalg::CpuFeatures & f = linalg::cpuFeatures();
+		if (f.avx2 && f.f16c && f.fma)
+			return { &dotsU8AVX2, &dotsS8AVX2, &distancesF16AVX2 };
+		return { &dotsCPP<unsigned char>, &dotsCPP<signed char>, &distancesF16CPP };
+	}
+
+	// A query ready for the kernels
+	struct PreparedQuery
+	{
+		std::vector<signed char> w; // integer formats
+		float alpha = 0; // w ~ alpha * w8
+		float norm = 0; // sum of (q - offset)^2
+		std::vector<float> q; // FP16, zero padded
+	};
+
+	QuantizedFeatures::QuantizedFeatures(const float * features, int count, int dim, int stride, FeatureFormat format)
+		: m_count(count), m_dim(dim), m_format(format)
+	{
+		m_paddedDim = format == FeatureFormat::FP16 ? (dim + 15) / 16 * 16 : (dim + 31) / 32 * 32;
+		m_rowBytes = (size_t)m_paddedDim * (format == FeatureFormat::FP16 ? 2 : 1);
+		m_codes.assign((size_t)count * m_rowBytes, 0);
+		if (format == FeatureFormat::FP16)
+		{
+			for (int i = 0; i < count; i++)
+			{
+				unsigned short * row = (unsigned short *)&m_codes[(size_t)i * m_rowBytes];
+				for (int p = 0; p < dim; p++)
+					row[p] = floatToHalf(features[(size_t)i * stride + p]);
+			}
+			return;
+		}
+
+		// Range of every dimension
+		m_offset.assign(dim, 0.f);
+		m_scale.assign(dim, 1.f);
+		for (int p = 0; p < dim; p++)
+		{
+			float lo = std::numeric_limits<float>::infinity(), hi = -lo;
+			for (int i = 0; i < count; i++)
+			{
+				lo = std::min(lo, features[(size_t)i * stride + p]);
+				hi = std::max(hi, features[(size_t)i * stride + p]);
+			}
+			if (format == FeatureFormat::UINT8)
+			{
+				m_offset[p] = lo;
+				m_scale[p] = hi > lo ? (hi - lo) / 255 : 1.f;
+			}
+			else
+			{
+				float m = std::max(std::abs(lo), std::abs(hi));
+				m_scale[p] = m > 0 ? m / 127 : 1.f;
+			}
+		}
+
+		m_norms.assign(count, 0.f);
+		for (int i = 0; i < count; i++)
+		{
+			unsigned char * row = &m_codes[(size_t)i * m_rowBytes];
+			float norm = 0;
+			for (int p = 0; p < dim; p++)
+			{
+				float c = std::round((features[(size_t)i * stride + p] - m_offset[p]) / m_scale[p]);
+				if (format == FeatureFormat::UINT8)
+				{
+					c = std::min(255.f, std::max(0.f, c));
+					row[p] = (unsigned char)c;
+				}
+				else
+				{
+					c = std::min(127.f, std::max(-127.f, c));
+					row[p] = (unsigned char)(signed char)c;
+				}
+				norm += (m_scale[p] * c) * (m_scale[p] * c);
+			}
+			m_norms[i] = norm;
+		}
+	}
+
+	void QuantizedFeatures::search(const float * queries, int numQueries, int stride, int k, std::vector<Match> & matches) const
+	{
+		static const QuantizedKernels kernels = selectQuantizedKernels();
+		matches.assign((size_t)numQueries * k, Match{ -1, std::numeric_limits<float>::infinity() });
+		if (numQueries == 0 || k <= 0 || m_count == 0)
+			return;
+
+		std::vector<PreparedQuery> prepared(numQueries);
+		for (int q = 0; q < numQueries; q++)
+		{
+			PreparedQuery & pq = prepared[q];
+			const float * query = queries + (size_t)q * stride;
+			if (m_format == FeatureFormat::FP16)
+			{
+				pq.q.assign(m_paddedDim, 0.f);
+				std::copy(query, query + m_dim, pq.q.begin());
+				continue;
+			}
+			std::vector<float> w(m_dim);
+			float wMax = 0;
+			for (int p = 0; p < m_dim; p++)
+			{
+				float a = query[p] - m_offset[p];
+				pq.norm += a * a;
+				w[p] = a * m_scale[p];
+				wMax = std::max(wMax, std::abs(w[p]));
+			}
+			float limit = m_format == FeatureFormat::UINT8 ? 64.f : 127.f;
+			pq.alpha = wMax > 0 ? wMax / limit : 1.f;
+			pq.w.assign(m_paddedDim, 0);
+			for (int p = 0; p < m_dim; p++)
+				pq.w[p] = (signed char)std::round(w[p] / pq.alpha);
+		}
+
+		int candidates = std::max(k, m_rerankCandidates);
+		int numThreads = m_numThreads > 0 ? m_numThreads : std::max(1, (int)std::thread::hardware_concurrency());
+		numThreads = std::min(numThreads, m_count);
+		int chunk = (int)std::max<size_t>(4, QUANTIZED_CHUNK_BYTES / m_rowBytes);
+		std::vector<TopK> tops(numThreads, TopK(numQueries, candidates));
+
+		auto scan = [&](int t)
+		{
+			BENCH_COUNTERS_SCOPE("quantized-search");
+			int i0 = (int)((long)m_count * t / numThreads);
+			int i1 = (int)((long)m_count * (t + 1) / numThreads);
+			TopK & top = tops[t];
+			std::vector<int> dots(chunk);
+			std::vector<float> dist(chunk);
+			std::vector<float> bounds(numQueries, std::numeric_limits<float>::infinity());
+			for (int c0 = i0; c0 < i1; c0 += chunk)
+			{
+				int n = std::min(chunk, i1 - c0);
+				const unsigned char * codes = &m_codes[(size_t)c0 * m_rowBytes];
+				for (int q = 0; q < numQueries; q++)
+				{
+					const PreparedQuery & pq = prepared[q];
+					if (m_format == FeatureFormat::FP16)
+						kernels.distancesF16((const unsigned short *)codes, m_paddedDim, n, &pq.q[0], m_paddedDim, &dist[0]);
+					else
+					{
+						if (m_format == FeatureFormat::UINT8)
+							kernels.dotsU8(codes, m_paddedDim, n, &pq.w[0], m_paddedDim, &dots[0]);
+						else
+							kernels.dotsS8((const signed char *)codes, m_paddedDim, n, &pq.w[0], m_paddedDim, &dots[0]);
+						for (int i = 0; i < n; i++)
+							dist[i] = pq.norm + m_norms[c0 + i] - 2 * pq.alpha * dots[i];
+					}
+					for (int i = 0; i < n; i++)
+						if (dist[i] < bounds[q])
+							bounds[q] = top.insert(q, dist[i], c0 + i);
+				}
+			}
+		};
+		std::vector<std::thread> threads;
+		for (int t = 1; t < numThreads; t++)
+			threads.push_back(std::thread(scan, t));
+		scan(0);
+		for (std::thread & thread : threads)
+			thread.join();
+		TopK & top = tops[0];
+		for (int t = 1; t < numThreads; t++)
+			top.merge(tops[t], numQueries);
+
+		if (m_rerankCandidates > 0)
+		{
+			// Float distances of the candidates, the k best of them
+			TopK reranked(numQueries, k);
+			for (int q = 0; q < numQueries; q++)
+				for (int r = 0; r < candidates && top.index[(size_t)q * candidates + r] >= 0; r++)
+				{
+					int i = top.index[(size_t)q * candidates + r];
+					const float * x = m_rerankFeatures + (size_t)i * m_rerankStride;
+					const float * query = queries + (size_t)q * stride;
+					float sum = 0;
+					for (int p = 0; p < m_dim; p++)
+						sum += (query[p] - x[p]) * (query[p] - x[p]);
+					reranked.insert(q, sum, i);
+				}
+			for (int q = 0; q < numQueries; q++)
+				for (int r = 0; r < k && reranked.index[(size_t)q * k + r] >= 0; r++)
+					matches[(size_t)q * k + r] = Match{ reranked.index[(size_t)q * k + r], std::sqrt(reranked.dist[(size_t)q * k + r]) };
+			return;
+		}
+		for (int q = 0; q < numQueries; q++)
+			for (int r = 0; r < k && top.index[(size_t)q * candidates + r] >= 0; r++)
+				matches[(size_t)q * k + r] = Match{ top.index[(size_t)q * candidates + r], std::sqrt(std::max(0.f, top.dist[(size_t)q * candidates + r])) };
+	}
+
+}
@@ -0,0 +1,69 @@
+#ifndef _FEATURES_QUANTIZED_FEATURES_HPP_
+#define _FEATURES_QUANTIZED_FEATURES_HPP_
+
+#include <vector>
+
+#include "feature_matcher.hpp"
+
+// Feature database in 1 or 2 bytes per dimension instead of 4, searched by brute force
+// A search over float features reads the whole database for every batch of queries and is limited by memory
+// bandwidth, 1 byte codes are 4 times less to read and 32 of them are multiplied per AVX2 instruction
+// Distances from codes are approximate; re-ranking recomputes the float distances of the best candidates, which
+// recovers the exact order among them for a few extra rows read from the float features
+
+namespace features{
+
+	enum class FeatureFormat
+	{
+		UINT8, // x = offset[p] + scale[p] * code, code 0..255 over the range of dimension p in the database
+		INT8, // x = scale[p] * code, code -127..127 over the largest magnitude of dimension p
+		FP16 // IEEE half precision, converted with F16C
+	};
+
+	class QuantizedFeatures
+	{
+	public:
+		/// Encodes count features of dim floats, feature i at features[i * stride]
+		QuantizedFeatures(const float * features, int count, int dim, int stride, FeatureFormat format);
+
+		int size() const { return m_count; }
+		int dim() const { return m_dim; }
+		FeatureFormat format() const { return m_format; }
+
+		/// Bytes stored per feature, padding included
+		size_t bytesPerFeature() const { return m_rowBytes; }
+
+		/// Threads the database is split across, 0 (the default) for all hardware threads
+		void setNumThreads(int numThreads) { m_numThreads = numThreads; }
+
+		/// Re-ranks the best candidates of every search by their distance to the float features, feature i at
+		/// features[i * stride] (not copied, must stay valid); 0 candidates, the default, turns re-ranking off
+		void setRerank(const float * features, int stride, int candidates)
+		{
+			m_rerankFeatures = features;
+			m_rerankStride = stride;
+			m_rerankCandidates = features ? candidates : 0;
+		}
+
+		/// The k nearest features of every query, nearest first, into matches[q * k + r]
+		/// Query q at queries[q * stride], dim floats; distances from the codes unless re-ranked
+		void search(const float * queries, int numQueries, int stride, int k, std::vector<Match> & matches) const;
+
+	private:
+		int m_count;
+		int m_dim;
+		int m_paddedDim; // multiple of 32 codes, or of 16 for FP16
+		FeatureFormat m_format;
+		size_t m_rowBytes;
+		std::vector<unsigned char> m_codes; // m_count rows of m_rowBytes, zero padded
+		std::vector<float> m_offset; // per dimension, UINT8
+		std::vector<float> m_scale; // per dimension, UINT8 and INT8
+		std::vector<float> m_norms; // squared norm of every decoded feature minus the offset, UINT8 and INT8
+		int m_numThreads = 0;
+		const float * m_rerankFeatures = NULL;
+		int m_rerankStride = 0;
+		int m_rerankCandidates = 0;
+	};
+
+}
+#endif
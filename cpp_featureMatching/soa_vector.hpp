@@ -0,0 +1,335 @@
+#ifndef _FEATURES_SOA_VECTOR_HPP_
+#define _FEATURES_SOA_VECTOR_HPP_
+
+#include <cstdlib> //for aligned_alloc
+#include <cstring> //for memcpy
+#include <cstddef>
+#include <algorithm>
+#include <iterator>
+#include <new>
+#include <tuple>
+#include <type_traits>
+
+// Columnar container, the hot/cold split of featureMatching.cpp without writing it by hand:
+// SoAVector<Point, Feature> stores element i as Point i of one array and Feature i of another, so a loop over the
+// features only brings features into the cache, however large the points are, and the columns stay in sync
+// Elements are accessed through proxies, tuples of references to the fields of one element:
+//   v.push_back(point, feature);
+//   std::get<1>(v[i]) = feature;              // or v.get<1>(i)
+//   for (auto f : v.fields<1>())              // some of the fields of every element
+//       use(std::get<0>(f));
+//   const Feature * column = v.column<1>();   // for SIMD loops
+// Fields must be trivially copyable: columns are moved with memcpy and new elements are zero filled
+// Every column is SOA_ALIGNMENT aligned and holds a multiple of SOA_PADDING elements, the ones past size() zero, so
+// that vector loops can run over paddedSize() elements without a remainder loop
+
+namespace features{
+
+	/// Alignment of every column: a cache line, and an AVX-512 register
+	const size_t SOA_ALIGNMENT = 64;
+
+	/// Columns hold multiples of this many elements, 16 floats are one AVX-512 register
+	const size_t SOA_PADDING = 16;
+
+namespace util{
+
+	// std::index_sequence is C++14
+	template<size_t... Is> struct Indices {};
+	template<size_t N, size_t... Is> struct MakeIndices : MakeIndices<N - 1, N - 1, Is...> {};
+	template<size_t... Is> struct MakeIndices<0, Is...> { typedef Indices<Is...> type; };
+
+	inline size_t roundUp(size_t value, size_t multiple)
+	{
+		return (value + multiple - 1) / multiple * multiple;
+	}
+
+	// Zero filled, NULL for no elements
+	template<typename T>
+	T * allocateColumn(size_t capacity)
+	{
+		if (capacity == 0)
+			return NULL;
+		size_t bytes = roundUp(capacity * sizeof(T), SOA_ALIGNMENT);
+		void * mem = aligned_alloc(SOA_ALIGNMENT, bytes);
+		if (!mem)
+			throw std::bad_alloc();
+		memset(mem, 0, bytes);
+		return static_cast<T *>(mem);
+	}
+
+	// Operations on every column, through SoAVector::forEachColumn
+
+	struct ReallocateColumn
+	{
+		size_t size;
+		size_t capacity;
+		template<typename T> void operator()(T *& column) const
+		{
+			T * c = allocateColumn<T>(capacity);
+			if (size > 0)
+				memcpy(c, column, size * sizeof(T));
+			free(column);
+			column = c;
+		}
+	};
+
+	struct FreeColumn
+	{
+		template<typename T> void operator()(T *& column) const
+		{
+			free(column);
+			column = NULL;
+		}
+	};
+
+	struct ZeroElements
+	{
+		size_t first;
+		size_t last;
+		template<typename T> void operator()(T *& column) const
+		{
+			if (last > first)
+				memset(column + first, 0, (last - first) * sizeof(T));
+		}
+	};
+
+	struct MoveElements
+	{
+		size_t from;
+		size_t to;
+		size_t count;
+		template<typename T> void operator()(T *& column) const
+		{
+			if (count > 0)
+				memmove(column + to, column + from, count * sizeof(T));
+		}
+	};
+}
+
+	/// Some of the columns of a SoAVector: size() elements of the fields Ts, as tuples of references
+	/// Invalidated, as its iterators, by anything that reallocates the SoAVector
+	template<typename... Ts>
+	class SoAView
+	{
+	public:
+		typedef std::tuple<Ts &...> reference;
+
+		class iterator
+		{
+		public:
+			typedef std::forward_iterator_tag iterator_category;
+			typedef std::tuple<typename std::remove_const<Ts>::type...> value_type;
+			typedef std::ptrdiff_t difference_type;
+			typedef void pointer;
+			typedef std::tuple<Ts &...> reference;
+
+			iterator(const std::tuple<Ts *...> & columns, size_t index) : m_columns(columns), m_index(index) {}
+
+			reference operator*() const { return at(typename util::MakeIndices<sizeof...(Ts)>::type()); }
+			iterator & operator++() { ++m_index; return *this; }
+			iterator operator++(int) { iterator old = *this; ++m_index; return old; }
+			bool operator==(const iterator & other) const { return m_index == other.m_index; }
+			bool operator!=(const iterator & other) const { return m_index != other.m_index; }
+
+			/// Position of the element in the SoAVector
+			size_t index() const { return m_index; }
+
+		private:
+			template<size_t... Is>
+			reference at(util::Indices<Is...>) const { return reference(std::get<Is>(m_columns)[m_index]...); }
+
+			std::tuple<Ts *...> m_columns;
+			size_t m_index;
+		};
+
+		SoAView(const std::tuple<Ts *...> & columns, size_t size) : m_columns(columns), m_size(size) {}
+
+		size_t size() const { return m_size; }
+		iterator begin() const { return iterator(m_columns, 0); }
+		iterator end() const { return iterator(m_columns, m_size); }
+		reference operator[](size_t i) const { return *iterator(m_columns, i); }
+
+		/// Column I of the view
+		template<size_t I>
+		typename std::tuple_element<I, std::tuple<Ts...>>::type * column() const { return std::get<I>(m_columns); }
+
+	private:
+		std::tuple<Ts *...> m_columns;
+		size_t m_size;
+	};
+
+	template<typename... Fields>
+	class SoAVector
+	{
+		static_assert(sizeof...(Fields) > 0, "SoAVector needs at least one field");
+		typedef typename util::MakeIndices<sizeof...(Fields)>::type AllFields;
+
+	public:
+		typedef std::tuple<Fields...> value_type;
+		typedef std::tuple<Fields &...> reference;
+		typedef std::tuple<const Fields &...> const_reference;
+		typedef typename SoAView<Fields...>::iterator iterator;
+		typedef typename SoAView<const Fields...>::iterator const_iterator;
+		template<size_t I> using field_type = typename std::tuple_element<I, value_type>::type;
+
+		SoAVector() : m_columns(static_cast<Fields *>(NULL)...) { checkFields(); }
+
+		/// n zero filled elements
+		explicit SoAVector(size_t n) : SoAVector() { resize(n); }
+
+		SoAVector(const SoAVector & other) : SoAVector()
+		{
+			reserve(other.m_size);
+			m_size = other.m_size;
+			copyColumns(other, AllFields());
+		}
+
+		SoAVector(SoAVector && other) : m_columns(other.m_columns), m_size(other.m_size), m_capacity(other.m_capacity)
+		{
+			other.m_columns = std::tuple<Fields *...>(static_cast<Fields *>(NULL)...);
+			other.m_size = other.m_capacity = 0;
+		}
+
+		SoAVector & operator=(SoAVector other)
+		{
+			std::swap(m_columns, other.m_columns);
+			std::swap(m_size, other.m_size);
+			std::swap(m_capacity, other.m_capacity);
+			return *this;
+		}
+
+		~SoAVector() { forEachColumn(util::FreeColumn(), AllFields()); }
+
+		size_t size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+		size_t capacity() const { return m_capacity; }
+
+		/// size() rounded up to SOA_PADDING: the elements a vector loop may read, those past size() are zero
+		size_t paddedSize() const { return util::roundUp(m_size, SOA_PADDING); }
+
+		/// Field I of all the elements, SOA_ALIGNMENT aligned, NULL while nothing is allocated
+		template<size_t I> field_type<I> * column() { return std::get<I>(m_columns); }
+		template<size_t I> const field_type<I> * column() const { return std::get<I>(m_columns); }
+
+		/// Field I of element i
+		template<size_t I> field_type<I> & get(size_t i) { return column<I>()[i]; }
+		template<size_t I> const field_type<I> & get(size_t i) const { return column<I>()[i]; }
+
+		/// All the fields of element i, e.g. v[i] = std::make_tuple(point, feature)
+		reference operator[](size_t i) { return element<reference>(i, AllFields()); }
+		const_reference operator[](size_t i) const { return element<const_reference>(i, AllFields()); }
+
+		/// The fields Is of every element, e.g. for (auto f : v.fields<1>()) ...
+		template<size_t... Is>
+		SoAView<field_type<Is>...> fields() { return SoAView<field_type<Is>...>(std::tuple<field_type<Is> *...>(column<Is>()...), m_size); }
+		template<size_t... Is>
+		SoAView<const field_type<Is>...> fields() const
+		{
+			return SoAView<const field_type<Is>...>(std::tuple<const field_type<Is> *...>(column<Is>()...), m_size);
+		}
+
+		iterator begin() { return all(AllFields()).begin(); }
+		iterator end() { return all(AllFields()).end(); }
+		const_iterator begin() const { return all(AllFields()).begin(); }
+		const_iterator end() const { return all(AllFields()).end(); }
+
+		/// Capacity for n elements, rounded up to SOA_PADDING
+		void reserve(size_t n)
+		{
+			if (n <= m_capacity)
+				return;
+			m_capacity = util::roundUp(n, SOA_PADDING);
+			forEachColumn(util::ReallocateColumn{ m_size, m_capacity }, AllFields());
+		}
+
+		/// New elements are zero filled
+		void resize(size_t n)
+		{
+			if (n > m_capacity)
+				reserve(std::max(n, 2 * m_capacity));
+			if (n < m_size)
+				forEachColumn(util::ZeroElements{ n, m_size }, AllFields());
+			m_size = n;
+		}
+
+		void clear() { resize(0); }
+
+		void push_back(const Fields &... values)
+		{
+			if (m_size == m_capacity)
+			{
+				// The values may be elements of this vector
+				value_type copy(values...);
+				reserve(std::max(SOA_PADDING, 2 * m_capacity));
+				store(m_size, copy, AllFields());
+			}
+			else
+				store(m_size, value_type(values...), AllFields());
+			m_size++;
+		}
+
+		void pop_back() { resize(m_size - 1); }
+
+		/// Removes elements first .. last - 1, the following ones move down in every column
+		void erase(size_t first, size_t last)
+		{
+			forEachColumn(util::MoveElements{ last, first, m_size - last }, AllFields());
+			resize(m_size - (last - first));
+		}
+
+		void erase(size_t i) { erase(i, i + 1); }
+
+	private:
+		template<typename T>
+		static int checkField()
+		{
+			static_assert(std::is_trivially_copyable<T>::value, "SoAVector fields must be trivially copyable");
+			static_assert(alignof(T) <= SOA_ALIGNMENT, "SoAVector fields must not be over-aligned");
+			return 0;
+		}
+
+		static void checkFields()
+		{
+			int expand[] = { checkField<Fields>()... };
+			(void)expand;
+		}
+
+		template<typename F, size_t... Is>
+		void forEachColumn(const F & f, util::Indices<Is...>)
+		{
+			int expand[] = { (f(std::get<Is>(m_columns)), 0)... };
+			(void)expand;
+		}
+
+		template<size_t... Is>
+		void copyColumns(const SoAVector & other, util::Indices<Is...>)
+		{
+			if (m_size > 0)
+			{
+				int expand[] = { (memcpy(std::get<Is>(m_columns), std::get<Is>(other.m_columns), m_size * sizeof(field_type<Is>)), 0)... };
+				(void)expand;
+			}
+		}
+
+		template<size_t... Is>
+		void store(size_t i, const value_type & values, util::Indices<Is...>)
+		{
+			int expand[] = { (std::get<Is>(m_columns)[i] = std::get<Is>(values), 0)... };
+			(void)expand;
+		}
+
+		template<typename R, size_t... Is>
+		R element(size_t i, util::Indices<Is...>) const { return R(std::get<Is>(m_columns)[i]...); }
+
+		template<size_t... Is>
+		SoAView<Fields...> all(util::Indices<Is...>) { return fields<Is...>(); }
+		template<size_t... Is>
+		SoAView<const Fields...> all(util::Indices<Is...>) const { return fields<Is...>(); }
+
+		std::tuple<Fields *...> m_columns;
+		size_t m_size = 0;
+		size_t m_capacity = 0;
+	};
+
+}
+#endif
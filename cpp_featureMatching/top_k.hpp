@@ -0,0 +1,46 @@
+#ifndef _FEATURES_TOP_K_HPP_
+#define _FEATURES_TOP_K_HPP_
+
+#include <limits>
+#include <vector>
+
+namespace features{
+
+	// The k smallest squared distances of a group of queries, sorted, list q at [q * k]
+	struct TopK
+	{
+		TopK(int numQueries, int k) : k(k), dist((size_t)numQueries * k, std::numeric_limits<float>::infinity()), index((size_t)numQueries * k, -1) {}
+
+		// Keeps (d, i) if it is among the k best of query q, returns the new k-th distance
+		float insert(int q, float d, int i)
+		{
+			float * dq = &dist[(size_t)q * k];
+			int * iq = &index[(size_t)q * k];
+			if (!(d < dq[k - 1]))
+				return dq[k - 1];
+			int r = k - 1;
+			for (; r > 0 && dq[r - 1] > d; r--)
+			{
+				dq[r] = dq[r - 1];
+				iq[r] = iq[r - 1];
+			}
+			dq[r] = d;
+			iq[r] = i;
+			return dq[k - 1];
+		}
+
+		// Adds the lists of queries 0 .. numQueries - 1 of other, e.g. those of another thread
+		void merge(const TopK & other, int numQueries)
+		{
+			for (int q = 0; q < numQueries; q++)
+				for (int r = 0; r < k && other.index[(size_t)q * k + r] >= 0; r++)
+					insert(q, other.dist[(size_t)q * k + r], other.index[(size_t)q * k + r]);
+		}
+
+		int k;
+		std::vector<float> dist;
+		std::vector<int> index;
+	};
+
+}
+#endif